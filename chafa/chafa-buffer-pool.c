@@ -0,0 +1,205 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2018-2021 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that turns images into character art.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "config.h"
+#include "chafa.h"
+#include "internal/chafa-private.h"
+
+/**
+ * SECTION:chafa-buffer-pool
+ * @title: ChafaBufferPool
+ * @short_description: Recycles canvas buffers between frames
+ *
+ * A #ChafaBufferPool allows a set of canvases to recycle their internal
+ * cell arrays and working pixel buffers instead of freeing and
+ * reallocating them. This is useful when canvases are created and
+ * destroyed at a high rate with identical geometry, e.g. one per frame
+ * of a video stream.
+ *
+ * Attach the pool to a canvas with chafa_canvas_set_buffer_pool ().
+ * Canvases created from it with chafa_canvas_new_similar () inherit the
+ * pool. The pool is thread-safe and holds its buffers until it is
+ * freed.
+ **/
+
+/* Buffers are recycled only on an exact size match; a mix of geometries
+ * would otherwise slowly migrate every buffer to the largest size in
+ * use. Keep a modest cap so a one-off large canvas can't pin memory
+ * indefinitely. */
+#define BUFFER_POOL_MAX_BLOCKS 32
+
+typedef struct
+{
+    gpointer data;
+    gsize size;
+}
+PoolBlock;
+
+struct ChafaBufferPool
+{
+    gint refs;
+
+    GMutex mutex;
+    GSList *blocks;  /* PoolBlock */
+    gint n_blocks;
+};
+
+/* Internal: returns a buffer of exactly the requested size, reusing a
+ * pooled one if possible. The buffer comes from chafa_alloc_large (); it
+ * can be released back to any pool or freed with chafa_free_large (). */
+gpointer
+chafa_buffer_pool_acquire (ChafaBufferPool *pool, gsize size)
+{
+    GSList *l, *prev = NULL;
+    gpointer data = NULL;
+
+    g_mutex_lock (&pool->mutex);
+
+    for (l = pool->blocks; l; prev = l, l = g_slist_next (l))
+    {
+        PoolBlock *block = l->data;
+
+        if (block->size == size)
+        {
+            data = block->data;
+
+            if (prev)
+                prev->next = g_slist_remove_link (l, l);
+            else
+                pool->blocks = g_slist_remove_link (l, l);
+
+            pool->n_blocks--;
+            g_free (block);
+            g_slist_free_1 (l);
+            break;
+        }
+    }
+
+    g_mutex_unlock (&pool->mutex);
+
+    if (!data)
+        data = chafa_alloc_large (size);
+
+    return data;
+}
+
+/* Internal: returns a buffer to the pool, or frees it if the pool is
+ * already at capacity */
+void
+chafa_buffer_pool_release (ChafaBufferPool *pool, gpointer data, gsize size)
+{
+    PoolBlock *block;
+
+    if (!data)
+        return;
+
+    g_mutex_lock (&pool->mutex);
+
+    if (pool->n_blocks >= BUFFER_POOL_MAX_BLOCKS)
+    {
+        g_mutex_unlock (&pool->mutex);
+        chafa_free_large (data);
+        return;
+    }
+
+    block = g_new (PoolBlock, 1);
+    block->data = data;
+    block->size = size;
+    pool->blocks = g_slist_prepend (pool->blocks, block);
+    pool->n_blocks++;
+
+    g_mutex_unlock (&pool->mutex);
+}
+
+/**
+ * chafa_buffer_pool_new:
+ *
+ * Creates a new, empty #ChafaBufferPool.
+ *
+ * Returns: The new buffer pool
+ *
+ * Since: 1.10
+ **/
+ChafaBufferPool *
+chafa_buffer_pool_new (void)
+{
+    ChafaBufferPool *pool;
+
+    pool = g_new0 (ChafaBufferPool, 1);
+    pool->refs = 1;
+    g_mutex_init (&pool->mutex);
+
+    return pool;
+}
+
+/**
+ * chafa_buffer_pool_ref:
+ * @pool: Buffer pool to add a reference to
+ *
+ * Adds a reference to @pool.
+ *
+ * Since: 1.10
+ **/
+void
+chafa_buffer_pool_ref (ChafaBufferPool *pool)
+{
+    gint refs;
+
+    g_return_if_fail (pool != NULL);
+    refs = g_atomic_int_get (&pool->refs);
+    g_return_if_fail (refs > 0);
+
+    g_atomic_int_inc (&pool->refs);
+}
+
+/**
+ * chafa_buffer_pool_unref:
+ * @pool: Buffer pool to remove a reference from
+ *
+ * Removes a reference from @pool. When remaining references drops to
+ * zero, the pool and all buffers held in it are freed.
+ *
+ * Since: 1.10
+ **/
+void
+chafa_buffer_pool_unref (ChafaBufferPool *pool)
+{
+    gint refs;
+
+    g_return_if_fail (pool != NULL);
+    refs = g_atomic_int_get (&pool->refs);
+    g_return_if_fail (refs > 0);
+
+    if (g_atomic_int_dec_and_test (&pool->refs))
+    {
+        GSList *l;
+
+        for (l = pool->blocks; l; l = g_slist_next (l))
+        {
+            PoolBlock *block = l->data;
+
+            chafa_free_large (block->data);
+            g_free (block);
+        }
+
+        g_slist_free (pool->blocks);
+        g_mutex_clear (&pool->mutex);
+        g_free (pool);
+    }
+}
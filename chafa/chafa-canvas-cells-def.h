@@ -0,0 +1,304 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2018-2021 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that turns images into character art.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Expanded repeatedly from chafa-canvas.c to generate specialized variants
+ * of the per-cell update loop, one for each combination of per-frame
+ * constants. Before each inclusion, define:
+ *
+ * CHAFA_CELLS_VARIANT - suffix appended to the generated function names
+ * CHAFA_CELLS_INDEXED - 1 if cell colors resolve through the palette,
+ *                       0 if they are packed directly (truecolor and FGBG)
+ * CHAFA_CELLS_FG_ONLY - 1 if fg_only_enabled is set
+ * CHAFA_CELLS_WIDE    - 1 if the symbol map contains wide symbols
+ *
+ * The variant to run is picked once per frame in update_cells_rows(), so
+ * the per-cell loop carries no configuration branches. The macros are
+ * undefined at the end of this file; the including site only provides the
+ * four definitions. */
+
+#define CHAFA_CELLS_PASTE_2(a, b) a##_##b
+#define CHAFA_CELLS_PASTE(a, b) CHAFA_CELLS_PASTE_2 (a, b)
+#define CHAFA_CELLS_FUNC(name) CHAFA_CELLS_PASTE (name, CHAFA_CELLS_VARIANT)
+
+static gint
+CHAFA_CELLS_FUNC (update_cell) (ChafaCanvas *canvas, ChafaWorkCell *work_cell,
+                                ChafaCanvasCell *cell_out)
+{
+    gunichar sym = 0;
+    ChafaColorPair color_pair;
+#if CHAFA_CELLS_INDEXED
+    ChafaColorCandidates ccand;
+#endif
+    gint sym_error;
+
+    if (canvas->config.symbol_map.n_symbols == 0)
+        return SYMBOL_ERROR_MAX;
+
+    if (canvas->work_factor_int >= 8
+        && chafa_work_cell_get_range (work_cell) > FLAT_CELL_RANGE_MAX)
+        pick_symbol_and_colors_slow (canvas, work_cell, &sym, &color_pair, &sym_error);
+    else
+        pick_symbol_and_colors_fast (canvas, work_cell, &sym, &color_pair, &sym_error);
+
+    cell_out->c = sym;
+
+#if CHAFA_CELLS_INDEXED
+    chafa_palette_lookup_nearest (&canvas->palette, canvas->config.color_space, &color_pair.colors [CHAFA_COLOR_PAIR_FG], &ccand);
+    cell_out->fg_color = ccand.index [0];
+    chafa_palette_lookup_nearest (&canvas->palette, canvas->config.color_space, &color_pair.colors [CHAFA_COLOR_PAIR_BG], &ccand);
+    cell_out->bg_color = ccand.index [0];
+#else
+    cell_out->fg_color = chafa_pack_color (&color_pair.colors [CHAFA_COLOR_PAIR_FG]);
+    cell_out->bg_color = chafa_pack_color (&color_pair.colors [CHAFA_COLOR_PAIR_BG]);
+#endif
+
+#if CHAFA_CELLS_FG_ONLY
+    cell_out->bg_color = transparent_cell_color (canvas->config.canvas_mode);
+#endif
+
+    /* FIXME: It would probably be better to do the fgbg/bgfg blank symbol check
+     * from emit_ansi_fgbg_bgfg() here. */
+
+    return sym_error;
+}
+
+#if CHAFA_CELLS_WIDE
+
+/* Only generated for symbol maps that contain wide symbols; the variant
+ * selection guarantees n_symbols2 > 0 */
+static void
+CHAFA_CELLS_FUNC (update_cells_wide) (ChafaCanvas *canvas,
+                                      ChafaWorkCell *work_cell_a, ChafaWorkCell *work_cell_b,
+                                      ChafaCanvasCell *cell_a_out, ChafaCanvasCell *cell_b_out,
+                                      gint *error_a_out, gint *error_b_out)
+{
+    gunichar sym = 0;
+    ChafaColorPair color_pair;
+#if CHAFA_CELLS_INDEXED
+    ChafaColorCandidates ccand;
+#endif
+
+    *error_a_out = *error_b_out = SYMBOL_ERROR_MAX;
+
+    if (canvas->work_factor_int >= 8
+        && (chafa_work_cell_get_range (work_cell_a) > FLAT_CELL_RANGE_MAX
+            || chafa_work_cell_get_range (work_cell_b) > FLAT_CELL_RANGE_MAX))
+        pick_symbol_and_colors_wide_slow (canvas, work_cell_a, work_cell_b,
+                                          &sym, &color_pair,
+                                          error_a_out, error_b_out);
+    else
+        pick_symbol_and_colors_wide_fast (canvas, work_cell_a, work_cell_b,
+                                          &sym, &color_pair,
+                                          error_a_out, error_b_out);
+
+    cell_a_out->c = sym;
+    cell_b_out->c = 0;
+
+#if CHAFA_CELLS_INDEXED
+    chafa_palette_lookup_nearest (&canvas->palette, canvas->config.color_space, &color_pair.colors [CHAFA_COLOR_PAIR_FG], &ccand);
+    cell_a_out->fg_color = cell_b_out->fg_color = ccand.index [0];
+    chafa_palette_lookup_nearest (&canvas->palette, canvas->config.color_space, &color_pair.colors [CHAFA_COLOR_PAIR_BG], &ccand);
+    cell_a_out->bg_color = cell_b_out->bg_color = ccand.index [0];
+#else
+    cell_a_out->fg_color = cell_b_out->fg_color = chafa_pack_color (&color_pair.colors [CHAFA_COLOR_PAIR_FG]);
+    cell_a_out->bg_color = cell_b_out->bg_color = chafa_pack_color (&color_pair.colors [CHAFA_COLOR_PAIR_BG]);
+#endif
+
+#if CHAFA_CELLS_FG_ONLY
+    cell_a_out->bg_color = cell_b_out->bg_color = transparent_cell_color (canvas->config.canvas_mode);
+#endif
+}
+
+#endif /* CHAFA_CELLS_WIDE */
+
+static void
+CHAFA_CELLS_FUNC (update_cells_row) (ChafaCanvas *canvas, gint row, gint pixels_row)
+{
+    ChafaCanvasCell *cells;
+    ChafaWorkCell work_cells [N_BUF_CELLS];
+    gint cell_errors [N_BUF_CELLS];
+    guint8 cell_unchanged [N_BUF_CELLS];
+    guint64 *row_hashes = NULL;
+    gint *row_errors = NULL;
+    gboolean cache_valid = FALSE;
+    gint cx, cy;
+
+    cells = &canvas->cells [row * canvas->config.width];
+
+    /* The working image may hold just a strip of the canvas; pixels_row is
+     * the row's position within it */
+    cy = pixels_row;
+
+    if (canvas->cell_hashes)
+    {
+        row_hashes = canvas->cell_hashes + row * canvas->config.width;
+        row_errors = canvas->cell_errors + row * canvas->config.width;
+        cache_valid = canvas->cell_cache_valid;
+    }
+
+    for (cx = 0; cx < canvas->config.width; cx++)
+    {
+        gint buf_index = cx % N_BUF_CELLS;
+        ChafaWorkCell *wcell = &work_cells [buf_index];
+#if CHAFA_CELLS_WIDE
+        ChafaCanvasCell wide_cells [2];
+        gint wide_cell_errors [2];
+#endif
+        gboolean skip = FALSE;
+
+        chafa_work_cell_init (wcell, canvas->pixels, canvas->width_pixels, cx, cy);
+
+        cell_unchanged [buf_index] = FALSE;
+
+        if (row_hashes)
+        {
+            guint64 hash = hash_pixel_block (wcell->pixels);
+            gboolean unchanged = cache_valid && row_hashes [cx] == hash;
+
+            row_hashes [cx] = hash;
+            cell_unchanged [buf_index] = unchanged;
+
+            /* A cached right half of a wide pair (c == 0) is only valid if
+             * its left half is being kept too */
+            skip = unchanged
+                && (cells [cx].c != 0
+                    || (cx >= 1 && cell_unchanged [buf_cell_index (cx - 1)]));
+        }
+
+        if (skip)
+        {
+            /* Input matches the previous frame; reuse the stored cell and
+             * its error */
+            cell_errors [buf_index] = row_errors [cx];
+        }
+        else
+        {
+#if CHAFA_CELLS_WIDE
+            /* If this cell was the right-half shadow (c == 0) of a wide pair
+             * whose left half is being kept from the previous frame, the
+             * pair is now broken: our new contents may not re-pair with it
+             * below. Revert the left cell to its best narrow symbol first;
+             * the wide comparison gets to re-form the pair if it still
+             * wins. */
+            if (cx >= 1 && cells [cx].c == 0
+                && cell_unchanged [buf_cell_index (cx - 1)])
+            {
+                gint prev_buf_index = buf_cell_index (cx - 1);
+
+                memset (&cells [cx - 1], 0, sizeof (cells [cx - 1]));
+                cells [cx - 1].c = ' ';
+
+                cell_errors [prev_buf_index] =
+                    CHAFA_CELLS_FUNC (update_cell) (canvas,
+                                                    &work_cells [prev_buf_index],
+                                                    &cells [cx - 1]);
+                if (row_errors)
+                    row_errors [cx - 1] = cell_errors [prev_buf_index];
+            }
+#endif
+
+            memset (&cells [cx], 0, sizeof (cells [cx]));
+            cells [cx].c = ' ';
+
+            cell_errors [buf_index] = CHAFA_CELLS_FUNC (update_cell) (canvas, wcell, &cells [cx]);
+        }
+
+#if CHAFA_CELLS_WIDE
+        /* Try wide symbol. If this cell and the previous one are both
+         * unchanged, the stored cells already reflect last frame's verdict. */
+
+        /* FIXME: If we're overlapping the rightmost half of a wide symbol,
+         * try to revert it to two regular symbols and overwrite the rightmost
+         * one. */
+
+        if (cx >= 1 && cells [cx - 1].c != 0
+            && !(cell_unchanged [buf_index] && cell_unchanged [buf_cell_index (cx - 1)]))
+        {
+            gint wide_buf_index [2];
+
+            wide_buf_index [0] = buf_cell_index (cx - 1);
+            wide_buf_index [1] = buf_index;
+
+            CHAFA_CELLS_FUNC (update_cells_wide) (canvas,
+                                                  &work_cells [wide_buf_index [0]],
+                                                  &work_cells [wide_buf_index [1]],
+                                                  &wide_cells [0],
+                                                  &wide_cells [1],
+                                                  &wide_cell_errors [0],
+                                                  &wide_cell_errors [1]);
+
+            if (wide_cell_errors [0] + wide_cell_errors [1] <
+                cell_errors [wide_buf_index [0]] + cell_errors [wide_buf_index [1]])
+            {
+                cells [cx - 1] = wide_cells [0];
+                cells [cx] = wide_cells [1]; cells [cx].c = 0;
+                cell_errors [wide_buf_index [0]] = wide_cell_errors [0];
+                cell_errors [wide_buf_index [1]] = wide_cell_errors [1];
+
+                if (row_errors)
+                    row_errors [cx - 1] = wide_cell_errors [0];
+            }
+        }
+#endif
+
+        if (!skip)
+        {
+            /* If we produced a featureless cell, try fill */
+
+            /* FIXME: Check popcount == 0 or == 64 instead of symbol char */
+            if (cells [cx].c != 0 && (cells [cx].c == ' ' || cells [cx].c == 0x2588
+                                      || cells [cx].fg_color == cells [cx].bg_color))
+            {
+#if CHAFA_CELLS_FG_ONLY
+                apply_fill_fg_only (canvas, wcell, &cells [cx]);
+                cells [cx].bg_color = transparent_cell_color (canvas->config.canvas_mode);
+#else
+                apply_fill (canvas, wcell, &cells [cx]);
+#endif
+            }
+        }
+
+        /* If cell is still featureless after fill, use blank_char consistently */
+
+        if (cells [cx].c != 0 && (cells [cx].c == ' '
+                                  || cells [cx].fg_color == cells [cx].bg_color))
+        {
+            cells [cx].c = canvas->blank_char;
+
+            /* Copy FG color from previous cell in order to avoid emitting
+             * unnecessary control sequences changing it, but only if we're 100%
+             * sure the "blank" char has no foreground features. It's safest to
+             * permit this optimization only with ASCII space. */
+            if (canvas->blank_char == ' ' && cx > 0)
+                cells [cx].fg_color = cells [cx - 1].fg_color;
+        }
+
+        if (row_errors)
+            row_errors [cx] = cell_errors [buf_index];
+    }
+}
+
+#undef CHAFA_CELLS_FUNC
+#undef CHAFA_CELLS_PASTE
+#undef CHAFA_CELLS_PASTE_2
+
+#undef CHAFA_CELLS_VARIANT
+#undef CHAFA_CELLS_INDEXED
+#undef CHAFA_CELLS_FG_ONLY
+#undef CHAFA_CELLS_WIDE
@@ -87,6 +87,7 @@
  * @CHAFA_OPTIMIZATION_REUSE_ATTRIBUTES: Suppress redundant SGR control sequences.
  * @CHAFA_OPTIMIZATION_SKIP_CELLS: Reserved for future use.
  * @CHAFA_OPTIMIZATION_REPEAT_CELLS: Use REP sequence to compress repeated runs of similar cells.
+ * @CHAFA_OPTIMIZATION_REUSE_CELLS: Skip symbol re-evaluation for cells whose input pixels are unchanged since the last frame.
  * @CHAFA_OPTIMIZATION_NONE: All optimizations disabled.
  * @CHAFA_OPTIMIZATION_ALL: All optimizations enabled.
  **/
@@ -120,6 +121,10 @@ chafa_canvas_config_init (ChafaCanvasConfig *canvas_config)
     canvas_config->preprocessing_enabled = TRUE;
     canvas_config->optimizations = CHAFA_OPTIMIZATION_ALL;
     canvas_config->fg_only_enabled = FALSE;
+    canvas_config->frame_deltas_enabled = FALSE;
+    canvas_config->kitty_shm_enabled = FALSE;
+    canvas_config->source_retention_enabled = FALSE;
+    canvas_config->compression_level = 0;
 
     chafa_symbol_map_init (&canvas_config->symbol_map);
     chafa_symbol_map_add_by_tags (&canvas_config->symbol_map, CHAFA_SYMBOL_TAG_BLOCK);
@@ -936,3 +941,193 @@ chafa_canvas_config_set_fg_only_enabled (ChafaCanvasConfig *config, gboolean fg_
 
     config->fg_only_enabled = fg_only_enabled;
 }
+
+/**
+ * chafa_canvas_config_get_compression_level:
+ * @config: A #ChafaCanvasConfig
+ *
+ * Queries the compression level applied to image data in the canvas output.
+ *
+ * Returns: The compression level, ranging from 0 (none) to 9 (maximum)
+ *
+ * Since: 1.10
+ **/
+gint
+chafa_canvas_config_get_compression_level (const ChafaCanvasConfig *config)
+{
+    g_return_val_if_fail (config != NULL, 0);
+    g_return_val_if_fail (config->refs > 0, 0);
+
+    return config->compression_level;
+}
+
+/**
+ * chafa_canvas_config_set_compression_level:
+ * @config: A #ChafaCanvasConfig
+ * @compression_level: Desired compression level, ranging from 0 (none) to 9 (maximum)
+ *
+ * Sets the compression level to apply to image data in the canvas output.
+ * The default is 0, which disables compression. Higher levels produce less
+ * output at increasing CPU cost.
+ *
+ * This is currently honored by #CHAFA_PIXEL_MODE_KITTY, where a non-zero
+ * level enables deflate-compressed transmission if the library was built
+ * with zlib support and the terminal advertises
+ * #CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1_ZLIB. Other pixel modes
+ * ignore it.
+ *
+ * Since: 1.10
+ **/
+void
+chafa_canvas_config_set_compression_level (ChafaCanvasConfig *config, gint compression_level)
+{
+    g_return_if_fail (config != NULL);
+    g_return_if_fail (config->refs > 0);
+    g_return_if_fail (compression_level >= 0 && compression_level <= 9);
+
+    config->compression_level = compression_level;
+}
+
+/**
+ * chafa_canvas_config_get_frame_deltas_enabled:
+ * @config: A #ChafaCanvasConfig
+ *
+ * Queries whether frame deltas are enabled. See
+ * chafa_canvas_config_set_frame_deltas_enabled () for details.
+ *
+ * Returns: %TRUE if frame deltas are enabled
+ *
+ * Since: 1.10
+ **/
+gboolean
+chafa_canvas_config_get_frame_deltas_enabled (const ChafaCanvasConfig *config)
+{
+    g_return_val_if_fail (config != NULL, FALSE);
+    g_return_val_if_fail (config->refs > 0, FALSE);
+
+    return config->frame_deltas_enabled;
+}
+
+/**
+ * chafa_canvas_config_set_frame_deltas_enabled:
+ * @config: A #ChafaCanvasConfig
+ * @frame_deltas_enabled: Whether to enable frame deltas
+ *
+ * Indicates whether repeated draws to the same canvas may be emitted as
+ * partial updates of the previously emitted frame. This is useful for
+ * animations and video, where consecutive frames tend to be similar and
+ * the difference in output size can be dramatic.
+ *
+ * When enabled, the output of each frame is only meaningful when printed
+ * to a terminal that has already received the preceding frames, and it
+ * updates the existing image in place instead of displaying a new one at
+ * the cursor. The default is %FALSE, producing self-contained output.
+ *
+ * This is currently honored by #CHAFA_PIXEL_MODE_KITTY, when the terminal
+ * supports #CHAFA_TERM_SEQ_BEGIN_KITTY_IMAGE_FRAME_V1, and by
+ * #CHAFA_PIXEL_MODE_SIXELS, where color register definitions already in
+ * effect from previous frames are omitted. Other pixel modes ignore it.
+ *
+ * Since: 1.10
+ **/
+void
+chafa_canvas_config_set_frame_deltas_enabled (ChafaCanvasConfig *config, gboolean frame_deltas_enabled)
+{
+    g_return_if_fail (config != NULL);
+    g_return_if_fail (config->refs > 0);
+
+    config->frame_deltas_enabled = frame_deltas_enabled;
+}
+
+/**
+ * chafa_canvas_config_get_kitty_shm_enabled:
+ * @config: A #ChafaCanvasConfig
+ *
+ * Queries whether Kitty shared-memory transmission is enabled. See
+ * chafa_canvas_config_set_kitty_shm_enabled () for details.
+ *
+ * Returns: %TRUE if shared-memory transmission is enabled
+ *
+ * Since: 1.10
+ **/
+gboolean
+chafa_canvas_config_get_kitty_shm_enabled (const ChafaCanvasConfig *config)
+{
+    g_return_val_if_fail (config != NULL, FALSE);
+    g_return_val_if_fail (config->refs > 0, FALSE);
+
+    return config->kitty_shm_enabled;
+}
+
+/**
+ * chafa_canvas_config_set_kitty_shm_enabled:
+ * @config: A #ChafaCanvasConfig
+ * @kitty_shm_enabled: Whether to enable shared-memory transmission
+ *
+ * Indicates whether #CHAFA_PIXEL_MODE_KITTY output may pass pixel data
+ * through a POSIX shared memory object instead of encoding it into the
+ * output stream, reducing a full-screen image's escape sequence from
+ * megabytes to under a hundred bytes.
+ *
+ * This only works when the terminal runs on the same host as the caller,
+ * who is responsible for enabling it for local sessions only. If the
+ * shared memory object can't be created, or the terminal doesn't
+ * advertise #CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1_SHM, output
+ * falls back to direct transmission. The default is %FALSE.
+ *
+ * Since: 1.10
+ **/
+void
+chafa_canvas_config_set_kitty_shm_enabled (ChafaCanvasConfig *config, gboolean kitty_shm_enabled)
+{
+    g_return_if_fail (config != NULL);
+    g_return_if_fail (config->refs > 0);
+
+    config->kitty_shm_enabled = kitty_shm_enabled;
+}
+
+/**
+ * chafa_canvas_config_get_source_retention_enabled:
+ * @config: A #ChafaCanvasConfig
+ *
+ * Queries whether source image retention is enabled. See
+ * chafa_canvas_config_set_source_retention_enabled () for details.
+ *
+ * Returns: %TRUE if source retention is enabled
+ *
+ * Since: 1.10
+ **/
+gboolean
+chafa_canvas_config_get_source_retention_enabled (const ChafaCanvasConfig *config)
+{
+    g_return_val_if_fail (config != NULL, FALSE);
+    g_return_val_if_fail (config->refs > 0, FALSE);
+
+    return config->source_retention_enabled;
+}
+
+/**
+ * chafa_canvas_config_set_source_retention_enabled:
+ * @config: A #ChafaCanvasConfig
+ * @source_retention_enabled: Whether to retain source pixel data
+ *
+ * Indicates whether a canvas keeps a copy of the source-resolution pixel
+ * data passed to chafa_canvas_draw_all_pixels(). A canvas created with
+ * chafa_canvas_new_reflowed() can then redraw itself at a different
+ * geometry without the caller decoding the source again, e.g. on
+ * terminal resize.
+ *
+ * The copy costs memory proportional to the source image size. The
+ * default is %FALSE.
+ *
+ * Since: 1.10
+ **/
+void
+chafa_canvas_config_set_source_retention_enabled (ChafaCanvasConfig *config,
+                                                  gboolean source_retention_enabled)
+{
+    g_return_if_fail (config != NULL);
+    g_return_if_fail (config->refs > 0);
+
+    config->source_retention_enabled = source_retention_enabled;
+}
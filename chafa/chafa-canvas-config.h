@@ -100,6 +100,7 @@ typedef enum
     CHAFA_OPTIMIZATION_REUSE_ATTRIBUTES = (1 << 0),
     CHAFA_OPTIMIZATION_SKIP_CELLS = (1 << 1),
     CHAFA_OPTIMIZATION_REPEAT_CELLS = (1 << 2),
+    CHAFA_OPTIMIZATION_REUSE_CELLS = (1 << 3),
 
     CHAFA_OPTIMIZATION_NONE = 0,
     CHAFA_OPTIMIZATION_ALL = 0x7fffffff
@@ -209,6 +210,27 @@ gboolean chafa_canvas_config_get_fg_only_enabled (const ChafaCanvasConfig *confi
 CHAFA_AVAILABLE_IN_1_8
 void chafa_canvas_config_set_fg_only_enabled (ChafaCanvasConfig *config, gboolean fg_only_enabled);
 
+CHAFA_AVAILABLE_IN_1_10
+gint chafa_canvas_config_get_compression_level (const ChafaCanvasConfig *config);
+CHAFA_AVAILABLE_IN_1_10
+void chafa_canvas_config_set_compression_level (ChafaCanvasConfig *config, gint compression_level);
+
+CHAFA_AVAILABLE_IN_1_10
+gboolean chafa_canvas_config_get_frame_deltas_enabled (const ChafaCanvasConfig *config);
+CHAFA_AVAILABLE_IN_1_10
+void chafa_canvas_config_set_frame_deltas_enabled (ChafaCanvasConfig *config, gboolean frame_deltas_enabled);
+
+CHAFA_AVAILABLE_IN_1_10
+gboolean chafa_canvas_config_get_kitty_shm_enabled (const ChafaCanvasConfig *config);
+CHAFA_AVAILABLE_IN_1_10
+void chafa_canvas_config_set_kitty_shm_enabled (ChafaCanvasConfig *config, gboolean kitty_shm_enabled);
+
+CHAFA_AVAILABLE_IN_1_10
+gboolean chafa_canvas_config_get_source_retention_enabled (const ChafaCanvasConfig *config);
+CHAFA_AVAILABLE_IN_1_10
+void chafa_canvas_config_set_source_retention_enabled (ChafaCanvasConfig *config,
+                                                       gboolean source_retention_enabled);
+
 G_END_DECLS
 
 #endif /* __CHAFA_CANVAS_CONFIG_H__ */
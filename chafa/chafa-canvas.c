@@ -23,10 +23,12 @@
 #include <string.h>
 #include <glib.h>
 #include "chafa.h"
+#include "internal/chafa-batch.h"
 #include "internal/chafa-canvas-internal.h"
 #include "internal/chafa-canvas-printer.h"
 #include "internal/chafa-private.h"
 #include "internal/chafa-pixops.h"
+#include "internal/chafa-profile.h"
 #include "internal/chafa-work-cell.h"
 #include "internal/smolscale/smolscale.h"
 
@@ -54,6 +56,11 @@
  * limited by a similar constant in chafa-symbol-map.c */
 #define N_CANDIDATES_MAX 8
 
+/* Cells whose widest channel spread is at most this are considered flat
+ * and take the fast picker even at high work factors; with fg and bg
+ * nearly coinciding, the exhaustive search can't improve on it */
+#define FLAT_CELL_RANGE_MAX 8
+
 /* Dithering */
 #define DITHER_BASE_INTENSITY_FGBG 1.0
 #define DITHER_BASE_INTENSITY_8C   0.5
@@ -188,7 +195,8 @@ eval_symbol_colors_wide (ChafaCanvas *canvas, ChafaWorkCell *wcell_a, ChafaWorkC
 }
 
 static gint
-calc_error_plain (const ChafaPixel *block, const ChafaColorPair *color_pair, const guint8 *cov)
+calc_error_plain (const ChafaPixel *block, const ChafaColorPair *color_pair, const guint8 *cov,
+                  gint max_error)
 {
     gint error = 0;
     gint i;
@@ -199,13 +207,20 @@ calc_error_plain (const ChafaPixel *block, const ChafaColorPair *color_pair, con
         const ChafaPixel *p0 = block++;
 
         error += chafa_color_diff_fast (&color_pair->colors [p], &p0->col);
+
+        /* Bail once this symbol can't beat the best candidate; the caller
+         * only compares the result against it. Checking every 16 pixels
+         * keeps the overhead well below the work saved. */
+        if ((i & 0xf) == 0xf && error >= max_error)
+            break;
     }
 
     return error;
 }
 
 static gint
-calc_error_with_alpha (const ChafaPixel *block, const ChafaColorPair *color_pair, const guint8 *cov, ChafaColorSpace cs)
+calc_error_with_alpha (const ChafaPixel *block, const ChafaColorPair *color_pair, const guint8 *cov,
+                       ChafaColorSpace cs, gint max_error)
 {
     gint error = 0;
     gint i;
@@ -216,30 +231,49 @@ calc_error_with_alpha (const ChafaPixel *block, const ChafaColorPair *color_pair
         const ChafaPixel *p0 = block++;
 
         error += chafa_color_diff_slow (&color_pair->colors [p], &p0->col, cs);
+
+        if ((i & 0xf) == 0xf && error >= max_error)
+            break;
     }
 
     return error;
 }
 
+/* max_error permits early rejection: the returned error is exact if below
+ * max_error, otherwise merely guaranteed to be >= max_error. Pass
+ * SYMBOL_ERROR_MAX for a full evaluation. The SIMD kernels always run to
+ * completion; interrupting their accumulators mid-loop would cost more
+ * than it saves. */
 static void
 eval_symbol_error (ChafaCanvas *canvas, const ChafaWorkCell *wcell,
-                   const ChafaSymbol *sym, SymbolEval *eval)
+                   const ChafaSymbol *sym, SymbolEval *eval, gint max_error)
 {
     const guint8 *covp = (guint8 *) &sym->coverage [0];
     gint error;
 
     if (canvas->have_alpha)
     {
-        error = calc_error_with_alpha (wcell->pixels, &eval->colors, covp, canvas->config.color_space);
+        error = calc_error_with_alpha (wcell->pixels, &eval->colors, covp,
+                                       canvas->config.color_space, max_error);
     }
     else
     {
+#ifdef HAVE_AVX2_INTRINSICS
+        if (chafa_have_avx2 ())
+            error = calc_error_avx2 (wcell->pixels, &eval->colors, covp);
+        else
+#endif
 #ifdef HAVE_SSE41_INTRINSICS
         if (chafa_have_sse41 ())
             error = calc_error_sse41 (wcell->pixels, &eval->colors, covp);
         else
 #endif
-            error = calc_error_plain (wcell->pixels, &eval->colors, covp);
+#ifdef HAVE_NEON_INTRINSICS
+        if (chafa_have_neon ())
+            error = calc_error_neon (wcell->pixels, &eval->colors, covp);
+        else
+#endif
+            error = calc_error_plain (wcell->pixels, &eval->colors, covp, max_error);
     }
 
     eval->error = error;
@@ -247,15 +281,31 @@ eval_symbol_error (ChafaCanvas *canvas, const ChafaWorkCell *wcell,
 
 static void
 eval_symbol_error_wide (ChafaCanvas *canvas, const ChafaWorkCell *wcell_a, const ChafaWorkCell *wcell_b,
-                        const ChafaSymbol2 *sym, SymbolEval2 *wide_eval)
+                        const ChafaSymbol2 *sym, SymbolEval2 *wide_eval, gint max_error)
 {
     SymbolEval eval [2];
 
+#ifdef HAVE_AVX2_INTRINSICS
+    /* Both halves share a color pair, so they can be evaluated in a
+     * single interleaved pass */
+    if (!canvas->have_alpha && chafa_have_avx2 ())
+    {
+        calc_error_2_avx2 (wcell_a->pixels, wcell_b->pixels,
+                           &wide_eval->colors,
+                           (const guint8 *) sym->sym [0].coverage,
+                           (const guint8 *) sym->sym [1].coverage,
+                           &wide_eval->error [0], &wide_eval->error [1]);
+        return;
+    }
+#endif
+
     eval [0].colors = wide_eval->colors;
     eval [1].colors = wide_eval->colors;
 
-    eval_symbol_error (canvas, wcell_a, &sym->sym [0], &eval [0]);
-    eval_symbol_error (canvas, wcell_b, &sym->sym [1], &eval [1]);
+    /* The bound applies to the sum of both halves, so either half alone
+     * exceeding it is enough to reject the symbol */
+    eval_symbol_error (canvas, wcell_a, &sym->sym [0], &eval [0], max_error);
+    eval_symbol_error (canvas, wcell_b, &sym->sym [1], &eval [1], max_error);
 
     wide_eval->error [0] = eval [0].error;
     wide_eval->error [1] = eval [1].error;
@@ -280,7 +330,7 @@ eval_symbol (ChafaCanvas *canvas, ChafaWorkCell *wcell, gint sym_index,
         eval_symbol_colors (canvas, wcell, sym, &eval);
     }
 
-    eval_symbol_error (canvas, wcell, sym, &eval);
+    eval_symbol_error (canvas, wcell, sym, &eval, best_eval_inout->error);
 
     if (eval.error < best_eval_inout->error)
     {
@@ -313,7 +363,8 @@ eval_symbol_wide (ChafaCanvas *canvas, ChafaWorkCell *wcell_a, ChafaWorkCell *wc
 
     eval_symbol_error_wide (canvas, wcell_a, wcell_b,
                             sym2,
-                            &eval);
+                            &eval,
+                            best_eval_inout->error [0] + best_eval_inout->error [1]);
 
     if (eval.error [0] + eval.error [1] < best_eval_inout->error [0] + best_eval_inout->error [1])
     {
@@ -329,16 +380,41 @@ pick_symbol_and_colors_slow (ChafaCanvas *canvas,
                              ChafaColorPair *color_pair_out,
                              gint *error_out)
 {
+    const ChafaSymbol *symbols = canvas->config.symbol_map.symbols;
     SymbolEval best_eval;
     gint best_symbol = -1;
-    gint i;
+    ChafaColorPair contrast_pair;
+    gint cell_popcount;
+    gint n, pivot, a, b;
 
-    /* Find best symbol. All symbols are candidates. */
+    /* Find best symbol. All symbols are candidates, but visiting them by
+     * increasing popcount distance from the cell finds a strong one early,
+     * letting the error cutoff in eval_symbol() reject most of the rest
+     * after a partial evaluation. Symbols are sorted by popcount. */
 
     best_eval.error = SYMBOL_ERROR_MAX;
 
-    for (i = 0; canvas->config.symbol_map.symbols [i].c != 0; i++)
-        eval_symbol (canvas, wcell, i, &best_symbol, &best_eval);
+    for (n = 0; symbols [n].c != 0; n++)
+        ;
+
+    if (n > 0)
+    {
+        chafa_work_cell_get_contrasting_color_pair (wcell, &contrast_pair);
+        cell_popcount = chafa_population_count_u64 (chafa_work_cell_to_bitmap (wcell, &contrast_pair));
+
+        for (pivot = 0; pivot < n - 1 && symbols [pivot].popcount < cell_popcount; pivot++)
+            ;
+
+        for (a = pivot, b = pivot + 1; a >= 0 || b < n; )
+        {
+            if (b >= n
+                || (a >= 0 && cell_popcount - symbols [a].popcount
+                    <= symbols [b].popcount - cell_popcount))
+                eval_symbol (canvas, wcell, a--, &best_symbol, &best_eval);
+            else
+                eval_symbol (canvas, wcell, b++, &best_symbol, &best_eval);
+        }
+    }
 
     chafa_leave_mmx ();  /* Make FPU happy again */
 
@@ -365,16 +441,47 @@ pick_symbol_and_colors_wide_slow (ChafaCanvas *canvas,
                                   gint *error_a_out,
                                   gint *error_b_out)
 {
+    const ChafaSymbol2 *symbols2 = canvas->config.symbol_map.symbols2;
     SymbolEval2 best_eval;
     gint best_symbol = -1;
-    gint i;
+    ChafaColorPair contrast_pair;
+    gint cell_popcount;
+    gint n, pivot, a, b;
 
-    /* Find best symbol. All symbols are candidates. */
+    /* Find best symbol. All symbols are candidates; see
+     * pick_symbol_and_colors_slow() for the visiting order. Wide symbols
+     * are sorted by the summed popcount of their halves. */
 
     best_eval.error [0] = best_eval.error [1] = SYMBOL_ERROR_MAX;
 
-    for (i = 0; canvas->config.symbol_map.symbols2 [i].sym [0].c != 0; i++)
-        eval_symbol_wide (canvas, wcell_a, wcell_b, i, &best_symbol, &best_eval);
+    for (n = 0; symbols2 [n].sym [0].c != 0; n++)
+        ;
+
+    if (n > 0)
+    {
+        chafa_work_cell_get_contrasting_color_pair (wcell_a, &contrast_pair);
+        cell_popcount = chafa_population_count_u64 (chafa_work_cell_to_bitmap (wcell_a, &contrast_pair));
+        chafa_work_cell_get_contrasting_color_pair (wcell_b, &contrast_pair);
+        cell_popcount += chafa_population_count_u64 (chafa_work_cell_to_bitmap (wcell_b, &contrast_pair));
+
+        for (pivot = 0;
+             pivot < n - 1 && (symbols2 [pivot].sym [0].popcount
+                               + symbols2 [pivot].sym [1].popcount) < cell_popcount;
+             pivot++)
+            ;
+
+        for (a = pivot, b = pivot + 1; a >= 0 || b < n; )
+        {
+            if (b >= n
+                || (a >= 0 && cell_popcount - (symbols2 [a].sym [0].popcount
+                                               + symbols2 [a].sym [1].popcount)
+                    <= (symbols2 [b].sym [0].popcount
+                        + symbols2 [b].sym [1].popcount) - cell_popcount))
+                eval_symbol_wide (canvas, wcell_a, wcell_b, a--, &best_symbol, &best_eval);
+            else
+                eval_symbol_wide (canvas, wcell_a, wcell_b, b++, &best_symbol, &best_eval);
+        }
+    }
 
     chafa_leave_mmx ();  /* Make FPU happy again */
 
@@ -443,7 +550,23 @@ pick_symbol_and_colors_fast (ChafaCanvas *canvas,
     best_eval.error = SYMBOL_ERROR_MAX;
 
     for (i = 0; i < n_candidates; i++)
-        eval_symbol (canvas, wcell, candidates [i].symbol_index, &best_symbol, &best_eval);
+    {
+        gint sym_index = candidates [i].symbol_index;
+        gint j;
+
+        /* The same symbol can appear twice, as a normal and an inverted
+         * candidate. Evaluation doesn't depend on inversion, so score
+         * each symbol once. */
+        for (j = 0; j < i; j++)
+        {
+            if (candidates [j].symbol_index == sym_index)
+                break;
+        }
+        if (j < i)
+            continue;
+
+        eval_symbol (canvas, wcell, sym_index, &best_symbol, &best_eval);
+    }
 
     chafa_leave_mmx ();  /* Make FPU happy again */
 
@@ -515,8 +638,23 @@ pick_symbol_and_colors_wide_fast (ChafaCanvas *canvas,
     best_eval.error [0] = best_eval.error [1] = SYMBOL_ERROR_MAX;
 
     for (i = 0; i < n_candidates; i++)
-        eval_symbol_wide (canvas, wcell_a, wcell_b, candidates [i].symbol_index,
+    {
+        gint sym_index = candidates [i].symbol_index;
+        gint j;
+
+        /* See pick_symbol_and_colors_fast(): score each symbol once even
+         * if it's a candidate both ways up */
+        for (j = 0; j < i; j++)
+        {
+            if (candidates [j].symbol_index == sym_index)
+                break;
+        }
+        if (j < i)
+            continue;
+
+        eval_symbol_wide (canvas, wcell_a, wcell_b, sym_index,
                           &best_symbol, &best_eval);
+    }
 
     chafa_leave_mmx ();  /* Make FPU happy again */
 
@@ -714,97 +852,6 @@ done:
     cell->c = canvas->config.fill_symbol_map.symbols [sym_cand.symbol_index].c;
 }
 
-static gint
-update_cell (ChafaCanvas *canvas, ChafaWorkCell *work_cell, ChafaCanvasCell *cell_out)
-{
-    gunichar sym = 0;
-    ChafaColorCandidates ccand;
-    ChafaColorPair color_pair;
-    gint sym_error;
-
-    if (canvas->config.symbol_map.n_symbols == 0)
-        return SYMBOL_ERROR_MAX;
-
-    if (canvas->work_factor_int >= 8)
-        pick_symbol_and_colors_slow (canvas, work_cell, &sym, &color_pair, &sym_error);
-    else
-        pick_symbol_and_colors_fast (canvas, work_cell, &sym, &color_pair, &sym_error);
-
-    cell_out->c = sym;
-
-    if (canvas->config.canvas_mode == CHAFA_CANVAS_MODE_INDEXED_256
-        || canvas->config.canvas_mode == CHAFA_CANVAS_MODE_INDEXED_240
-        || canvas->config.canvas_mode == CHAFA_CANVAS_MODE_INDEXED_16
-        || canvas->config.canvas_mode == CHAFA_CANVAS_MODE_INDEXED_8
-        || canvas->config.canvas_mode == CHAFA_CANVAS_MODE_FGBG_BGFG)
-    {
-        chafa_palette_lookup_nearest (&canvas->palette, canvas->config.color_space, &color_pair.colors [CHAFA_COLOR_PAIR_FG], &ccand);
-        cell_out->fg_color = ccand.index [0];
-        chafa_palette_lookup_nearest (&canvas->palette, canvas->config.color_space, &color_pair.colors [CHAFA_COLOR_PAIR_BG], &ccand);
-        cell_out->bg_color = ccand.index [0];
-    }
-    else
-    {
-        cell_out->fg_color = chafa_pack_color (&color_pair.colors [CHAFA_COLOR_PAIR_FG]);
-        cell_out->bg_color = chafa_pack_color (&color_pair.colors [CHAFA_COLOR_PAIR_BG]);
-    }
-
-    if (canvas->config.fg_only_enabled)
-        cell_out->bg_color = transparent_cell_color (canvas->config.canvas_mode);
-
-    /* FIXME: It would probably be better to do the fgbg/bgfg blank symbol check
-     * from emit_ansi_fgbg_bgfg() here. */
-
-    return sym_error;
-}
-
-static void
-update_cells_wide (ChafaCanvas *canvas, ChafaWorkCell *work_cell_a, ChafaWorkCell *work_cell_b,
-                   ChafaCanvasCell *cell_a_out, ChafaCanvasCell *cell_b_out,
-                   gint *error_a_out, gint *error_b_out)
-{
-    gunichar sym = 0;
-    ChafaColorCandidates ccand;
-    ChafaColorPair color_pair;
-
-    *error_a_out = *error_b_out = SYMBOL_ERROR_MAX;
-
-    if (canvas->config.symbol_map.n_symbols2 == 0)
-        return;
-
-    if (canvas->work_factor_int >= 8)
-        pick_symbol_and_colors_wide_slow (canvas, work_cell_a, work_cell_b,
-                                          &sym, &color_pair,
-                                          error_a_out, error_b_out);
-    else
-        pick_symbol_and_colors_wide_fast (canvas, work_cell_a, work_cell_b,
-                                          &sym, &color_pair,
-                                          error_a_out, error_b_out);
-
-    cell_a_out->c = sym;
-    cell_b_out->c = 0;
-
-    if (canvas->config.canvas_mode == CHAFA_CANVAS_MODE_INDEXED_256
-        || canvas->config.canvas_mode == CHAFA_CANVAS_MODE_INDEXED_240
-        || canvas->config.canvas_mode == CHAFA_CANVAS_MODE_INDEXED_16
-        || canvas->config.canvas_mode == CHAFA_CANVAS_MODE_INDEXED_8
-        || canvas->config.canvas_mode == CHAFA_CANVAS_MODE_FGBG_BGFG)
-    {
-        chafa_palette_lookup_nearest (&canvas->palette, canvas->config.color_space, &color_pair.colors [CHAFA_COLOR_PAIR_FG], &ccand);
-        cell_a_out->fg_color = cell_b_out->fg_color = ccand.index [0];
-        chafa_palette_lookup_nearest (&canvas->palette, canvas->config.color_space, &color_pair.colors [CHAFA_COLOR_PAIR_BG], &ccand);
-        cell_a_out->bg_color = cell_b_out->bg_color = ccand.index [0];
-    }
-    else
-    {
-        cell_a_out->fg_color = cell_b_out->fg_color = chafa_pack_color (&color_pair.colors [CHAFA_COLOR_PAIR_FG]);
-        cell_a_out->bg_color = cell_b_out->bg_color = chafa_pack_color (&color_pair.colors [CHAFA_COLOR_PAIR_BG]);
-    }
-
-    if (canvas->config.fg_only_enabled)
-        cell_a_out->bg_color = cell_b_out->bg_color = transparent_cell_color (canvas->config.canvas_mode);
-}
-
 /* Number of entries in our cell ring buffer. This allows us to do lookback
  * and replace single-cell symbols with double-cell ones if it improves
  * the error value. */
@@ -813,128 +860,215 @@ update_cells_wide (ChafaCanvas *canvas, ChafaWorkCell *work_cell_a, ChafaWorkCel
 /* Calculate index after positive or negative wraparound(s) */
 #define buf_cell_index(i) (((i) + N_BUF_CELLS * 64) % N_BUF_CELLS)
 
-static void
-update_cells_row (ChafaCanvas *canvas, gint row)
+/* FNV-1a over a cell's prepared pixels, in 64-bit strides */
+static guint64
+hash_pixel_block (const ChafaPixel *pixels)
 {
-    ChafaCanvasCell *cells;
-    ChafaWorkCell work_cells [N_BUF_CELLS];
-    gint cell_errors [N_BUF_CELLS];
-    gint cx, cy;
-
-    cells = &canvas->cells [row * canvas->config.width];
-    cy = row;
-
-    for (cx = 0; cx < canvas->config.width; cx++)
-    {
-        gint buf_index = cx % N_BUF_CELLS;
-        ChafaWorkCell *wcell = &work_cells [buf_index];
-        ChafaCanvasCell wide_cells [2];
-        gint wide_cell_errors [2];
-
-        memset (&cells [cx], 0, sizeof (cells [cx]));
-        cells [cx].c = ' ';
-
-        chafa_work_cell_init (wcell, canvas->pixels, canvas->width_pixels, cx, cy);
-        cell_errors [buf_index] = update_cell (canvas, wcell, &cells [cx]);
-
-        /* Try wide symbol */
-
-        /* FIXME: If we're overlapping the rightmost half of a wide symbol,
-         * try to revert it to two regular symbols and overwrite the rightmost
-         * one. */
-
-        if (cx >= 1 && cells [cx - 1].c != 0)
-        {
-            gint wide_buf_index [2];
-
-            wide_buf_index [0] = buf_cell_index (cx - 1);
-            wide_buf_index [1] = buf_index;
-
-            update_cells_wide (canvas,
-                               &work_cells [wide_buf_index [0]],
-                               &work_cells [wide_buf_index [1]],
-                               &wide_cells [0],
-                               &wide_cells [1],
-                               &wide_cell_errors [0],
-                               &wide_cell_errors [1]);
-
-            if (wide_cell_errors [0] + wide_cell_errors [1] <
-                cell_errors [wide_buf_index [0]] + cell_errors [wide_buf_index [1]])
-            {
-                cells [cx - 1] = wide_cells [0];
-                cells [cx] = wide_cells [1]; cells [cx].c = 0;
-                cell_errors [wide_buf_index [0]] = wide_cell_errors [0];
-                cell_errors [wide_buf_index [1]] = wide_cell_errors [1];
-            }
-        }
+    const guint64 *p = (const guint64 *) pixels;
+    guint64 h = 0xcbf29ce484222325;
+    gint i;
 
-        /* If we produced a featureless cell, try fill */
+    for (i = 0; i < CHAFA_SYMBOL_N_PIXELS * (gint) sizeof (ChafaPixel) / (gint) sizeof (guint64); i++)
+        h = (h ^ p [i]) * 0x100000001b3;
 
-        /* FIXME: Check popcount == 0 or == 64 instead of symbol char */
-        if (cells [cx].c != 0 && (cells [cx].c == ' ' || cells [cx].c == 0x2588
-                                  || cells [cx].fg_color == cells [cx].bg_color))
-        {
-            if (canvas->config.fg_only_enabled)
-            {
-                apply_fill_fg_only (canvas, wcell, &cells [cx]);
-                cells [cx].bg_color = transparent_cell_color (canvas->config.canvas_mode);
-            }
-            else
-            {
-                apply_fill (canvas, wcell, &cells [cx]);
-            }
-        }
+    return h;
+}
 
-        /* If cell is still featureless after fill, use blank_char consistently */
+/* Generate specialized variants of the cell update loop. The configuration
+ * flags below are constant for the duration of a frame, and folding them at
+ * compile time keeps the per-cell loop free of configuration branches. The
+ * variant to run is picked once per frame in update_cells_rows(). */
+
+#define CHAFA_CELLS_VARIANT direct
+#define CHAFA_CELLS_INDEXED 0
+#define CHAFA_CELLS_FG_ONLY 0
+#define CHAFA_CELLS_WIDE 0
+#include "chafa-canvas-cells-def.h"
+
+#define CHAFA_CELLS_VARIANT direct_wide
+#define CHAFA_CELLS_INDEXED 0
+#define CHAFA_CELLS_FG_ONLY 0
+#define CHAFA_CELLS_WIDE 1
+#include "chafa-canvas-cells-def.h"
+
+#define CHAFA_CELLS_VARIANT direct_fgonly
+#define CHAFA_CELLS_INDEXED 0
+#define CHAFA_CELLS_FG_ONLY 1
+#define CHAFA_CELLS_WIDE 0
+#include "chafa-canvas-cells-def.h"
+
+#define CHAFA_CELLS_VARIANT direct_fgonly_wide
+#define CHAFA_CELLS_INDEXED 0
+#define CHAFA_CELLS_FG_ONLY 1
+#define CHAFA_CELLS_WIDE 1
+#include "chafa-canvas-cells-def.h"
+
+#define CHAFA_CELLS_VARIANT indexed
+#define CHAFA_CELLS_INDEXED 1
+#define CHAFA_CELLS_FG_ONLY 0
+#define CHAFA_CELLS_WIDE 0
+#include "chafa-canvas-cells-def.h"
+
+#define CHAFA_CELLS_VARIANT indexed_wide
+#define CHAFA_CELLS_INDEXED 1
+#define CHAFA_CELLS_FG_ONLY 0
+#define CHAFA_CELLS_WIDE 1
+#include "chafa-canvas-cells-def.h"
+
+#define CHAFA_CELLS_VARIANT indexed_fgonly
+#define CHAFA_CELLS_INDEXED 1
+#define CHAFA_CELLS_FG_ONLY 1
+#define CHAFA_CELLS_WIDE 0
+#include "chafa-canvas-cells-def.h"
+
+#define CHAFA_CELLS_VARIANT indexed_fgonly_wide
+#define CHAFA_CELLS_INDEXED 1
+#define CHAFA_CELLS_FG_ONLY 1
+#define CHAFA_CELLS_WIDE 1
+#include "chafa-canvas-cells-def.h"
+
+typedef void (*UpdateCellsRowFunc) (ChafaCanvas *canvas, gint row, gint pixels_row);
+
+/* Indexed by (indexed << 2) | (fg_only << 1) | wide */
+static const UpdateCellsRowFunc update_cells_row_funcs [8] =
+{
+    update_cells_row_direct,
+    update_cells_row_direct_wide,
+    update_cells_row_direct_fgonly,
+    update_cells_row_direct_fgonly_wide,
+    update_cells_row_indexed,
+    update_cells_row_indexed_wide,
+    update_cells_row_indexed_fgonly,
+    update_cells_row_indexed_fgonly_wide
+};
+
+static UpdateCellsRowFunc
+select_update_cells_row_func (const ChafaCanvas *canvas)
+{
+    gboolean indexed = canvas->config.canvas_mode == CHAFA_CANVAS_MODE_INDEXED_256
+        || canvas->config.canvas_mode == CHAFA_CANVAS_MODE_INDEXED_240
+        || canvas->config.canvas_mode == CHAFA_CANVAS_MODE_INDEXED_16
+        || canvas->config.canvas_mode == CHAFA_CANVAS_MODE_INDEXED_8
+        || canvas->config.canvas_mode == CHAFA_CANVAS_MODE_FGBG_BGFG;
+    gboolean fg_only = canvas->config.fg_only_enabled;
+    gboolean wide = canvas->config.symbol_map.n_symbols2 > 0;
 
-        if (cells [cx].c != 0 && (cells [cx].c == ' '
-                                  || cells [cx].fg_color == cells [cx].bg_color))
-        {
-            cells [cx].c = canvas->blank_char;
-
-            /* Copy FG color from previous cell in order to avoid emitting
-             * unnecessary control sequences changing it, but only if we're 100%
-             * sure the "blank" char has no foreground features. It's safest to
-             * permit this optimization only with ASCII space. */
-            if (canvas->blank_char == ' ' && cx > 0)
-                cells [cx].fg_color = cells [cx - 1].fg_color;
-        }
-    }
+    return update_cells_row_funcs [(indexed ? 4 : 0) | (fg_only ? 2 : 0) | (wide ? 1 : 0)];
 }
 
 typedef struct
 {
     gint row;
+    gint pixels_row;
+    UpdateCellsRowFunc row_func;
 }
 CellBuildWork;
 
 static void
 cell_build_worker (CellBuildWork *work, ChafaCanvas *canvas)
 {
-    update_cells_row (canvas, work->row);
+    work->row_func (canvas, work->row, work->pixels_row);
     g_slice_free (CellBuildWork, work);
 }
 
 static void
-update_cells (ChafaCanvas *canvas)
+update_cells_rows (ChafaCanvas *canvas, gint first_row, gint n_rows)
 {
     GThreadPool *thread_pool = g_thread_pool_new ((GFunc) cell_build_worker,
                                                   canvas,
                                                   g_get_num_processors (),
                                                   FALSE,
                                                   NULL);
+    UpdateCellsRowFunc row_func = select_update_cells_row_func (canvas);
     gint cy;
 
-    for (cy = 0; cy < canvas->config.height; cy++)
+    for (cy = 0; cy < n_rows; cy++)
     {
         CellBuildWork *work = g_slice_new (CellBuildWork);
-        work->row = cy;
+        work->row = first_row + cy;
+        work->pixels_row = cy;
+        work->row_func = row_func;
         g_thread_pool_push (thread_pool, work, NULL);
     }
 
     g_thread_pool_free (thread_pool, FALSE, TRUE);
 }
 
+static void
+update_cells (ChafaCanvas *canvas)
+{
+    update_cells_rows (canvas, 0, canvas->config.height);
+
+    /* Hashes from this pass can be trusted on the next one */
+    if (canvas->cell_hashes)
+        canvas->cell_cache_valid = TRUE;
+}
+
+typedef struct
+{
+    ChafaCanvas *canvas;
+    ChafaPrepareContext *prep_ctx;
+    UpdateCellsRowFunc row_func;
+}
+PipelineCtx;
+
+static void
+pipeline_band_worker (ChafaBatchInfo *batch, PipelineCtx *ctx)
+{
+    ChafaCanvas *canvas = ctx->canvas;
+    gint i;
+
+    /* Scale and convert this band's pixels, then evaluate its cells while
+     * they're still cache-hot. Other bands are being prepared concurrently
+     * on their own threads. */
+    chafa_prepare_pixel_data_band (ctx->prep_ctx,
+                                   batch->first_row * CHAFA_SYMBOL_HEIGHT_PIXELS,
+                                   batch->n_rows * CHAFA_SYMBOL_HEIGHT_PIXELS);
+
+    for (i = 0; i < batch->n_rows; i++)
+        ctx->row_func (canvas, batch->first_row + i, batch->first_row + i);
+}
+
+/* Like prepare + update_cells(), but pipelined: each worker prepares a band
+ * of pixel rows and evaluates its cells in one go, so the second thread
+ * pool barrier between the stages disappears and prepared rows are consumed
+ * while still in cache. Only usable when the prepare stage has no
+ * whole-frame dependencies; see chafa_prepare_pixel_data_can_fuse(). */
+static void
+prepare_and_update_cells_pipelined (ChafaCanvas *canvas, ChafaPixelType src_pixel_type,
+                                    const guint8 *src_pixels,
+                                    gint src_width, gint src_height, gint src_rowstride)
+{
+    PipelineCtx ctx;
+
+    ctx.canvas = canvas;
+    ctx.prep_ctx = chafa_prepare_pixel_data_begin (&canvas->palette, &canvas->dither,
+                                                   canvas->config.color_space,
+                                                   canvas->config.preprocessing_enabled,
+                                                   canvas->work_factor_int,
+                                                   src_pixel_type,
+                                                   src_pixels,
+                                                   src_width, src_height,
+                                                   src_rowstride,
+                                                   canvas->pixels,
+                                                   canvas->width_pixels, canvas->height_pixels,
+                                                   &canvas->scale_cache);
+    ctx.row_func = select_update_cells_row_func (canvas);
+
+    chafa_process_batches (&ctx,
+                           (GFunc) pipeline_band_worker,
+                           NULL,
+                           canvas->config.height,
+                           g_get_num_processors (),
+                           1);
+
+    chafa_prepare_pixel_data_end (ctx.prep_ctx);
+
+    /* Hashes from this pass can be trusted on the next one */
+    if (canvas->cell_hashes)
+        canvas->cell_cache_valid = TRUE;
+}
+
 static void
 differentiate_channel (guint8 *dest_channel, guint8 reference_channel, gint min_diff)
 {
@@ -1119,6 +1253,41 @@ find_best_blank_char (ChafaCanvas *canvas)
  *
  * Returns: The new canvas
  **/
+/* Allocation funnel for the canvas' big recyclable buffers. With no
+ * pool attached these are plain g_malloc/g_free; with one, same-sized
+ * buffers circulate between canvases instead of hitting the heap. */
+static gpointer
+acquire_buffer (ChafaCanvas *canvas, gsize size)
+{
+    chafa_heap_stats_add (size);
+
+    if (canvas->buffer_pool)
+        return chafa_buffer_pool_acquire (canvas->buffer_pool, size);
+
+    return chafa_alloc_large (size);
+}
+
+static void
+release_buffer (ChafaCanvas *canvas, gpointer data, gsize size)
+{
+    if (!data)
+        return;
+
+    chafa_heap_stats_remove (size);
+
+    if (canvas->buffer_pool)
+        chafa_buffer_pool_release (canvas->buffer_pool, data, size);
+    else
+        chafa_free_large (data);
+}
+
+static gsize
+cell_buffer_size (const ChafaCanvas *canvas)
+{
+    return (gsize) canvas->config.width * canvas->config.height
+        * sizeof (ChafaCanvasCell);
+}
+
 ChafaCanvas *
 chafa_canvas_new (const ChafaCanvasConfig *config)
 {
@@ -1136,9 +1305,24 @@ chafa_canvas_new (const ChafaCanvasConfig *config)
     canvas = g_new0 (ChafaCanvas, 1);
 
     if (config)
+    {
+        /* Prepare the source config's symbol maps before copying, so every
+         * canvas created from the same config shares one set of prepared
+         * symbol arrays instead of rebuilding them. This only populates a
+         * lazy cache; the config is logically unchanged. Serialized since
+         * multiple threads may create canvases from one shared config. */
+        static GMutex prepare_mutex;
+
+        g_mutex_lock (&prepare_mutex);
+        chafa_symbol_map_prepare ((ChafaSymbolMap *) &config->symbol_map);
+        chafa_symbol_map_prepare ((ChafaSymbolMap *) &config->fill_symbol_map);
         chafa_canvas_config_copy_contents (&canvas->config, config);
+        g_mutex_unlock (&prepare_mutex);
+    }
     else
+    {
         chafa_canvas_config_init (&canvas->config);
+    }
 
     canvas->refs = 1;
 
@@ -1166,11 +1350,21 @@ chafa_canvas_new (const ChafaCanvasConfig *config)
     }
 
     canvas->pixels = NULL;
-    canvas->cells = g_new (ChafaCanvasCell, canvas->config.width * canvas->config.height);
+    canvas->cells = acquire_buffer (canvas, cell_buffer_size (canvas));
     canvas->work_factor_int = canvas->config.work_factor * 10 + 0.5;
     canvas->needs_clear = TRUE;
     canvas->have_alpha = FALSE;
 
+    if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS
+        && (canvas->config.optimizations & CHAFA_OPTIMIZATION_REUSE_CELLS))
+    {
+        canvas->cell_hashes = acquire_buffer (canvas, (gsize) canvas->config.width
+                                              * canvas->config.height * sizeof (guint64));
+        canvas->cell_errors = acquire_buffer (canvas, (gsize) canvas->config.width
+                                              * canvas->config.height * sizeof (gint));
+    }
+
+    /* No-ops if the config was prepared above and the copy shares its state */
     chafa_symbol_map_prepare (&canvas->config.symbol_map);
     chafa_symbol_map_prepare (&canvas->config.fill_symbol_map);
 
@@ -1250,14 +1444,89 @@ chafa_canvas_new_similar (ChafaCanvas *orig)
     chafa_canvas_config_copy_contents (&canvas->config, &orig->config);
 
     canvas->pixels = NULL;
-    canvas->cells = g_new (ChafaCanvasCell, canvas->config.width * canvas->config.height);
+    canvas->scratch_pixels = NULL;
+    canvas->scratch_n_pixels = 0;
+    memset (&canvas->scale_cache, 0, sizeof (canvas->scale_cache));
+    canvas->retained_pixels = NULL;
+    canvas->pixel_canvas = NULL;
+    canvas->kitty_prev_frame = NULL;
+    canvas->kitty_image_id = 0;
+    memset (canvas->sixel_emitted_registers, 0, sizeof (canvas->sixel_emitted_registers));
+
+    /* Share the original's buffer pool, if any */
+    if (canvas->buffer_pool)
+        chafa_buffer_pool_ref (canvas->buffer_pool);
+
+    canvas->cells = acquire_buffer (canvas, cell_buffer_size (canvas));
     canvas->needs_clear = TRUE;
 
+    canvas->cell_hashes = NULL;
+    canvas->cell_errors = NULL;
+    canvas->cell_cache_valid = FALSE;
+
+    if (orig->cell_hashes)
+    {
+        canvas->cell_hashes = acquire_buffer (canvas, (gsize) canvas->config.width
+                                              * canvas->config.height * sizeof (guint64));
+        canvas->cell_errors = acquire_buffer (canvas, (gsize) canvas->config.width
+                                              * canvas->config.height * sizeof (gint));
+    }
+
     chafa_dither_copy (&orig->dither, &canvas->dither);
 
     return canvas;
 }
 
+/**
+ * chafa_canvas_new_reflowed:
+ * @orig: Canvas to reflow
+ * @width: Width of the new canvas, in character cells
+ * @height: Height of the new canvas, in character cells
+ *
+ * Creates a new canvas configured like @orig, but with a different
+ * geometry. If source retention is enabled
+ * (chafa_canvas_config_set_source_retention_enabled()) and @orig has
+ * been drawn to, the new canvas is immediately drawn from the retained
+ * source image. This turns e.g. a terminal resize into a scale and
+ * conversion pass, with no fresh decode of the source needed.
+ *
+ * Returns: The new canvas
+ *
+ * Since: 1.10
+ **/
+ChafaCanvas *
+chafa_canvas_new_reflowed (ChafaCanvas *orig, gint width, gint height)
+{
+    ChafaCanvasConfig *config;
+    ChafaCanvas *canvas;
+
+    g_return_val_if_fail (orig != NULL, NULL);
+    g_return_val_if_fail (orig->refs > 0, NULL);
+    g_return_val_if_fail (width > 0, NULL);
+    g_return_val_if_fail (height > 0, NULL);
+
+    config = chafa_canvas_config_copy (&orig->config);
+    chafa_canvas_config_set_geometry (config, width, height);
+    canvas = chafa_canvas_new (config);
+    chafa_canvas_config_unref (config);
+
+    /* Share the original's buffer pool, if any */
+    if (orig->buffer_pool)
+        chafa_canvas_set_buffer_pool (canvas, orig->buffer_pool);
+
+    if (orig->retained_pixels)
+    {
+        chafa_canvas_draw_all_pixels (canvas,
+                                      orig->retained_pixel_type,
+                                      orig->retained_pixels,
+                                      orig->retained_width,
+                                      orig->retained_height,
+                                      orig->retained_rowstride);
+    }
+
+    return canvas;
+}
+
 /**
  * chafa_canvas_ref:
  * @canvas: Canvas to add a reference to
@@ -1314,8 +1583,23 @@ chafa_canvas_unref (ChafaCanvas *canvas)
         destroy_pixel_canvas (canvas);
         chafa_dither_deinit (&canvas->dither);
         chafa_palette_deinit (&canvas->palette);
-        g_free (canvas->pixels);
-        g_free (canvas->cells);
+        chafa_scale_cache_deinit (&canvas->scale_cache);
+        if (canvas->retained_pixels)
+        {
+            chafa_heap_stats_remove ((gsize) canvas->retained_rowstride * canvas->retained_height);
+            g_free (canvas->retained_pixels);
+        }
+        release_buffer (canvas, canvas->scratch_pixels,
+                        (gsize) canvas->scratch_n_pixels * sizeof (ChafaPixel));
+        release_buffer (canvas, canvas->kitty_prev_frame,
+                        (gsize) canvas->width_pixels * canvas->height_pixels * sizeof (guint32));
+        release_buffer (canvas, canvas->cells, cell_buffer_size (canvas));
+        release_buffer (canvas, canvas->cell_hashes,
+                        (gsize) canvas->config.width * canvas->config.height * sizeof (guint64));
+        release_buffer (canvas, canvas->cell_errors,
+                        (gsize) canvas->config.width * canvas->config.height * sizeof (gint));
+        if (canvas->buffer_pool)
+            chafa_buffer_pool_unref (canvas->buffer_pool);
         g_free (canvas);
     }
 }
@@ -1339,6 +1623,137 @@ chafa_canvas_peek_config (ChafaCanvas *canvas)
     return &canvas->config;
 }
 
+/**
+ * chafa_canvas_set_buffer_pool:
+ * @canvas: A canvas
+ * @pool: A #ChafaBufferPool, or %NULL to detach
+ *
+ * Attaches a buffer pool to @canvas. When the canvas is freed, its
+ * internal cell and working pixel buffers are returned to the pool
+ * instead of the heap, and canvases created from it with
+ * chafa_canvas_new_similar () will draw matching buffers from the pool.
+ * This avoids allocation churn when canvases are created and destroyed
+ * at a high rate with the same geometry.
+ *
+ * The canvas holds a reference to the pool. Buffers acquired from one
+ * pool can be safely released to another, or to none.
+ *
+ * Since: 1.10
+ **/
+void
+chafa_canvas_set_buffer_pool (ChafaCanvas *canvas, ChafaBufferPool *pool)
+{
+    g_return_if_fail (canvas != NULL);
+    g_return_if_fail (canvas->refs > 0);
+
+    if (pool)
+        chafa_buffer_pool_ref (pool);
+    if (canvas->buffer_pool)
+        chafa_buffer_pool_unref (canvas->buffer_pool);
+
+    canvas->buffer_pool = pool;
+}
+
+/* Returns a working image buffer holding at least n_pixels, reusing the
+ * previous frame's allocation when it's big enough. Grow-only; the buffer
+ * lives until the canvas is freed. */
+static ChafaPixel *
+ensure_scratch_pixels (ChafaCanvas *canvas, gint n_pixels)
+{
+    if (canvas->scratch_n_pixels < n_pixels)
+    {
+        release_buffer (canvas, canvas->scratch_pixels,
+                        (gsize) canvas->scratch_n_pixels * sizeof (ChafaPixel));
+        canvas->scratch_pixels = acquire_buffer (canvas, (gsize) n_pixels * sizeof (ChafaPixel));
+        canvas->scratch_n_pixels = n_pixels;
+    }
+
+    return canvas->scratch_pixels;
+}
+
+/* Returns TRUE if the source buffer can stand in for our internal working
+ * image directly: same geometry and memory layout, no color space
+ * conversion, and no preprocessing or dithering pass that would write to
+ * it. The pixels must also be fully opaque, which is checked separately. */
+static gboolean
+can_borrow_source_pixels (ChafaCanvas *canvas, ChafaPixelType src_pixel_type,
+                          gint src_width, gint src_height, gint src_rowstride)
+{
+    ChafaPaletteType palette_type = chafa_palette_get_type (&canvas->palette);
+
+    return (src_pixel_type == CHAFA_PIXEL_RGBA8_UNASSOCIATED
+            || src_pixel_type == CHAFA_PIXEL_RGBA8_PREMULTIPLIED)
+        && src_width == canvas->width_pixels
+        && src_height == canvas->height_pixels
+        && src_rowstride == src_width * (gint) sizeof (guint32)
+        && canvas->config.color_space == CHAFA_COLOR_SPACE_RGB
+        && canvas->dither.mode == CHAFA_DITHER_MODE_NONE
+        && !(canvas->config.preprocessing_enabled
+             && (palette_type == CHAFA_PALETTE_TYPE_FIXED_16
+                 || palette_type == CHAFA_PALETTE_TYPE_FIXED_8
+                 || palette_type == CHAFA_PALETTE_TYPE_FIXED_FGBG));
+}
+
+static gboolean
+source_pixels_are_opaque (const guint8 *src_pixels, gint src_width, gint src_height)
+{
+    const guint32 *p = (const guint32 *) src_pixels;
+    const guint32 *p_end = p + (gsize) src_width * src_height;
+    guint32 acc = 0xffffffffU;
+
+    while (p < p_end)
+        acc &= *(p++);
+
+    return ((const guint8 *) &acc) [3] == 0xff;
+}
+
+/* Keeps a packed copy of the source image in the canvas
+ * (config.source_retention_enabled) so it can be redrawn at a different
+ * geometry later */
+static void
+retain_source_pixels (ChafaCanvas *canvas, ChafaPixelType src_pixel_type,
+                      const guint8 *src_pixels,
+                      gint src_width, gint src_height, gint src_rowstride)
+{
+    gint n_bytes_per_pixel = src_pixel_type >= CHAFA_PIXEL_RGB8 ? 3 : 4;
+    gint packed_rowstride = src_width * n_bytes_per_pixel;
+    gsize new_size = (gsize) packed_rowstride * src_height;
+    gint y;
+
+    if (canvas->retained_pixels
+        && (gsize) canvas->retained_rowstride * canvas->retained_height != new_size)
+    {
+        chafa_heap_stats_remove ((gsize) canvas->retained_rowstride * canvas->retained_height);
+        g_free (canvas->retained_pixels);
+        canvas->retained_pixels = NULL;
+    }
+
+    if (!canvas->retained_pixels)
+    {
+        canvas->retained_pixels = g_malloc (new_size);
+        chafa_heap_stats_add (new_size);
+    }
+
+    if (src_rowstride == packed_rowstride)
+    {
+        memcpy (canvas->retained_pixels, src_pixels, new_size);
+    }
+    else
+    {
+        for (y = 0; y < src_height; y++)
+        {
+            memcpy (canvas->retained_pixels + (gsize) y * packed_rowstride,
+                    src_pixels + (gsize) y * src_rowstride,
+                    packed_rowstride);
+        }
+    }
+
+    canvas->retained_pixel_type = src_pixel_type;
+    canvas->retained_width = src_width;
+    canvas->retained_height = src_height;
+    canvas->retained_rowstride = packed_rowstride;
+}
+
 /**
  * chafa_canvas_draw_all_pixels:
  * @canvas: Canvas whose pixel data to replace
@@ -1351,6 +1766,10 @@ chafa_canvas_peek_config (ChafaCanvas *canvas)
  * Replaces pixel data of @canvas with a copy of that found at @src_pixels,
  * which must be in one of the formats supported by #ChafaPixelType.
  *
+ * The source data may be read in place instead of being copied when its
+ * layout permits; it only needs to remain valid until this function
+ * returns.
+ *
  * Since: 1.2
  **/
 void
@@ -1358,6 +1777,8 @@ chafa_canvas_draw_all_pixels (ChafaCanvas *canvas, ChafaPixelType src_pixel_type
                               const guint8 *src_pixels,
                               gint src_width, gint src_height, gint src_rowstride)
 {
+    gint64 prof_t0;
+
     g_return_if_fail (canvas != NULL);
     g_return_if_fail (canvas->refs > 0);
     g_return_if_fail (src_pixel_type < CHAFA_PIXEL_MAX);
@@ -1368,39 +1789,81 @@ chafa_canvas_draw_all_pixels (ChafaCanvas *canvas, ChafaPixelType src_pixel_type
     if (src_width == 0 || src_height == 0)
         return;
 
-    if (canvas->pixels)
-    {
-        g_free (canvas->pixels);
-        canvas->pixels = NULL;
-    }
+    if (canvas->config.source_retention_enabled)
+        retain_source_pixels (canvas, src_pixel_type, src_pixels,
+                              src_width, src_height, src_rowstride);
 
+    canvas->pixels = NULL;
     destroy_pixel_canvas (canvas);
 
     if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS)
     {
         /* Symbol mode */
 
-        canvas->pixels = g_new (ChafaPixel, canvas->width_pixels * canvas->height_pixels);
-
-        chafa_prepare_pixel_data_for_symbols (&canvas->palette, &canvas->dither,
-                                              canvas->config.color_space,
-                                              canvas->config.preprocessing_enabled,
-                                              canvas->work_factor_int,
-                                              src_pixel_type,
-                                              src_pixels,
-                                              src_width, src_height,
-                                              src_rowstride,
-                                              canvas->pixels,
-                                              canvas->width_pixels, canvas->height_pixels);
+        if (can_borrow_source_pixels (canvas, src_pixel_type, src_width, src_height, src_rowstride)
+            && source_pixels_are_opaque (src_pixels, src_width, src_height))
+        {
+            /* The source data matches our working format exactly and has no
+             * alpha to composite, so borrow it for the duration of the call
+             * instead of copying and converting it. update_cells() only
+             * reads from the working image. */
+            canvas->pixels = (ChafaPixel *) src_pixels;
+
+            prof_t0 = chafa_prof_begin ();
+            update_cells (canvas);
+            chafa_prof_end (CHAFA_PROF_STAGE_CELLS, prof_t0);
+            canvas->needs_clear = FALSE;
+
+            canvas->pixels = NULL;
+        }
+        else if (chafa_prepare_pixel_data_can_fuse (&canvas->palette,
+                                                    canvas->config.preprocessing_enabled))
+        {
+            canvas->pixels = ensure_scratch_pixels (canvas,
+                                                    canvas->width_pixels * canvas->height_pixels);
 
-        if (canvas->config.alpha_threshold == 0)
-            canvas->have_alpha = FALSE;
+            /* Preparation and cell evaluation run interleaved here, so
+             * their cost is reported as a single stage */
+            prof_t0 = chafa_prof_begin ();
+            prepare_and_update_cells_pipelined (canvas, src_pixel_type, src_pixels,
+                                                src_width, src_height, src_rowstride);
+            chafa_prof_end (CHAFA_PROF_STAGE_CELLS, prof_t0);
 
-        update_cells (canvas);
-        canvas->needs_clear = FALSE;
+            if (canvas->config.alpha_threshold == 0)
+                canvas->have_alpha = FALSE;
 
-        g_free (canvas->pixels);
-        canvas->pixels = NULL;
+            canvas->needs_clear = FALSE;
+            canvas->pixels = NULL;
+        }
+        else
+        {
+            canvas->pixels = ensure_scratch_pixels (canvas,
+                                                    canvas->width_pixels * canvas->height_pixels);
+
+            prof_t0 = chafa_prof_begin ();
+            chafa_prepare_pixel_data_for_symbols (&canvas->palette, &canvas->dither,
+                                                  canvas->config.color_space,
+                                                  canvas->config.preprocessing_enabled,
+                                                  canvas->work_factor_int,
+                                                  src_pixel_type,
+                                                  src_pixels,
+                                                  src_width, src_height,
+                                                  src_rowstride,
+                                                  canvas->pixels,
+                                                  canvas->width_pixels, canvas->height_pixels,
+                                                  &canvas->scale_cache);
+            chafa_prof_end (CHAFA_PROF_STAGE_PREPARE, prof_t0);
+
+            if (canvas->config.alpha_threshold == 0)
+                canvas->have_alpha = FALSE;
+
+            prof_t0 = chafa_prof_begin ();
+            update_cells (canvas);
+            chafa_prof_end (CHAFA_PROF_STAGE_CELLS, prof_t0);
+            canvas->needs_clear = FALSE;
+
+            canvas->pixels = NULL;
+        }
     }
     else if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_SIXELS)
     {
@@ -1417,6 +1880,19 @@ chafa_canvas_draw_all_pixels (ChafaCanvas *canvas, ChafaPixelType src_pixel_type
                                             src_pixels,
                                             src_width, src_height,
                                             src_rowstride);
+
+        /* Carry the generated palette over to the next frame; generation
+         * is skipped there if the color distribution hasn't drifted */
+        chafa_palette_copy (&((ChafaSixelCanvas *) canvas->pixel_canvas)->image->palette,
+                            &canvas->palette);
+
+        if (canvas->config.frame_deltas_enabled)
+        {
+            /* Omit color register definitions already in effect from a
+             * previous frame's output */
+            chafa_sixel_canvas_set_emitted_registers (canvas->pixel_canvas,
+                                                      canvas->sixel_emitted_registers);
+        }
     }
     else if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_KITTY)
     {
@@ -1430,6 +1906,20 @@ chafa_canvas_draw_all_pixels (ChafaCanvas *canvas, ChafaPixelType src_pixel_type
                                             src_pixels,
                                             src_width, src_height,
                                             src_rowstride);
+
+        if (canvas->config.frame_deltas_enabled)
+        {
+            if (!canvas->kitty_image_id)
+            {
+                /* Nonzero ID identifying this canvas's image to the terminal.
+                 * The sequence formatter handles up to four decimal digits. */
+                canvas->kitty_image_id = g_random_int_range (1, 10000);
+            }
+
+            chafa_kitty_canvas_set_frame_delta (canvas->pixel_canvas,
+                                                canvas->kitty_prev_frame,
+                                                canvas->kitty_image_id);
+        }
     }
     else  /* if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_ITERM2) */
     {
@@ -1446,6 +1936,300 @@ chafa_canvas_draw_all_pixels (ChafaCanvas *canvas, ChafaPixelType src_pixel_type
     }
 }
 
+/**
+ * chafa_canvas_draw_all_pixels_indexed:
+ * @canvas: Canvas whose pixel data to replace
+ * @src_index_pixels: Pointer to the start of source index memory, one byte per pixel
+ * @src_width: Width in pixels of source pixel data
+ * @src_height: Height in pixels of source pixel data
+ * @src_rowstride: Number of bytes between the start of each pixel row
+ * @src_palette: Palette colors, four bytes per entry in RGBA order
+ * @src_n_colors: Number of entries in @src_palette, in the range [1..256]
+ * @src_transparent_index: Palette entry to treat as transparent, or -1 for none
+ *
+ * Like chafa_canvas_draw_all_pixels(), but takes indexed pixel data along
+ * with its palette. Every index must be less than @src_n_colors.
+ *
+ * When the canvas is in %CHAFA_PIXEL_MODE_SIXELS with a truecolor canvas
+ * mode, the indexes and palette are adopted directly, skipping the usual
+ * expansion and quantization passes. This is the fast path for content
+ * that is already paletted, e.g. GIF frames. In other modes the data is
+ * expanded to RGBA and drawn normally.
+ *
+ * Since: 1.10
+ **/
+void
+chafa_canvas_draw_all_pixels_indexed (ChafaCanvas *canvas,
+                                      const guint8 *src_index_pixels,
+                                      gint src_width, gint src_height, gint src_rowstride,
+                                      const guint8 *src_palette, gint src_n_colors,
+                                      gint src_transparent_index)
+{
+    g_return_if_fail (canvas != NULL);
+    g_return_if_fail (canvas->refs > 0);
+    g_return_if_fail (src_index_pixels != NULL);
+    g_return_if_fail (src_width >= 0);
+    g_return_if_fail (src_height >= 0);
+    g_return_if_fail (src_palette != NULL);
+    g_return_if_fail (src_n_colors > 0 && src_n_colors <= 256);
+    g_return_if_fail (src_transparent_index >= -1 && src_transparent_index <= 255);
+
+    if (src_width == 0 || src_height == 0)
+        return;
+
+    if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_SIXELS
+        && chafa_palette_get_type (&canvas->palette) == CHAFA_PALETTE_TYPE_DYNAMIC_256)
+    {
+        /* Sixel output is paletted too, so the source indexes and colors
+         * can flow straight through */
+
+        canvas->pixels = NULL;
+        destroy_pixel_canvas (canvas);
+
+        canvas->pixel_canvas = chafa_sixel_canvas_new (canvas->width_pixels,
+                                                       canvas->height_pixels,
+                                                       canvas->config.color_space,
+                                                       &canvas->palette,
+                                                       &canvas->dither);
+        chafa_sixel_canvas_draw_all_indexed_pixels (canvas->pixel_canvas,
+                                                    src_index_pixels,
+                                                    src_palette, src_n_colors,
+                                                    src_transparent_index,
+                                                    src_width, src_height,
+                                                    src_rowstride);
+
+        if (canvas->config.frame_deltas_enabled)
+        {
+            chafa_sixel_canvas_set_emitted_registers (canvas->pixel_canvas,
+                                                      canvas->sixel_emitted_registers);
+        }
+    }
+    else
+    {
+        /* Everything else wants full RGBA; expand into a temporary buffer
+         * and take the regular path */
+
+        guint32 palette_u32 [256];
+        guint32 *rgba_pixels;
+        gint x, y;
+
+        memset (palette_u32, 0, sizeof (palette_u32));
+        memcpy (palette_u32, src_palette, src_n_colors * sizeof (guint32));
+        if (src_transparent_index >= 0)
+            palette_u32 [src_transparent_index] = 0;
+
+        rgba_pixels = g_malloc ((gsize) src_width * src_height * sizeof (guint32));
+        chafa_heap_stats_add ((gsize) src_width * src_height * sizeof (guint32));
+
+        for (y = 0; y < src_height; y++)
+        {
+            const guint8 *src_row = src_index_pixels + (gsize) y * src_rowstride;
+            guint32 *dest_row = rgba_pixels + (gsize) y * src_width;
+
+            for (x = 0; x < src_width; x++)
+                dest_row [x] = palette_u32 [src_row [x]];
+        }
+
+        chafa_canvas_draw_all_pixels (canvas, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                      (const guint8 *) rgba_pixels,
+                                      src_width, src_height,
+                                      src_width * sizeof (guint32));
+
+        chafa_heap_stats_remove ((gsize) src_width * src_height * sizeof (guint32));
+        g_free (rgba_pixels);
+    }
+}
+
+typedef struct
+{
+    ChafaCanvas *canvas;
+    ChafaPixelType src_pixel_type;
+    const guint8 *src_pixels;
+    gint src_width, src_height, src_rowstride;
+    ChafaCanvasReadyFunc ready_func;
+    gpointer user_data;
+}
+AsyncDrawJob;
+
+static void
+async_draw_worker (gpointer data, G_GNUC_UNUSED gpointer user_data)
+{
+    AsyncDrawJob *job = data;
+
+    chafa_canvas_draw_all_pixels (job->canvas,
+                                  job->src_pixel_type,
+                                  job->src_pixels,
+                                  job->src_width, job->src_height,
+                                  job->src_rowstride);
+
+    if (job->ready_func)
+        job->ready_func (job->canvas, job->user_data);
+
+    chafa_canvas_unref (job->canvas);
+    g_free (job);
+}
+
+static GThreadPool *
+get_async_draw_pool (void)
+{
+    static GThreadPool *async_draw_pool;
+    static gsize initialized = 0;
+
+    if (g_once_init_enter (&initialized))
+    {
+        /* A single dispatcher is enough: each conversion already fans out
+         * across all processors internally, so running several at once
+         * would just make them fight over the batch workers. Queued jobs
+         * run in submission order. */
+        async_draw_pool = g_thread_pool_new (async_draw_worker,
+                                             NULL,
+                                             1,
+                                             FALSE,
+                                             NULL);
+        g_once_init_leave (&initialized, 1);
+    }
+
+    return async_draw_pool;
+}
+
+/**
+ * chafa_canvas_draw_all_pixels_async:
+ * @canvas: Canvas whose pixel data to replace
+ * @src_pixel_type: Pixel format of @src_pixels
+ * @src_pixels: Pointer to the start of source pixel memory
+ * @src_width: Width in pixels of source pixel data
+ * @src_height: Height in pixels of source pixel data
+ * @src_rowstride: Number of bytes between the start of each pixel row
+ * @ready_func: (nullable): Function to call when the draw completes
+ * @user_data: Data to pass to @ready_func
+ *
+ * Like chafa_canvas_draw_all_pixels(), but returns immediately and
+ * performs the conversion on a worker thread. @ready_func is invoked on
+ * that thread when the canvas is ready to print.
+ *
+ * Unlike the synchronous variant, @src_pixels must remain valid until
+ * @ready_func is invoked. The canvas must not be accessed in the
+ * meantime; a reference is held on it for the duration, so it will not
+ * be finalized even if the caller unrefs it before completion.
+ *
+ * Since: 1.10
+ **/
+void
+chafa_canvas_draw_all_pixels_async (ChafaCanvas *canvas, ChafaPixelType src_pixel_type,
+                                    const guint8 *src_pixels,
+                                    gint src_width, gint src_height, gint src_rowstride,
+                                    ChafaCanvasReadyFunc ready_func, gpointer user_data)
+{
+    AsyncDrawJob *job;
+
+    g_return_if_fail (canvas != NULL);
+    g_return_if_fail (canvas->refs > 0);
+    g_return_if_fail (src_pixel_type < CHAFA_PIXEL_MAX);
+    g_return_if_fail (src_pixels != NULL);
+    g_return_if_fail (src_width >= 0);
+    g_return_if_fail (src_height >= 0);
+
+    job = g_new (AsyncDrawJob, 1);
+    job->canvas = canvas;
+    job->src_pixel_type = src_pixel_type;
+    job->src_pixels = src_pixels;
+    job->src_width = src_width;
+    job->src_height = src_height;
+    job->src_rowstride = src_rowstride;
+    job->ready_func = ready_func;
+    job->user_data = user_data;
+
+    chafa_canvas_ref (canvas);
+    g_thread_pool_push (get_async_draw_pool (), job, NULL);
+}
+
+/**
+ * chafa_canvas_draw_pixel_rows:
+ * @canvas: Canvas whose pixel data to replace
+ * @src_pixel_type: Pixel format of @src_pixels
+ * @src_pixels: Pointer to the start of source pixel memory
+ * @src_width: Width in pixels of source pixel data
+ * @src_height: Height in pixels of source pixel data
+ * @src_rowstride: Number of bytes between the start of each pixel row
+ * @first_row: First canvas row to replace
+ * @n_rows: Number of canvas rows to replace
+ *
+ * Like chafa_canvas_draw_all_pixels(), but converts only the canvas rows
+ * [@first_row .. @first_row + @n_rows). The source image is always scaled
+ * relative to the entire canvas; each call materializes just the strip of
+ * the internal working image needed for the requested rows, keeping peak
+ * memory use proportional to the strip rather than the full canvas.
+ * Combine with chafa_canvas_print_rows() to stream very large images a
+ * strip at a time.
+ *
+ * Image preprocessing and alpha detection are computed per strip, so the
+ * output can deviate slightly from a whole-image conversion when
+ * preprocessing is enabled.
+ *
+ * The canvas must be in %CHAFA_PIXEL_MODE_SYMBOLS mode.
+ *
+ * Since: 1.10
+ **/
+void
+chafa_canvas_draw_pixel_rows (ChafaCanvas *canvas, ChafaPixelType src_pixel_type,
+                              const guint8 *src_pixels,
+                              gint src_width, gint src_height, gint src_rowstride,
+                              gint first_row, gint n_rows)
+{
+    gint n_pixel_rows;
+    gint64 prof_t0;
+
+    g_return_if_fail (canvas != NULL);
+    g_return_if_fail (canvas->refs > 0);
+    g_return_if_fail (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS);
+    g_return_if_fail (src_pixel_type < CHAFA_PIXEL_MAX);
+    g_return_if_fail (src_pixels != NULL);
+    g_return_if_fail (src_width >= 0);
+    g_return_if_fail (src_height >= 0);
+    g_return_if_fail (first_row >= 0);
+    g_return_if_fail (n_rows >= 0);
+    g_return_if_fail (first_row + n_rows <= canvas->config.height);
+
+    if (src_width == 0 || src_height == 0 || n_rows == 0)
+        return;
+
+    canvas->pixels = NULL;
+    destroy_pixel_canvas (canvas);
+
+    n_pixel_rows = n_rows * CHAFA_SYMBOL_HEIGHT_PIXELS;
+    canvas->pixels = ensure_scratch_pixels (canvas, canvas->width_pixels * n_pixel_rows);
+
+    prof_t0 = chafa_prof_begin ();
+    chafa_prepare_pixel_data_for_symbols_rows (&canvas->palette, &canvas->dither,
+                                               canvas->config.color_space,
+                                               canvas->config.preprocessing_enabled,
+                                               canvas->work_factor_int,
+                                               src_pixel_type,
+                                               src_pixels,
+                                               src_width, src_height,
+                                               src_rowstride,
+                                               canvas->pixels,
+                                               canvas->width_pixels, canvas->height_pixels,
+                                               first_row * CHAFA_SYMBOL_HEIGHT_PIXELS,
+                                               n_pixel_rows,
+                                               &canvas->scale_cache);
+    chafa_prof_end (CHAFA_PROF_STAGE_PREPARE, prof_t0);
+
+    if (canvas->config.alpha_threshold == 0)
+        canvas->have_alpha = FALSE;
+
+    /* Rows outside the strip keep their old contents; make sure they're
+     * at least initialized before we stop requesting clears */
+    maybe_clear (canvas);
+
+    prof_t0 = chafa_prof_begin ();
+    update_cells_rows (canvas, first_row, n_rows);
+    chafa_prof_end (CHAFA_PROF_STAGE_CELLS, prof_t0);
+    canvas->needs_clear = FALSE;
+
+    canvas->pixels = NULL;
+}
+
 /**
  * chafa_canvas_set_contents_rgba8:
  * @canvas: Canvas whose pixel data to replace
@@ -1518,15 +2302,183 @@ chafa_canvas_print (ChafaCanvas *canvas, ChafaTermInfo *term_info)
     g_return_val_if_fail (canvas != NULL, NULL);
     g_return_val_if_fail (canvas->refs > 0, NULL);
 
+    str = g_string_new ("");
+    chafa_canvas_print_into (canvas, term_info, str);
+    return str;
+}
+
+/* --- Frame output size bounds --- */
+
+/* "#NNN;2;NNN;NNN;NNN" */
+#define SIXEL_PALETTE_DEF_SIZE_MAX 18
+
+static gsize
+print_size_max_sixels (ChafaCanvas *canvas, ChafaTermInfo *term_info)
+{
+    gsize n_sixel_rows = ((gsize) canvas->height_pixels + 5) / 6;
+
+    /* The sixel encoder's worst case is every pen visiting every column of
+     * every six-pixel band: width data bytes plus pen selection and CR per
+     * pen, plus an LF per band. Run-length encoding only ever shrinks this. */
+    return (gsize) chafa_term_info_get_seq_length_max (term_info, CHAFA_TERM_SEQ_BEGIN_SIXELS)
+        + 24  /* Raster attributes */
+        + 256 * SIXEL_PALETTE_DEF_SIZE_MAX
+        + n_sixel_rows * (256 * ((gsize) canvas->width_pixels + 5) + 1)
+        + chafa_term_info_get_seq_length_max (term_info, CHAFA_TERM_SEQ_END_SIXELS)
+        + 1;
+}
+
+static gsize
+print_size_max_kitty (ChafaCanvas *canvas, ChafaTermInfo *term_info)
+{
+    gsize payload = (gsize) canvas->width_pixels * canvas->height_pixels * 4;
+    gsize n_chunks;
+
+    /* Deflate can expand incompressible input slightly */
+    payload += payload / 1000 + 64;
+    n_chunks = payload / 512 + 1;
+
+    return (gsize) chafa_term_info_get_seq_length_max (term_info, CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1)
+        + chafa_term_info_get_seq_length_max (term_info, CHAFA_TERM_SEQ_BEGIN_KITTY_IMAGE_FRAME_V1)
+        + ((payload + 2) / 3) * 4
+        + n_chunks * ((gsize) chafa_term_info_get_seq_length_max (term_info, CHAFA_TERM_SEQ_BEGIN_KITTY_IMAGE_CHUNK)
+                      + chafa_term_info_get_seq_length_max (term_info, CHAFA_TERM_SEQ_END_KITTY_IMAGE_CHUNK))
+        + chafa_term_info_get_seq_length_max (term_info, CHAFA_TERM_SEQ_END_KITTY_IMAGE)
+        + 64;  /* Variant begin seqs with extra arguments */
+}
+
+static gsize
+print_size_max_iterm2 (ChafaCanvas *canvas, ChafaTermInfo *term_info)
+{
+    /* Base64-encoded TIFF: pixel data plus a small header and tag block */
+    gsize payload = (gsize) canvas->width_pixels * canvas->height_pixels * 4 + 512;
+
+    return (gsize) chafa_term_info_get_seq_length_max (term_info, CHAFA_TERM_SEQ_BEGIN_ITERM2_IMAGE)
+        + ((payload + 2) / 3) * 4 + 4
+        + chafa_term_info_get_seq_length_max (term_info, CHAFA_TERM_SEQ_END_ITERM2_IMAGE)
+        + 1;
+}
+
+/**
+ * chafa_canvas_get_print_size_max:
+ * @canvas: The canvas to compute an output bound for
+ * @term_info: Terminal to format for, or %NULL for fallback
+ *
+ * Computes an upper bound on the number of bytes a subsequent
+ * chafa_canvas_print() or chafa_canvas_print_into() of @canvas can
+ * produce, based on the canvas geometry, pixel mode and the lengths of
+ * the control sequences in @term_info.
+ *
+ * The bound is tight enough to make a single right-sized buffer
+ * allocation per frame practical, e.g. with g_string_sized_new().
+ * chafa_canvas_print_into() applies it automatically.
+ *
+ * Returns: Upper bound on printed frame size, in bytes
+ *
+ * Since: 1.10
+ **/
+gsize
+chafa_canvas_get_print_size_max (ChafaCanvas *canvas, ChafaTermInfo *term_info)
+{
+    gsize size = 0;
+
+    g_return_val_if_fail (canvas != NULL, 0);
+    g_return_val_if_fail (canvas->refs > 0, 0);
+
     if (term_info)
         chafa_term_info_ref (term_info);
     else
         term_info = chafa_term_db_get_fallback_info (chafa_term_db_get_default ());
 
+    switch (canvas->config.pixel_mode)
+    {
+        case CHAFA_PIXEL_MODE_SYMBOLS:
+            size = chafa_canvas_printer_get_size_max (canvas, term_info);
+            break;
+        case CHAFA_PIXEL_MODE_SIXELS:
+            size = print_size_max_sixels (canvas, term_info);
+            break;
+        case CHAFA_PIXEL_MODE_KITTY:
+            size = print_size_max_kitty (canvas, term_info);
+            break;
+        case CHAFA_PIXEL_MODE_ITERM2:
+            size = print_size_max_iterm2 (canvas, term_info);
+            break;
+        case CHAFA_PIXEL_MODE_MAX:
+            g_assert_not_reached ();
+            break;
+    }
+
+    chafa_term_info_unref (term_info);
+    return size;
+}
+
+/* After printing a Kitty frame, remember what the terminal is now
+ * displaying, so the next frame can be emitted as a delta against it */
+static void
+update_kitty_frame_delta (ChafaCanvas *canvas)
+{
+    ChafaKittyCanvas *kitty_canvas = canvas->pixel_canvas;
+
+    if (!canvas->config.frame_deltas_enabled)
+        return;
+
+    if (!canvas->kitty_prev_frame)
+        canvas->kitty_prev_frame = acquire_buffer (canvas,
+                                                   (gsize) canvas->width_pixels
+                                                   * canvas->height_pixels
+                                                   * sizeof (guint32));
+    memcpy (canvas->kitty_prev_frame, kitty_canvas->rgba_image,
+            canvas->width_pixels * canvas->height_pixels * sizeof (guint32));
+    chafa_kitty_canvas_set_frame_delta (kitty_canvas,
+                                        canvas->kitty_prev_frame,
+                                        canvas->kitty_image_id);
+}
+
+/**
+ * chafa_canvas_print_into:
+ * @canvas: The canvas to generate a printable representation of
+ * @term_info: Terminal to format for, or %NULL for fallback
+ * @gs: A #GString to append the output to
+ *
+ * Like chafa_canvas_print(), but appends the output to a caller-supplied
+ * #GString instead of allocating a new one. Reusing the same buffer for
+ * every frame of an animation -- e.g. by calling g_string_truncate()
+ * between frames -- lets steady-state printing proceed without any
+ * allocations once the buffer has grown to its working size.
+ *
+ * Since: 1.10
+ **/
+void
+chafa_canvas_print_into (ChafaCanvas *canvas, ChafaTermInfo *term_info, GString *gs)
+{
+    g_return_if_fail (canvas != NULL);
+    g_return_if_fail (canvas->refs > 0);
+    g_return_if_fail (gs != NULL);
+
+    if (term_info)
+        chafa_term_info_ref (term_info);
+    else
+        term_info = chafa_term_db_get_fallback_info (chafa_term_db_get_default ());
+
+    /* Grow the buffer to the frame's upper bound up front, so building
+     * appends without intermediate reallocations */
+    {
+        gsize needed = chafa_canvas_get_print_size_max (canvas, term_info);
+
+        if (gs->allocated_len - gs->len < needed)
+        {
+            gsize current_len = gs->len;
+
+            g_string_set_size (gs, gs->len + needed);
+            gs->len = current_len;
+        }
+    }
+
     if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS)
     {
         maybe_clear (canvas);
-        str = chafa_canvas_print_symbols (canvas, term_info);
+        chafa_canvas_print_symbols_into (canvas, term_info, gs);
     }
     else if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_SIXELS
              && chafa_term_info_get_seq (term_info, CHAFA_TERM_SEQ_BEGIN_SIXELS))
@@ -1538,35 +2490,241 @@ chafa_canvas_print (ChafaCanvas *canvas, ChafaTermInfo *term_info)
 
         out = chafa_term_info_emit_begin_sixels (term_info, buf, 0, 1, 0);
         *out = '\0';
-        str = g_string_new (buf);
+        g_string_append (gs, buf);
 
-        g_string_append_printf (str, "\"1;1;%d;%d", canvas->width_pixels, canvas->height_pixels);
-        chafa_sixel_canvas_build_ansi (canvas->pixel_canvas, str);
+        g_string_append_printf (gs, "\"1;1;%d;%d", canvas->width_pixels, canvas->height_pixels);
+        chafa_sixel_canvas_build_ansi (canvas->pixel_canvas, gs);
 
         out = chafa_term_info_emit_end_sixels (term_info, buf);
         *out = '\0';
-        g_string_append (str, buf);
+        g_string_append (gs, buf);
     }
     else if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_KITTY
              && chafa_term_info_get_seq (term_info, CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1))
     {
         /* Kitty mode */
 
-        str = g_string_new ("");
-        chafa_kitty_canvas_build_ansi (canvas->pixel_canvas, term_info, str,
-                                       canvas->config.width, canvas->config.height);
+        chafa_kitty_canvas_build_ansi (canvas->pixel_canvas, term_info, gs,
+                                       canvas->config.width, canvas->config.height,
+                                       canvas->config.compression_level,
+                                       canvas->config.kitty_shm_enabled);
+        update_kitty_frame_delta (canvas);
     }
     else if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_ITERM2)
     {
         /* iTerm2 mode */
 
-        str = g_string_new ("");
-        chafa_iterm2_canvas_build_ansi (canvas->pixel_canvas, term_info, str,
+        chafa_iterm2_canvas_build_ansi (canvas->pixel_canvas, term_info, gs,
                                         canvas->config.width, canvas->config.height);
     }
+
+    chafa_term_info_unref (term_info);
+}
+
+/**
+ * chafa_canvas_print_to_fd:
+ * @canvas: The canvas to generate a printable representation of
+ * @term_info: Terminal to format for, or %NULL for fallback
+ * @fd: File descriptor to write to
+ *
+ * Like chafa_canvas_print(), but writes the output to file descriptor
+ * @fd in bounded chunks as they are serialized, instead of materializing
+ * the entire frame in memory first. For large sixel or Kitty frames this
+ * caps serialization memory at a few rows' worth of output and gets the
+ * first bytes to the terminal sooner.
+ *
+ * @fd should be in blocking mode; writes are retried on EINTR and short
+ * writes, but any other write error aborts the frame.
+ *
+ * Returns: %TRUE on success, %FALSE if a write failed
+ *
+ * Since: 1.10
+ **/
+gboolean
+chafa_canvas_print_to_fd (ChafaCanvas *canvas, ChafaTermInfo *term_info, gint fd)
+{
+    gboolean success = TRUE;
+
+    g_return_val_if_fail (canvas != NULL, FALSE);
+    g_return_val_if_fail (canvas->refs > 0, FALSE);
+    g_return_val_if_fail (fd >= 0, FALSE);
+
+    if (term_info)
+        chafa_term_info_ref (term_info);
     else
+        term_info = chafa_term_db_get_fallback_info (chafa_term_db_get_default ());
+
+    if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS)
     {
-        str = g_string_new ("");
+        gint row;
+
+        maybe_clear (canvas);
+
+        /* A strip of rows at a time; concatenated strips match
+         * chafa_canvas_print() exactly */
+        for (row = 0; row < canvas->config.height && success; row += 8)
+        {
+            gint n_rows = MIN (8, canvas->config.height - row);
+            GString *gs = chafa_canvas_print_symbols_rows (canvas, term_info,
+                                                           row, n_rows);
+
+            success = chafa_fd_write_all (fd, gs->str, gs->len);
+            g_string_free (gs, TRUE);
+        }
+    }
+    else if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_SIXELS
+             && chafa_term_info_get_seq (term_info, CHAFA_TERM_SEQ_BEGIN_SIXELS))
+    {
+        gchar buf [CHAFA_TERM_SEQ_LENGTH_MAX + 1];
+        GString *header = g_string_new ("");
+        gchar *out;
+
+        /* Sixel mode */
+
+        out = chafa_term_info_emit_begin_sixels (term_info, buf, 0, 1, 0);
+        *out = '\0';
+        g_string_append (header, buf);
+        g_string_append_printf (header, "\"1;1;%d;%d", canvas->width_pixels, canvas->height_pixels);
+        success = chafa_fd_write_all (fd, header->str, header->len);
+        g_string_free (header, TRUE);
+
+        if (success)
+            success = chafa_sixel_canvas_build_ansi_fd (canvas->pixel_canvas, fd);
+
+        if (success)
+        {
+            out = chafa_term_info_emit_end_sixels (term_info, buf);
+            success = chafa_fd_write_all (fd, buf, out - buf);
+        }
+    }
+    else if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_KITTY
+             && chafa_term_info_get_seq (term_info, CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1))
+    {
+        /* Kitty mode */
+
+        success = chafa_kitty_canvas_build_ansi_fd (canvas->pixel_canvas, term_info, fd,
+                                                    canvas->config.width, canvas->config.height,
+                                                    canvas->config.compression_level,
+                                                    canvas->config.kitty_shm_enabled);
+        if (success)
+            update_kitty_frame_delta (canvas);
+    }
+    else if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_ITERM2)
+    {
+        /* iTerm2 mode */
+
+        success = chafa_iterm2_canvas_build_ansi_fd (canvas->pixel_canvas, term_info, fd,
+                                                     canvas->config.width, canvas->config.height);
+    }
+
+    chafa_term_info_unref (term_info);
+    return success;
+}
+
+/**
+ * chafa_canvas_print_rows:
+ * @canvas: The canvas to generate a printable representation of
+ * @term_info: Terminal to format for, or %NULL for fallback
+ * @first_row: First canvas row to print
+ * @n_rows: Number of canvas rows to print
+ *
+ * Like chafa_canvas_print(), but prints only the canvas rows
+ * [@first_row .. @first_row + @n_rows). Concatenating the output of
+ * consecutive calls covering the entire canvas produces exactly the
+ * output of chafa_canvas_print(); in particular, a newline is emitted
+ * after every row except the canvas' last.
+ *
+ * Together with chafa_canvas_draw_pixel_rows(), this allows very large
+ * images to be converted and emitted a strip at a time, bounding memory
+ * use and reducing time to first output.
+ *
+ * The canvas must be in %CHAFA_PIXEL_MODE_SYMBOLS mode.
+ *
+ * Returns: A UTF-8 string of terminal control sequences and symbols
+ *
+ * Since: 1.10
+ **/
+GString *
+chafa_canvas_print_rows (ChafaCanvas *canvas, ChafaTermInfo *term_info,
+                         gint first_row, gint n_rows)
+{
+    GString *str;
+
+    g_return_val_if_fail (canvas != NULL, NULL);
+    g_return_val_if_fail (canvas->refs > 0, NULL);
+    g_return_val_if_fail (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS, NULL);
+    g_return_val_if_fail (first_row >= 0, NULL);
+    g_return_val_if_fail (n_rows >= 0, NULL);
+    g_return_val_if_fail (first_row + n_rows <= canvas->config.height, NULL);
+
+    if (term_info)
+        chafa_term_info_ref (term_info);
+    else
+        term_info = chafa_term_db_get_fallback_info (chafa_term_db_get_default ());
+
+    maybe_clear (canvas);
+    str = chafa_canvas_print_symbols_rows (canvas, term_info, first_row, n_rows);
+
+    chafa_term_info_unref (term_info);
+    return str;
+}
+
+/**
+ * chafa_canvas_print_diff:
+ * @canvas: The canvas to generate a printable representation of
+ * @prev_canvas: Canvas holding the previously printed frame, or %NULL
+ * @term_info: Terminal to format for, or %NULL for fallback
+ *
+ * Like chafa_canvas_print (), but emits only the character cells that
+ * differ from @prev_canvas, using relative cursor positioning sequences
+ * to skip over unchanged runs. This can reduce animation bandwidth
+ * dramatically when most of the frame is static.
+ *
+ * Both canvases must be in symbol pixel mode and have identical
+ * dimensions and canvas modes; typically @prev_canvas is created with
+ * chafa_canvas_new_similar (). The cursor is assumed to be at the
+ * canvas' top left corner, and will be returned there after printing.
+ *
+ * If diff output is not possible (no previous frame, mismatched
+ * configuration, or a terminal without cursor movement sequences), the
+ * full frame is printed instead.
+ *
+ * Returns: A UTF-8 string of terminal control sequences and symbols
+ *
+ * Since: 1.10
+ **/
+GString *
+chafa_canvas_print_diff (ChafaCanvas *canvas, ChafaCanvas *prev_canvas,
+                         ChafaTermInfo *term_info)
+{
+    GString *str;
+
+    g_return_val_if_fail (canvas != NULL, NULL);
+    g_return_val_if_fail (canvas->refs > 0, NULL);
+
+    if (term_info)
+        chafa_term_info_ref (term_info);
+    else
+        term_info = chafa_term_db_get_fallback_info (chafa_term_db_get_default ());
+
+    if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS
+        && prev_canvas
+        && prev_canvas->config.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS
+        && !prev_canvas->needs_clear
+        && prev_canvas->config.width == canvas->config.width
+        && prev_canvas->config.height == canvas->config.height
+        && prev_canvas->config.canvas_mode == canvas->config.canvas_mode
+        && chafa_term_info_have_seq (term_info, CHAFA_TERM_SEQ_CURSOR_UP)
+        && chafa_term_info_have_seq (term_info, CHAFA_TERM_SEQ_CURSOR_DOWN)
+        && chafa_term_info_have_seq (term_info, CHAFA_TERM_SEQ_CURSOR_LEFT)
+        && chafa_term_info_have_seq (term_info, CHAFA_TERM_SEQ_CURSOR_RIGHT))
+    {
+        maybe_clear (canvas);
+        str = chafa_canvas_print_symbols_diff (canvas, prev_canvas, term_info);
+    }
+    else
+    {
+        str = chafa_canvas_print (canvas, term_info);
     }
 
     chafa_term_info_unref (term_info);
@@ -1659,39 +2817,12 @@ chafa_canvas_set_char_at (ChafaCanvas *canvas, gint x, gint y, gunichar c)
     return cwidth;
 }
 
-/**
- * chafa_canvas_get_colors_at:
- * @canvas: The canvas to inspect
- * @x: Column of character cell to inspect
- * @y: Row of character cell to inspect
- * @fg_out: Storage for foreground color
- * @bg_out: Storage for background color
- *
- * Gets the colors at cell (x, y). The coordinates are zero-indexed. For
- * double-width characters, both cells will contain the same colors.
- *
- * The colors will be -1 for transparency, packed 8bpc RGB otherwise,
- * i.e. 0x00RRGGBB hex.
- *
- * If the canvas is in an indexed mode, palette lookups will be made
- * for you.
- *
- * Since: 1.8
- **/
-void
-chafa_canvas_get_colors_at (ChafaCanvas *canvas, gint x, gint y,
-                            gint *fg_out, gint *bg_out)
+static void
+get_cell_colors (ChafaCanvas *canvas, const ChafaCanvasCell *cell,
+                 gint *fg_out, gint *bg_out)
 {
-    const ChafaCanvasCell *cell;
     gint fg = -1, bg = -1;
 
-    g_return_if_fail (canvas != NULL);
-    g_return_if_fail (canvas->refs > 0);
-    g_return_if_fail (x >= 0 && x < canvas->config.width);
-    g_return_if_fail (y >= 0 && y < canvas->config.height);
-
-    cell = &canvas->cells [y * canvas->config.width + x];
-
     switch (canvas->config.canvas_mode)
     {
         case CHAFA_CANVAS_MODE_TRUECOLOR:
@@ -1728,6 +2859,74 @@ chafa_canvas_get_colors_at (ChafaCanvas *canvas, gint x, gint y,
     *bg_out = bg;
 }
 
+static void
+get_cell_raw_colors (ChafaCanvas *canvas, const ChafaCanvasCell *cell,
+                     gint *fg_out, gint *bg_out)
+{
+    gint fg = -1, bg = -1;
+
+    switch (canvas->config.canvas_mode)
+    {
+        case CHAFA_CANVAS_MODE_TRUECOLOR:
+            fg = packed_rgba_to_rgb (canvas, cell->fg_color);
+            bg = packed_rgba_to_rgb (canvas, cell->bg_color);
+            break;
+        case CHAFA_CANVAS_MODE_INDEXED_256:
+        case CHAFA_CANVAS_MODE_INDEXED_240:
+        case CHAFA_CANVAS_MODE_INDEXED_16:
+        case CHAFA_CANVAS_MODE_INDEXED_8:
+            fg = cell->fg_color < 256 ? (gint) cell->fg_color : -1;
+            bg = cell->bg_color < 256 ? (gint) cell->bg_color : -1;
+            break;
+        case CHAFA_CANVAS_MODE_FGBG_BGFG:
+            fg = cell->fg_color == CHAFA_PALETTE_INDEX_FG ? 0 : -1;
+            bg = cell->bg_color == CHAFA_PALETTE_INDEX_FG ? 0 : -1;
+            break;
+        case CHAFA_CANVAS_MODE_FGBG:
+            fg = 0;
+            bg = -1;
+            break;
+        case CHAFA_CANVAS_MODE_MAX:
+            g_assert_not_reached ();
+            break;
+    }
+
+    *fg_out = fg;
+    *bg_out = bg;
+}
+
+/**
+ * chafa_canvas_get_colors_at:
+ * @canvas: The canvas to inspect
+ * @x: Column of character cell to inspect
+ * @y: Row of character cell to inspect
+ * @fg_out: Storage for foreground color
+ * @bg_out: Storage for background color
+ *
+ * Gets the colors at cell (x, y). The coordinates are zero-indexed. For
+ * double-width characters, both cells will contain the same colors.
+ *
+ * The colors will be -1 for transparency, packed 8bpc RGB otherwise,
+ * i.e. 0x00RRGGBB hex.
+ *
+ * If the canvas is in an indexed mode, palette lookups will be made
+ * for you.
+ *
+ * Since: 1.8
+ **/
+void
+chafa_canvas_get_colors_at (ChafaCanvas *canvas, gint x, gint y,
+                            gint *fg_out, gint *bg_out)
+{
+    g_return_if_fail (canvas != NULL);
+    g_return_if_fail (canvas->refs > 0);
+    g_return_if_fail (x >= 0 && x < canvas->config.width);
+    g_return_if_fail (y >= 0 && y < canvas->config.height);
+
+    get_cell_colors (canvas, &canvas->cells [y * canvas->config.width + x],
+                     fg_out, bg_out);
+}
+
 /**
  * chafa_canvas_set_colors_at:
  * @canvas: The canvas to manipulate
@@ -1824,41 +3023,15 @@ void
 chafa_canvas_get_raw_colors_at (ChafaCanvas *canvas, gint x, gint y,
                                 gint *fg_out, gint *bg_out)
 {
-    const ChafaCanvasCell *cell;
-    gint fg = -1, bg = -1;
+    gint fg, bg;
 
     g_return_if_fail (canvas != NULL);
     g_return_if_fail (canvas->refs > 0);
     g_return_if_fail (x >= 0 && x < canvas->config.width);
     g_return_if_fail (y >= 0 && y < canvas->config.height);
 
-    cell = &canvas->cells [y * canvas->config.width + x];
-
-    switch (canvas->config.canvas_mode)
-    {
-        case CHAFA_CANVAS_MODE_TRUECOLOR:
-            fg = packed_rgba_to_rgb (canvas, cell->fg_color);
-            bg = packed_rgba_to_rgb (canvas, cell->bg_color);
-            break;
-        case CHAFA_CANVAS_MODE_INDEXED_256:
-        case CHAFA_CANVAS_MODE_INDEXED_240:
-        case CHAFA_CANVAS_MODE_INDEXED_16:
-        case CHAFA_CANVAS_MODE_INDEXED_8:
-            fg = cell->fg_color < 256 ? (gint) cell->fg_color : -1;
-            bg = cell->bg_color < 256 ? (gint) cell->bg_color : -1;
-            break;
-        case CHAFA_CANVAS_MODE_FGBG_BGFG:
-            fg = cell->fg_color == CHAFA_PALETTE_INDEX_FG ? 0 : -1;
-            bg = cell->bg_color == CHAFA_PALETTE_INDEX_FG ? 0 : -1;
-            break;
-        case CHAFA_CANVAS_MODE_FGBG:
-            fg = 0;
-            bg = -1;
-            break;
-        case CHAFA_CANVAS_MODE_MAX:
-            g_assert_not_reached ();
-            break;
-    }
+    get_cell_raw_colors (canvas, &canvas->cells [y * canvas->config.width + x],
+                         &fg, &bg);
 
     if (fg_out)
         *fg_out = fg;
@@ -1938,3 +3111,133 @@ chafa_canvas_set_raw_colors_at (ChafaCanvas *canvas, gint x, gint y,
         cell [1].bg_color = cell->bg_color;
     }
 }
+
+/**
+ * chafa_canvas_get_cells:
+ * @canvas: The canvas to inspect
+ * @x: Column of the region's top left corner
+ * @y: Row of the region's top left corner
+ * @width: Width of the region, in cells
+ * @height: Height of the region, in cells
+ * @cells_out: Storage for width * height cell records, in row-major order
+ *
+ * Exports a rectangular region of the canvas in a single call. This is
+ * equivalent to calling chafa_canvas_get_char_at() and
+ * chafa_canvas_get_colors_at() for every cell in the region, but with
+ * the per-call overhead paid only once. Useful when copying the entire
+ * canvas into e.g. a curses pad every frame.
+ *
+ * The colors will be -1 for transparency, packed 8bpc RGB otherwise,
+ * i.e. 0x00RRGGBB hex. If the canvas is in an indexed mode, palette
+ * lookups will be made for you.
+ *
+ * Since: 1.10
+ **/
+void
+chafa_canvas_get_cells (ChafaCanvas *canvas, gint x, gint y,
+                        gint width, gint height,
+                        ChafaCanvasCellInfo *cells_out)
+{
+    gint row, col;
+
+    g_return_if_fail (canvas != NULL);
+    g_return_if_fail (canvas->refs > 0);
+    g_return_if_fail (width >= 0 && height >= 0);
+    g_return_if_fail (x >= 0 && x + width <= canvas->config.width);
+    g_return_if_fail (y >= 0 && y + height <= canvas->config.height);
+    g_return_if_fail (cells_out != NULL);
+
+    for (row = 0; row < height; row++)
+    {
+        const ChafaCanvasCell *cell = &canvas->cells [(y + row) * canvas->config.width + x];
+
+        for (col = 0; col < width; col++, cell++, cells_out++)
+        {
+            cells_out->c = cell->c;
+            get_cell_colors (canvas, cell, &cells_out->fg_color, &cells_out->bg_color);
+        }
+    }
+}
+
+/**
+ * chafa_canvas_get_raw_cells:
+ * @canvas: The canvas to inspect
+ * @x: Column of the region's top left corner
+ * @y: Row of the region's top left corner
+ * @width: Width of the region, in cells
+ * @height: Height of the region, in cells
+ * @cells_out: Storage for width * height cell records, in row-major order
+ *
+ * Like chafa_canvas_get_cells(), but color values are reported the way
+ * chafa_canvas_get_raw_colors_at() reports them: packed 8bpc RGB in
+ * truecolor mode, the raw pen value (0-255) in indexed modes, and -1
+ * for transparency.
+ *
+ * It's the caller's responsibility to handle the color values correctly
+ * according to the canvas mode (truecolor or indexed).
+ *
+ * Since: 1.10
+ **/
+void
+chafa_canvas_get_raw_cells (ChafaCanvas *canvas, gint x, gint y,
+                            gint width, gint height,
+                            ChafaCanvasCellInfo *cells_out)
+{
+    gint row, col;
+
+    g_return_if_fail (canvas != NULL);
+    g_return_if_fail (canvas->refs > 0);
+    g_return_if_fail (width >= 0 && height >= 0);
+    g_return_if_fail (x >= 0 && x + width <= canvas->config.width);
+    g_return_if_fail (y >= 0 && y + height <= canvas->config.height);
+    g_return_if_fail (cells_out != NULL);
+
+    for (row = 0; row < height; row++)
+    {
+        const ChafaCanvasCell *cell = &canvas->cells [(y + row) * canvas->config.width + x];
+
+        for (col = 0; col < width; col++, cell++, cells_out++)
+        {
+            cells_out->c = cell->c;
+            get_cell_raw_colors (canvas, cell, &cells_out->fg_color, &cells_out->bg_color);
+        }
+    }
+}
+
+/**
+ * chafa_canvas_get_allocated_bytes:
+ * @canvas: The canvas to measure
+ *
+ * Returns the number of bytes currently allocated for @canvas' own
+ * buffers: the cell array, cell reuse caches, the scratch pixel buffer
+ * and the previous-frame copy kept for Kitty frame deltas.
+ *
+ * Backing stores belonging to the sixel, Kitty and iTerm2 encoders are
+ * not attributed to a specific canvas; they show up in the process-wide
+ * figures reported by chafa_get_heap_stats() instead.
+ *
+ * Returns: Bytes allocated for @canvas
+ *
+ * Since: 1.10
+ **/
+gsize
+chafa_canvas_get_allocated_bytes (ChafaCanvas *canvas)
+{
+    gsize n_bytes;
+
+    g_return_val_if_fail (canvas != NULL, 0);
+    g_return_val_if_fail (canvas->refs > 0, 0);
+
+    n_bytes = sizeof (ChafaCanvas) + cell_buffer_size (canvas);
+
+    if (canvas->cell_hashes)
+        n_bytes += (gsize) canvas->config.width * canvas->config.height * sizeof (guint64);
+    if (canvas->cell_errors)
+        n_bytes += (gsize) canvas->config.width * canvas->config.height * sizeof (gint);
+    if (canvas->scratch_pixels)
+        n_bytes += (gsize) canvas->scratch_n_pixels * sizeof (ChafaPixel);
+    if (canvas->kitty_prev_frame)
+        n_bytes += (gsize) canvas->width_pixels * canvas->height_pixels * sizeof (guint32);
+
+    return n_bytes;
+}
@@ -30,10 +30,42 @@ G_BEGIN_DECLS
 
 typedef struct ChafaCanvas ChafaCanvas;
 
+/**
+ * ChafaCanvasCellInfo:
+ * @c: The cell's character
+ * @fg_color: The cell's foreground color
+ * @bg_color: The cell's background color
+ *
+ * One cell's contents as exported by chafa_canvas_get_cells() and
+ * chafa_canvas_get_raw_cells().
+ *
+ * Since: 1.10
+ **/
+typedef struct
+{
+    gunichar c;
+    gint fg_color;
+    gint bg_color;
+}
+ChafaCanvasCellInfo;
+
+/**
+ * ChafaCanvasReadyFunc:
+ * @canvas: The canvas that finished drawing
+ * @user_data: User data passed to chafa_canvas_draw_all_pixels_async()
+ *
+ * Invoked on a worker thread when an asynchronous draw completes.
+ *
+ * Since: 1.10
+ **/
+typedef void (*ChafaCanvasReadyFunc) (ChafaCanvas *canvas, gpointer user_data);
+
 CHAFA_AVAILABLE_IN_ALL
 ChafaCanvas *chafa_canvas_new (const ChafaCanvasConfig *config);
 CHAFA_AVAILABLE_IN_ALL
 ChafaCanvas *chafa_canvas_new_similar (ChafaCanvas *orig);
+CHAFA_AVAILABLE_IN_1_10
+ChafaCanvas *chafa_canvas_new_reflowed (ChafaCanvas *orig, gint width, gint height);
 CHAFA_AVAILABLE_IN_ALL
 void chafa_canvas_ref (ChafaCanvas *canvas);
 CHAFA_AVAILABLE_IN_ALL
@@ -42,12 +74,45 @@ void chafa_canvas_unref (ChafaCanvas *canvas);
 CHAFA_AVAILABLE_IN_ALL
 const ChafaCanvasConfig *chafa_canvas_peek_config (ChafaCanvas *canvas);
 
+CHAFA_AVAILABLE_IN_1_10
+void chafa_canvas_set_buffer_pool (ChafaCanvas *canvas, ChafaBufferPool *pool);
+
 CHAFA_AVAILABLE_IN_1_2
 void chafa_canvas_draw_all_pixels (ChafaCanvas *canvas, ChafaPixelType src_pixel_type,
                                    const guint8 *src_pixels,
                                    gint src_width, gint src_height, gint src_rowstride);
+CHAFA_AVAILABLE_IN_1_10
+void chafa_canvas_draw_all_pixels_indexed (ChafaCanvas *canvas,
+                                           const guint8 *src_index_pixels,
+                                           gint src_width, gint src_height, gint src_rowstride,
+                                           const guint8 *src_palette, gint src_n_colors,
+                                           gint src_transparent_index);
+CHAFA_AVAILABLE_IN_1_10
+void chafa_canvas_draw_all_pixels_async (ChafaCanvas *canvas, ChafaPixelType src_pixel_type,
+                                         const guint8 *src_pixels,
+                                         gint src_width, gint src_height, gint src_rowstride,
+                                         ChafaCanvasReadyFunc ready_func, gpointer user_data);
+CHAFA_AVAILABLE_IN_1_10
+void chafa_canvas_draw_pixel_rows (ChafaCanvas *canvas, ChafaPixelType src_pixel_type,
+                                   const guint8 *src_pixels,
+                                   gint src_width, gint src_height, gint src_rowstride,
+                                   gint first_row, gint n_rows);
 CHAFA_AVAILABLE_IN_1_6
 GString *chafa_canvas_print (ChafaCanvas *canvas, ChafaTermInfo *term_info);
+CHAFA_AVAILABLE_IN_1_10
+void chafa_canvas_print_into (ChafaCanvas *canvas, ChafaTermInfo *term_info,
+                              GString *gs);
+CHAFA_AVAILABLE_IN_1_10
+gboolean chafa_canvas_print_to_fd (ChafaCanvas *canvas, ChafaTermInfo *term_info,
+                                   gint fd);
+CHAFA_AVAILABLE_IN_1_10
+GString *chafa_canvas_print_rows (ChafaCanvas *canvas, ChafaTermInfo *term_info,
+                                  gint first_row, gint n_rows);
+CHAFA_AVAILABLE_IN_1_10
+GString *chafa_canvas_print_diff (ChafaCanvas *canvas, ChafaCanvas *prev_canvas,
+                                  ChafaTermInfo *term_info);
+CHAFA_AVAILABLE_IN_1_10
+gsize chafa_canvas_get_print_size_max (ChafaCanvas *canvas, ChafaTermInfo *term_info);
 
 CHAFA_AVAILABLE_IN_1_8
 gunichar chafa_canvas_get_char_at (ChafaCanvas *canvas, gint x, gint y);
@@ -64,10 +129,22 @@ void chafa_canvas_set_colors_at (ChafaCanvas *canvas, gint x, gint y,
 CHAFA_AVAILABLE_IN_1_8
 void chafa_canvas_get_raw_colors_at (ChafaCanvas *canvas, gint x, gint y,
                                      gint *fg_out, gint *bg_out);
+
+CHAFA_AVAILABLE_IN_1_10
+void chafa_canvas_get_cells (ChafaCanvas *canvas, gint x, gint y,
+                             gint width, gint height,
+                             ChafaCanvasCellInfo *cells_out);
+CHAFA_AVAILABLE_IN_1_10
+void chafa_canvas_get_raw_cells (ChafaCanvas *canvas, gint x, gint y,
+                                 gint width, gint height,
+                                 ChafaCanvasCellInfo *cells_out);
 CHAFA_AVAILABLE_IN_1_8
 void chafa_canvas_set_raw_colors_at (ChafaCanvas *canvas, gint x, gint y,
                                      gint fg, gint bg);
 
+CHAFA_AVAILABLE_IN_1_10
+gsize chafa_canvas_get_allocated_bytes (ChafaCanvas *canvas);
+
 CHAFA_DEPRECATED_IN_1_2
 void chafa_canvas_set_contents_rgba8 (ChafaCanvas *canvas, const guint8 *src_pixels,
                                      gint src_width, gint src_height, gint src_rowstride);
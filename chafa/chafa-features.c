@@ -38,6 +38,8 @@
  * @CHAFA_FEATURE_MMX: Flag indicating MMX support.
  * @CHAFA_FEATURE_SSE41: Flag indicating SSE 4.1 support.
  * @CHAFA_FEATURE_POPCNT: Flag indicating popcnt support.
+ * @CHAFA_FEATURE_AVX2: Flag indicating AVX2 support.
+ * @CHAFA_FEATURE_NEON: Flag indicating ARM NEON support.
  **/
 
 static gboolean chafa_initialized;
@@ -45,6 +47,8 @@ static gboolean chafa_initialized;
 static gboolean have_mmx;
 static gboolean have_sse41;
 static gboolean have_popcnt;
+static gboolean have_avx2;
+static gboolean have_neon;
 
 static void
 init_features (void)
@@ -66,6 +70,17 @@ init_features (void)
     if (__builtin_cpu_supports ("popcnt"))
         have_popcnt = TRUE;
 # endif
+
+# ifdef HAVE_AVX2_INTRINSICS
+    if (__builtin_cpu_supports ("avx2"))
+        have_avx2 = TRUE;
+# endif
+#endif
+
+#ifdef HAVE_NEON_INTRINSICS
+    /* The configure check only passes where NEON is part of the baseline
+     * (e.g. AArch64), so no runtime probe is needed */
+    have_neon = TRUE;
 #endif
 }
 
@@ -106,6 +121,18 @@ chafa_have_popcnt (void)
     return have_popcnt;
 }
 
+gboolean
+chafa_have_avx2 (void)
+{
+    return have_avx2;
+}
+
+gboolean
+chafa_have_neon (void)
+{
+    return have_neon;
+}
+
 /* Public API */
 
 /**
@@ -132,6 +159,14 @@ chafa_get_builtin_features (void)
     features |= CHAFA_FEATURE_POPCNT;
 #endif
 
+#ifdef HAVE_AVX2_INTRINSICS
+    features |= CHAFA_FEATURE_AVX2;
+#endif
+
+#ifdef HAVE_NEON_INTRINSICS
+    features |= CHAFA_FEATURE_NEON;
+#endif
+
     return features;
 }
 
@@ -150,7 +185,9 @@ chafa_get_supported_features (void)
 
     return (have_mmx ? CHAFA_FEATURE_MMX : 0)
       | (have_sse41 ? CHAFA_FEATURE_SSE41 : 0)
-      | (have_popcnt ? CHAFA_FEATURE_POPCNT : 0);
+      | (have_popcnt ? CHAFA_FEATURE_POPCNT : 0)
+      | (have_avx2 ? CHAFA_FEATURE_AVX2 : 0)
+      | (have_neon ? CHAFA_FEATURE_NEON : 0);
 }
 
 /**
@@ -174,6 +211,10 @@ chafa_describe_features (ChafaFeatures features)
         g_string_append (features_gstr, "sse4.1 ");
     if (features & CHAFA_FEATURE_POPCNT)
         g_string_append (features_gstr, "popcnt ");
+    if (features & CHAFA_FEATURE_AVX2)
+        g_string_append (features_gstr, "avx2 ");
+    if (features & CHAFA_FEATURE_NEON)
+        g_string_append (features_gstr, "neon ");
 
     if (features_gstr->len > 0 && features_gstr->str [features_gstr->len - 1] == ' ')
         g_string_truncate (features_gstr, features_gstr->len - 1);
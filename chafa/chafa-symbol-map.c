@@ -30,6 +30,10 @@
 /* Max number of candidates to return from chafa_symbol_map_find_candidates() */
 #define N_CANDIDATES_MAX 8
 
+/* With maps this big, pre-filtering on 16-bit coarse signatures beats the
+ * vectorized exact scan; below it, the full scan is cheap enough anyway */
+#define COARSE_FILTER_MIN_SYMBOLS 256
+
 typedef enum
 {
     SELECTOR_TAG,
@@ -167,6 +171,20 @@ bitmap_to_bytes (guint64 bitmap)
     return cov;
 }
 
+/* Initialize a ChafaSymbol from a user glyph bitmap. Coverage is allocated. */
+static void
+init_symbol_from_glyph_bitmap (ChafaSymbol *sym, ChafaSymbolTags tags, gunichar c,
+                               guint64 bitmap)
+{
+    sym->sc = tags;
+    sym->c = c;
+    sym->bitmap = bitmap;
+    sym->coverage = (gchar *) bitmap_to_bytes (bitmap);
+    sym->popcount = chafa_population_count_u64 (bitmap);
+    sym->fg_weight = sym->popcount;
+    sym->bg_weight = CHAFA_SYMBOL_N_PIXELS - sym->popcount;
+}
+
 /* Input format must always be RGBA8. old_format is just an indicator of how
  * the channel values are to be extracted. */
 static void
@@ -332,6 +350,26 @@ glyph_to_bitmap_wide (gint width, gint height,
                                             CHAFA_SYMBOL_WIDTH_PIXELS * 2);
 }
 
+/* 16-bit downsampled signature: one bit per 4-bit group of the cell
+ * bitmap, set if any bit in the group is. Any disjoint grouping gives the
+ * same bound properties, so we use nibbles, which are cheapest to fold. A
+ * differing signature bit implies at least one differing bitmap bit, and
+ * groups where both signatures are clear are known identical. */
+static guint16
+coarse_signature (guint64 bitmap)
+{
+    guint16 sig = 0;
+    gint i;
+
+    for (i = 0; i < 16; i++)
+    {
+        if ((bitmap >> (i * 4)) & 0xf)
+            sig |= (guint16) 1 << i;
+    }
+
+    return sig;
+}
+
 static gint
 compare_symbols_popcount (const void *a, const void *b)
 {
@@ -367,12 +405,6 @@ compile_symbols (ChafaSymbolMap *symbol_map, GHashTable *desired_symbols)
     gpointer key, value;
     gint i;
 
-    for (i = 0; i < symbol_map->n_symbols; i++)
-        g_free (symbol_map->symbols [i].coverage);
-
-    g_free (symbol_map->symbols);
-    g_free (symbol_map->packed_bitmaps);
-
     symbol_map->n_symbols = g_hash_table_size (desired_symbols);
     symbol_map->symbols = g_new (ChafaSymbol, symbol_map->n_symbols + 1);
 
@@ -397,6 +429,10 @@ compile_symbols (ChafaSymbolMap *symbol_map, GHashTable *desired_symbols)
     symbol_map->packed_bitmaps = g_new (guint64, symbol_map->n_symbols);
     for (i = 0; i < symbol_map->n_symbols; i++)
         symbol_map->packed_bitmaps [i] = symbol_map->symbols [i].bitmap;
+
+    symbol_map->coarse_bitmaps = g_new (guint16, symbol_map->n_symbols);
+    for (i = 0; i < symbol_map->n_symbols; i++)
+        symbol_map->coarse_bitmaps [i] = coarse_signature (symbol_map->packed_bitmaps [i]);
 }
 
 static void
@@ -406,14 +442,6 @@ compile_symbols_wide (ChafaSymbolMap *symbol_map, GHashTable *desired_symbols)
     gpointer key, value;
     gint i;
 
-    for (i = 0; i < symbol_map->n_symbols2; i++)
-    {
-        g_free (symbol_map->symbols2 [i].sym [0].coverage);
-        g_free (symbol_map->symbols2 [i].sym [1].coverage);
-    }
-
-    g_free (symbol_map->symbols2);
-
     symbol_map->n_symbols2 = g_hash_table_size (desired_symbols);
     symbol_map->symbols2 = g_new (ChafaSymbol2, symbol_map->n_symbols2 + 1);
 
@@ -445,6 +473,29 @@ compile_symbols_wide (ChafaSymbolMap *symbol_map, GHashTable *desired_symbols)
     }
 }
 
+/* Precompute popcount -> closest-popcount symbol lookups for fill symbol
+ * selection. Symbols are sorted by ascending popcount, so a single advancing
+ * pass suffices; for each target we keep the last symbol with popcount at or
+ * below it, stepping forward when the next symbol is strictly closer. This
+ * matches what the old binary search would've picked. */
+static void
+build_fill_index (ChafaSymbolMap *symbol_map)
+{
+    gint i = 0;
+    gint p;
+
+    for (p = 0; p <= CHAFA_SYMBOL_N_PIXELS; p++)
+    {
+        while (i + 1 < symbol_map->n_symbols
+               && (symbol_map->symbols [i + 1].popcount <= p
+                   || (abs (symbol_map->symbols [i + 1].popcount - p)
+                       < abs (symbol_map->symbols [i].popcount - p))))
+            i++;
+
+        symbol_map->fill_index [p] = i;
+    }
+}
+
 static gboolean
 char_is_selected (GArray *selectors, ChafaSymbolTags tags, gunichar c)
 {
@@ -525,6 +576,44 @@ free_symbol_wide (gpointer sym_p)
     g_free (sym);
 }
 
+/* Drop this map's hold on the prepared symbol arrays. They may be shared
+ * with other maps copied from the same source; the last holder frees them. */
+static void
+clear_prepared (ChafaSymbolMap *symbol_map)
+{
+    gint i;
+
+    if (!symbol_map->prepared_refs
+        || g_atomic_int_dec_and_test (symbol_map->prepared_refs))
+    {
+        for (i = 0; i < symbol_map->n_symbols; i++)
+            g_free (symbol_map->symbols [i].coverage);
+
+        for (i = 0; i < symbol_map->n_symbols2; i++)
+        {
+            g_free (symbol_map->symbols2 [i].sym [0].coverage);
+            g_free (symbol_map->symbols2 [i].sym [1].coverage);
+        }
+
+        g_free (symbol_map->symbols);
+        g_free (symbol_map->symbols2);
+        g_free (symbol_map->packed_bitmaps);
+        g_free (symbol_map->packed_bitmaps2);
+        g_free (symbol_map->coarse_bitmaps);
+        g_free (symbol_map->prepared_refs);
+    }
+
+    symbol_map->symbols = NULL;
+    symbol_map->n_symbols = 0;
+    symbol_map->symbols2 = NULL;
+    symbol_map->n_symbols2 = 0;
+    symbol_map->packed_bitmaps = NULL;
+    symbol_map->packed_bitmaps2 = NULL;
+    symbol_map->coarse_bitmaps = NULL;
+    symbol_map->prepared_refs = NULL;
+    symbol_map->n_selectors_prepared = -1;
+}
+
 static void
 rebuild_symbols (ChafaSymbolMap *symbol_map)
 {
@@ -534,6 +623,8 @@ rebuild_symbols (ChafaSymbolMap *symbol_map)
     gpointer key, value;
     gint i;
 
+    clear_prepared (symbol_map);
+
     desired_syms = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, free_symbol);
     desired_syms_wide = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, free_symbol_wide);
 
@@ -592,14 +683,7 @@ rebuild_symbols (ChafaSymbolMap *symbol_map)
         {
             ChafaSymbol *sym = g_new0 (ChafaSymbol, 1);
 
-            sym->sc = tags;
-            sym->c = glyph->c;
-            sym->bitmap = glyph->bitmap;
-            sym->coverage = (gchar *) bitmap_to_bytes (glyph->bitmap);
-            sym->popcount = chafa_population_count_u64 (glyph->bitmap);
-            sym->fg_weight = sym->popcount;
-            sym->bg_weight = CHAFA_SYMBOL_N_PIXELS - sym->popcount;
-
+            init_symbol_from_glyph_bitmap (sym, tags, glyph->c, glyph->bitmap);
             g_hash_table_replace (desired_syms, GUINT_TO_POINTER (glyph->c), sym);
         }
     }
@@ -619,22 +703,8 @@ rebuild_symbols (ChafaSymbolMap *symbol_map)
         {
             ChafaSymbol2 *sym = g_new0 (ChafaSymbol2, 1);
 
-            sym->sym [0].sc = tags;
-            sym->sym [0].c = glyph->c;
-            sym->sym [0].bitmap = glyph->bitmap [0];
-            sym->sym [0].coverage = (gchar *) bitmap_to_bytes (glyph->bitmap [0]);
-            sym->sym [0].popcount = chafa_population_count_u64 (glyph->bitmap [0]);
-            sym->sym [0].fg_weight = sym->sym [0].popcount;
-            sym->sym [0].bg_weight = CHAFA_SYMBOL_N_PIXELS - sym->sym [0].popcount;
-
-            sym->sym [1].sc = tags;
-            sym->sym [1].c = glyph->c;
-            sym->sym [1].bitmap = glyph->bitmap [1];
-            sym->sym [1].coverage = (gchar *) bitmap_to_bytes (glyph->bitmap [1]);
-            sym->sym [1].popcount = chafa_population_count_u64 (glyph->bitmap [1]);
-            sym->sym [1].fg_weight = sym->sym [1].popcount;
-            sym->sym [1].bg_weight = CHAFA_SYMBOL_N_PIXELS - sym->sym [1].popcount;
-
+            init_symbol_from_glyph_bitmap (&sym->sym [0], tags, glyph->c, glyph->bitmap [0]);
+            init_symbol_from_glyph_bitmap (&sym->sym [1], tags, glyph->c, glyph->bitmap [1]);
             g_hash_table_replace (desired_syms_wide, GUINT_TO_POINTER (glyph->c), sym);
         }
     }
@@ -642,9 +712,295 @@ rebuild_symbols (ChafaSymbolMap *symbol_map)
     compile_symbols_wide (symbol_map, desired_syms_wide);
     g_hash_table_destroy (desired_syms_wide);
 
+    build_fill_index (symbol_map);
+
+    symbol_map->prepared_refs = g_new (gint, 1);
+    *symbol_map->prepared_refs = 1;
+
+    symbol_map->n_selectors_prepared = symbol_map->selectors->len;
     symbol_map->need_rebuild = FALSE;
 }
 
+static gboolean
+selector_matches (const Selector *selector, ChafaSymbolTags tags, gunichar c)
+{
+    if (selector->selector_type == SELECTOR_TAG)
+        return (tags & selector->tags) ? TRUE : FALSE;
+
+    return c >= selector->first_code_point && c <= selector->last_code_point;
+}
+
+/* TRUE if any selector appended since the last prepare applies to this
+ * character. Only such characters can change selection state; since
+ * char_is_selected () lets the last matching selector win and updates
+ * its auto-exclusions only on a match, everything else is untouched. */
+static gboolean
+char_matches_new_selectors (const ChafaSymbolMap *symbol_map, ChafaSymbolTags tags, gunichar c)
+{
+    gint i;
+
+    for (i = symbol_map->n_selectors_prepared; i < (gint) symbol_map->selectors->len; i++)
+    {
+        if (selector_matches (&g_array_index (symbol_map->selectors, Selector, i), tags, c))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* Apply selectors appended since the last prepare without rebuilding the
+ * whole map. The affected characters are re-evaluated against the full
+ * selector list; the sorted symbol arrays are then patched with a stable
+ * filter (drops) and a sorted merge (additions), so a tag toggle costs
+ * O(n) instead of a full re-sort and re-pack.
+ *
+ * Returns FALSE if the map must be rebuilt in full instead: the prepared
+ * arrays are missing, shared with another map, or were invalidated by a
+ * glyph or selector-reset mutation. */
+static gboolean
+prepare_incremental (ChafaSymbolMap *symbol_map)
+{
+    GHashTable *affected, *affected_wide;
+    GHashTable *desired, *desired_wide;
+    GHashTableIter iter;
+    gpointer key, value;
+    ChafaSymbol *add_syms, *merged;
+    ChafaSymbol2 *add_syms2, *merged2;
+    gint n_add, n_add2;
+    gint i, j, n;
+
+    if (symbol_map->n_selectors_prepared < 0
+        || symbol_map->n_selectors_prepared >= (gint) symbol_map->selectors->len
+        || !symbol_map->prepared_refs
+        || g_atomic_int_get (symbol_map->prepared_refs) != 1)
+        return FALSE;
+
+    affected = g_hash_table_new (g_direct_hash, g_direct_equal);
+    affected_wide = g_hash_table_new (g_direct_hash, g_direct_equal);
+    desired = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, free_symbol);
+    desired_wide = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, free_symbol_wide);
+
+    /* Characters whose user glyph tags match a new selector. These need
+     * their built-in contribution re-evaluated too, so collect them first. */
+
+    g_hash_table_iter_init (&iter, symbol_map->glyphs);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        Glyph *glyph = value;
+
+        if (char_matches_new_selectors (symbol_map, chafa_get_tags_for_char (glyph->c), glyph->c))
+            g_hash_table_add (affected, GUINT_TO_POINTER (glyph->c));
+    }
+
+    g_hash_table_iter_init (&iter, symbol_map->glyphs2);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        Glyph2 *glyph = value;
+
+        if (char_matches_new_selectors (symbol_map, chafa_get_tags_for_char (glyph->c), glyph->c))
+            g_hash_table_add (affected_wide, GUINT_TO_POINTER (glyph->c));
+    }
+
+    /* Built-in contributions for affected characters */
+
+    if (symbol_map->use_builtin_glyphs)
+    {
+        for (i = 0; chafa_symbols [i].c != 0; i++)
+        {
+            gunichar c = chafa_symbols [i].c;
+
+            if (!g_hash_table_contains (affected, GUINT_TO_POINTER (c))
+                && !char_matches_new_selectors (symbol_map, chafa_symbols [i].sc, c))
+                continue;
+
+            g_hash_table_add (affected, GUINT_TO_POINTER (c));
+
+            if (char_is_selected (symbol_map->selectors, chafa_symbols [i].sc, c))
+            {
+                ChafaSymbol *sym = g_new (ChafaSymbol, 1);
+
+                *sym = chafa_symbols [i];
+                sym->coverage = g_memdup (sym->coverage, CHAFA_SYMBOL_N_PIXELS);
+                g_hash_table_replace (desired, GUINT_TO_POINTER (c), sym);
+            }
+        }
+
+        for (i = 0; chafa_symbols2 [i].sym [0].c != 0; i++)
+        {
+            gunichar c = chafa_symbols2 [i].sym [0].c;
+
+            if (!g_hash_table_contains (affected_wide, GUINT_TO_POINTER (c))
+                && !char_matches_new_selectors (symbol_map, chafa_symbols2 [i].sym [0].sc, c))
+                continue;
+
+            g_hash_table_add (affected_wide, GUINT_TO_POINTER (c));
+
+            if (char_is_selected (symbol_map->selectors, chafa_symbols2 [i].sym [0].sc, c))
+            {
+                ChafaSymbol2 *sym = g_new (ChafaSymbol2, 1);
+
+                *sym = chafa_symbols2 [i];
+                sym->sym [0].coverage = g_memdup (sym->sym [0].coverage, CHAFA_SYMBOL_N_PIXELS);
+                sym->sym [1].coverage = g_memdup (sym->sym [1].coverage, CHAFA_SYMBOL_N_PIXELS);
+                g_hash_table_replace (desired_wide, GUINT_TO_POINTER (c), sym);
+            }
+        }
+    }
+
+    /* User glyph contributions override built-ins, as in rebuild_symbols () */
+
+    g_hash_table_iter_init (&iter, symbol_map->glyphs);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        Glyph *glyph = value;
+        ChafaSymbolTags tags = chafa_get_tags_for_char (glyph->c);
+
+        if (!g_hash_table_contains (affected, GUINT_TO_POINTER (glyph->c)))
+            continue;
+
+        if (char_is_selected (symbol_map->selectors, tags, glyph->c))
+        {
+            ChafaSymbol *sym = g_new0 (ChafaSymbol, 1);
+
+            init_symbol_from_glyph_bitmap (sym, tags, glyph->c, glyph->bitmap);
+            g_hash_table_replace (desired, GUINT_TO_POINTER (glyph->c), sym);
+        }
+    }
+
+    g_hash_table_iter_init (&iter, symbol_map->glyphs2);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        Glyph2 *glyph = value;
+        ChafaSymbolTags tags = chafa_get_tags_for_char (glyph->c);
+
+        if (!g_hash_table_contains (affected_wide, GUINT_TO_POINTER (glyph->c)))
+            continue;
+
+        if (char_is_selected (symbol_map->selectors, tags, glyph->c))
+        {
+            ChafaSymbol2 *sym = g_new0 (ChafaSymbol2, 1);
+
+            init_symbol_from_glyph_bitmap (&sym->sym [0], tags, glyph->c, glyph->bitmap [0]);
+            init_symbol_from_glyph_bitmap (&sym->sym [1], tags, glyph->c, glyph->bitmap [1]);
+            g_hash_table_replace (desired_wide, GUINT_TO_POINTER (glyph->c), sym);
+        }
+    }
+
+    /* Steal the desired symbols into sorted arrays. Affected characters that
+     * remain selected are dropped from the old array and re-added from here,
+     * which also covers a representation change (built-in <-> user glyph). */
+
+    n_add = g_hash_table_size (desired);
+    add_syms = g_new (ChafaSymbol, n_add);
+    i = 0;
+    g_hash_table_iter_init (&iter, desired);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        add_syms [i++] = *(ChafaSymbol *) value;
+        g_hash_table_iter_steal (&iter);
+        g_free (value);
+    }
+    qsort (add_syms, n_add, sizeof (ChafaSymbol), compare_symbols_popcount);
+
+    n_add2 = g_hash_table_size (desired_wide);
+    add_syms2 = g_new (ChafaSymbol2, n_add2);
+    i = 0;
+    g_hash_table_iter_init (&iter, desired_wide);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        add_syms2 [i++] = *(ChafaSymbol2 *) value;
+        g_hash_table_iter_steal (&iter);
+        g_free (value);
+    }
+    qsort (add_syms2, n_add2, sizeof (ChafaSymbol2), compare_symbols2_popcount);
+
+    /* Drop affected symbols and merge in the new ones, preserving order */
+
+    merged = g_new (ChafaSymbol, symbol_map->n_symbols + n_add + 1);
+    for (i = 0, j = 0, n = 0; i < symbol_map->n_symbols; i++)
+    {
+        ChafaSymbol *sym = &symbol_map->symbols [i];
+
+        if (g_hash_table_contains (affected, GUINT_TO_POINTER (sym->c)))
+        {
+            g_free (sym->coverage);
+            continue;
+        }
+
+        while (j < n_add && add_syms [j].popcount <= sym->popcount)
+            merged [n++] = add_syms [j++];
+
+        merged [n++] = *sym;
+    }
+    while (j < n_add)
+        merged [n++] = add_syms [j++];
+    memset (&merged [n], 0, sizeof (ChafaSymbol));
+
+    g_free (add_syms);
+    g_free (symbol_map->symbols);
+    symbol_map->symbols = merged;
+    symbol_map->n_symbols = n;
+
+    merged2 = g_new (ChafaSymbol2, symbol_map->n_symbols2 + n_add2 + 1);
+    for (i = 0, j = 0, n = 0; i < symbol_map->n_symbols2; i++)
+    {
+        ChafaSymbol2 *sym = &symbol_map->symbols2 [i];
+
+        if (g_hash_table_contains (affected_wide, GUINT_TO_POINTER (sym->sym [0].c)))
+        {
+            g_free (sym->sym [0].coverage);
+            g_free (sym->sym [1].coverage);
+            continue;
+        }
+
+        while (j < n_add2
+               && add_syms2 [j].sym [0].popcount + add_syms2 [j].sym [1].popcount
+                  <= sym->sym [0].popcount + sym->sym [1].popcount)
+            merged2 [n++] = add_syms2 [j++];
+
+        merged2 [n++] = *sym;
+    }
+    while (j < n_add2)
+        merged2 [n++] = add_syms2 [j++];
+    memset (&merged2 [n], 0, sizeof (ChafaSymbol2));
+
+    g_free (add_syms2);
+    g_free (symbol_map->symbols2);
+    symbol_map->symbols2 = merged2;
+    symbol_map->n_symbols2 = n;
+
+    /* The packed and coarse bitmaps are plain projections of the sorted
+     * arrays; regenerating them is linear and cheap */
+
+    g_free (symbol_map->packed_bitmaps);
+    g_free (symbol_map->coarse_bitmaps);
+    symbol_map->packed_bitmaps = g_new (guint64, symbol_map->n_symbols);
+    symbol_map->coarse_bitmaps = g_new (guint16, symbol_map->n_symbols);
+    for (i = 0; i < symbol_map->n_symbols; i++)
+    {
+        symbol_map->packed_bitmaps [i] = symbol_map->symbols [i].bitmap;
+        symbol_map->coarse_bitmaps [i] = coarse_signature (symbol_map->packed_bitmaps [i]);
+    }
+
+    g_free (symbol_map->packed_bitmaps2);
+    symbol_map->packed_bitmaps2 = g_new (guint64, symbol_map->n_symbols2 * 2);
+    for (i = 0; i < symbol_map->n_symbols2; i++)
+    {
+        symbol_map->packed_bitmaps2 [i * 2] = symbol_map->symbols2 [i].sym [0].bitmap;
+        symbol_map->packed_bitmaps2 [i * 2 + 1] = symbol_map->symbols2 [i].sym [1].bitmap;
+    }
+
+    build_fill_index (symbol_map);
+
+    g_hash_table_destroy (affected);
+    g_hash_table_destroy (affected_wide);
+    g_hash_table_destroy (desired);
+    g_hash_table_destroy (desired_wide);
+
+    symbol_map->n_selectors_prepared = symbol_map->selectors->len;
+    return TRUE;
+}
+
 static GHashTable *
 copy_glyph_table (GHashTable *src)
 {
@@ -936,6 +1292,7 @@ parse_selectors (ChafaSymbolMap *symbol_map, const gchar *selectors, GError **er
         if (!is_add && !is_remove)
         {
             g_array_set_size (symbol_map->selectors, 0);
+            symbol_map->n_selectors_prepared = -1;
             is_add = TRUE;
         }
 
@@ -977,25 +1334,19 @@ chafa_symbol_map_init (ChafaSymbolMap *symbol_map)
     symbol_map->glyphs = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
     symbol_map->glyphs2 = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
     symbol_map->selectors = g_array_new (FALSE, FALSE, sizeof (Selector));
+    symbol_map->n_selectors_prepared = -1;
 }
 
 void
 chafa_symbol_map_deinit (ChafaSymbolMap *symbol_map)
 {
-    gint i;
-
     g_return_if_fail (symbol_map != NULL);
 
-    for (i = 0; i < symbol_map->n_symbols; i++)
-        g_free (symbol_map->symbols [i].coverage);
+    clear_prepared (symbol_map);
 
     g_hash_table_destroy (symbol_map->glyphs);
     g_hash_table_destroy (symbol_map->glyphs2);
     g_array_free (symbol_map->selectors, TRUE);
-    g_free (symbol_map->symbols);
-    g_free (symbol_map->symbols2);
-    g_free (symbol_map->packed_bitmaps);
-    g_free (symbol_map->packed_bitmaps2);
 }
 
 void
@@ -1009,11 +1360,28 @@ chafa_symbol_map_copy_contents (ChafaSymbolMap *dest, const ChafaSymbolMap *src)
     dest->glyphs = copy_glyph_table (dest->glyphs);
     dest->glyphs2 = copy_glyph2_table (dest->glyphs2);
     dest->selectors = copy_selector_array (dest->selectors);
-    dest->symbols = NULL;
-    dest->symbols2 = NULL;
-    dest->packed_bitmaps = NULL;
-    dest->packed_bitmaps2 = NULL;
-    dest->need_rebuild = TRUE;
+
+    if (!src->need_rebuild && src->prepared_refs)
+    {
+        /* Share the source's prepared symbol arrays instead of making every
+         * copy rebuild them from scratch. They're immutable once built; any
+         * later mutation of this copy detaches it via clear_prepared () */
+        g_atomic_int_inc (dest->prepared_refs);
+    }
+    else
+    {
+        dest->symbols = NULL;
+        dest->n_symbols = 0;
+        dest->symbols2 = NULL;
+        dest->n_symbols2 = 0;
+        dest->packed_bitmaps = NULL;
+        dest->packed_bitmaps2 = NULL;
+        dest->coarse_bitmaps = NULL;
+        dest->prepared_refs = NULL;
+        dest->n_selectors_prepared = -1;
+        dest->need_rebuild = TRUE;
+    }
+
     dest->refs = 1;
 }
 
@@ -1023,6 +1391,12 @@ chafa_symbol_map_prepare (ChafaSymbolMap *symbol_map)
     if (!symbol_map->need_rebuild)
         return;
 
+    if (prepare_incremental (symbol_map))
+    {
+        symbol_map->need_rebuild = FALSE;
+        return;
+    }
+
     rebuild_symbols (symbol_map);
 }
 
@@ -1078,6 +1452,58 @@ insert_candidate (ChafaCandidate *candidates, const ChafaCandidate *new_cand)
     candidates [0] = *new_cand;
 }
 
+/* Scan with coarse signature rejection. Each differing signature bit
+ * implies at least one differing bitmap bit, so the signature distance
+ * bounds the exact distance from below; groups where both signatures are
+ * clear are known identical, bounding it from above. Exact distances are
+ * only computed for symbols that could still make the candidate list. */
+static void
+find_candidates_coarse (const ChafaSymbolMap *symbol_map, guint64 bitmap,
+                        gboolean do_inverse, ChafaCandidate *candidates)
+{
+    guint16 sig = coarse_signature (bitmap);
+    gint i;
+
+    for (i = 0; i < symbol_map->n_symbols; i++)
+    {
+        guint16 sym_sig = symbol_map->coarse_bitmaps [i];
+        gint worst = candidates [N_CANDIDATES_MAX - 1].hamming_distance;
+        gboolean maybe_normal, maybe_inverse;
+        ChafaCandidate cand;
+        gint hd;
+
+        maybe_normal = chafa_population_count_u64 (sig ^ sym_sig) < worst;
+        maybe_inverse = do_inverse
+            && 64 - 4 * chafa_population_count_u64 (sig | sym_sig) < worst;
+
+        if (!maybe_normal && !maybe_inverse)
+            continue;
+
+        hd = chafa_population_count_u64 (bitmap ^ symbol_map->packed_bitmaps [i]);
+
+        if (hd < worst)
+        {
+            cand.symbol_index = i;
+            cand.hamming_distance = hd;
+            cand.is_inverted = FALSE;
+            insert_candidate (candidates, &cand);
+        }
+
+        if (do_inverse)
+        {
+            hd = 64 - hd;
+
+            if (hd < candidates [N_CANDIDATES_MAX - 1].hamming_distance)
+            {
+                cand.symbol_index = i;
+                cand.hamming_distance = hd;
+                cand.is_inverted = TRUE;
+                insert_candidate (candidates, &cand);
+            }
+        }
+    }
+}
+
 void
 chafa_symbol_map_find_candidates (const ChafaSymbolMap *symbol_map, guint64 bitmap,
                                   gboolean do_inverse, ChafaCandidate *candidates_out, gint *n_candidates_inout)
@@ -1098,12 +1524,15 @@ chafa_symbol_map_find_candidates (const ChafaSymbolMap *symbol_map, guint64 bitm
 
     g_return_if_fail (symbol_map != NULL);
 
-    ham_dist = g_alloca (sizeof (gint) * (symbol_map->n_symbols + 1));
-
-    chafa_hamming_distance_vu64 (bitmap, symbol_map->packed_bitmaps, ham_dist, symbol_map->n_symbols);
-
-    if (do_inverse)
+    if (symbol_map->n_symbols >= COARSE_FILTER_MIN_SYMBOLS)
     {
+        find_candidates_coarse (symbol_map, bitmap, do_inverse, candidates);
+    }
+    else if (do_inverse)
+    {
+        ham_dist = g_alloca (sizeof (gint) * (symbol_map->n_symbols + 1));
+        chafa_hamming_distance_vu64 (bitmap, symbol_map->packed_bitmaps, ham_dist, symbol_map->n_symbols);
+
         for (i = 0; i < symbol_map->n_symbols; i++)
         {
             ChafaCandidate cand;
@@ -1130,6 +1559,9 @@ chafa_symbol_map_find_candidates (const ChafaSymbolMap *symbol_map, guint64 bitm
     }
     else
     {
+        ham_dist = g_alloca (sizeof (gint) * (symbol_map->n_symbols + 1));
+        chafa_hamming_distance_vu64 (bitmap, symbol_map->packed_bitmaps, ham_dist, symbol_map->n_symbols);
+
         for (i = 0; i < symbol_map->n_symbols; i++)
         {
             ChafaCandidate cand;
@@ -1232,40 +1664,16 @@ chafa_symbol_map_find_wide_candidates (const ChafaSymbolMap *symbol_map, const g
     memcpy (candidates_out, candidates, i * sizeof (ChafaCandidate));
 }
 
-/* Assumes symbols are sorted by ascending popcount */
 static gint
 find_closest_popcount (const ChafaSymbolMap *symbol_map, gint popcount)
 {
-    gint i, j;
-
     g_assert (symbol_map->n_symbols > 0);
 
-    i = 0;
-    j = symbol_map->n_symbols - 1;
+    /* The wide inverse probe can ask for popcounts past the narrow max;
+     * clamping yields the highest-popcount symbol, like the old search */
+    popcount = MIN (popcount, CHAFA_SYMBOL_N_PIXELS);
 
-    while (i < j)
-    {
-        gint k = (i + j + 1) / 2;
-
-        if (popcount < symbol_map->symbols [k].popcount)
-            j = k - 1;
-        else if (popcount >= symbol_map->symbols [k].popcount)
-            i = k;
-        else
-            i = j = k;
-    }
-
-    /* If we didn't find the exact popcount, the i+1'th element may be
-     * a closer match. */
-
-    if (i < symbol_map->n_symbols - 1
-        && (abs (popcount - symbol_map->symbols [i + 1].popcount)
-            < abs (popcount - symbol_map->symbols [i].popcount)))
-    {
-        i++;
-    }
-
-    return i;
+    return symbol_map->fill_index [popcount];
 }
 
 /* Always returns zero or one candidates. We may want to do more in the future */
@@ -1666,6 +2074,7 @@ chafa_symbol_map_set_allow_builtin_glyphs (ChafaSymbolMap *symbol_map,
         return;
 
     symbol_map->use_builtin_glyphs = use_builtin_glyphs;
+    symbol_map->n_selectors_prepared = -1;
     symbol_map->need_rebuild = TRUE;
 }
 
@@ -1721,5 +2130,6 @@ chafa_symbol_map_add_glyph (ChafaSymbolMap *symbol_map,
         g_hash_table_insert (symbol_map->glyphs, GUINT_TO_POINTER (code_point), glyph);
     }
 
+    symbol_map->n_selectors_prepared = -1;
     symbol_map->need_rebuild = TRUE;
 }
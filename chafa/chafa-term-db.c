@@ -37,8 +37,19 @@
 struct ChafaTermDb
 {
     gint refs;
+
+    /* Memoized detection results. Parsing the sequence strings is the bulk
+     * of the construction cost, so repeat queries (common in short-lived
+     * processes going through the default singleton) get copies of a cached
+     * result instead. detected_env_key records the environment the cached
+     * detection was made in. */
+    ChafaTermInfo *detected_info;
+    gchar *detected_env_key;
+    ChafaTermInfo *fallback_info;
 };
 
+static GMutex cache_mutex;
+
 typedef struct
 {
     ChafaTermSeq seq;
@@ -167,6 +178,10 @@ static const SeqStr *color_fbterm_list [] =
 static const SeqStr kitty_seqs [] =
 {
     { CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1, "\033_Ga=T,f=%1,s=%2,v=%3,c=%4,r=%5,m=1\033\\" },
+    { CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1_ZLIB, "\033_Ga=T,o=z,f=%1,s=%2,v=%3,c=%4,r=%5,m=1\033\\" },
+    { CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1_ID, "\033_Ga=T,i=%1,f=%2,s=%3,v=%4,c=%5,r=%6,m=1\033\\" },
+    { CHAFA_TERM_SEQ_BEGIN_KITTY_IMAGE_FRAME_V1, "\033_Ga=f,i=%1,x=%2,y=%3,s=%4,v=%5,f=32,r=1,m=1\033\\" },
+    { CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1_SHM, "\033_Ga=T,t=s,f=%1,s=%2,v=%3,c=%4,r=%5;" },
     { CHAFA_TERM_SEQ_END_KITTY_IMAGE, "\033_Gm=0\033\\" },
     { CHAFA_TERM_SEQ_BEGIN_KITTY_IMAGE_CHUNK, "\033_Gm=1;" },
     { CHAFA_TERM_SEQ_END_KITTY_IMAGE_CHUNK, "\033\\" },
@@ -382,6 +397,32 @@ detect_capabilities (ChafaTermInfo *ti, gchar **envp)
     add_seqs (ti, rep_seqs_local);
 }
 
+/* The environment variables that influence detect_capabilities (); used
+ * to key the memoized result */
+static const gchar * const detect_env_vars [] =
+{
+    "TERM", "COLORTERM", "VTE_VERSION", "TERM_PROGRAM",
+    "TMUX", "CTX_BACKEND", "LC_TERMINAL",
+    NULL
+};
+
+static gchar *
+build_env_key (gchar **envp)
+{
+    GString *gs = g_string_new (NULL);
+    gint i;
+
+    for (i = 0; detect_env_vars [i]; i++)
+    {
+        const gchar *value = g_environ_getenv (envp, detect_env_vars [i]);
+
+        g_string_append (gs, value ? value : "");
+        g_string_append_c (gs, '\x1f');
+    }
+
+    return g_string_free (gs, FALSE);
+}
+
 static ChafaTermDb *
 instantiate_singleton (G_GNUC_UNUSED gpointer data)
 {
@@ -429,6 +470,11 @@ chafa_term_db_copy (const ChafaTermDb *term_db)
     memcpy (new_term_db, term_db, sizeof (ChafaTermDb));
     new_term_db->refs = 1;
 
+    /* The memoized results stay with the original */
+    new_term_db->detected_info = NULL;
+    new_term_db->detected_env_key = NULL;
+    new_term_db->fallback_info = NULL;
+
     return new_term_db;
 }
 
@@ -471,6 +517,11 @@ chafa_term_db_unref (ChafaTermDb *term_db)
 
     if (g_atomic_int_dec_and_test (&term_db->refs))
     {
+        if (term_db->detected_info)
+            chafa_term_info_unref (term_db->detected_info);
+        g_free (term_db->detected_env_key);
+        if (term_db->fallback_info)
+            chafa_term_info_unref (term_db->fallback_info);
         g_free (term_db);
     }
 }
@@ -513,11 +564,32 @@ ChafaTermInfo *
 chafa_term_db_detect (ChafaTermDb *term_db, gchar **envp)
 {
     ChafaTermInfo *ti;
+    gchar *env_key;
 
     g_return_val_if_fail (term_db != NULL, NULL);
 
-    ti = chafa_term_info_new ();
-    detect_capabilities (ti, envp);
+    env_key = build_env_key (envp);
+
+    g_mutex_lock (&cache_mutex);
+
+    if (!term_db->detected_info
+        || strcmp (env_key, term_db->detected_env_key) != 0)
+    {
+        if (term_db->detected_info)
+            chafa_term_info_unref (term_db->detected_info);
+        g_free (term_db->detected_env_key);
+
+        term_db->detected_info = chafa_term_info_new ();
+        detect_capabilities (term_db->detected_info, envp);
+        term_db->detected_env_key = env_key;
+        env_key = NULL;
+    }
+
+    ti = chafa_term_info_copy (term_db->detected_info);
+
+    g_mutex_unlock (&cache_mutex);
+
+    g_free (env_key);
     return ti;
 }
 
@@ -543,8 +615,17 @@ chafa_term_db_get_fallback_info (ChafaTermDb *term_db)
 
     g_return_val_if_fail (term_db != NULL, NULL);
 
-    ti = chafa_term_info_new ();
-    add_seq_list (ti, fallback_list);
+    g_mutex_lock (&cache_mutex);
+
+    if (!term_db->fallback_info)
+    {
+        term_db->fallback_info = chafa_term_info_new ();
+        add_seq_list (term_db->fallback_info, fallback_list);
+    }
+
+    ti = chafa_term_info_copy (term_db->fallback_info);
+
+    g_mutex_unlock (&cache_mutex);
 
     return ti;
 }
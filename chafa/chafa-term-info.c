@@ -89,6 +89,9 @@
  * @CHAFA_TERM_SEQ_END_KITTY_IMAGE_CHUNK: End Kitty image data chunk.
  * @CHAFA_TERM_SEQ_BEGIN_ITERM2_IMAGE: Begin iTerm2 image data.
  * @CHAFA_TERM_SEQ_END_ITERM2_IMAGE: End of iTerm2 image data.
+ * @CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1_ZLIB: Begin upload of deflate-compressed Kitty image for immediate display at cursor. Since: 1.10
+ * @CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1_ID: Begin upload of Kitty image with an assigned ID for immediate display at cursor. Since: 1.10
+ * @CHAFA_TERM_SEQ_BEGIN_KITTY_IMAGE_FRAME_V1: Begin upload of a region update to a previously transmitted Kitty image. Since: 1.10
  * @CHAFA_TERM_SEQ_MAX: Last control sequence plus one.
  *
  * An enumeration of the control sequences supported by #ChafaTermInfo.
@@ -111,6 +114,10 @@ struct ChafaTermInfo
     gchar seq_str [CHAFA_TERM_SEQ_MAX] [CHAFA_TERM_SEQ_LENGTH_MAX];
     SeqArgInfo seq_args [CHAFA_TERM_SEQ_MAX] [CHAFA_TERM_SEQ_ARGS_MAX];
     gchar *unparsed_str [CHAFA_TERM_SEQ_MAX];
+
+    /* Lazily built by chafa_term_info_get_color256_cache(); dropped
+     * whenever a sequence changes */
+    ChafaTermColor256Cache *color256_cache;
 };
 
 typedef struct
@@ -331,6 +338,20 @@ emit_seq_5_args_uint (const ChafaTermInfo *term_info, gchar *out, ChafaTermSeq s
     return emit_seq_guint (term_info, out, seq, args, 5);
 }
 
+static gchar *
+emit_seq_6_args_uint (const ChafaTermInfo *term_info, gchar *out, ChafaTermSeq seq, guint arg0, guint arg1, guint arg2, guint arg3, guint arg4, guint arg5)
+{
+    guint args [6];
+
+    args [0] = arg0;
+    args [1] = arg1;
+    args [2] = arg2;
+    args [3] = arg3;
+    args [4] = arg4;
+    args [5] = arg5;
+    return emit_seq_guint (term_info, out, seq, args, 6);
+}
+
 static gchar *
 emit_seq_3_args_uint8 (const ChafaTermInfo *term_info, gchar *out, ChafaTermSeq seq, guint8 arg0, guint8 arg1, guint8 arg2)
 {
@@ -407,6 +428,7 @@ chafa_term_info_copy (const ChafaTermInfo *term_info)
     new_term_info = g_new (ChafaTermInfo, 1);
     memcpy (new_term_info, term_info, sizeof (ChafaTermInfo));
     new_term_info->refs = 1;
+    new_term_info->color256_cache = NULL;
 
     for (i = 0; i < CHAFA_TERM_SEQ_MAX; i++)
     {
@@ -461,6 +483,7 @@ chafa_term_info_unref (ChafaTermInfo *term_info)
         for (i = 0; i < CHAFA_TERM_SEQ_MAX; i++)
             g_free (term_info->unparsed_str [i]);
 
+        g_free (term_info->color256_cache);
         g_free (term_info);
     }
 }
@@ -485,6 +508,37 @@ chafa_term_info_have_seq (const ChafaTermInfo *term_info, ChafaTermSeq seq)
     return term_info->unparsed_str [seq] ? TRUE : FALSE;
 }
 
+/* Internal: upper bound on the number of bytes an emit of @seq can
+ * produce, computed from the parsed literal segments and the decimal
+ * width of its argument type. Zero if the sequence is unset. Much
+ * tighter than CHAFA_TERM_SEQ_LENGTH_MAX for typical short sequences. */
+gint
+chafa_term_info_get_seq_length_max (const ChafaTermInfo *term_info, ChafaTermSeq seq)
+{
+    gint arg_len_max;
+    gint len = 0;
+    guint n_args;
+    guint i;
+
+    g_return_val_if_fail (term_info != NULL, 0);
+    g_return_val_if_fail (seq >= 0 && seq < CHAFA_TERM_SEQ_MAX, 0);
+
+    if (!chafa_term_info_have_seq (term_info, seq))
+        return 0;
+
+    n_args = seq_meta [seq].n_args;
+    arg_len_max = seq_meta [seq].type_size == 1 ? 3
+        : seq_meta [seq].type_size == 2 ? 5 : 10;
+
+    for (i = 0; i < n_args; i++)
+        len += term_info->seq_args [seq] [i].pre_len + arg_len_max;
+
+    /* Trailing literal segment */
+    len += term_info->seq_args [seq] [n_args].pre_len;
+
+    return len;
+}
+
 /**
  * chafa_term_info_get_seq:
  * @term_info: A #ChafaTermInfo.
@@ -532,6 +586,13 @@ chafa_term_info_get_seq (ChafaTermInfo *term_info, ChafaTermSeq seq)
  *
  * Since: 1.6
  **/
+static void
+invalidate_color256_cache (ChafaTermInfo *term_info)
+{
+    g_free (term_info->color256_cache);
+    term_info->color256_cache = NULL;
+}
+
 gboolean
 chafa_term_info_set_seq (ChafaTermInfo *term_info, ChafaTermSeq seq, const gchar *str,
                          GError **error)
@@ -543,6 +604,8 @@ chafa_term_info_set_seq (ChafaTermInfo *term_info, ChafaTermSeq seq, const gchar
     g_return_val_if_fail (term_info != NULL, FALSE);
     g_return_val_if_fail (seq >= 0 && seq < CHAFA_TERM_SEQ_MAX, FALSE);
 
+    invalidate_color256_cache (term_info);
+
     if (!str)
     {
         term_info->seq_str [seq] [0] = '\0';
@@ -593,6 +656,8 @@ chafa_term_info_supplement (ChafaTermInfo *term_info, ChafaTermInfo *source)
     g_return_if_fail (term_info != NULL);
     g_return_if_fail (source != NULL);
 
+    invalidate_color256_cache (term_info);
+
     for (i = 0; i < CHAFA_TERM_SEQ_MAX; i++)
     {
         if (!term_info->unparsed_str [i] && source->unparsed_str [i])
@@ -650,6 +715,10 @@ gchar *chafa_term_info_emit_##func_name(const ChafaTermInfo *term_info, gchar *d
 gchar *chafa_term_info_emit_##func_name(const ChafaTermInfo *term_info, gchar *dest, guint arg0, guint arg1, guint arg2, guint arg3, guint arg4) \
 { return emit_seq_5_args_uint (term_info, dest, CHAFA_TERM_SEQ_##seq_name, arg0, arg1, arg2, arg3, arg4); }
 
+#define DEFINE_EMIT_SEQ_6_none_guint(func_name, seq_name) \
+gchar *chafa_term_info_emit_##func_name(const ChafaTermInfo *term_info, gchar *dest, guint arg0, guint arg1, guint arg2, guint arg3, guint arg4, guint arg5) \
+{ return emit_seq_6_args_uint (term_info, dest, CHAFA_TERM_SEQ_##seq_name, arg0, arg1, arg2, arg3, arg4, arg5); }
+
 #define DEFINE_EMIT_SEQ_3_none_guint8(func_name, seq_name) \
 gchar *chafa_term_info_emit_##func_name(const ChafaTermInfo *term_info, gchar *dest, guint8 arg0, guint8 arg1, guint8 arg2) \
 { return emit_seq_3_args_uint8 (term_info, dest, CHAFA_TERM_SEQ_##seq_name, arg0, arg1, arg2); }
@@ -662,3 +731,55 @@ gchar *chafa_term_info_emit_##func_name(const ChafaTermInfo *term_info, gchar *d
     DEFINE_EMIT_SEQ_##n_args##_##arg_proc##_##arg_type(name, NAME)
 #include "chafa-term-seq-def.h"
 #undef CHAFA_TERM_SEQ_DEF
+
+/* The 256-color SGR space is small enough to enumerate, so preformat all
+ * of it once and let the printer copy finished strings instead of running
+ * the formatter per attribute change. Going through the regular emitters
+ * keeps any user-supplied sequence strings intact. */
+static ChafaTermColor256Cache *
+build_color256_cache (const ChafaTermInfo *term_info)
+{
+    ChafaTermColor256Cache *cache;
+    gint i;
+
+    cache = g_new (ChafaTermColor256Cache, 1);
+
+    for (i = 0; i < 256; i++)
+    {
+        gchar *end;
+
+        end = chafa_term_info_emit_set_color_fg_256 (term_info, cache->fg_str [i], i);
+        cache->fg_len [i] = end - cache->fg_str [i];
+
+        end = chafa_term_info_emit_set_color_bg_256 (term_info, cache->bg_str [i], i);
+        cache->bg_len [i] = end - cache->bg_str [i];
+
+        end = chafa_term_info_emit_set_color_fgbg_256 (term_info, cache->fgbg_str [i], i, i);
+        cache->fgbg_len [i] = end - cache->fgbg_str [i];
+    }
+
+    return cache;
+}
+
+const ChafaTermColor256Cache *
+chafa_term_info_get_color256_cache (ChafaTermInfo *term_info)
+{
+    ChafaTermColor256Cache *cache;
+
+    cache = g_atomic_pointer_get (&term_info->color256_cache);
+
+    if (G_UNLIKELY (!cache))
+    {
+        cache = build_color256_cache (term_info);
+
+        /* Another thread may have beaten us to it */
+        if (!g_atomic_pointer_compare_and_exchange (&term_info->color256_cache,
+                                                    NULL, cache))
+        {
+            g_free (cache);
+            cache = g_atomic_pointer_get (&term_info->color256_cache);
+        }
+    }
+
+    return cache;
+}
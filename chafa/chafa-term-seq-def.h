@@ -973,6 +973,128 @@ CHAFA_TERM_SEQ_DEF(begin_iterm2_image, BEGIN_ITERM2_IMAGE, 2, none, guint, CHAFA
  **/
 CHAFA_TERM_SEQ_DEF(end_iterm2_image, END_ITERM2_IMAGE, 0, none, void)
 
+/* --- Available in 1.10+ --- */
+
+#undef CHAFA_TERM_SEQ_AVAILABILITY
+#define CHAFA_TERM_SEQ_AVAILABILITY CHAFA_AVAILABLE_IN_1_10
+
+/**
+ * chafa_term_info_emit_begin_kitty_immediate_image_v1_zlib:
+ * @term_info: A #ChafaTermInfo
+ * @dest: String destination
+ * @bpp: Bits per pixel
+ * @width_pixels: Image width in pixels
+ * @height_pixels: Image height in pixels
+ * @width_cells: Target width in cells
+ * @height_cells: Target height in cells
+ *
+ * Prints the control sequence for #CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1_ZLIB.
+ *
+ * @dest must have enough space to hold
+ * #CHAFA_TERM_SEQ_LENGTH_MAX bytes, even if the emitted sequence is
+ * shorter. The output will not be zero-terminated.
+ *
+ * @bpp must be set to either 24 for RGB data or 32 for RGBA.
+ *
+ * Like #CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1, but the image data
+ * is deflate-compressed before the base-64 encoding. The chunking sequences
+ * are the same as for the uncompressed variant.
+ *
+ * Returns: Pointer to first byte after emitted string
+ *
+ * Since: 1.10
+ **/
+CHAFA_TERM_SEQ_DEF(begin_kitty_immediate_image_v1_zlib, BEGIN_KITTY_IMMEDIATE_IMAGE_V1_ZLIB, 5, none, guint, CHAFA_TERM_SEQ_ARGS guint bpp, guint width_pixels, guint height_pixels, guint width_cells, guint height_cells)
+
+/**
+ * chafa_term_info_emit_begin_kitty_immediate_image_v1_id:
+ * @term_info: A #ChafaTermInfo
+ * @dest: String destination
+ * @image_id: Unique image ID, nonzero
+ * @bpp: Bits per pixel
+ * @width_pixels: Image width in pixels
+ * @height_pixels: Image height in pixels
+ * @width_cells: Target width in cells
+ * @height_cells: Target height in cells
+ *
+ * Prints the control sequence for #CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1_ID.
+ *
+ * @dest must have enough space to hold
+ * #CHAFA_TERM_SEQ_LENGTH_MAX bytes, even if the emitted sequence is
+ * shorter. The output will not be zero-terminated.
+ *
+ * @bpp must be set to either 24 for RGB data or 32 for RGBA.
+ *
+ * Like #CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1, but assigns @image_id
+ * to the image so it can be updated later with
+ * #CHAFA_TERM_SEQ_BEGIN_KITTY_IMAGE_FRAME_V1. The chunking sequences are the
+ * same as for the anonymous variant.
+ *
+ * Returns: Pointer to first byte after emitted string
+ *
+ * Since: 1.10
+ **/
+CHAFA_TERM_SEQ_DEF(begin_kitty_immediate_image_v1_id, BEGIN_KITTY_IMMEDIATE_IMAGE_V1_ID, 6, none, guint, CHAFA_TERM_SEQ_ARGS guint image_id, guint bpp, guint width_pixels, guint height_pixels, guint width_cells, guint height_cells)
+
+/**
+ * chafa_term_info_emit_begin_kitty_image_frame_v1:
+ * @term_info: A #ChafaTermInfo
+ * @dest: String destination
+ * @image_id: ID of a previously transmitted image, nonzero
+ * @x: Horizontal offset of the updated region, in pixels
+ * @y: Vertical offset of the updated region, in pixels
+ * @width_pixels: Width of the updated region, in pixels
+ * @height_pixels: Height of the updated region, in pixels
+ *
+ * Prints the control sequence for #CHAFA_TERM_SEQ_BEGIN_KITTY_IMAGE_FRAME_V1.
+ *
+ * @dest must have enough space to hold
+ * #CHAFA_TERM_SEQ_LENGTH_MAX bytes, even if the emitted sequence is
+ * shorter. The output will not be zero-terminated.
+ *
+ * Begins transmission of RGBA pixel data replacing a rectangular region of
+ * the image previously transmitted with ID @image_id, updating its display
+ * in place. The data must be chunked with the same sequences as
+ * #CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1, ending with
+ * #CHAFA_TERM_SEQ_END_KITTY_IMAGE.
+ *
+ * Returns: Pointer to first byte after emitted string
+ *
+ * Since: 1.10
+ **/
+CHAFA_TERM_SEQ_DEF(begin_kitty_image_frame_v1, BEGIN_KITTY_IMAGE_FRAME_V1, 5, none, guint, CHAFA_TERM_SEQ_ARGS guint image_id, guint x, guint y, guint width_pixels, guint height_pixels)
+
+/**
+ * chafa_term_info_emit_begin_kitty_immediate_image_v1_shm:
+ * @term_info: A #ChafaTermInfo
+ * @dest: String destination
+ * @bpp: Bits per pixel
+ * @width_pixels: Image width in pixels
+ * @height_pixels: Image height in pixels
+ * @width_cells: Target width in cells
+ * @height_cells: Target height in cells
+ *
+ * Prints the control sequence for #CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1_SHM.
+ *
+ * @dest must have enough space to hold
+ * #CHAFA_TERM_SEQ_LENGTH_MAX bytes, even if the emitted sequence is
+ * shorter. The output will not be zero-terminated.
+ *
+ * @bpp must be set to either 24 for RGB data or 32 for RGBA.
+ *
+ * Like #CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1, but the pixel data
+ * is passed out of band in a POSIX shared memory object instead of being
+ * encoded into the stream. The payload is the base64-encoded name of the
+ * object, terminated with #CHAFA_TERM_SEQ_END_KITTY_IMAGE_CHUNK. The
+ * terminal deletes the object after reading it. This only works when the
+ * terminal and the client run on the same host.
+ *
+ * Returns: Pointer to first byte after emitted string
+ *
+ * Since: 1.10
+ **/
+CHAFA_TERM_SEQ_DEF(begin_kitty_immediate_image_v1_shm, BEGIN_KITTY_IMMEDIATE_IMAGE_V1_SHM, 5, none, guint, CHAFA_TERM_SEQ_ARGS guint bpp, guint width_pixels, guint height_pixels, guint width_cells, guint height_cells)
+
 #undef CHAFA_TERM_SEQ_AVAILABILITY
 
 #undef CHAFA_TERM_SEQ_ARGS
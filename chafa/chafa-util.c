@@ -19,6 +19,13 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef HAVE_MADVISE
+# include <sys/mman.h>
+#endif
+
 #include "chafa.h"
 #include "internal/chafa-private.h"
 
@@ -199,3 +206,157 @@ chafa_gen_bayer_matrix (gint matrix_size, gdouble magnitude)
 
     return matrix;
 }
+
+/* --- Large buffer allocation --- */
+
+/* Alignment for large working buffers: a cache line, so batch workers
+ * writing adjacent row ranges don't false-share the boundary lines */
+#define LARGE_ALLOC_ALIGNMENT 64
+
+/* Buffers at least this big get 2 MB alignment and a transparent
+ * huge page hint, cutting dTLB pressure when a pass streams hundreds
+ * of megabytes of working pixels */
+#define LARGE_ALLOC_HUGE_THRESHOLD (2 * 1024 * 1024)
+
+gpointer
+chafa_alloc_large (gsize size)
+{
+#ifdef HAVE_POSIX_MEMALIGN
+    gsize alignment = size >= LARGE_ALLOC_HUGE_THRESHOLD
+        ? LARGE_ALLOC_HUGE_THRESHOLD : LARGE_ALLOC_ALIGNMENT;
+    gpointer p = NULL;
+
+    /* Memory allocated here must be released with chafa_free_large ().
+     * g_free () only matches when GLib's allocator is the system
+     * malloc (), which our baseline GLib version does not guarantee. */
+    if (posix_memalign (&p, alignment, size) != 0)
+    {
+        /* Plain malloc () so chafa_free_large () can release it the same
+         * way as the aligned allocations */
+        p = malloc (size);
+        if (!p)
+            g_error ("%s: failed to allocate %" G_GSIZE_FORMAT " bytes",
+                     G_STRFUNC, size);
+        return p;
+    }
+
+#if defined(HAVE_MADVISE) && defined(MADV_HUGEPAGE)
+    if (size >= LARGE_ALLOC_HUGE_THRESHOLD)
+        madvise (p, size, MADV_HUGEPAGE);
+#endif
+
+    return p;
+#else
+    return g_malloc (size);
+#endif
+}
+
+void
+chafa_free_large (gpointer mem)
+{
+#ifdef HAVE_POSIX_MEMALIGN
+    free (mem);
+#else
+    g_free (mem);
+#endif
+}
+
+/* --- Heap accounting --- */
+
+/* Running totals for the library's large allocations: cell arrays, working
+ * pixel buffers and the picture-mode backing stores. Updated from the
+ * allocation funnels in chafa-canvas.c and the pixel canvases; small
+ * fixed-size structures and transient strings are not tracked. */
+
+static GMutex heap_stats_mutex;
+static gsize heap_current_bytes;
+static gsize heap_peak_bytes;
+
+void
+chafa_heap_stats_add (gsize size)
+{
+    g_mutex_lock (&heap_stats_mutex);
+    heap_current_bytes += size;
+    if (heap_current_bytes > heap_peak_bytes)
+        heap_peak_bytes = heap_current_bytes;
+    g_mutex_unlock (&heap_stats_mutex);
+}
+
+void
+chafa_heap_stats_remove (gsize size)
+{
+    g_mutex_lock (&heap_stats_mutex);
+    g_assert (heap_current_bytes >= size);
+    heap_current_bytes -= size;
+    g_mutex_unlock (&heap_stats_mutex);
+}
+
+/**
+ * chafa_get_heap_stats:
+ * @current_bytes_out: Return location for bytes currently in use, or %NULL
+ * @peak_bytes_out: Return location for the all-time peak, or %NULL
+ *
+ * Reports the library's process-wide memory footprint. The figures cover
+ * the major allocations -- canvas cell arrays, working pixel buffers and
+ * the backing stores used by the sixel, Kitty and iTerm2 pixel modes --
+ * but not small fixed-size structures or transient string output.
+ *
+ * Buffers are counted while held by a canvas; memory idling in a
+ * #ChafaBufferPool after release is excluded. Useful for capacity
+ * planning when running many canvases side by side, where resident set
+ * size alone doesn't show which arenas are growing.
+ *
+ * Since: 1.10
+ **/
+void
+chafa_get_heap_stats (gsize *current_bytes_out, gsize *peak_bytes_out)
+{
+    g_mutex_lock (&heap_stats_mutex);
+    if (current_bytes_out)
+        *current_bytes_out = heap_current_bytes;
+    if (peak_bytes_out)
+        *peak_bytes_out = heap_peak_bytes;
+    g_mutex_unlock (&heap_stats_mutex);
+}
+
+/* Writes the entire buffer to a (blocking) file descriptor, retrying on
+ * EINTR and short writes. Returns FALSE on write error. Used by the
+ * streaming print path; see chafa_canvas_print_to_fd(). */
+gboolean
+chafa_fd_write_all (gint fd, gconstpointer data, gsize len)
+{
+    const gchar *p = data;
+
+    while (len > 0)
+    {
+        gssize n = write (fd, p, len);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+
+        p += n;
+        len -= n;
+    }
+
+    return TRUE;
+}
+
+/* Writes a scratch string to fd and truncates it for reuse. Returns
+ * FALSE on write error. */
+gboolean
+chafa_fd_flush_gstring (gint fd, GString *gs)
+{
+    gboolean success = TRUE;
+
+    if (gs->len > 0)
+    {
+        success = chafa_fd_write_all (fd, gs->str, gs->len);
+        g_string_truncate (gs, 0);
+    }
+
+    return success;
+}
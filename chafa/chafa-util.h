@@ -37,6 +37,10 @@ void chafa_calc_canvas_geometry (gint src_width,
                                  gboolean zoom,
                                  gboolean stretch);
 
+CHAFA_AVAILABLE_IN_1_10
+void chafa_get_heap_stats (gsize *current_bytes_out,
+                           gsize *peak_bytes_out);
+
 G_END_DECLS
 
 #endif /* __CHAFA_UTIL_H__ */
@@ -30,6 +30,7 @@ G_BEGIN_DECLS
 
 #include <chafa-common.h>
 #include <chafa-features.h>
+#include <chafa-buffer-pool.h>
 #include <chafa-canvas-config.h>
 #include <chafa-canvas.h>
 #include <chafa-symbol-map.h>
@@ -0,0 +1,443 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2021 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that turns images into character art.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "config.h"
+
+#include <immintrin.h>
+#include "chafa.h"
+#include "internal/chafa-private.h"
+
+/* Like calc_error_sse41(), but we go four pixels at a time and keep the
+ * error in eight 32-bit accumulators. Alpha is masked off before squaring,
+ * so the result matches the scalar code, which sums R/G/B only. */
+
+static inline __m256i
+sq_error_4px (__m128i px4, __m128i col4, __m256i alpha_mask)
+{
+    __m256i t0, t1, d;
+
+    t0 = _mm256_cvtepu8_epi16 (px4);
+    t1 = _mm256_cvtepu8_epi16 (col4);
+
+    d = _mm256_sub_epi16 (t0, t1);
+    d = _mm256_and_si256 (d, alpha_mask);
+
+    return _mm256_madd_epi16 (d, d);
+}
+
+/* Pick fg or bg color for each of four pixels according to coverage */
+static inline __m128i
+cov_colors_4px (const guint8 *cov, __m128i col_bg4, __m128i col_fg4)
+{
+    __m128i sel, m;
+
+    sel = _mm_cvtepu8_epi32 (_mm_cvtsi32_si128 (*(const gint32 *) cov));
+    m = _mm_cmpgt_epi32 (sel, _mm_setzero_si128 ());
+
+    return _mm_blendv_epi8 (col_bg4, col_fg4, m);
+}
+
+static inline gint
+sum_error_8x32 (__m256i err8)
+{
+    __m128i s;
+
+    s = _mm_add_epi32 (_mm256_castsi256_si128 (err8),
+                       _mm256_extracti128_si256 (err8, 1));
+    s = _mm_add_epi32 (s, _mm_srli_si128 (s, 8));
+    s = _mm_add_epi32 (s, _mm_srli_si128 (s, 4));
+
+    return _mm_cvtsi128_si32 (s);
+}
+
+gint
+calc_error_avx2 (const ChafaPixel *pixels, const ChafaColorPair *color_pair, const guint8 *cov)
+{
+    const guint32 *u32p0 = (const guint32 *) pixels;
+    const guint32 *u32p1 = (const guint32 *) color_pair->colors;
+    const __m256i alpha_mask = _mm256_set_epi16 (0, -1, -1, -1, 0, -1, -1, -1,
+                                                 0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i col_bg4 = _mm_set1_epi32 (u32p1 [0]);
+    const __m128i col_fg4 = _mm_set1_epi32 (u32p1 [1]);
+    __m256i err8 = _mm256_setzero_si256 ();
+    gint i;
+
+    for (i = 0; i < CHAFA_SYMBOL_N_PIXELS; i += 4)
+    {
+        __m128i px4, col4;
+
+        px4 = _mm_loadu_si128 ((const __m128i *) (u32p0 + i));
+        col4 = cov_colors_4px (cov + i, col_bg4, col_fg4);
+
+        err8 = _mm256_add_epi32 (err8, sq_error_4px (px4, col4, alpha_mask));
+    }
+
+    return sum_error_8x32 (err8);
+}
+
+/* Evaluate the two halves of a wide symbol in one pass. The halves use the
+ * same color pair but separate pixel blocks and coverage maps; interleaving
+ * them keeps both accumulator chains busy. */
+void
+calc_error_2_avx2 (const ChafaPixel *pixels_a, const ChafaPixel *pixels_b,
+                   const ChafaColorPair *color_pair,
+                   const guint8 *cov_a, const guint8 *cov_b,
+                   gint *error_a_out, gint *error_b_out)
+{
+    const guint32 *u32pa = (const guint32 *) pixels_a;
+    const guint32 *u32pb = (const guint32 *) pixels_b;
+    const guint32 *u32p1 = (const guint32 *) color_pair->colors;
+    const __m256i alpha_mask = _mm256_set_epi16 (0, -1, -1, -1, 0, -1, -1, -1,
+                                                 0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i col_bg4 = _mm_set1_epi32 (u32p1 [0]);
+    const __m128i col_fg4 = _mm_set1_epi32 (u32p1 [1]);
+    __m256i err8a = _mm256_setzero_si256 ();
+    __m256i err8b = _mm256_setzero_si256 ();
+    gint i;
+
+    for (i = 0; i < CHAFA_SYMBOL_N_PIXELS; i += 4)
+    {
+        __m128i px4, col4;
+
+        px4 = _mm_loadu_si128 ((const __m128i *) (u32pa + i));
+        col4 = cov_colors_4px (cov_a + i, col_bg4, col_fg4);
+        err8a = _mm256_add_epi32 (err8a, sq_error_4px (px4, col4, alpha_mask));
+
+        px4 = _mm_loadu_si128 ((const __m128i *) (u32pb + i));
+        col4 = cov_colors_4px (cov_b + i, col_bg4, col_fg4);
+        err8b = _mm256_add_epi32 (err8b, sq_error_4px (px4, col4, alpha_mask));
+    }
+
+    *error_a_out = sum_error_8x32 (err8a);
+    *error_b_out = sum_error_8x32 (err8b);
+}
+
+/* Sum fg and bg channel totals branch-free. The coverage bytes (0 or 1)
+ * are widened to per-pixel masks; each pixel is AND'ed into the fg sum and
+ * ANDN'ed into the bg sum, sixteen pixels per iteration. Channel sums are
+ * kept in 16-bit lanes, which is safe: 64 pixels * 255 < 2^15. */
+void
+calc_colors_avx2 (const ChafaPixel *pixels, ChafaColorAccum *accums_out, const guint8 *cov)
+{
+    const guint32 *u32p0 = (const guint32 *) pixels;
+    __m256i accum_fg = _mm256_setzero_si256 ();
+    __m256i accum_bg = _mm256_setzero_si256 ();
+    __m128i s_fg, s_bg;
+    gint i;
+
+    for (i = 0; i < CHAFA_SYMBOL_N_PIXELS; i += 16)
+    {
+        gint j;
+
+        for (j = 0; j < 16; j += 8)
+        {
+            __m256i px8, sel, fg8, bg8;
+
+            px8 = _mm256_loadu_si256 ((const __m256i *) (u32p0 + i + j));
+            sel = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *) (cov + i + j)));
+            sel = _mm256_cmpgt_epi32 (sel, _mm256_setzero_si256 ());
+
+            fg8 = _mm256_and_si256 (px8, sel);
+            bg8 = _mm256_andnot_si256 (sel, px8);
+
+            accum_fg = _mm256_add_epi16 (accum_fg,
+                _mm256_add_epi16 (_mm256_cvtepu8_epi16 (_mm256_castsi256_si128 (fg8)),
+                                  _mm256_cvtepu8_epi16 (_mm256_extracti128_si256 (fg8, 1))));
+            accum_bg = _mm256_add_epi16 (accum_bg,
+                _mm256_add_epi16 (_mm256_cvtepu8_epi16 (_mm256_castsi256_si128 (bg8)),
+                                  _mm256_cvtepu8_epi16 (_mm256_extracti128_si256 (bg8, 1))));
+        }
+    }
+
+    /* Fold the four per-slot channel sums down to one */
+
+    s_fg = _mm_add_epi16 (_mm256_castsi256_si128 (accum_fg),
+                          _mm256_extracti128_si256 (accum_fg, 1));
+    s_fg = _mm_add_epi16 (s_fg, _mm_srli_si128 (s_fg, 8));
+    s_bg = _mm_add_epi16 (_mm256_castsi256_si128 (accum_bg),
+                          _mm256_extracti128_si256 (accum_bg, 1));
+    s_bg = _mm_add_epi16 (s_bg, _mm_srli_si128 (s_bg, 8));
+
+    _mm_storel_epi64 ((__m128i *) &accums_out [0], s_bg);
+    _mm_storel_epi64 ((__m128i *) &accums_out [1], s_fg);
+}
+
+/* --- Bulk popcount over packed symbol bitmaps --- */
+
+/* AVX2 has no per-qword popcount instruction, so count set bits per nibble
+ * through a shuffled lookup table and let PSADBW sum the bytes of each
+ * 64-bit lane. Four bitmaps per iteration. */
+
+static inline __m256i
+pop_count_4x64 (__m256i x)
+{
+    const __m256i lut = _mm256_setr_epi8 (0, 1, 1, 2, 1, 2, 2, 3,
+                                          1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3,
+                                          1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble_mask = _mm256_set1_epi8 (0x0f);
+    __m256i lo, hi, cnt;
+
+    lo = _mm256_and_si256 (x, nibble_mask);
+    hi = _mm256_and_si256 (_mm256_srli_epi64 (x, 4), nibble_mask);
+
+    cnt = _mm256_add_epi8 (_mm256_shuffle_epi8 (lut, lo),
+                           _mm256_shuffle_epi8 (lut, hi));
+
+    return _mm256_sad_epu8 (cnt, _mm256_setzero_si256 ());
+}
+
+void
+chafa_hamming_distance_vu64_avx2 (guint64 a, const guint64 *vb, gint *vc, gint n)
+{
+    const __m256i a4 = _mm256_set1_epi64x (a);
+
+    while (n >= 4)
+    {
+        __m256i x = _mm256_xor_si256 (a4, _mm256_loadu_si256 ((const __m256i *) vb));
+        __m256i sum = pop_count_4x64 (x);
+
+        vc [0] = (gint) _mm256_extract_epi64 (sum, 0);
+        vc [1] = (gint) _mm256_extract_epi64 (sum, 1);
+        vc [2] = (gint) _mm256_extract_epi64 (sum, 2);
+        vc [3] = (gint) _mm256_extract_epi64 (sum, 3);
+
+        vb += 4;
+        vc += 4;
+        n -= 4;
+    }
+
+    while (n--)
+        *(vc++) = chafa_population_count_u64 (a ^ *(vb++));
+}
+
+/* Two bitmaps per item (a points to a pair, vb points to array of pairs) */
+void
+chafa_hamming_distance_2_vu64_avx2 (const guint64 *a, const guint64 *vb, gint *vc, gint n)
+{
+    const __m256i a22 = _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i *) a));
+
+    while (n >= 2)
+    {
+        __m256i x = _mm256_xor_si256 (a22, _mm256_loadu_si256 ((const __m256i *) vb));
+        __m256i sum = pop_count_4x64 (x);
+
+        vc [0] = (gint) (_mm256_extract_epi64 (sum, 0) + _mm256_extract_epi64 (sum, 1));
+        vc [1] = (gint) (_mm256_extract_epi64 (sum, 2) + _mm256_extract_epi64 (sum, 3));
+
+        vb += 4;
+        vc += 2;
+        n -= 2;
+    }
+
+    while (n--)
+    {
+        *(vc++) = chafa_population_count_u64 (a [0] ^ vb [0])
+            + chafa_population_count_u64 (a [1] ^ vb [1]);
+        vb += 2;
+    }
+}
+
+/* --- Base64 --- */
+
+/* Expand two lanes of 12 input bytes each into 16 6-bit indices. Each
+ * 3-byte group is first shuffled to [b1 b0 b2 b1] so the two multiplies
+ * can shift all four indices into their output bytes at once. */
+static inline __m256i
+base64_split_6bit (__m256i in)
+{
+    const __m256i shuf = _mm256_setr_epi8 (1, 0, 2, 1, 4, 3, 5, 4,
+                                           7, 6, 8, 7, 10, 9, 11, 10,
+                                           1, 0, 2, 1, 4, 3, 5, 4,
+                                           7, 6, 8, 7, 10, 9, 11, 10);
+    __m256i t0, t1, t2, t3;
+
+    in = _mm256_shuffle_epi8 (in, shuf);
+
+    t0 = _mm256_and_si256 (in, _mm256_set1_epi32 (0x0fc0fc00));
+    t1 = _mm256_mulhi_epu16 (t0, _mm256_set1_epi32 (0x04000040));
+    t2 = _mm256_and_si256 (in, _mm256_set1_epi32 (0x003f03f0));
+    t3 = _mm256_mullo_epi16 (t2, _mm256_set1_epi32 (0x01000010));
+
+    return _mm256_or_si256 (t1, t3);
+}
+
+/* Map 6-bit indices to base64 code points by adding a per-range offset
+ * picked from a 13-entry table */
+static inline __m256i
+base64_translate (__m256i in)
+{
+    const __m256i lut = _mm256_setr_epi8 (65, 71, -4, -4, -4, -4, -4, -4,
+                                          -4, -4, -4, -4, -19, -16, 0, 0,
+                                          65, 71, -4, -4, -4, -4, -4, -4,
+                                          -4, -4, -4, -4, -19, -16, 0, 0);
+    __m256i indices, mask;
+
+    indices = _mm256_subs_epu8 (in, _mm256_set1_epi8 (51));
+    mask = _mm256_cmpgt_epi8 (in, _mm256_set1_epi8 (25));
+    indices = _mm256_sub_epi8 (indices, mask);
+
+    return _mm256_add_epi8 (in, _mm256_shuffle_epi8 (lut, indices));
+}
+
+/* Encode complete 3-byte groups, 24 bytes per iteration. Returns the
+ * number of input bytes consumed; the caller handles the remainder.
+ * Each iteration reads 28 bytes, hence the conservative loop bound. */
+gint
+chafa_base64_encode_avx2 (guint8 *out, const guint8 *in, gint in_len)
+{
+    gint consumed = 0;
+
+    while (in_len - consumed >= 28)
+    {
+        __m256i t;
+
+        t = _mm256_set_m128i (_mm_loadu_si128 ((const __m128i *) (in + 12)),
+                              _mm_loadu_si128 ((const __m128i *) in));
+        t = base64_translate (base64_split_6bit (t));
+        _mm256_storeu_si256 ((__m256i *) out, t);
+
+        in += 24;
+        out += 32;
+        consumed += 24;
+    }
+
+    return consumed;
+}
+
+/* --- PCA Gram accumulation --- */
+
+static inline gfloat
+sum_8xf32 (__m256 s)
+{
+    __m128 t;
+
+    t = _mm_add_ps (_mm256_castps256_ps128 (s),
+                    _mm256_extractf128_ps (s, 1));
+    t = _mm_add_ps (t, _mm_movehl_ps (t, t));
+    t = _mm_add_ss (t, _mm_movehdup_ps (t));
+
+    return _mm_cvtss_f32 (t);
+}
+
+/* Accumulate the six unique products of the symmetric Gram matrix over an
+ * array of packed 3-float vectors. The x/y/z components are gathered eight
+ * vectors at a time with stride-3 indices; the tail is done in scalar.
+ * sums_out receives { xx, xy, xz, yy, yz, zz }. */
+void
+chafa_vec3f32_gram_avx2 (const gfloat *v, gint n_vecs, gfloat *sums_out)
+{
+    const __m256i idx = _mm256_setr_epi32 (0, 3, 6, 9, 12, 15, 18, 21);
+    __m256 sxx = _mm256_setzero_ps ();
+    __m256 sxy = _mm256_setzero_ps ();
+    __m256 sxz = _mm256_setzero_ps ();
+    __m256 syy = _mm256_setzero_ps ();
+    __m256 syz = _mm256_setzero_ps ();
+    __m256 szz = _mm256_setzero_ps ();
+
+    while (n_vecs >= 8)
+    {
+        __m256 x = _mm256_i32gather_ps (v, idx, 4);
+        __m256 y = _mm256_i32gather_ps (v + 1, idx, 4);
+        __m256 z = _mm256_i32gather_ps (v + 2, idx, 4);
+
+        sxx = _mm256_add_ps (sxx, _mm256_mul_ps (x, x));
+        sxy = _mm256_add_ps (sxy, _mm256_mul_ps (x, y));
+        sxz = _mm256_add_ps (sxz, _mm256_mul_ps (x, z));
+        syy = _mm256_add_ps (syy, _mm256_mul_ps (y, y));
+        syz = _mm256_add_ps (syz, _mm256_mul_ps (y, z));
+        szz = _mm256_add_ps (szz, _mm256_mul_ps (z, z));
+
+        v += 8 * 3;
+        n_vecs -= 8;
+    }
+
+    sums_out [0] = sum_8xf32 (sxx);
+    sums_out [1] = sum_8xf32 (sxy);
+    sums_out [2] = sum_8xf32 (sxz);
+    sums_out [3] = sum_8xf32 (syy);
+    sums_out [4] = sum_8xf32 (syz);
+    sums_out [5] = sum_8xf32 (szz);
+
+    while (n_vecs--)
+    {
+        sums_out [0] += v [0] * v [0];
+        sums_out [1] += v [0] * v [1];
+        sums_out [2] += v [0] * v [2];
+        sums_out [3] += v [1] * v [1];
+        sums_out [4] += v [1] * v [2];
+        sums_out [5] += v [2] * v [2];
+        v += 3;
+    }
+}
+
+/* --- Nearest-pen scan --- */
+
+/* Evaluate eight consecutive color table entries given by SoA arrays
+ * (first projected component and unpacked pen channels). True squared
+ * distances are computed directly; since the projected distance is a
+ * lower bound on the true distance, this accepts exactly the same
+ * entries as the scalar prune-then-refine sequence. Updates the running
+ * best entry/diff and returns FALSE when the projected distance alone
+ * rules out every entry at and beyond this block. */
+gboolean
+chafa_color_table_scan_8_avx2 (const gint *v0s,
+                               const gint *chr, const gint *chg, const gint *chb,
+                               gint ofs, gint tv0, gint tr, gint tg, gint tb,
+                               gint *best_entry_inout, gint *best_diff_inout)
+{
+    gint a [8], d [8];
+    __m256i t, a8, d8;
+    gint min_a, i;
+
+    t = _mm256_sub_epi32 (_mm256_loadu_si256 ((const __m256i *) (v0s + ofs)),
+                          _mm256_set1_epi32 (tv0));
+    a8 = _mm256_mullo_epi32 (t, t);
+
+    t = _mm256_sub_epi32 (_mm256_loadu_si256 ((const __m256i *) (chr + ofs)),
+                          _mm256_set1_epi32 (tr));
+    d8 = _mm256_mullo_epi32 (t, t);
+    t = _mm256_sub_epi32 (_mm256_loadu_si256 ((const __m256i *) (chg + ofs)),
+                          _mm256_set1_epi32 (tg));
+    d8 = _mm256_add_epi32 (d8, _mm256_mullo_epi32 (t, t));
+    t = _mm256_sub_epi32 (_mm256_loadu_si256 ((const __m256i *) (chb + ofs)),
+                          _mm256_set1_epi32 (tb));
+    d8 = _mm256_add_epi32 (d8, _mm256_mullo_epi32 (t, t));
+
+    /* Scale to match color_diff(), which works on FIXED_MUL-scaled channels */
+    d8 = _mm256_slli_epi32 (d8, 10);
+
+    _mm256_storeu_si256 ((__m256i *) a, a8);
+    _mm256_storeu_si256 ((__m256i *) d, d8);
+
+    min_a = a [0];
+
+    for (i = 0; i < 8; i++)
+    {
+        min_a = MIN (min_a, a [i]);
+
+        if (d [i] <= *best_diff_inout)
+        {
+            *best_diff_inout = d [i];
+            *best_entry_inout = ofs + i;
+        }
+    }
+
+    return min_a <= *best_diff_inout;
+}
@@ -21,6 +21,7 @@
 
 #include "chafa.h"
 #include "internal/chafa-base64.h"
+#include "internal/chafa-private.h"
 
 static const gchar base64_dict [] =
     "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
@@ -78,6 +79,42 @@ chafa_base64_encode (ChafaBase64 *base64, GString *gs_out, gconstpointer in, gin
 
     base64->buf_len = 0;
 
+#if defined(HAVE_AVX2_INTRINSICS) || defined(HAVE_SSE41_INTRINSICS) || defined(HAVE_NEON_INTRINSICS)
+    if (end_u8 - in_u8 >= 32)
+    {
+        gsize orig_len = gs_out->len;
+        gint len = end_u8 - in_u8;
+        gint consumed = 0;
+
+        /* Make room for the longest possible bulk output up front, then
+         * trim to what the kernel actually produced */
+        g_string_set_size (gs_out, orig_len + (len / 3) * 4);
+
+#ifdef HAVE_AVX2_INTRINSICS
+        if (chafa_have_avx2 ())
+            consumed = chafa_base64_encode_avx2 ((guint8 *) gs_out->str + orig_len,
+                                                 in_u8, len);
+        else
+#endif
+#ifdef HAVE_SSE41_INTRINSICS
+        if (chafa_have_sse41 ())
+            consumed = chafa_base64_encode_sse41 ((guint8 *) gs_out->str + orig_len,
+                                                  in_u8, len);
+        else
+#endif
+#ifdef HAVE_NEON_INTRINSICS
+        if (chafa_have_neon ())
+            consumed = chafa_base64_encode_neon ((guint8 *) gs_out->str + orig_len,
+                                                 in_u8, len);
+        else
+#endif
+            consumed = 0;
+
+        g_string_set_size (gs_out, orig_len + (consumed / 3) * 4);
+        in_u8 += consumed;
+    }
+#endif
+
     while (end_u8 - in_u8 >= 3)
     {
         r = (in_u8 [0] << 16) | (in_u8 [1] << 8) | in_u8 [2];
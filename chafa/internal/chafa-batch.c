@@ -21,14 +21,231 @@
 
 #include "internal/chafa-batch.h"
 
+/* Batches per worker thread. Oversubscribing lets workers that draw cheap
+ * batches (e.g. flat image regions) go back for more while slower ones are
+ * still chewing, so a single expensive batch can't stall the whole pass.
+ * This is the starting point; see the per-stage tuner below. */
+#define BATCH_OVERSUBSCRIPTION 4
+
+/* --- Per-stage oversubscription tuner --- */
+
+/* The best batch granularity depends on per-row cost variance and on the
+ * host's core topology (e.g. performance/efficiency hybrids), neither of
+ * which we can see directly. Instead, measure: each distinct batch_func
+ * is treated as a stage, and during its first few invocations we try each
+ * candidate factor and keep the one with the lowest per-row wall time.
+ * The result sticks for the lifetime of the process. */
+
+static const gint tuning_factors [] = { 2, 4, 8, 16 };
+
+#define TUNING_MAX_STAGES 16
+#define TUNING_ROUNDS_PER_FACTOR 2
+
+typedef struct
+{
+    GFunc batch_func;  /* Stage key */
+    gint factor_idx;   /* Candidate being tried while calibrating */
+    gint rounds;       /* Rounds measured for the current candidate */
+    gdouble cost_acc;  /* Accumulated us per row for current candidate */
+    gdouble best_cost;
+    gint best_factor;
+    gint factor;       /* Chosen factor, valid once done is set */
+    guint done : 1;
+}
+StageTuning;
+
+static StageTuning tuning_stages [TUNING_MAX_STAGES];
+static gint tuning_n_stages;
+static GMutex tuning_mutex;
+
+/* Called with tuning_mutex held. Returns NULL if the stage table is full,
+ * in which case the caller falls back to the fixed default. */
+static StageTuning *
+get_stage_tuning (GFunc batch_func)
+{
+    StageTuning *st;
+    gint i;
+
+    for (i = 0; i < tuning_n_stages; i++)
+    {
+        if (tuning_stages [i].batch_func == batch_func)
+            return &tuning_stages [i];
+    }
+
+    if (tuning_n_stages >= TUNING_MAX_STAGES)
+        return NULL;
+
+    st = &tuning_stages [tuning_n_stages++];
+    st->batch_func = batch_func;
+    st->best_cost = G_MAXDOUBLE;
+    st->best_factor = BATCH_OVERSUBSCRIPTION;
+    return st;
+}
+
+static gint
+tuning_get_factor (GFunc batch_func)
+{
+    gint factor = BATCH_OVERSUBSCRIPTION;
+    StageTuning *st;
+
+    g_mutex_lock (&tuning_mutex);
+    st = get_stage_tuning (batch_func);
+    if (st)
+        factor = st->done ? st->factor : tuning_factors [st->factor_idx];
+    g_mutex_unlock (&tuning_mutex);
+
+    return factor;
+}
+
+static void
+tuning_report (GFunc batch_func, gint n_rows, gint64 elapsed_us)
+{
+    StageTuning *st;
+
+    g_mutex_lock (&tuning_mutex);
+
+    st = get_stage_tuning (batch_func);
+    if (!st || st->done)
+        goto out;
+
+    st->cost_acc += (gdouble) elapsed_us / (gdouble) n_rows;
+    st->rounds++;
+
+    if (st->rounds >= TUNING_ROUNDS_PER_FACTOR)
+    {
+        gdouble avg_cost = st->cost_acc / st->rounds;
+
+        if (avg_cost < st->best_cost)
+        {
+            st->best_cost = avg_cost;
+            st->best_factor = tuning_factors [st->factor_idx];
+        }
+
+        st->cost_acc = 0.0;
+        st->rounds = 0;
+        st->factor_idx++;
+
+        if (st->factor_idx >= (gint) G_N_ELEMENTS (tuning_factors))
+        {
+            st->factor = st->best_factor;
+            st->done = TRUE;
+        }
+    }
+
+out:
+    g_mutex_unlock (&tuning_mutex);
+}
+
+/* A contiguous run of batches preferred by one worker. Regions keep the
+ * batch-to-worker mapping deterministic across passes and frames, so on
+ * multi-socket hosts the pages a worker first-touches in one pass are
+ * streamed by the same region's worker in the next instead of being
+ * interleaved across sockets. */
+typedef struct
+{
+    gint first_batch;
+    gint n_batches;
+    gint next;  /* Atomic claim counter, relative to first_batch */
+}
+BatchRegion;
+
+/* Per-invocation dispatch state shared by all jobs belonging to a single
+ * chafa_process_batches() call. Lives on the caller's stack. */
+typedef struct
+{
+    GMutex mutex;
+    GCond cond;
+    gint n_pending;
+
+    GFunc batch_func;
+    gpointer ctx;
+
+    ChafaBatchInfo *batches;
+    gint n_batches;
+
+    BatchRegion *regions;
+    gint n_regions;
+}
+BatchDispatch;
+
+typedef struct
+{
+    BatchDispatch *dispatch;
+    gint region_idx;
+}
+WorkerJob;
+
+/* Process-wide worker pool. Created lazily on first use and kept around
+ * forever, so repeated invocations (e.g. one per animation frame) don't
+ * pay for thread setup/teardown every time. */
+
+static void
+batch_pool_func (gpointer data, G_GNUC_UNUSED gpointer user_data)
+{
+    WorkerJob *job = data;
+    BatchDispatch *dispatch = job->dispatch;
+    gint k;
+
+    /* Drain the worker's own region first, then steal from the others in
+     * ring order. This self-balances when per-row cost is skewed; no
+     * worker idles while batches are left anywhere. */
+    for (k = 0; k < dispatch->n_regions; k++)
+    {
+        BatchRegion *region = &dispatch->regions [(job->region_idx + k)
+                                                  % dispatch->n_regions];
+
+        for (;;)
+        {
+            gint i = g_atomic_int_add (&region->next, 1);
+
+            if (i >= region->n_batches)
+                break;
+
+            dispatch->batch_func (&dispatch->batches [region->first_batch + i],
+                                  dispatch->ctx);
+        }
+    }
+
+    g_mutex_lock (&dispatch->mutex);
+    dispatch->n_pending--;
+    if (dispatch->n_pending == 0)
+        g_cond_signal (&dispatch->cond);
+    g_mutex_unlock (&dispatch->mutex);
+}
+
+static GThreadPool *
+get_batch_pool (void)
+{
+    static GThreadPool *batch_pool;
+    static gsize initialized = 0;
+
+    if (g_once_init_enter (&initialized))
+    {
+        batch_pool = g_thread_pool_new (batch_pool_func,
+                                        NULL,
+                                        g_get_num_processors (),
+                                        TRUE,
+                                        NULL);
+        g_once_init_leave (&initialized, 1);
+    }
+
+    return batch_pool;
+}
+
 void
 chafa_process_batches (gpointer ctx, GFunc batch_func, GFunc post_func, gint n_rows, gint n_batches, gint batch_unit)
 {
     GThreadPool *thread_pool;
     ChafaBatchInfo *batches;
+    BatchDispatch dispatch;
+    BatchRegion *regions;
+    WorkerJob *jobs;
+    gint n_workers;
     gint n_units;
     gfloat units_per_batch;
     gfloat ofs [2] = { .0, .0 };
+    gboolean tuned = FALSE;
+    gint64 t0 = 0;
     gint i;
 
     g_assert (n_batches >= 1);
@@ -37,15 +254,31 @@ chafa_process_batches (gpointer ctx, GFunc batch_func, GFunc post_func, gint n_r
     if (n_rows < 1)
         return;
 
+    n_workers = n_batches;
+
+    /* Chop the work up finer than the worker count so the claim loop in
+     * batch_pool_func() can balance skewed workloads. The factor is tuned
+     * per stage from measured round times. */
+    if (n_batches > 1)
+    {
+        n_batches *= tuning_get_factor (batch_func);
+        tuned = TRUE;
+        t0 = g_get_monotonic_time ();
+    }
+
     n_units = (n_rows + batch_unit - 1) / batch_unit;
+    n_batches = MIN (n_batches, MAX (n_units, 1));
     units_per_batch = (gfloat) n_units / (gfloat) n_batches;
 
     batches = g_new0 (ChafaBatchInfo, n_batches);
-    thread_pool = g_thread_pool_new (batch_func,
-                                     (gpointer) ctx,
-                                     g_get_num_processors (),
-                                     FALSE,
-                                     NULL);
+
+    g_mutex_init (&dispatch.mutex);
+    g_cond_init (&dispatch.cond);
+    dispatch.batch_func = batch_func;
+    dispatch.ctx = ctx;
+    dispatch.batches = batches;
+
+    thread_pool = get_batch_pool ();
 
     /* Divide work up into batches that are multiples of batch_unit, except
      * for the last one (if n_rows is not itself a multiple) */
@@ -84,13 +317,49 @@ chafa_process_batches (gpointer ctx, GFunc batch_func, GFunc post_func, gint n_r
         g_printerr ("Batch %d: %04d rows\n", i, batch->n_rows);
 #endif
 
-        g_thread_pool_push (thread_pool, batch, NULL);
-
         ofs [0] = ofs [1];
     }
 
-    /* Wait for threads to finish */
-    g_thread_pool_free (thread_pool, FALSE, TRUE);
+    dispatch.n_batches = i;
+
+    n_workers = MIN (n_workers, dispatch.n_batches);
+    dispatch.n_pending = n_workers;
+
+    /* Carve the batch list into one contiguous region per worker. Batches
+     * are in row order, so region i always covers the same rows for a
+     * given geometry. */
+
+    regions = g_newa (BatchRegion, n_workers);
+    jobs = g_newa (WorkerJob, n_workers);
+    dispatch.regions = regions;
+    dispatch.n_regions = n_workers;
+
+    for (i = 0; i < n_workers; i++)
+    {
+        regions [i].first_batch = (dispatch.n_batches * i) / n_workers;
+        regions [i].n_batches = (dispatch.n_batches * (i + 1)) / n_workers
+            - regions [i].first_batch;
+        regions [i].next = 0;
+
+        jobs [i].dispatch = &dispatch;
+        jobs [i].region_idx = i;
+    }
+
+    for (i = 0; i < n_workers; i++)
+        g_thread_pool_push (thread_pool, &jobs [i], NULL);
+
+    /* Wait for batches to finish */
+
+    g_mutex_lock (&dispatch.mutex);
+    while (dispatch.n_pending > 0)
+        g_cond_wait (&dispatch.cond, &dispatch.mutex);
+    g_mutex_unlock (&dispatch.mutex);
+
+    g_mutex_clear (&dispatch.mutex);
+    g_cond_clear (&dispatch.cond);
+
+    if (tuned)
+        tuning_report (batch_func, n_rows, g_get_monotonic_time () - t0);
 
     if (post_func)
     {
@@ -80,6 +80,123 @@ chafa_bitfield_set_bit (ChafaBitfield *bitfield, guint nth, gboolean value)
     bitfield->bits [index] = (bitfield->bits [index] & ~(1UL << shift)) | (v32 << shift);
 }
 
+/* Binary ops over bit ranges. Word-aligned arguments go a word at a time;
+ * anything else falls back to single bits. Ranges must lie within both
+ * fields. */
+
+static inline void
+chafa_bitfield_or_range (ChafaBitfield *dest, guint dest_first,
+                         const ChafaBitfield *src, guint src_first,
+                         guint n_bits)
+{
+    guint i;
+
+    g_return_if_fail (dest_first + n_bits <= dest->n_bits);
+    g_return_if_fail (src_first + n_bits <= src->n_bits);
+
+    if (((dest_first | src_first | n_bits) % 32) == 0)
+    {
+        const guint32 *s = src->bits + src_first / 32;
+        guint32 *d = dest->bits + dest_first / 32;
+
+        for (i = 0; i < n_bits / 32; i++)
+            d [i] |= s [i];
+    }
+    else
+    {
+        for (i = 0; i < n_bits; i++)
+        {
+            if (chafa_bitfield_get_bit (src, src_first + i))
+                chafa_bitfield_set_bit (dest, dest_first + i, TRUE);
+        }
+    }
+}
+
+static inline void
+chafa_bitfield_and_range (ChafaBitfield *dest, guint dest_first,
+                          const ChafaBitfield *src, guint src_first,
+                          guint n_bits)
+{
+    guint i;
+
+    g_return_if_fail (dest_first + n_bits <= dest->n_bits);
+    g_return_if_fail (src_first + n_bits <= src->n_bits);
+
+    if (((dest_first | src_first | n_bits) % 32) == 0)
+    {
+        const guint32 *s = src->bits + src_first / 32;
+        guint32 *d = dest->bits + dest_first / 32;
+
+        for (i = 0; i < n_bits / 32; i++)
+            d [i] &= s [i];
+    }
+    else
+    {
+        for (i = 0; i < n_bits; i++)
+        {
+            if (!chafa_bitfield_get_bit (src, src_first + i))
+                chafa_bitfield_set_bit (dest, dest_first + i, FALSE);
+        }
+    }
+}
+
+static inline void
+chafa_bitfield_and_not_range (ChafaBitfield *dest, guint dest_first,
+                              const ChafaBitfield *src, guint src_first,
+                              guint n_bits)
+{
+    guint i;
+
+    g_return_if_fail (dest_first + n_bits <= dest->n_bits);
+    g_return_if_fail (src_first + n_bits <= src->n_bits);
+
+    if (((dest_first | src_first | n_bits) % 32) == 0)
+    {
+        const guint32 *s = src->bits + src_first / 32;
+        guint32 *d = dest->bits + dest_first / 32;
+
+        for (i = 0; i < n_bits / 32; i++)
+            d [i] &= ~s [i];
+    }
+    else
+    {
+        for (i = 0; i < n_bits; i++)
+        {
+            if (chafa_bitfield_get_bit (src, src_first + i))
+                chafa_bitfield_set_bit (dest, dest_first + i, FALSE);
+        }
+    }
+}
+
+/* Returns the index of the first set bit at or after @first, or -1 if
+ * there is none */
+static inline gint
+chafa_bitfield_next_set_bit (const ChafaBitfield *bitfield, guint first)
+{
+    guint n_words;
+    guint index;
+    guint32 w;
+
+    if (first >= bitfield->n_bits)
+        return -1;
+
+    index = first / 32;
+    w = bitfield->bits [index] >> (first % 32);
+    if (w)
+        return first + g_bit_nth_lsf (w, -1);
+
+    n_words = (bitfield->n_bits + 31) / 32;
+
+    for (index++; index < n_words; index++)
+    {
+        w = bitfield->bits [index];
+        if (w)
+            return index * 32 + g_bit_nth_lsf (w, -1);
+    }
+
+    return -1;
+}
+
 G_END_DECLS
 
 #endif /* __CHAFA_BITFIELD_H__ */
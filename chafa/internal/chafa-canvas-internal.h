@@ -42,6 +42,24 @@ struct ChafaCanvas
 
     gint width_pixels, height_pixels;
     ChafaPixel *pixels;
+
+    /* Working image scratch buffer, kept across frames so animations reach
+     * a steady state with no per-frame allocation. pixels aliases this (or
+     * caller memory) only for the duration of a draw. */
+    ChafaPixel *scratch_pixels;
+    gint scratch_n_pixels;
+
+    /* Scaling context kept across frames; animation frames share geometry,
+     * so the sampling coefficients need computing only once */
+    ChafaScaleCache scale_cache;
+
+    /* Retained copy of the last source image
+     * (config.source_retention_enabled); chafa_canvas_new_reflowed ()
+     * redraws from this so the caller needn't decode the source again */
+    guint8 *retained_pixels;
+    ChafaPixelType retained_pixel_type;
+    gint retained_width, retained_height, retained_rowstride;
+
     ChafaCanvasCell *cells;
     guint have_alpha : 1;
     guint needs_clear : 1;
@@ -52,6 +70,13 @@ struct ChafaCanvas
      * space, but could be something else depending on the symbol map. */
     gunichar blank_char;
 
+    /* Temporal cell cache (CHAFA_OPTIMIZATION_REUSE_CELLS): hashes of each
+     * cell's prepared source pixels and the corresponding symbol errors
+     * from the previous frame. Allocated in symbol mode only. */
+    guint64 *cell_hashes;
+    gint *cell_errors;
+    guint cell_cache_valid : 1;
+
     ChafaCanvasConfig config;
 
     /* Used when setting pixel data */
@@ -60,6 +85,19 @@ struct ChafaCanvas
     /* Set if we're in sixel (ChafaSixelCanvas *) or Kitty (ChafaKittyCanvas *) mode */
     gpointer pixel_canvas;
 
+    /* Frame-delta state (config.frame_deltas_enabled): the last emitted
+     * kitty frame's RGBA data, and the image ID it was transmitted with */
+    gpointer kitty_prev_frame;
+    guint32 kitty_image_id;
+
+    /* Frame-delta state for sixel mode: the color register definitions
+     * previously sent to the terminal, so unchanged ones can be omitted */
+    guint32 sixel_emitted_registers [256];
+
+    /* Optional buffer pool (reffed); cell arrays and working pixel
+     * buffers are acquired from and released to it when set */
+    ChafaBufferPool *buffer_pool;
+
     /* Our palette. Kind of a big structure, so it goes last. */
     ChafaPalette palette;
 };
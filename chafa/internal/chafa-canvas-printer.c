@@ -20,7 +20,9 @@
 #include "config.h"
 
 #include "chafa.h"
+#include "internal/chafa-batch.h"
 #include "internal/chafa-canvas-printer.h"
+#include "internal/chafa-profile.h"
 
 typedef struct
 {
@@ -36,9 +38,51 @@ typedef struct
     /* For direct-color mode */
     ChafaColor cur_fg_direct;
     ChafaColor cur_bg_direct;
+
+    /* Preformatted SGR strings; fetched on first use */
+    const ChafaTermColor256Cache *color256;
 }
 PrintCtx;
 
+/* --- Preformatted 256-color attribute emission --- */
+
+G_GNUC_WARN_UNUSED_RESULT static gchar *
+emit_set_color_fg_256_cached (PrintCtx *ctx, gchar *out, guint32 pen)
+{
+    if (!ctx->color256)
+        ctx->color256 = chafa_term_info_get_color256_cache (ctx->term_info);
+
+    memcpy (out, ctx->color256->fg_str [pen], ctx->color256->fg_len [pen]);
+    return out + ctx->color256->fg_len [pen];
+}
+
+G_GNUC_WARN_UNUSED_RESULT static gchar *
+emit_set_color_bg_256_cached (PrintCtx *ctx, gchar *out, guint32 pen)
+{
+    if (!ctx->color256)
+        ctx->color256 = chafa_term_info_get_color256_cache (ctx->term_info);
+
+    memcpy (out, ctx->color256->bg_str [pen], ctx->color256->bg_len [pen]);
+    return out + ctx->color256->bg_len [pen];
+}
+
+G_GNUC_WARN_UNUSED_RESULT static gchar *
+emit_set_color_fgbg_256_cached (PrintCtx *ctx, gchar *out, guint32 fg, guint32 bg)
+{
+    /* Only the common fg == bg case is preformatted; the full pair space
+     * would be too big to table */
+    if (fg == bg)
+    {
+        if (!ctx->color256)
+            ctx->color256 = chafa_term_info_get_color256_cache (ctx->term_info);
+
+        memcpy (out, ctx->color256->fgbg_str [fg], ctx->color256->fgbg_len [fg]);
+        return out + ctx->color256->fgbg_len [fg];
+    }
+
+    return chafa_term_info_emit_set_color_fgbg_256 (ctx->term_info, out, fg, bg);
+}
+
 static gint
 cmp_colors (ChafaColor a, ChafaColor b)
 {
@@ -275,18 +319,18 @@ emit_attributes_256 (PrintCtx *ctx, gchar *out,
             if (bg != ctx->cur_bg && bg != CHAFA_PALETTE_INDEX_TRANSPARENT)
             {
                 out = flush_chars (ctx, out);
-                out = chafa_term_info_emit_set_color_fgbg_256 (ctx->term_info, out, fg, bg);
+                out = emit_set_color_fgbg_256_cached (ctx, out, fg, bg);
             }
             else if (fg != CHAFA_PALETTE_INDEX_TRANSPARENT)
             {
                 out = flush_chars (ctx, out);
-                out = chafa_term_info_emit_set_color_fg_256 (ctx->term_info, out, fg);
+                out = emit_set_color_fg_256_cached (ctx, out, fg);
             }
         }
         else if (bg != ctx->cur_bg && bg != CHAFA_PALETTE_INDEX_TRANSPARENT)
         {
             out = flush_chars (ctx, out);
-            out = chafa_term_info_emit_set_color_bg_256 (ctx->term_info, out, bg);
+            out = emit_set_color_bg_256_cached (ctx, out, bg);
         }
     }
     else
@@ -300,16 +344,16 @@ emit_attributes_256 (PrintCtx *ctx, gchar *out,
         {
             if (bg != CHAFA_PALETTE_INDEX_TRANSPARENT)
             {
-                out = chafa_term_info_emit_set_color_fgbg_256 (ctx->term_info, out, fg, bg);
+                out = emit_set_color_fgbg_256_cached (ctx, out, fg, bg);
             }
             else
             {
-                out = chafa_term_info_emit_set_color_fg_256 (ctx->term_info, out, fg);
+                out = emit_set_color_fg_256_cached (ctx, out, fg);
             }
         }
         else if (bg != CHAFA_PALETTE_INDEX_TRANSPARENT)
         {
-            out = chafa_term_info_emit_set_color_bg_256 (ctx->term_info, out, bg);
+            out = emit_set_color_bg_256_cached (ctx, out, bg);
         }
     }
 
@@ -532,44 +576,241 @@ emit_ansi_fgbg (PrintCtx *ctx, gchar *out, gint i, gint i_max)
     return out;
 }
 
+G_GNUC_WARN_UNUSED_RESULT static gchar *
+emit_ansi_span (PrintCtx *ctx, gchar *out, gint i, gint i_max)
+{
+    switch (ctx->canvas->config.canvas_mode)
+    {
+        case CHAFA_CANVAS_MODE_TRUECOLOR:
+            out = emit_ansi_truecolor (ctx, out, i, i_max);
+            break;
+        case CHAFA_CANVAS_MODE_INDEXED_256:
+        case CHAFA_CANVAS_MODE_INDEXED_240:
+            out = emit_ansi_256 (ctx, out, i, i_max);
+            break;
+        case CHAFA_CANVAS_MODE_INDEXED_16:
+            out = emit_ansi_16 (ctx, out, i, i_max);
+            break;
+        case CHAFA_CANVAS_MODE_INDEXED_8:
+            out = emit_ansi_16 (ctx, out, i, i_max);
+            break;
+        case CHAFA_CANVAS_MODE_FGBG_BGFG:
+            out = emit_ansi_fgbg_bgfg (ctx, out, i, i_max);
+            break;
+        case CHAFA_CANVAS_MODE_FGBG:
+            out = emit_ansi_fgbg (ctx, out, i, i_max);
+            break;
+        case CHAFA_CANVAS_MODE_MAX:
+            g_assert_not_reached ();
+            break;
+    }
+
+    return out;
+}
+
+/* Tight per-cell upper bound for serializing one cell in the current
+ * canvas mode: worst case is an attribute reset, an invert, the most
+ * expensive color sequence combination, and a six-byte UTF-8 character.
+ * The repeat-char optimization only kicks in when it amortizes below
+ * this, so it can't break the bound. */
+static gsize
+cell_size_max (const ChafaCanvas *canvas, ChafaTermInfo *ti)
+{
+    gsize color_len = 0;
+
+    switch (canvas->config.canvas_mode)
+    {
+        case CHAFA_CANVAS_MODE_TRUECOLOR:
+            color_len = MAX (chafa_term_info_get_seq_length_max (ti, CHAFA_TERM_SEQ_SET_COLOR_FGBG_DIRECT),
+                             chafa_term_info_get_seq_length_max (ti, CHAFA_TERM_SEQ_SET_COLOR_FG_DIRECT)
+                             + chafa_term_info_get_seq_length_max (ti, CHAFA_TERM_SEQ_SET_COLOR_BG_DIRECT));
+            break;
+
+        case CHAFA_CANVAS_MODE_INDEXED_256:
+        case CHAFA_CANVAS_MODE_INDEXED_240:
+            color_len = MAX (chafa_term_info_get_seq_length_max (ti, CHAFA_TERM_SEQ_SET_COLOR_FGBG_256),
+                             chafa_term_info_get_seq_length_max (ti, CHAFA_TERM_SEQ_SET_COLOR_FG_256)
+                             + chafa_term_info_get_seq_length_max (ti, CHAFA_TERM_SEQ_SET_COLOR_BG_256));
+            break;
+
+        case CHAFA_CANVAS_MODE_INDEXED_16:
+        case CHAFA_CANVAS_MODE_INDEXED_8:
+            color_len = MAX (chafa_term_info_get_seq_length_max (ti, CHAFA_TERM_SEQ_SET_COLOR_FGBG_16),
+                             chafa_term_info_get_seq_length_max (ti, CHAFA_TERM_SEQ_SET_COLOR_FG_16)
+                             + chafa_term_info_get_seq_length_max (ti, CHAFA_TERM_SEQ_SET_COLOR_BG_16));
+            break;
+
+        case CHAFA_CANVAS_MODE_FGBG_BGFG:
+        case CHAFA_CANVAS_MODE_FGBG:
+        case CHAFA_CANVAS_MODE_MAX:
+            break;
+    }
+
+    return chafa_term_info_get_seq_length_max (ti, CHAFA_TERM_SEQ_RESET_ATTRIBUTES)
+        + chafa_term_info_get_seq_length_max (ti, CHAFA_TERM_SEQ_INVERT_COLORS)
+        + color_len + 6;
+}
+
+/* Internal: exact upper bound on the bytes appended by a full symbol-mode
+ * print of the canvas. One row adds a reset and a newline on top of its
+ * cells. Callers can use this to make a single right-sized allocation
+ * per frame. */
+gsize
+chafa_canvas_printer_get_size_max (ChafaCanvas *canvas, ChafaTermInfo *ti)
+{
+    gsize cell_len = cell_size_max (canvas, ti);
+
+    return (gsize) canvas->config.height
+        * ((gsize) canvas->config.width * cell_len + cell_len + 1)
+        + 1;
+}
+
 static void
-prealloc_string (GString *gs, gint n_cells)
+prealloc_string (GString *gs, gint n_cells, gsize cell_len)
 {
-    guint needed_len;
+    gsize needed_len;
 
-    /* Each cell produces at most three control sequences and six bytes
-     * for the UTF-8 character. Each row may add one seq and one newline. */
-    needed_len = (n_cells + 1) * (CHAFA_TERM_SEQ_LENGTH_MAX * 3 + 6) + 1;
+    /* Each row may add one reset sequence and one newline on top of its
+     * cells; one extra cell slot covers both */
+    needed_len = (gsize) (n_cells + 1) * cell_len + 1;
 
     if (gs->allocated_len - gs->len < needed_len)
     {
-        guint current_len = gs->len;
+        gsize current_len = gs->len;
         g_string_set_size (gs, gs->len + needed_len * 2);
         gs->len = current_len;
     }
 }
 
-static GString *
-build_ansi_gstring (ChafaCanvas *canvas, ChafaTermInfo *ti)
+/* --- Row-parallel serialization --- */
+
+typedef struct
+{
+    ChafaCanvas *canvas;
+    ChafaTermInfo *term_info;
+    GString *out_str;
+
+    /* Global offset of batch row 0 */
+    gint first_row;
+}
+BuildAnsiCtx;
+
+/* Each row of output ends with reset_attributes (), so a band of rows can
+ * be serialized from a fresh context as long as it starts from the same
+ * post-reset state. Only the first row of the canvas emits the sequence;
+ * later bands merely assume it. */
+static void
+build_ansi_row_worker (ChafaBatchInfo *batch, const BuildAnsiCtx *actx)
+{
+    PrintCtx ctx = { 0 };
+    ChafaCanvas *canvas = actx->canvas;
+    gint width = canvas->config.width;
+    gint i, i_max, i_next, i_canvas_max;
+    gchar *buf, *out;
+
+    ctx.canvas = canvas;
+    ctx.term_info = actx->term_info;
+
+    /* State as left behind by reset_attributes (); the direct-color and
+     * inverted fields are already cleared by the zero initializer */
+    ctx.cur_fg = CHAFA_PALETTE_INDEX_TRANSPARENT;
+    ctx.cur_bg = CHAFA_PALETTE_INDEX_TRANSPARENT;
+
+    /* Same worst case as prealloc_string (), per row of the band */
+    buf = g_malloc ((gsize) batch->n_rows * (width + 1)
+                    * cell_size_max (canvas, actx->term_info) + 1);
+    out = buf;
+
+    i = (actx->first_row + batch->first_row) * width;
+    i_max = i + batch->n_rows * width;
+    i_canvas_max = width * canvas->config.height;
+
+    for ( ; i < i_max; i = i_next)
+    {
+        i_next = i + width;
+
+        if (i == 0)
+            out = reset_attributes (&ctx, out);
+
+        out = emit_ansi_span (&ctx, out, i, i_next);
+        out = flush_chars (&ctx, out);
+        out = reset_attributes (&ctx, out);
+
+        /* Last line should not end in newline */
+        if (i_next < i_canvas_max)
+            *(out++) = '\n';
+    }
+
+    batch->ret_p = buf;
+    batch->ret_n = out - buf;
+}
+
+static void
+build_ansi_row_post (ChafaBatchInfo *batch, BuildAnsiCtx *actx)
+{
+    g_string_append_len (actx->out_str, batch->ret_p, batch->ret_n);
+    g_free (batch->ret_p);
+}
+
+/* Appends to gs, which may already hold data; a buffer reused across
+ * frames reaches steady state with no further allocations */
+static void
+build_ansi_gstring (ChafaCanvas *canvas, ChafaTermInfo *ti, gint first_row, gint n_rows,
+                    GString *gs)
 {
-    GString *gs = g_string_new ("");
     PrintCtx ctx = { 0 };
+    gsize cell_len;
     gint i, i_max, i_step, i_next;
+    gint i_canvas_max;
+    gint64 prof_t0;
+
+    prof_t0 = chafa_prof_begin ();
+
+    /* In FGBG and fg-only output no per-row reset is emitted, so attribute
+     * state carries across rows and serialization must stay sequential.
+     * Everywhere else, hand row bands to the worker pool and join the
+     * buffers in batch order. */
+    if (canvas->config.canvas_mode != CHAFA_CANVAS_MODE_FGBG
+        && !canvas->config.fg_only_enabled
+        && n_rows > 1)
+    {
+        BuildAnsiCtx actx;
+
+        actx.canvas = canvas;
+        actx.term_info = ti;
+        actx.out_str = gs;
+        actx.first_row = first_row;
+
+        chafa_process_batches (&actx,
+                               (GFunc) build_ansi_row_worker,
+                               (GFunc) build_ansi_row_post,
+                               n_rows,
+                               g_get_num_processors (),
+                               1);
+
+        chafa_prof_end (CHAFA_PROF_STAGE_PRINT, prof_t0);
+        return;
+    }
 
     ctx.canvas = canvas;
     ctx.term_info = ti;
+    cell_len = cell_size_max (canvas, ti);
 
-    i = 0;
-    i_max = canvas->config.width * canvas->config.height;
+    i = first_row * canvas->config.width;
+    i_max = (first_row + n_rows) * canvas->config.width;
     i_step = canvas->config.width;
 
+    /* Newline handling must consider the whole canvas, so strips
+     * concatenate into exactly the output of a full print */
+    i_canvas_max = canvas->config.width * canvas->config.height;
+
     for ( ; i < i_max; i = i_next)
     {
         gchar *out;
 
         i_next = i + i_step;
 
-        prealloc_string (gs, i_step);
+        prealloc_string (gs, i_step, cell_len);
         out = gs->str + gs->len;
 
         /* Avoid control codes in FGBG mode. Don't reset attributes when BG
@@ -581,31 +822,7 @@ build_ansi_gstring (ChafaCanvas *canvas, ChafaTermInfo *ti)
             out = reset_attributes (&ctx, out);
         }
 
-        switch (canvas->config.canvas_mode)
-        {
-            case CHAFA_CANVAS_MODE_TRUECOLOR:
-                out = emit_ansi_truecolor (&ctx, out, i, i_next);
-                break;
-            case CHAFA_CANVAS_MODE_INDEXED_256:
-            case CHAFA_CANVAS_MODE_INDEXED_240:
-                out = emit_ansi_256 (&ctx, out, i, i_next);
-                break;
-            case CHAFA_CANVAS_MODE_INDEXED_16:
-                out = emit_ansi_16 (&ctx, out, i, i_next);
-                break;
-            case CHAFA_CANVAS_MODE_INDEXED_8:
-                out = emit_ansi_16 (&ctx, out, i, i_next);
-                break;
-            case CHAFA_CANVAS_MODE_FGBG_BGFG:
-                out = emit_ansi_fgbg_bgfg (&ctx, out, i, i_next);
-                break;
-            case CHAFA_CANVAS_MODE_FGBG:
-                out = emit_ansi_fgbg (&ctx, out, i, i_next);
-                break;
-            case CHAFA_CANVAS_MODE_MAX:
-                g_assert_not_reached ();
-                break;
-        }
+        out = emit_ansi_span (&ctx, out, i, i_next);
 
         out = flush_chars (&ctx, out);
 
@@ -618,21 +835,200 @@ build_ansi_gstring (ChafaCanvas *canvas, ChafaTermInfo *ti)
         }
 
         /* Last line should not end in newline */
-        if (i_next < i_max)
+        if (i_next < i_canvas_max)
             *(out++) = '\n';
 
         *out = '\0';
         gs->len = out - gs->str;
     }
 
-    return gs;
+    chafa_prof_end (CHAFA_PROF_STAGE_PRINT, prof_t0);
 }
 
 GString *
 chafa_canvas_print_symbols (ChafaCanvas *canvas, ChafaTermInfo *ti)
+{
+    GString *gs;
+
+    g_assert (canvas != NULL);
+    g_assert (ti != NULL);
+
+    gs = g_string_new ("");
+    build_ansi_gstring (canvas, ti, 0, canvas->config.height, gs);
+    return gs;
+}
+
+void
+chafa_canvas_print_symbols_into (ChafaCanvas *canvas, ChafaTermInfo *ti, GString *gs)
 {
     g_assert (canvas != NULL);
     g_assert (ti != NULL);
+    g_assert (gs != NULL);
+
+    build_ansi_gstring (canvas, ti, 0, canvas->config.height, gs);
+}
+
+GString *
+chafa_canvas_print_symbols_rows (ChafaCanvas *canvas, ChafaTermInfo *ti,
+                                 gint first_row, gint n_rows)
+{
+    GString *gs;
+
+    g_assert (canvas != NULL);
+    g_assert (ti != NULL);
+
+    gs = g_string_new ("");
+    build_ansi_gstring (canvas, ti, first_row, n_rows, gs);
+    return gs;
+}
+
+/* --- Diff printing --- */
+
+/* Max unchanged cells to overprint rather than reposition across. A cursor
+ * move costs up to ~8 bytes; short gaps are cheaper to just print. */
+#define DIFF_RUN_GAP_MAX 4
+
+static gboolean
+cell_equals (const ChafaCanvasCell *a, const ChafaCanvasCell *b)
+{
+    return a->c == b->c
+        && a->fg_color == b->fg_color
+        && a->bg_color == b->bg_color;
+}
+
+G_GNUC_WARN_UNUSED_RESULT static gchar *
+emit_cursor_rel (PrintCtx *ctx, gchar *out, gint *cur_x, gint *cur_y, gint x, gint y)
+{
+    if (y > *cur_y)
+        out = chafa_term_info_emit_cursor_down (ctx->term_info, out, y - *cur_y);
+    else if (y < *cur_y)
+        out = chafa_term_info_emit_cursor_up (ctx->term_info, out, *cur_y - y);
+
+    if (x > *cur_x)
+        out = chafa_term_info_emit_cursor_right (ctx->term_info, out, x - *cur_x);
+    else if (x < *cur_x)
+        out = chafa_term_info_emit_cursor_left (ctx->term_info, out, *cur_x - x);
+
+    *cur_x = x;
+    *cur_y = y;
+    return out;
+}
+
+GString *
+chafa_canvas_print_symbols_diff (ChafaCanvas *canvas, ChafaCanvas *prev_canvas,
+                                 ChafaTermInfo *ti)
+{
+    GString *gs = g_string_new ("");
+    PrintCtx ctx = { 0 };
+    gsize cell_len;
+    gint width, height;
+    gint cur_x = 0, cur_y = 0;
+    gint x, y;
+
+    g_assert (canvas != NULL);
+    g_assert (prev_canvas != NULL);
+    g_assert (ti != NULL);
+
+    ctx.canvas = canvas;
+    ctx.term_info = ti;
+
+    /* Each changed run also moves the cursor; pad the cell bound with the
+     * relative movement sequences */
+    cell_len = cell_size_max (canvas, ti)
+        + chafa_term_info_get_seq_length_max (ti, CHAFA_TERM_SEQ_CURSOR_UP)
+        + chafa_term_info_get_seq_length_max (ti, CHAFA_TERM_SEQ_CURSOR_DOWN)
+        + chafa_term_info_get_seq_length_max (ti, CHAFA_TERM_SEQ_CURSOR_LEFT)
+        + chafa_term_info_get_seq_length_max (ti, CHAFA_TERM_SEQ_CURSOR_RIGHT);
+
+    width = canvas->config.width;
+    height = canvas->config.height;
 
-    return build_ansi_gstring (canvas, ti);
+    for (y = 0; y < height; y++)
+    {
+        const ChafaCanvasCell *row = &canvas->cells [y * width];
+        const ChafaCanvasCell *prev_row = &prev_canvas->cells [y * width];
+
+        x = 0;
+        while (x < width)
+        {
+            gint x0, x1, gap;
+            gchar *out;
+
+            if (cell_equals (&row [x], &prev_row [x]))
+            {
+                x++;
+                continue;
+            }
+
+            /* Find the end of the changed run, overprinting short
+             * unchanged gaps */
+
+            x0 = x;
+            x1 = x + 1;
+            gap = 0;
+
+            while (x1 < width && gap <= DIFF_RUN_GAP_MAX)
+            {
+                if (cell_equals (&row [x1], &prev_row [x1]))
+                    gap++;
+                else
+                    gap = 0;
+                x1++;
+            }
+
+            x1 -= gap;
+
+            /* Don't split wide symbols down the middle */
+            if (row [x0].c == 0 && x0 > 0)
+                x0--;
+            if (x1 < width && row [x1].c == 0)
+                x1++;
+
+            prealloc_string (gs, x1 - x0 + 2, cell_len);
+            out = gs->str + gs->len;
+
+            /* Avoid control codes in FGBG mode. Don't reset attributes when
+             * BG is held, to preserve any BG color set previously. */
+            if (gs->len == 0
+                && canvas->config.canvas_mode != CHAFA_CANVAS_MODE_FGBG
+                && !canvas->config.fg_only_enabled)
+            {
+                out = reset_attributes (&ctx, out);
+            }
+
+            out = emit_cursor_rel (&ctx, out, &cur_x, &cur_y, x0, y);
+            out = emit_ansi_span (&ctx, out, y * width + x0, y * width + x1);
+            out = flush_chars (&ctx, out);
+
+            *out = '\0';
+            gs->len = out - gs->str;
+
+            /* Printing advanced the cursor to the end of the run */
+            cur_x = x1;
+            x = x1;
+        }
+    }
+
+    if (gs->len > 0)
+    {
+        gchar *out;
+
+        prealloc_string (gs, 1, cell_len);
+        out = gs->str + gs->len;
+
+        if (canvas->config.canvas_mode != CHAFA_CANVAS_MODE_FGBG
+            && !canvas->config.fg_only_enabled)
+        {
+            out = reset_attributes (&ctx, out);
+        }
+
+        /* Leave the cursor where it started, at the canvas' top left */
+        out = emit_cursor_rel (&ctx, out, &cur_x, &cur_y, 0, 0);
+
+        *out = '\0';
+        gs->len = out - gs->str;
+    }
+
+    return gs;
 }
+
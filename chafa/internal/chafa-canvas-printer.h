@@ -29,6 +29,13 @@
 G_BEGIN_DECLS
 
 GString *chafa_canvas_print_symbols (ChafaCanvas *canvas, ChafaTermInfo *ti);
+void chafa_canvas_print_symbols_into (ChafaCanvas *canvas, ChafaTermInfo *ti,
+                                      GString *gs);
+GString *chafa_canvas_print_symbols_rows (ChafaCanvas *canvas, ChafaTermInfo *ti,
+                                          gint first_row, gint n_rows);
+GString *chafa_canvas_print_symbols_diff (ChafaCanvas *canvas, ChafaCanvas *prev_canvas,
+                                          ChafaTermInfo *ti);
+gsize chafa_canvas_printer_get_size_max (ChafaCanvas *canvas, ChafaTermInfo *ti);
 
 G_END_DECLS
 
@@ -23,16 +23,27 @@
 #include "internal/chafa-color-hash.h"
 
 void
-chafa_color_hash_init (ChafaColorHash *color_hash)
+chafa_color_hash_init_sized (ChafaColorHash *color_hash, guint n_entries)
 {
+    guint mask = n_entries - 1;
     guint i;
     guint32 j;
 
-    /* Initialize with invalid entries */
+    /* Power of two only */
+    g_assert (n_entries > 0 && (n_entries & mask) == 0);
+
+    memset (color_hash, 0, sizeof (*color_hash));
+    color_hash->n_entries = n_entries;
+    color_hash->map = g_malloc (n_entries * sizeof (guint32));
+
+    /* Initialize with invalid entries. A slot can be reached either directly
+     * or as the second way of the preceding slot, so the poison color must
+     * hash to neither. */
 
-    for (i = 0, j = 0; i < CHAFA_COLOR_HASH_N_ENTRIES; i++)
+    for (i = 0, j = 0; i < n_entries; i++)
     {
-        while (_chafa_color_hash_calc_hash (j) == i)
+        while (_chafa_color_hash_calc_hash (j, mask) == i
+               || _chafa_color_hash_calc_hash (j, mask) == ((i + n_entries - 1) & mask))
         {
             j++;
             j %= 0x01000000;
@@ -43,6 +54,21 @@ chafa_color_hash_init (ChafaColorHash *color_hash)
 }
 
 void
-chafa_color_hash_deinit (G_GNUC_UNUSED ChafaColorHash *color_hash)
+chafa_color_hash_init (ChafaColorHash *color_hash)
 {
+    chafa_color_hash_init_sized (color_hash, CHAFA_COLOR_HASH_N_ENTRIES);
+}
+
+void
+chafa_color_hash_deinit (ChafaColorHash *color_hash)
+{
+#if CHAFA_COLOR_HASH_ENABLE_PROFILING
+    g_printerr ("l=%7d h=%7d hit rate=%6.2lf%%\n",
+                color_hash->n_lookups,
+                color_hash->n_hits,
+                (100.0 * color_hash->n_hits) / (gdouble) MAX (color_hash->n_lookups, 1));
+#endif
+
+    g_free (color_hash->map);
+    color_hash->map = NULL;
 }
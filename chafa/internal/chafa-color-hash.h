@@ -23,41 +23,80 @@
 G_BEGIN_DECLS
 
 #define CHAFA_COLOR_HASH_N_ENTRIES 16384
+#define CHAFA_COLOR_HASH_MAX_N_ENTRIES (1 << 18)
+
+#define CHAFA_COLOR_HASH_ENABLE_PROFILING 0
 
 typedef struct
 {
-    guint32 map [CHAFA_COLOR_HASH_N_ENTRIES];
+    guint32 *map;
+    guint n_entries;  /* Must be a power of two */
+
+#if CHAFA_COLOR_HASH_ENABLE_PROFILING
+    gint n_lookups;
+    gint n_hits;
+#endif
 }
 ChafaColorHash;
 
-void   chafa_color_hash_init    (ChafaColorHash *color_hash);
-void   chafa_color_hash_deinit  (ChafaColorHash *color_hash);
+void   chafa_color_hash_init        (ChafaColorHash *color_hash);
+void   chafa_color_hash_init_sized  (ChafaColorHash *color_hash, guint n_entries);
+void   chafa_color_hash_deinit      (ChafaColorHash *color_hash);
 
 static inline guint
-_chafa_color_hash_calc_hash (guint32 color)
+_chafa_color_hash_calc_hash (guint32 color, guint mask)
 {
     color &= 0x00ffffff;
 
-    return (color ^ (color >> 7) ^ (color >> 14)) % CHAFA_COLOR_HASH_N_ENTRIES;
+    return (color ^ (color >> 7) ^ (color >> 14)) & mask;
 }
 
+/* Each slot pairs with its successor as a two-way set. Inserts demote the
+ * front entry to the second slot; hits in the second slot promote the entry
+ * back to the front, approximating LRU within the set. */
+
 static inline void
 chafa_color_hash_replace (ChafaColorHash *color_hash, guint32 color, guint8 pen)
 {
-    guint index = _chafa_color_hash_calc_hash (color);
+    guint mask = color_hash->n_entries - 1;
+    guint index = _chafa_color_hash_calc_hash (color, mask);
     guint32 entry = (color << 8) | pen;
 
+    color_hash->map [(index + 1) & mask] = color_hash->map [index];
     color_hash->map [index] = entry;
 }
 
 static inline gint
-chafa_color_hash_lookup (const ChafaColorHash *color_hash, guint32 color)
+chafa_color_hash_lookup (ChafaColorHash *color_hash, guint32 color)
 {
-    guint index = _chafa_color_hash_calc_hash (color);
-    guint32 entry = color_hash->map [index];
+    guint mask = color_hash->n_entries - 1;
+    guint index = _chafa_color_hash_calc_hash (color, mask);
+    guint index_2 = (index + 1) & mask;
+    guint32 entry;
+
+#if CHAFA_COLOR_HASH_ENABLE_PROFILING
+    color_hash->n_lookups++;
+#endif
+
+    entry = color_hash->map [index];
+    if ((entry & 0xffffff00) == (color << 8))
+    {
+#if CHAFA_COLOR_HASH_ENABLE_PROFILING
+        color_hash->n_hits++;
+#endif
+        return entry & 0xff;
+    }
 
+    entry = color_hash->map [index_2];
     if ((entry & 0xffffff00) == (color << 8))
+    {
+        color_hash->map [index_2] = color_hash->map [index];
+        color_hash->map [index] = entry;
+#if CHAFA_COLOR_HASH_ENABLE_PROFILING
+        color_hash->n_hits++;
+#endif
         return entry & 0xff;
+    }
 
     return -1;
 }
@@ -22,6 +22,7 @@
 #include "chafa.h"
 #include "internal/chafa-color-table.h"
 #include "internal/chafa-pca.h"
+#include "internal/chafa-private.h"
 
 #define CHAFA_COLOR_TABLE_ENABLE_PROFILING 0
 #define DEBUG_PEN_CHOICE(x)
@@ -301,6 +302,18 @@ chafa_color_table_sort (ChafaColorTable *color_table)
     do_pca (color_table);
 
     qsort (color_table->entries, color_table->n_entries, sizeof (ChafaColorTableEntry), compare_entries);
+
+    for (i = 0; i < color_table->n_entries; i++)
+    {
+        const ChafaColorTableEntry *entry = &color_table->entries [i];
+        guint32 col = color_table->pens [entry->pen];
+
+        color_table->scan_v0 [i] = entry->v [0];
+        color_table->scan_ch [0] [i] = col & 0xff;
+        color_table->scan_ch [1] [i] = (col >> 8) & 0xff;
+        color_table->scan_ch [2] [i] = (col >> 16) & 0xff;
+    }
+
     color_table->is_sorted = TRUE;
 }
 
@@ -336,20 +349,77 @@ chafa_color_table_find_nearest_pen (const ChafaColorTable *color_table, guint32
 
     m = j;
 
-    /* Left scan for closer match */
-
-    for (j = m; j >= 0; j--)
+#ifdef HAVE_AVX2_INTRINSICS
+    if (chafa_have_avx2 ())
     {
-        if (!refine_pen_choice (color_table, want_color, v, j, &best_pen, &best_diff))
-            break;
-    }
+        gint tr = want_color & 0xff;
+        gint tg = (want_color >> 8) & 0xff;
+        gint tb = (want_color >> 16) & 0xff;
+
+        /* Left scan for closer match, eight entries at a time */
+
+        for (j = m; j >= 0; )
+        {
+            if (j >= 7)
+            {
+                if (!chafa_color_table_scan_8_avx2 (color_table->scan_v0,
+                                                    color_table->scan_ch [0],
+                                                    color_table->scan_ch [1],
+                                                    color_table->scan_ch [2],
+                                                    j - 7, v [0], tr, tg, tb,
+                                                    &best_pen, &best_diff))
+                    break;
+                j -= 8;
+            }
+            else
+            {
+                if (!refine_pen_choice (color_table, want_color, v, j, &best_pen, &best_diff))
+                    break;
+                j--;
+            }
+        }
 
-    /* Right scan for closer match */
+        /* Right scan for closer match */
 
-    for (j = m + 1; j < color_table->n_entries; j++)
+        for (j = m + 1; j < color_table->n_entries; )
+        {
+            if (j + 7 < color_table->n_entries)
+            {
+                if (!chafa_color_table_scan_8_avx2 (color_table->scan_v0,
+                                                    color_table->scan_ch [0],
+                                                    color_table->scan_ch [1],
+                                                    color_table->scan_ch [2],
+                                                    j, v [0], tr, tg, tb,
+                                                    &best_pen, &best_diff))
+                    break;
+                j += 8;
+            }
+            else
+            {
+                if (!refine_pen_choice (color_table, want_color, v, j, &best_pen, &best_diff))
+                    break;
+                j++;
+            }
+        }
+    }
+    else
+#endif
     {
-        if (!refine_pen_choice (color_table, want_color, v, j, &best_pen, &best_diff))
-            break;
+        /* Left scan for closer match */
+
+        for (j = m; j >= 0; j--)
+        {
+            if (!refine_pen_choice (color_table, want_color, v, j, &best_pen, &best_diff))
+                break;
+        }
+
+        /* Right scan for closer match */
+
+        for (j = m + 1; j < color_table->n_entries; j++)
+        {
+            if (!refine_pen_choice (color_table, want_color, v, j, &best_pen, &best_diff))
+                break;
+        }
     }
 
 #if CHAFA_COLOR_TABLE_ENABLE_PROFILING
@@ -40,6 +40,11 @@ typedef struct
     /* Each pen is 24 bits (B8G8R8) of color information */
     guint32 pens [CHAFA_COLOR_TABLE_MAX_ENTRIES];
 
+    /* SoA mirror of the sorted entries (first projected component and
+     * unpacked pen channels), for the vectorized nearest-pen scan */
+    gint scan_v0 [CHAFA_COLOR_TABLE_MAX_ENTRIES];
+    gint scan_ch [3] [CHAFA_COLOR_TABLE_MAX_ENTRIES];
+
     gint n_entries;
     guint is_sorted : 1;
 
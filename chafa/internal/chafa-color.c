@@ -262,6 +262,104 @@ chafa_color_rgb_to_din99d (const ChafaColor *rgb, ChafaColor *din99)
     din99->ch [3] = rgb->ch [3];
 }
 
+/* The DIN99d transform runs over every pixel of the working image in
+ * DIN99d mode and is heavy on libm (cube roots, logarithms, atan2). For
+ * bulk conversion we sample it on a 65^3 grid once per process and
+ * interpolate trilinearly; the grid has a node every four code values
+ * plus one at 255, and the result is within a couple of LSBs of the
+ * exact transform. */
+
+#define DIN99D_LUT_DIM 65
+
+static guint32 *din99d_lut;
+
+static guint32 *
+gen_din99d_lut (void)
+{
+    guint32 *lut;
+    gint r, g, b;
+    gint i = 0;
+
+    lut = g_new (guint32, DIN99D_LUT_DIM * DIN99D_LUT_DIM * DIN99D_LUT_DIM);
+
+    for (r = 0; r < DIN99D_LUT_DIM; r++)
+    {
+        for (g = 0; g < DIN99D_LUT_DIM; g++)
+        {
+            for (b = 0; b < DIN99D_LUT_DIM; b++)
+            {
+                ChafaColor in, out;
+
+                in.ch [0] = MIN (r * 4, 255);
+                in.ch [1] = MIN (g * 4, 255);
+                in.ch [2] = MIN (b * 4, 255);
+                in.ch [3] = 0xff;
+
+                chafa_color_rgb_to_din99d (&in, &out);
+
+                lut [i++] = out.ch [0] | (out.ch [1] << 8) | ((guint32) out.ch [2] << 16);
+            }
+        }
+    }
+
+    return lut;
+}
+
+static inline gint
+din99d_lut_interp_ch (guint32 c000, guint32 c001, guint32 c010, guint32 c011,
+                      guint32 c100, guint32 c101, guint32 c110, guint32 c111,
+                      gint shift, gint rf, gint gf, gint bf)
+{
+    gint x00, x01, x10, x11, x0, x1;
+
+    x00 = ((c000 >> shift) & 0xff) * (4 - bf) + ((c001 >> shift) & 0xff) * bf;
+    x01 = ((c010 >> shift) & 0xff) * (4 - bf) + ((c011 >> shift) & 0xff) * bf;
+    x10 = ((c100 >> shift) & 0xff) * (4 - bf) + ((c101 >> shift) & 0xff) * bf;
+    x11 = ((c110 >> shift) & 0xff) * (4 - bf) + ((c111 >> shift) & 0xff) * bf;
+
+    x0 = x00 * (4 - gf) + x01 * gf;
+    x1 = x10 * (4 - gf) + x11 * gf;
+
+    return (x0 * (4 - rf) + x1 * rf + 32) >> 6;
+}
+
+void
+chafa_color_rgb_to_din99d_fast (const ChafaColor *rgb, ChafaColor *din99)
+{
+    const guint32 *base;
+    guint32 c000, c001, c010, c011, c100, c101, c110, c111;
+    gint ri, gi, bi, rf, gf, bf;
+
+    if (g_once_init_enter (&din99d_lut))
+        g_once_init_leave (&din99d_lut, gen_din99d_lut ());
+
+    ri = rgb->ch [0] >> 2;
+    gi = rgb->ch [1] >> 2;
+    bi = rgb->ch [2] >> 2;
+    rf = rgb->ch [0] & 3;
+    gf = rgb->ch [1] & 3;
+    bf = rgb->ch [2] & 3;
+
+    base = din99d_lut + ((ri * DIN99D_LUT_DIM) + gi) * DIN99D_LUT_DIM + bi;
+
+    c000 = base [0];
+    c001 = base [1];
+    c010 = base [DIN99D_LUT_DIM];
+    c011 = base [DIN99D_LUT_DIM + 1];
+    c100 = base [DIN99D_LUT_DIM * DIN99D_LUT_DIM];
+    c101 = base [DIN99D_LUT_DIM * DIN99D_LUT_DIM + 1];
+    c110 = base [DIN99D_LUT_DIM * DIN99D_LUT_DIM + DIN99D_LUT_DIM];
+    c111 = base [DIN99D_LUT_DIM * DIN99D_LUT_DIM + DIN99D_LUT_DIM + 1];
+
+    din99->ch [0] = din99d_lut_interp_ch (c000, c001, c010, c011, c100, c101, c110, c111,
+                                          0, rf, gf, bf);
+    din99->ch [1] = din99d_lut_interp_ch (c000, c001, c010, c011, c100, c101, c110, c111,
+                                          8, rf, gf, bf);
+    din99->ch [2] = din99d_lut_interp_ch (c000, c001, c010, c011, c100, c101, c110, c111,
+                                          16, rf, gf, bf);
+    din99->ch [3] = rgb->ch [3];
+}
+
 static gint
 color_diff_rgb (const ChafaColor *col_a, const ChafaColor *col_b)
 {
@@ -142,6 +142,10 @@ void chafa_color_accum_div_scalar (ChafaColorAccum *color, gint scalar);
 
 void chafa_color_rgb_to_din99d (const ChafaColor *rgb, ChafaColor *din99);
 
+/* LUT-based approximation, good to within a couple of LSBs. Use this for
+ * bulk per-pixel conversion; the exact variant is for palette setup. */
+void chafa_color_rgb_to_din99d_fast (const ChafaColor *rgb, ChafaColor *din99);
+
 /* Ratio is in the range 0-1000 */
 void chafa_color_mix (ChafaColor *out, const ChafaColor *a, const ChafaColor *b, gint ratio);
 
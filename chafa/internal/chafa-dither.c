@@ -62,7 +62,25 @@ chafa_dither_init (ChafaDither *dither, ChafaDitherMode mode,
 
     if (mode == CHAFA_DITHER_MODE_ORDERED)
     {
-        dither->bayer_matrix = chafa_gen_bayer_matrix (BAYER_MATRIX_DIM, intensity);
+        /* The matrix depends on intensity only; memoize the last one
+         * generated so repeated canvas setup with the same settings
+         * copies instead of recomputing */
+        static GMutex memo_mutex;
+        static gint *memo_matrix;
+        static gdouble memo_intensity;
+
+        g_mutex_lock (&memo_mutex);
+
+        if (!memo_matrix || memo_intensity != intensity)
+        {
+            g_free (memo_matrix);
+            memo_matrix = chafa_gen_bayer_matrix (BAYER_MATRIX_DIM, intensity);
+            memo_intensity = intensity;
+        }
+
+        dither->bayer_matrix = g_memdup (memo_matrix, BAYER_MATRIX_SIZE * sizeof (gint));
+
+        g_mutex_unlock (&memo_mutex);
     }
     else if (mode == CHAFA_DITHER_MODE_DIFFUSION)
     {
@@ -23,6 +23,7 @@
 #include "chafa.h"
 #include "internal/chafa-batch.h"
 #include "internal/chafa-private.h"
+#include "internal/chafa-profile.h"
 
 typedef struct
 {
@@ -102,7 +103,7 @@ quantize_pixel (const DrawPixelsCtx *ctx, ChafaColorHash *color_hash, ChafaColor
     if (index < 0)
     {
         if (ctx->color_space == CHAFA_COLOR_SPACE_DIN99D)
-            chafa_color_rgb_to_din99d (&color, &color);
+            chafa_color_rgb_to_din99d_fast (&color, &color);
 
         index = chafa_palette_lookup_nearest (&ctx->indexed_image->palette,
                                               ctx->color_space,
@@ -135,7 +136,7 @@ quantize_pixel_with_error (const DrawPixelsCtx *ctx, ChafaColor color, ChafaColo
     }
 
     if (ctx->color_space == CHAFA_COLOR_SPACE_DIN99D)
-        chafa_color_rgb_to_din99d (&color, &color);
+        chafa_color_rgb_to_din99d_fast (&color, &color);
 
     index = chafa_palette_lookup_with_error (&ctx->indexed_image->palette,
                                              ctx->color_space,
@@ -297,33 +298,54 @@ fs_dither_row (const DrawPixelsCtx *ctx, ChafaColorHash *chash, const guint32 *i
     }
 }
 
+/* Batches other than the first start out with a zeroed error state, which
+ * would show up as a horizontal seam. To hide it, each batch first dithers
+ * a few rows belonging to the previous batch, discarding the output; the
+ * diffused error decays quickly enough that this reconstructs the error
+ * state at the batch boundary to within rounding. */
+#define FS_DITHER_WARMUP_ROWS 16
+
 static void
 draw_pixels_pass_2_fs (ChafaBatchInfo *batch, const DrawPixelsCtx *ctx,
                        ChafaColorHash *chash)
 {
     ChafaColorAccum *error_row [2];
+    guint8 *scratch_row;
     const guint32 *src_p;
-    guint8 *dest_end_p, *dest_p;
+    guint8 *dest_p;
+    gint first_row, end_row;
     gint y;
 
     error_row [0] = alloca (ctx->dest_width * sizeof (ChafaColorAccum));
     error_row [1] = alloca (ctx->dest_width * sizeof (ChafaColorAccum));
+    scratch_row = alloca (ctx->dest_width);
 
-    src_p = ctx->scaled_data + (ctx->dest_width * batch->first_row);
-    dest_p = ctx->indexed_image->pixels + (ctx->dest_width * batch->first_row);
-    dest_end_p = dest_p + (ctx->dest_width * batch->n_rows);
+    first_row = MAX (batch->first_row - FS_DITHER_WARMUP_ROWS, 0);
+    end_row = batch->first_row + batch->n_rows;
 
-    y = batch->first_row;
+    src_p = ctx->scaled_data + (ctx->dest_width * first_row);
+    dest_p = ctx->indexed_image->pixels + (ctx->dest_width * batch->first_row);
 
     memset (error_row [0], 0, ctx->dest_width * sizeof (ChafaColorAccum));
 
-    for ( ; dest_p < dest_end_p; src_p += ctx->dest_width, dest_p += ctx->dest_width, y++)
+    for (y = first_row; y < end_row; y++, src_p += ctx->dest_width)
     {
         ChafaColorAccum *error_row_temp;
+        guint8 *outrow_p;
+
+        if (y < batch->first_row)
+        {
+            outrow_p = scratch_row;
+        }
+        else
+        {
+            outrow_p = dest_p;
+            dest_p += ctx->dest_width;
+        }
 
         memset (error_row [1], 0, ctx->dest_width * sizeof (ChafaColorAccum));
 
-        fs_dither_row (ctx, chash, src_p, dest_p, error_row [0], error_row [1],
+        fs_dither_row (ctx, chash, src_p, outrow_p, error_row [0], error_row [1],
                        ctx->dest_width, y);
 
         error_row_temp = error_row [0];
@@ -332,12 +354,27 @@ draw_pixels_pass_2_fs (ChafaBatchInfo *batch, const DrawPixelsCtx *ctx,
     }
 }
 
+/* Size the color hash by the number of pixels it will see; photographic
+ * input can have nearly as many unique colors as pixels, and a hash
+ * that's too small spends most of its time evicting. */
+static guint
+color_hash_n_entries_for_image (const DrawPixelsCtx *ctx)
+{
+    guint n_pixels = ctx->dest_width * ctx->dest_height;
+    guint n = CHAFA_COLOR_HASH_N_ENTRIES;
+
+    while (n < n_pixels && n < CHAFA_COLOR_HASH_MAX_N_ENTRIES)
+        n <<= 1;
+
+    return n;
+}
+
 static void
 draw_pixels_pass_2_worker (ChafaBatchInfo *batch, const DrawPixelsCtx *ctx)
 {
     ChafaColorHash chash;
 
-    chafa_color_hash_init (&chash);
+    chafa_color_hash_init_sized (&chash, color_hash_n_entries_for_image (ctx));
 
     switch (ctx->indexed_image->dither.mode)
     {
@@ -364,24 +401,28 @@ draw_pixels_pass_2_worker (ChafaBatchInfo *batch, const DrawPixelsCtx *ctx)
 static void
 draw_pixels (DrawPixelsCtx *ctx)
 {
+    gint64 prof_t0;
+
+    prof_t0 = chafa_prof_begin ();
     chafa_process_batches (ctx,
                            (GFunc) draw_pixels_pass_1_worker,
                            NULL,
                            ctx->dest_height,
                            g_get_num_processors (),
                            1);
+    chafa_prof_end (CHAFA_PROF_STAGE_PREPARE, prof_t0);
 
+    prof_t0 = chafa_prof_begin ();
     chafa_palette_generate (&ctx->indexed_image->palette,
                             ctx->scaled_data, ctx->dest_width * ctx->dest_height,
                             ctx->color_space);
+    chafa_prof_end (CHAFA_PROF_STAGE_QUANTIZE, prof_t0);
 
-    /* Single thread only for diffusion; it's a fully serial operation */
     chafa_process_batches (ctx,
                            (GFunc) draw_pixels_pass_2_worker,
                            NULL,
                            ctx->dest_height,
-                           ctx->indexed_image->dither.mode == CHAFA_DITHER_MODE_DIFFUSION
-                             ? 1 : g_get_num_processors (),
+                           g_get_num_processors (),
                            1);
 }
 
@@ -395,7 +436,8 @@ chafa_indexed_image_new (gint width, gint height,
     indexed_image = g_new0 (ChafaIndexedImage, 1);
     indexed_image->width = width;
     indexed_image->height = height;
-    indexed_image->pixels = g_malloc (width * height);
+    indexed_image->pixels = chafa_alloc_large ((gsize) width * height);
+    chafa_heap_stats_add ((gsize) width * height);
 
     chafa_palette_copy (palette, &indexed_image->palette);
     chafa_palette_set_transparent_index (&indexed_image->palette, 255);
@@ -409,7 +451,8 @@ void
 chafa_indexed_image_destroy (ChafaIndexedImage *indexed_image)
 {
     chafa_dither_deinit (&indexed_image->dither);
-    g_free (indexed_image->pixels);
+    chafa_heap_stats_remove ((gsize) indexed_image->width * indexed_image->height);
+    chafa_free_large (indexed_image->pixels);
     g_free (indexed_image);
 }
 
@@ -445,6 +488,7 @@ chafa_indexed_image_draw_pixels (ChafaIndexedImage *indexed_image,
                                                    CHAFA_PALETTE_INDEX_BG));
 
     ctx.scaled_data = g_new (guint32, dest_width * dest_height);
+    chafa_heap_stats_add ((gsize) dest_width * dest_height * sizeof (guint32));
     ctx.scale_ctx = smol_scale_new_full ((SmolPixelType) src_pixel_type,
                                          (const guint32 *) src_pixels,
                                          src_width,
@@ -456,7 +500,8 @@ chafa_indexed_image_draw_pixels (ChafaIndexedImage *indexed_image,
                                          dest_height,
                                          dest_width * sizeof (guint32),
                                          post_scale_row,
-                                         &ctx);
+                                         &ctx,
+                                         SMOL_ALPHA_AUTO);
 
     draw_pixels (&ctx);
 
@@ -465,5 +510,54 @@ chafa_indexed_image_draw_pixels (ChafaIndexedImage *indexed_image,
             indexed_image->width * (indexed_image->height - dest_height));
 
     smol_scale_destroy (ctx.scale_ctx);
+    chafa_heap_stats_remove ((gsize) dest_width * dest_height * sizeof (guint32));
     g_free (ctx.scaled_data);
 }
+
+void
+chafa_indexed_image_draw_indexed_pixels (ChafaIndexedImage *indexed_image,
+                                         const guint8 *src_index_pixels,
+                                         gint src_width, gint src_height, gint src_rowstride,
+                                         gint dest_width, gint dest_height)
+{
+    gint transparent_index;
+    gint *x_ofs;
+    gint x, y;
+
+    g_return_if_fail (dest_width == indexed_image->width);
+    g_return_if_fail (dest_height <= indexed_image->height);
+
+    /* Pen indexes can't be interpolated, so scale by nearest-neighbor
+     * point sampling. The horizontal sample offsets are the same for every
+     * row; compute them once. */
+
+    x_ofs = g_new (gint, dest_width);
+    for (x = 0; x < dest_width; x++)
+        x_ofs [x] = (x * 2 + 1) * src_width / (dest_width * 2);
+
+    for (y = 0; y < dest_height; y++)
+    {
+        const guint8 *src_row = src_index_pixels
+            + (gsize) ((y * 2 + 1) * src_height / (dest_height * 2)) * src_rowstride;
+        guint8 *dest_row = indexed_image->pixels + (gsize) y * indexed_image->width;
+
+        if (src_width == dest_width)
+        {
+            memcpy (dest_row, src_row, dest_width);
+        }
+        else
+        {
+            for (x = 0; x < dest_width; x++)
+                dest_row [x] = src_row [x_ofs [x]];
+        }
+    }
+
+    g_free (x_ofs);
+
+    /* Fill the padding rows with the transparent pen where there is one,
+     * so they don't show in the output */
+    transparent_index = chafa_palette_get_transparent_index (&indexed_image->palette);
+    memset (indexed_image->pixels + indexed_image->width * dest_height,
+            transparent_index >= 0 && transparent_index <= 255 ? transparent_index : 0,
+            indexed_image->width * (indexed_image->height - dest_height));
+}
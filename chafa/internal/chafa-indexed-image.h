@@ -44,6 +44,10 @@ void chafa_indexed_image_draw_pixels (ChafaIndexedImage *indexed_image,
                                       gconstpointer src_pixels,
                                       gint src_width, gint src_height, gint src_rowstride,
                                       gint dest_width, gint dest_height);
+void chafa_indexed_image_draw_indexed_pixels (ChafaIndexedImage *indexed_image,
+                                              const guint8 *src_index_pixels,
+                                              gint src_width, gint src_height, gint src_rowstride,
+                                              gint dest_width, gint dest_height);
 
 G_END_DECLS
 
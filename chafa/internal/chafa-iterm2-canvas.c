@@ -26,6 +26,7 @@
 #include "internal/chafa-bitfield.h"
 #include "internal/chafa-indexed-image.h"
 #include "internal/chafa-iterm2-canvas.h"
+#include "internal/chafa-private.h"
 #include "internal/chafa-string-util.h"
 
 typedef enum
@@ -108,7 +109,8 @@ chafa_iterm2_canvas_new (gint width, gint height)
     iterm2_canvas = g_new (ChafaIterm2Canvas, 1);
     iterm2_canvas->width = width;
     iterm2_canvas->height = height;
-    iterm2_canvas->rgba_image = g_malloc (width * height * sizeof (guint32));
+    iterm2_canvas->rgba_image = chafa_alloc_large ((gsize) width * height * sizeof (guint32));
+    chafa_heap_stats_add ((gsize) width * height * sizeof (guint32));
 
     return iterm2_canvas;
 }
@@ -116,7 +118,9 @@ chafa_iterm2_canvas_new (gint width, gint height)
 void
 chafa_iterm2_canvas_destroy (ChafaIterm2Canvas *iterm2_canvas)
 {
-    g_free (iterm2_canvas->rgba_image);
+    chafa_heap_stats_remove ((gsize) iterm2_canvas->width * iterm2_canvas->height
+                             * sizeof (guint32));
+    chafa_free_large (iterm2_canvas->rgba_image);
     g_free (iterm2_canvas);
 }
 
@@ -157,7 +161,8 @@ chafa_iterm2_canvas_draw_all_pixels (ChafaIterm2Canvas *iterm2_canvas, ChafaPixe
                                          iterm2_canvas->height,
                                          iterm2_canvas->width * sizeof (guint32),
                                          NULL,
-                                         &ctx);
+                                         &ctx,
+                                         SMOL_ALPHA_AUTO);
 
     chafa_process_batches (&ctx,
                            (GFunc) draw_pixels_worker,
@@ -187,11 +192,64 @@ generate_tag (ChafaBase64 *base64, GString *gs,
     encode_tag (base64, gs, &tag);
 }
 
-void
-chafa_iterm2_canvas_build_ansi (ChafaIterm2Canvas *iterm2_canvas, ChafaTermInfo *term_info, GString *out_str, gint width_cells, gint height_cells)
+typedef struct
+{
+    ChafaIterm2Canvas *iterm2_canvas;
+    GString *out_str;
+
+    /* FD to stream to, or -1 to accumulate in out_str only */
+    gint fd;
+    gboolean fd_error;
+
+    /* Payload bytes encoded serially to reach a three-byte boundary */
+    gsize lead_len;
+}
+EncodePayloadCtx;
+
+/* Base64 output for disjoint three-byte-aligned input chunks is
+ * independently computable; each batch encodes a run of groups with a
+ * local encoder and leaves no carry behind */
+static void
+encode_payload_worker (ChafaBatchInfo *batch, const EncodePayloadCtx *ctx)
+{
+    ChafaBase64 base64;
+    GString *gs = g_string_new ("");
+
+    chafa_base64_init (&base64);
+    chafa_base64_encode (&base64, gs,
+                         (const guint8 *) ctx->iterm2_canvas->rgba_image
+                         + ctx->lead_len + (gsize) batch->first_row * 3,
+                         batch->n_rows * 3);
+    chafa_base64_deinit (&base64);
+
+    batch->ret_p = gs;
+    batch->ret_n = gs->len;
+}
+
+static void
+encode_payload_post (ChafaBatchInfo *batch, EncodePayloadCtx *ctx)
+{
+    GString *gs = batch->ret_p;
+
+    if (!ctx->fd_error)
+    {
+        g_string_append_len (ctx->out_str, gs->str, gs->len);
+
+        if (ctx->fd >= 0 && ctx->out_str->len >= CHAFA_FD_FLUSH_THRESHOLD
+            && !chafa_fd_flush_gstring (ctx->fd, ctx->out_str))
+            ctx->fd_error = TRUE;
+    }
+
+    g_string_free (gs, TRUE);
+}
+
+static gboolean
+build_ansi_internal (ChafaIterm2Canvas *iterm2_canvas, ChafaTermInfo *term_info, GString *out_str,
+                     gint fd, gint width_cells, gint height_cells)
 {
     gchar seq [CHAFA_TERM_SEQ_LENGTH_MAX + 1];
     ChafaBase64 base64;
+    gboolean success = TRUE;
     guint32 u32;
     guint16 u16;
 
@@ -208,11 +266,45 @@ chafa_iterm2_canvas_build_ansi (ChafaIterm2Canvas *iterm2_canvas, ChafaTermInfo
                          + sizeof (guint32) * 2);
     chafa_base64_encode (&base64, out_str, &u32, sizeof (u32));
 
-    /* Image data */
-
-    chafa_base64_encode (&base64, out_str,
-                         iterm2_canvas->rgba_image,
-                         iterm2_canvas->width * iterm2_canvas->height * sizeof (guint32));
+    /* Image data. The 8-byte header leaves a 2-byte carry in the encoder,
+     * so encode one leading payload byte serially to bring the stream to a
+     * three-byte boundary, then hand the aligned bulk to the worker pool
+     * in chunks joined in batch order. The unaligned tail carries into the
+     * IFD, so the output is identical to a single serial pass. */
+
+    {
+        EncodePayloadCtx ectx;
+        gsize n_bytes = (gsize) iterm2_canvas->width * iterm2_canvas->height
+            * sizeof (guint32);
+        gsize lead_len = MIN ((3 - (sizeof (guint32) * 2) % 3) % 3, n_bytes);
+        gsize n_groups = (n_bytes - lead_len) / 3;
+
+        chafa_base64_encode (&base64, out_str, iterm2_canvas->rgba_image, lead_len);
+
+        ectx.iterm2_canvas = iterm2_canvas;
+        ectx.out_str = out_str;
+        ectx.fd = fd;
+        ectx.fd_error = FALSE;
+        ectx.lead_len = lead_len;
+
+        chafa_process_batches (&ectx,
+                               (GFunc) encode_payload_worker,
+                               (GFunc) encode_payload_post,
+                               n_groups,
+                               g_get_num_processors (),
+                               1);
+
+        if (ectx.fd_error)
+        {
+            success = FALSE;
+            goto out;
+        }
+
+        chafa_base64_encode (&base64, out_str,
+                             (const guint8 *) iterm2_canvas->rgba_image
+                             + lead_len + n_groups * 3,
+                             n_bytes - lead_len - n_groups * 3);
+    }
 
     /* IFD */
 
@@ -240,8 +332,36 @@ chafa_iterm2_canvas_build_ansi (ChafaIterm2Canvas *iterm2_canvas, ChafaTermInfo
     chafa_base64_encode (&base64, out_str, &u32, sizeof (u32));
 
     chafa_base64_encode_end (&base64, out_str);
-    chafa_base64_deinit (&base64);
 
     *chafa_term_info_emit_end_iterm2_image (term_info, seq) = '\0';
     g_string_append (out_str, seq);
+
+    if (fd >= 0)
+        success = chafa_fd_flush_gstring (fd, out_str);
+
+out:
+    chafa_base64_deinit (&base64);
+    return success;
+}
+
+void
+chafa_iterm2_canvas_build_ansi (ChafaIterm2Canvas *iterm2_canvas, ChafaTermInfo *term_info, GString *out_str,
+                                gint width_cells, gint height_cells)
+{
+    build_ansi_internal (iterm2_canvas, term_info, out_str, -1, width_cells, height_cells);
+}
+
+/* Like chafa_iterm2_canvas_build_ansi (), but flushes the output to fd
+ * in bounded chunks as it's encoded. Returns FALSE on write error. */
+gboolean
+chafa_iterm2_canvas_build_ansi_fd (ChafaIterm2Canvas *iterm2_canvas, ChafaTermInfo *term_info, gint fd,
+                                   gint width_cells, gint height_cells)
+{
+    GString *scratch = g_string_new ("");
+    gboolean success;
+
+    success = build_ansi_internal (iterm2_canvas, term_info, scratch, fd, width_cells, height_cells);
+
+    g_string_free (scratch, TRUE);
+    return success;
 }
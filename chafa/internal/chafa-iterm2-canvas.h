@@ -39,6 +39,8 @@ void chafa_iterm2_canvas_draw_all_pixels (ChafaIterm2Canvas *iterm2_canvas, Chaf
                                           gint src_width, gint src_height, gint src_rowstride);
 void chafa_iterm2_canvas_build_ansi (ChafaIterm2Canvas *iterm2_canvas, ChafaTermInfo *term_info, GString *out_str,
                                      gint width_cells, gint height_cells);
+gboolean chafa_iterm2_canvas_build_ansi_fd (ChafaIterm2Canvas *iterm2_canvas, ChafaTermInfo *term_info, gint fd,
+                                            gint width_cells, gint height_cells);
 
 G_END_DECLS
 
@@ -19,6 +19,16 @@
 
 #include "config.h"
 
+#ifdef HAVE_ZLIB
+# include <zlib.h>
+#endif
+
+#ifdef HAVE_SHM_OPEN
+# include <fcntl.h>  /* O_* flags */
+# include <sys/mman.h>  /* shm_open, mmap */
+# include <unistd.h>  /* ftruncate, close, getpid */
+#endif
+
 #include "chafa.h"
 #include "smolscale/smolscale.h"
 #include "internal/chafa-base64.h"
@@ -26,6 +36,7 @@
 #include "internal/chafa-bitfield.h"
 #include "internal/chafa-indexed-image.h"
 #include "internal/chafa-kitty-canvas.h"
+#include "internal/chafa-private.h"
 #include "internal/chafa-string-util.h"
 
 typedef struct
@@ -50,7 +61,10 @@ chafa_kitty_canvas_new (gint width, gint height)
     kitty_canvas = g_new (ChafaKittyCanvas, 1);
     kitty_canvas->width = width;
     kitty_canvas->height = height;
-    kitty_canvas->rgba_image = g_malloc (width * height * sizeof (guint32));
+    kitty_canvas->rgba_image = chafa_alloc_large ((gsize) width * height * sizeof (guint32));
+    chafa_heap_stats_add ((gsize) width * height * sizeof (guint32));
+    kitty_canvas->prev_image = NULL;
+    kitty_canvas->image_id = 0;
 
     return kitty_canvas;
 }
@@ -58,7 +72,9 @@ chafa_kitty_canvas_new (gint width, gint height)
 void
 chafa_kitty_canvas_destroy (ChafaKittyCanvas *kitty_canvas)
 {
-    g_free (kitty_canvas->rgba_image);
+    chafa_heap_stats_remove ((gsize) kitty_canvas->width * kitty_canvas->height
+                             * sizeof (guint32));
+    chafa_free_large (kitty_canvas->rgba_image);
     g_free (kitty_canvas);
 }
 
@@ -99,7 +115,8 @@ chafa_kitty_canvas_draw_all_pixels (ChafaKittyCanvas *kitty_canvas, ChafaPixelTy
                                          kitty_canvas->height,
                                          kitty_canvas->width * sizeof (guint32),
                                          NULL,
-                                         &ctx);
+                                         &ctx,
+                                         SMOL_ALPHA_AUTO);
 
     chafa_process_batches (&ctx,
                            (GFunc) draw_pixels_worker,
@@ -109,6 +126,23 @@ chafa_kitty_canvas_draw_all_pixels (ChafaKittyCanvas *kitty_canvas, ChafaPixelTy
                            1);
 }
 
+/* Sets up emission of frame deltas. image_id must be a nonzero ID unique to
+ * this image; it is assigned on the initial full transmission and referenced
+ * by subsequent region updates. prev_image may point to the previous frame's
+ * RGBA data at the same dimensions, in which case only the changed bounding
+ * rectangle is transmitted; it must stay valid until after
+ * chafa_kitty_canvas_build_ansi (). */
+void
+chafa_kitty_canvas_set_frame_delta (ChafaKittyCanvas *kitty_canvas,
+                                    gconstpointer prev_image, guint32 image_id)
+{
+    g_return_if_fail (kitty_canvas != NULL);
+    g_return_if_fail (image_id != 0);
+
+    kitty_canvas->prev_image = prev_image;
+    kitty_canvas->image_id = image_id;
+}
+
 static void
 encode_chunk (GString *gs, const guint8 *start, const guint8 *end)
 {
@@ -120,24 +154,44 @@ encode_chunk (GString *gs, const guint8 *start, const guint8 *end)
     chafa_base64_deinit (&base64);
 }
 
-void
-chafa_kitty_canvas_build_ansi (ChafaKittyCanvas *kitty_canvas, ChafaTermInfo *term_info, GString *out_str,
-                               gint width_cells, gint height_cells)
+#ifdef HAVE_ZLIB
+
+/* Deflate the image with zlib. Returns a buffer owned by the caller, or
+ * NULL if the compressed representation would be bigger than the input */
+static guint8 *
+compress_image (ChafaKittyCanvas *kitty_canvas, gint compression_level, gulong *compressed_len_out)
 {
-    const guint8 *p, *last;
-    gchar seq [CHAFA_TERM_SEQ_LENGTH_MAX + 1];
+    gulong image_len, buf_len;
+    guint8 *buf;
 
-    *chafa_term_info_emit_begin_kitty_immediate_image_v1 (term_info, seq,
-                                                          32,
-                                                          kitty_canvas->width,
-                                                          kitty_canvas->height,
-                                                          width_cells,
-                                                          height_cells) = '\0';
-    g_string_append (out_str, seq);
+    image_len = kitty_canvas->width * kitty_canvas->height * sizeof (guint32);
+    buf_len = compressBound (image_len);
+    buf = g_malloc (buf_len);
 
-    last = kitty_canvas->rgba_image + kitty_canvas->width * kitty_canvas->height * sizeof (guint32);
+    if (compress2 (buf, &buf_len, kitty_canvas->rgba_image, image_len,
+                   MIN (compression_level, Z_BEST_COMPRESSION)) != Z_OK
+        || buf_len >= image_len)
+    {
+        g_free (buf);
+        return NULL;
+    }
+
+    *compressed_len_out = buf_len;
+    return buf;
+}
+
+#endif
+
+/* Chunks, encodes and appends image data, then ends the upload. When
+ * fd >= 0, out_str is treated as a scratch buffer flushed to the file
+ * descriptor at chunk boundaries. Returns FALSE on write error. */
+static gboolean
+emit_image_data (ChafaTermInfo *term_info, GString *out_str, gint fd,
+                 const guint8 *p, const guint8 *last)
+{
+    gchar seq [CHAFA_TERM_SEQ_LENGTH_MAX + 1];
 
-    for (p = kitty_canvas->rgba_image; p < last; )
+    for ( ; p < last; )
     {
         const guint8 *end;
 
@@ -153,9 +207,299 @@ chafa_kitty_canvas_build_ansi (ChafaKittyCanvas *kitty_canvas, ChafaTermInfo *te
         *chafa_term_info_emit_end_kitty_image_chunk (term_info, seq) = '\0';
         g_string_append (out_str, seq);
 
+        if (fd >= 0 && out_str->len >= CHAFA_FD_FLUSH_THRESHOLD
+            && !chafa_fd_flush_gstring (fd, out_str))
+            return FALSE;
+
         p = end;
     }
 
     *chafa_term_info_emit_end_kitty_image (term_info, seq) = '\0';
     g_string_append (out_str, seq);
+
+    if (fd >= 0)
+        return chafa_fd_flush_gstring (fd, out_str);
+
+    return TRUE;
+}
+
+/* Computes the bounding rectangle of the pixels that differ between a and b.
+ * Returns FALSE if the images are identical. */
+static gboolean
+find_changed_rect (const guint32 *a, const guint32 *b, gint width, gint height,
+                   gint *x_out, gint *y_out, gint *rect_width_out, gint *rect_height_out)
+{
+    gint first_row = -1, last_row = 0;
+    gint first_col = width, last_col = -1;
+    gint x, y;
+
+    for (y = 0; y < height; y++)
+    {
+        if (memcmp (a + y * width, b + y * width, width * sizeof (guint32)))
+        {
+            if (first_row < 0)
+                first_row = y;
+            last_row = y;
+        }
+    }
+
+    if (first_row < 0)
+        return FALSE;
+
+    for (y = first_row; y <= last_row; y++)
+    {
+        const guint32 *row_a = a + y * width;
+        const guint32 *row_b = b + y * width;
+
+        for (x = 0; x < first_col; x++)
+        {
+            if (row_a [x] != row_b [x])
+            {
+                first_col = x;
+                break;
+            }
+        }
+
+        for (x = width - 1; x > last_col; x--)
+        {
+            if (row_a [x] != row_b [x])
+            {
+                last_col = x;
+                break;
+            }
+        }
+    }
+
+    *x_out = first_col;
+    *y_out = first_row;
+    *rect_width_out = last_col + 1 - first_col;
+    *rect_height_out = last_row + 1 - first_row;
+    return TRUE;
+}
+
+static gboolean
+build_frame_delta (ChafaKittyCanvas *kitty_canvas, ChafaTermInfo *term_info, GString *out_str,
+                   gint fd, gint x, gint y, gint rect_width, gint rect_height)
+{
+    gchar seq [CHAFA_TERM_SEQ_LENGTH_MAX + 1];
+    guint8 *rect;
+    gboolean success;
+    gint row;
+
+    *chafa_term_info_emit_begin_kitty_image_frame_v1 (term_info, seq,
+                                                      kitty_canvas->image_id,
+                                                      x, y,
+                                                      rect_width, rect_height) = '\0';
+    g_string_append (out_str, seq);
+
+    rect = g_malloc (rect_width * rect_height * sizeof (guint32));
+
+    for (row = 0; row < rect_height; row++)
+    {
+        memcpy (rect + row * rect_width * sizeof (guint32),
+                (const guint8 *) kitty_canvas->rgba_image
+                + ((y + row) * kitty_canvas->width + x) * sizeof (guint32),
+                rect_width * sizeof (guint32));
+    }
+
+    success = emit_image_data (term_info, out_str, fd, rect,
+                               rect + rect_width * rect_height * sizeof (guint32));
+    g_free (rect);
+    return success;
+}
+
+#ifdef HAVE_SHM_OPEN
+
+/* Shared-memory transmission: the pixel data goes into a POSIX shm
+ * object and only its base64-encoded name is put on the wire. The
+ * terminal deletes the object after reading it. Returns FALSE if the
+ * object can't be set up, in which case the caller falls back to
+ * direct transmission. */
+static gboolean
+build_ansi_shm (ChafaKittyCanvas *kitty_canvas, ChafaTermInfo *term_info, GString *out_str,
+                gint width_cells, gint height_cells)
+{
+    static gint shm_counter;
+    gchar name [64];
+    gchar seq [CHAFA_TERM_SEQ_LENGTH_MAX + 1];
+    ChafaBase64 base64;
+    gsize size;
+    gpointer map;
+    gint fd;
+
+    size = (gsize) kitty_canvas->width * kitty_canvas->height * sizeof (guint32);
+
+    g_snprintf (name, sizeof (name), "/chafa-%d-%d",
+                (gint) getpid (), g_atomic_int_add (&shm_counter, 1));
+
+    fd = shm_open (name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return FALSE;
+
+    if (ftruncate (fd, size) != 0)
+    {
+        close (fd);
+        shm_unlink (name);
+        return FALSE;
+    }
+
+    map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+
+    if (map == MAP_FAILED)
+    {
+        shm_unlink (name);
+        return FALSE;
+    }
+
+    memcpy (map, kitty_canvas->rgba_image, size);
+    munmap (map, size);
+
+    *chafa_term_info_emit_begin_kitty_immediate_image_v1_shm (term_info, seq,
+                                                              32,
+                                                              kitty_canvas->width,
+                                                              kitty_canvas->height,
+                                                              width_cells,
+                                                              height_cells) = '\0';
+    g_string_append (out_str, seq);
+
+    chafa_base64_init (&base64);
+    chafa_base64_encode (&base64, out_str, name, strlen (name));
+    chafa_base64_encode_end (&base64, out_str);
+    chafa_base64_deinit (&base64);
+
+    *chafa_term_info_emit_end_kitty_image_chunk (term_info, seq) = '\0';
+    g_string_append (out_str, seq);
+
+    return TRUE;
+}
+
+#endif /* HAVE_SHM_OPEN */
+
+static gboolean
+build_ansi_internal (ChafaKittyCanvas *kitty_canvas, ChafaTermInfo *term_info, GString *out_str,
+                     gint fd, gint width_cells, gint height_cells, gint compression_level,
+                     gboolean shm_enabled)
+{
+    guint8 *compressed = NULL;
+    gulong compressed_len = 0;
+    const guint8 *p, *last;
+    gboolean success;
+    gchar seq [CHAFA_TERM_SEQ_LENGTH_MAX + 1];
+
+    if (kitty_canvas->image_id
+        && kitty_canvas->prev_image
+        && chafa_term_info_have_seq (term_info, CHAFA_TERM_SEQ_BEGIN_KITTY_IMAGE_FRAME_V1))
+    {
+        gint x, y, rect_width, rect_height;
+
+        /* In-place region update of the previously transmitted frame. If
+         * nothing changed, emit nothing; the displayed image is already
+         * correct. */
+        if (find_changed_rect (kitty_canvas->prev_image, kitty_canvas->rgba_image,
+                               kitty_canvas->width, kitty_canvas->height,
+                               &x, &y, &rect_width, &rect_height))
+            return build_frame_delta (kitty_canvas, term_info, out_str,
+                                      fd, x, y, rect_width, rect_height);
+        return TRUE;
+    }
+
+#ifdef HAVE_SHM_OPEN
+    /* Shared-memory handoff beats any encoding of the pixel data; only
+     * the anonymous immediate sequence has an shm variant */
+    if (shm_enabled
+        && !kitty_canvas->image_id
+        && chafa_term_info_have_seq (term_info, CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1_SHM)
+        && build_ansi_shm (kitty_canvas, term_info, out_str, width_cells, height_cells))
+        return TRUE;
+#else
+    (void) shm_enabled;
+#endif
+
+#ifdef HAVE_ZLIB
+    /* The initial frame of a delta sequence is sent uncompressed; there is
+     * no compressed variant of the ID-assigning sequence */
+    if (!kitty_canvas->image_id
+        && compression_level > 0
+        && chafa_term_info_have_seq (term_info, CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1_ZLIB))
+        compressed = compress_image (kitty_canvas, compression_level, &compressed_len);
+#else
+    (void) compression_level;
+#endif
+
+    if (compressed)
+    {
+        *chafa_term_info_emit_begin_kitty_immediate_image_v1_zlib (term_info, seq,
+                                                                   32,
+                                                                   kitty_canvas->width,
+                                                                   kitty_canvas->height,
+                                                                   width_cells,
+                                                                   height_cells) = '\0';
+    }
+    else if (kitty_canvas->image_id
+             && chafa_term_info_have_seq (term_info, CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1_ID))
+    {
+        *chafa_term_info_emit_begin_kitty_immediate_image_v1_id (term_info, seq,
+                                                                 kitty_canvas->image_id,
+                                                                 32,
+                                                                 kitty_canvas->width,
+                                                                 kitty_canvas->height,
+                                                                 width_cells,
+                                                                 height_cells) = '\0';
+    }
+    else
+    {
+        *chafa_term_info_emit_begin_kitty_immediate_image_v1 (term_info, seq,
+                                                              32,
+                                                              kitty_canvas->width,
+                                                              kitty_canvas->height,
+                                                              width_cells,
+                                                              height_cells) = '\0';
+    }
+    g_string_append (out_str, seq);
+
+    if (compressed)
+    {
+        p = compressed;
+        last = compressed + compressed_len;
+    }
+    else
+    {
+        p = kitty_canvas->rgba_image;
+        last = (const guint8 *) kitty_canvas->rgba_image
+            + kitty_canvas->width * kitty_canvas->height * sizeof (guint32);
+    }
+
+    success = emit_image_data (term_info, out_str, fd, p, last);
+
+    g_free (compressed);
+    return success;
+}
+
+void
+chafa_kitty_canvas_build_ansi (ChafaKittyCanvas *kitty_canvas, ChafaTermInfo *term_info, GString *out_str,
+                               gint width_cells, gint height_cells, gint compression_level,
+                               gboolean shm_enabled)
+{
+    build_ansi_internal (kitty_canvas, term_info, out_str, -1,
+                         width_cells, height_cells, compression_level, shm_enabled);
+}
+
+/* Like chafa_kitty_canvas_build_ansi (), but flushes the output to fd in
+ * bounded chunks as it's encoded. Returns FALSE on write error. */
+gboolean
+chafa_kitty_canvas_build_ansi_fd (ChafaKittyCanvas *kitty_canvas, ChafaTermInfo *term_info, gint fd,
+                                  gint width_cells, gint height_cells, gint compression_level,
+                                  gboolean shm_enabled)
+{
+    GString *scratch = g_string_new ("");
+    gboolean success;
+
+    success = build_ansi_internal (kitty_canvas, term_info, scratch, fd,
+                                   width_cells, height_cells, compression_level, shm_enabled);
+    if (success)
+        success = chafa_fd_flush_gstring (fd, scratch);
+
+    g_string_free (scratch, TRUE);
+    return success;
 }
@@ -28,6 +28,10 @@ typedef struct
 {
     gint width, height;
     gpointer rgba_image;
+
+    /* Optional frame-delta state; see chafa_kitty_canvas_set_frame_delta () */
+    gconstpointer prev_image;
+    guint32 image_id;
 }
 ChafaKittyCanvas;
 
@@ -37,8 +41,14 @@ void chafa_kitty_canvas_destroy (ChafaKittyCanvas *kitty_canvas);
 void chafa_kitty_canvas_draw_all_pixels (ChafaKittyCanvas *kitty_canvas, ChafaPixelType src_pixel_type,
                                          gconstpointer src_pixels,
                                          gint src_width, gint src_height, gint src_rowstride);
+void chafa_kitty_canvas_set_frame_delta (ChafaKittyCanvas *kitty_canvas,
+                                         gconstpointer prev_image, guint32 image_id);
 void chafa_kitty_canvas_build_ansi (ChafaKittyCanvas *kitty_canvas, ChafaTermInfo *term_info, GString *out_str,
-                                    gint width_cells, gint height_cells);
+                                    gint width_cells, gint height_cells, gint compression_level,
+                                    gboolean shm_enabled);
+gboolean chafa_kitty_canvas_build_ansi_fd (ChafaKittyCanvas *kitty_canvas, ChafaTermInfo *term_info, gint fd,
+                                           gint width_cells, gint height_cells, gint compression_level,
+                                           gboolean shm_enabled);
 
 G_END_DECLS
 
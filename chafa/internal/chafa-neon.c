@@ -0,0 +1,177 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2021 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that turns images into character art.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "config.h"
+
+#include <arm_neon.h>
+#include "chafa.h"
+#include "internal/chafa-private.h"
+
+/* ARM NEON ports of the x86 kernels in chafa-mmx.c, chafa-sse41.c and
+ * chafa-popcnt.c. NEON is baseline on AArch64, so these are used
+ * unconditionally when built in. */
+
+void
+calc_colors_neon (const ChafaPixel *pixels, ChafaColorAccum *accums_out, const guint8 *cov)
+{
+    const guint32 *u32p0 = (const guint32 *) pixels;
+    int16x4_t accum [2] = { vdup_n_s16 (0), vdup_n_s16 (0) };
+    gint i;
+
+    for (i = 0; i < CHAFA_SYMBOL_N_PIXELS; i++)
+    {
+        uint8x8_t p8 = vreinterpret_u8_u32 (vdup_n_u32 (u32p0 [i]));
+        int16x4_t p16 = vreinterpret_s16_u16 (vget_low_u16 (vmovl_u8 (p8)));
+
+        accum [cov [i]] = vadd_s16 (accum [cov [i]], p16);
+    }
+
+    vst1_s16 ((gint16 *) &accums_out [0], accum [0]);
+    vst1_s16 ((gint16 *) &accums_out [1], accum [1]);
+}
+
+gint
+calc_error_neon (const ChafaPixel *pixels, const ChafaColorPair *color_pair, const guint8 *cov)
+{
+    const guint32 *u32p0 = (const guint32 *) pixels;
+    const guint32 *u32p1 = (const guint32 *) color_pair->colors;
+    const uint8x8_t alpha_mask = vreinterpret_u8_u32 (vdup_n_u32 (0x00ffffff));
+    uint32x4_t err4 = vdupq_n_u32 (0);
+    uint64x2_t err2;
+    gint i;
+
+    /* Two pixels at a time: absolute channel differences fit in u8, their
+     * squares in u16, and the running sum in four u32 lanes. Alpha is
+     * masked off, like in calc_error_sse41(). */
+
+    for (i = 0; i < CHAFA_SYMBOL_N_PIXELS; i += 2)
+    {
+        uint32x2_t pp, cc;
+        uint8x8_t d;
+
+        pp = vld1_u32 (u32p0 + i);
+        cc = vset_lane_u32 (u32p1 [cov [i + 1]], vdup_n_u32 (u32p1 [cov [i]]), 1);
+
+        d = vabd_u8 (vreinterpret_u8_u32 (pp), vreinterpret_u8_u32 (cc));
+        d = vand_u8 (d, alpha_mask);
+
+        err4 = vpadalq_u16 (err4, vmull_u8 (d, d));
+    }
+
+    err2 = vpaddlq_u32 (err4);
+    return (gint) (vgetq_lane_u64 (err2, 0) + vgetq_lane_u64 (err2, 1));
+}
+
+static inline gint
+pop_count_u64_neon (guint64 v)
+{
+    uint8x8_t c = vcnt_u8 (vreinterpret_u8_u64 (vdup_n_u64 (v)));
+
+    return (gint) vget_lane_u64 (vpaddl_u32 (vpaddl_u16 (vpaddl_u8 (c))), 0);
+}
+
+gint
+chafa_pop_count_u64_neon (guint64 v)
+{
+    return pop_count_u64_neon (v);
+}
+
+void
+chafa_pop_count_vu64_neon (const guint64 *vv, gint *vc, gint n)
+{
+    while (n--)
+        *(vc++) = pop_count_u64_neon (*(vv++));
+}
+
+void
+chafa_hamming_distance_vu64_neon (guint64 a, const guint64 *vb, gint *vc, gint n)
+{
+    while (n--)
+        *(vc++) = pop_count_u64_neon (a ^ *(vb++));
+}
+
+/* Two bitmaps per item (a points to a pair, vb points to array of pairs) */
+void
+chafa_hamming_distance_2_vu64_neon (const guint64 *a, const guint64 *vb, gint *vc, gint n)
+{
+    uint8x16_t a16 = vreinterpretq_u8_u64 (vld1q_u64 (a));
+
+    while (n--)
+    {
+        uint8x16_t b16 = vreinterpretq_u8_u64 (vld1q_u64 (vb));
+        uint8x16_t c = vcnt_u8 (veorq_u8 (a16, b16));
+        uint64x2_t s = vpaddlq_u32 (vpaddlq_u16 (vpaddlq_u8 (c)));
+
+        *(vc++) = (gint) (vgetq_lane_u64 (s, 0) + vgetq_lane_u64 (s, 1));
+        vb += 2;
+    }
+}
+
+/* --- Base64 --- */
+
+/* Map 6-bit indices to base64 code points by adding a per-range offset
+ * built up from compares */
+static inline uint8x8_t
+base64_translate_neon (uint8x8_t in)
+{
+    uint8x8_t off = vdup_n_u8 (65);                                            /* 'A' */
+
+    off = vadd_u8 (off, vand_u8 (vcgt_u8 (in, vdup_n_u8 (25)), vdup_n_u8 (6)));    /* 'a' - 26 */
+    off = vsub_u8 (off, vand_u8 (vcgt_u8 (in, vdup_n_u8 (51)), vdup_n_u8 (75)));   /* '0' - 52 */
+    off = vsub_u8 (off, vand_u8 (vcgt_u8 (in, vdup_n_u8 (61)), vdup_n_u8 (15)));   /* '+' - 62 */
+    off = vadd_u8 (off, vand_u8 (vceq_u8 (in, vdup_n_u8 (63)), vdup_n_u8 (3)));    /* '/' - 63 */
+
+    return vadd_u8 (in, off);
+}
+
+/* Encode complete 3-byte groups, 24 bytes per iteration. The deinterleaving
+ * load puts the n'th byte of every group in the same register, making the
+ * bit splits plain shifts. Returns the number of input bytes consumed; the
+ * caller handles the remainder. */
+gint
+chafa_base64_encode_neon (guint8 *out, const guint8 *in, gint in_len)
+{
+    gint consumed = 0;
+
+    while (in_len - consumed >= 24)
+    {
+        uint8x8x3_t d = vld3_u8 (in);
+        uint8x8x4_t r;
+
+        r.val [0] = vshr_n_u8 (d.val [0], 2);
+        r.val [1] = vorr_u8 (vshl_n_u8 (vand_u8 (d.val [0], vdup_n_u8 (0x03)), 4),
+                             vshr_n_u8 (d.val [1], 4));
+        r.val [2] = vorr_u8 (vshl_n_u8 (vand_u8 (d.val [1], vdup_n_u8 (0x0f)), 2),
+                             vshr_n_u8 (d.val [2], 6));
+        r.val [3] = vand_u8 (d.val [2], vdup_n_u8 (0x3f));
+
+        r.val [0] = base64_translate_neon (r.val [0]);
+        r.val [1] = base64_translate_neon (r.val [1]);
+        r.val [2] = base64_translate_neon (r.val [2]);
+        r.val [3] = base64_translate_neon (r.val [3]);
+
+        vst4_u8 (out, r);
+
+        in += 24;
+        out += 32;
+        consumed += 24;
+    }
+
+    return consumed;
+}
@@ -370,12 +370,21 @@ extract_samples (gconstpointer pixels, gpointer pixels_out, gint n_pixels, gint
 
     step = MAX (step, 1);
 
-    for (i = 0; i < n_pixels; i += step)
+    if (alpha_threshold <= 0)
     {
-        gint alpha = p [i] >> 24;
-        if (alpha < alpha_threshold)
-            continue;
-        *(p_out++) = p [i];
+        /* Opaque fast path: every sample is kept, no per-pixel alpha test */
+        for (i = 0; i < n_pixels; i += step)
+            *(p_out++) = p [i];
+    }
+    else
+    {
+        for (i = 0; i < n_pixels; i += step)
+        {
+            gint alpha = p [i] >> 24;
+            if (alpha < alpha_threshold)
+                continue;
+            *(p_out++) = p [i];
+        }
     }
 
     return ((ptrdiff_t) p_out - (ptrdiff_t) pixels_out) / 4;
@@ -392,6 +401,13 @@ extract_samples_dense (gconstpointer pixels, gpointer pixels_out, gint n_pixels,
 
     g_assert (n_samples_max > 0);
 
+    if (alpha_threshold <= 0)
+    {
+        n_samples = MIN (n_pixels, n_samples_max);
+        memcpy (p_out, p, n_samples * sizeof (guint32));
+        return n_samples;
+    }
+
     for (i = 0; i < n_pixels; i++)
     {
         gint alpha = p [i] >> 24;
@@ -518,6 +534,41 @@ chafa_palette_init (ChafaPalette *palette_out, ChafaPaletteType type)
         for (i = 0; i < CHAFA_COLOR_SPACE_MAX; i++)
             chafa_color_table_init (&palette_out->table [i]);
     }
+
+    palette_out->have_histogram = FALSE;
+}
+
+/* Sets up a palette with caller-supplied colors, e.g. from an already
+ * quantized image. colors_rgba8 holds four bytes per entry in RGBA order.
+ * transparent_index can be -1 for none.
+ *
+ * The nearest-color tables are left unpopulated; a palette set up this way
+ * supports direct indexed drawing, but not lookups. */
+void
+chafa_palette_init_with_colors (ChafaPalette *palette_out,
+                                const guint8 *colors_rgba8, gint n_colors,
+                                gint transparent_index)
+{
+    gint i;
+
+    chafa_palette_init (palette_out, CHAFA_PALETTE_TYPE_DYNAMIC_256);
+
+    for (i = 0; i < n_colors; i++)
+    {
+        ChafaColor col;
+
+        col.ch [0] = colors_rgba8 [i * 4];
+        col.ch [1] = colors_rgba8 [i * 4 + 1];
+        col.ch [2] = colors_rgba8 [i * 4 + 2];
+        col.ch [3] = colors_rgba8 [i * 4 + 3];
+
+        chafa_palette_set_color (palette_out, i, &col);
+    }
+
+    palette_out->first_color = 0;
+    palette_out->n_colors = n_colors;
+    palette_out->transparent_index = transparent_index >= 0
+        ? transparent_index : CHAFA_PALETTE_INDEX_TRANSPARENT;
 }
 
 void
@@ -550,35 +601,97 @@ chafa_palette_copy (const ChafaPalette *src, ChafaPalette *dest)
     memcpy (dest, src, sizeof (*dest));
 }
 
+static void
+calc_histogram (const guint32 *samples, gint n_samples, guint16 *bins_out)
+{
+    gint i;
+
+    memset (bins_out, 0, CHAFA_PALETTE_N_HISTOGRAM_BINS * sizeof (guint16));
+
+    for (i = 0; i < n_samples; i++)
+    {
+        guint32 p = samples [i];
+        gint bin = ((p & 0x000000e0) >> 5)
+          | ((p & 0x0000e000) >> 10)
+          | ((p & 0x00e00000) >> 15);
+
+        bins_out [bin]++;
+    }
+}
+
+/* Returns TRUE if the sampled color distributions are similar enough that
+ * a palette generated from one can be reused for the other */
+static gboolean
+histograms_match (const guint16 *bins_a, gint n_samples_a,
+                  const guint16 *bins_b, gint n_samples_b)
+{
+    gint sad = 0;
+    gint i;
+
+    for (i = 0; i < CHAFA_PALETTE_N_HISTOGRAM_BINS; i++)
+        sad += ABS ((gint) bins_a [i] - (gint) bins_b [i]);
+
+    /* Regenerate when more than 1/4 of the samples moved to a different bin */
+    return sad * 4 < MAX (n_samples_a, n_samples_b);
+}
+
 /* pixels must point to RGBA8888 data to sample */
 void
 chafa_palette_generate (ChafaPalette *palette_out, gconstpointer pixels, gint n_pixels,
                         ChafaColorSpace color_space)
 {
+    guint16 histogram [CHAFA_PALETTE_N_HISTOGRAM_BINS];
     guint32 *pixels_copy;
+    gint alpha_threshold;
     gint step;
     gint copy_n_pixels;
 
     if (palette_out->type != CHAFA_PALETTE_TYPE_DYNAMIC_256)
         return;
 
+    /* With no transparent pen reserved there's nothing for translucent
+     * pixels to map to, so sample them like any other color and skip the
+     * per-pixel alpha tests */
+    alpha_threshold = palette_out->transparent_index < 256
+        ? palette_out->alpha_threshold : 0;
+
     pixels_copy = g_malloc (N_SAMPLES * sizeof (guint32));
 
     step = (n_pixels / N_SAMPLES) + 1;
     copy_n_pixels = extract_samples (pixels, pixels_copy, n_pixels, step,
-                                     palette_out->alpha_threshold);
+                                     alpha_threshold);
 
     /* If we recovered very few (potentially zero) samples, it could be due to
      * the image being mostly transparent. Resample at full density if so. */
     if (copy_n_pixels < 256 && step != 1)
         copy_n_pixels = extract_samples_dense (pixels, pixels_copy, n_pixels, N_SAMPLES,
-                                               palette_out->alpha_threshold);
+                                               alpha_threshold);
 
     DEBUG (g_printerr ("Extracted %d samples.\n", copy_n_pixels));
 
     if (copy_n_pixels < 1)
     {
         palette_out->n_colors = 0;
+        palette_out->have_histogram = FALSE;
+        goto out;
+    }
+
+    /* A palette carried over from the previous animation frame can be kept
+     * as long as the input's color distribution hasn't drifted appreciably;
+     * consecutive video frames are typically near-identical, and generation
+     * dominates the per-frame quantization cost. The comparison is always
+     * against the distribution the palette was generated from, so gradual
+     * drift accumulates until it triggers regeneration. */
+    calc_histogram (pixels_copy, copy_n_pixels, histogram);
+
+    if (palette_out->have_histogram
+        && palette_out->generated_color_space == color_space
+        && palette_out->generated_have_transparency
+           == (palette_out->transparent_index < 256 ? (guint) 1 : (guint) 0)
+        && histograms_match (palette_out->histogram, palette_out->histogram_n_samples,
+                             histogram, copy_n_pixels))
+    {
+        DEBUG (g_printerr ("Reusing previous palette.\n"));
         goto out;
     }
 
@@ -598,6 +711,13 @@ chafa_palette_generate (ChafaPalette *palette_out, gconstpointer pixels, gint n_
         gen_table (palette_out, CHAFA_COLOR_SPACE_DIN99D);
     }
 
+    memcpy (palette_out->histogram, histogram, sizeof (histogram));
+    palette_out->histogram_n_samples = copy_n_pixels;
+    palette_out->generated_color_space = color_space;
+    palette_out->generated_have_transparency =
+        palette_out->transparent_index < 256 ? TRUE : FALSE;
+    palette_out->have_histogram = TRUE;
+
 out:
     g_free (pixels_copy);
 }
@@ -37,6 +37,9 @@ typedef enum
 }
 ChafaPaletteType;
 
+/* Coarse sample histogram: 3 bits per channel, 512 bins */
+#define CHAFA_PALETTE_N_HISTOGRAM_BINS 512
+
 typedef struct
 {
     ChafaPaletteType type;
@@ -46,10 +49,22 @@ typedef struct
     gint n_colors;
     gint alpha_threshold;
     gint transparent_index;
+
+    /* Sample histogram captured when the palette was generated. Used to
+     * detect when a palette carried over from the previous animation frame
+     * has drifted too far from the current input and must be regenerated. */
+    guint16 histogram [CHAFA_PALETTE_N_HISTOGRAM_BINS];
+    gint histogram_n_samples;
+    ChafaColorSpace generated_color_space;
+    guint generated_have_transparency : 1;
+    guint have_histogram : 1;
 }
 ChafaPalette;
 
 void chafa_palette_init (ChafaPalette *palette_out, ChafaPaletteType type);
+void chafa_palette_init_with_colors (ChafaPalette *palette_out,
+                                     const guint8 *colors_rgba8, gint n_colors,
+                                     gint transparent_index);
 void chafa_palette_deinit (ChafaPalette *palette);
 
 void chafa_palette_copy (const ChafaPalette *src, ChafaPalette *dest);
@@ -19,18 +19,55 @@
 
 #include "config.h"
 
+#include "chafa.h"
 #include "internal/chafa-pca.h"
+#include "internal/chafa-private.h"
 
 #define PCA_POWER_MAX_ITERATIONS 1000
 #define PCA_POWER_MIN_ERROR 0.0001
 
+/* Accumulate the symmetric Gram matrix G = sum (v_i v_i^T) over the array.
+ * Since s = sum (v_i (v_i . r)) equals G r, building G once turns each
+ * power iteration into a 3x3 mat-vec instead of a pass over all vectors. */
+static void
+compute_gram (const ChafaVec3f32 *vecs, gint n_vecs, ChafaVec3f32 gram_out [3])
+{
+    gfloat s [6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+#ifdef HAVE_AVX2_INTRINSICS
+    if (chafa_have_avx2 ())
+    {
+        chafa_vec3f32_gram_avx2 ((const gfloat *) vecs, n_vecs, s);
+    }
+    else
+#endif
+    {
+        gint i;
+
+        for (i = 0; i < n_vecs; i++)
+        {
+            const ChafaVec3f32 *v = &vecs [i];
+
+            s [0] += v->v [0] * v->v [0];
+            s [1] += v->v [0] * v->v [1];
+            s [2] += v->v [0] * v->v [2];
+            s [3] += v->v [1] * v->v [1];
+            s [4] += v->v [1] * v->v [2];
+            s [5] += v->v [2] * v->v [2];
+        }
+    }
+
+    chafa_vec3f32_set (&gram_out [0], s [0], s [1], s [2]);
+    chafa_vec3f32_set (&gram_out [1], s [1], s [3], s [4]);
+    chafa_vec3f32_set (&gram_out [2], s [2], s [4], s [5]);
+}
+
 static gfloat
-pca_converge (const ChafaVec3f32 *vecs_in, gint n_vecs,
-              ChafaVec3f32 *eigenvector_out)
+pca_converge (const ChafaVec3f32 gram [3], ChafaVec3f32 *eigenvector_out)
 {
     ChafaVec3f32 r = CHAFA_VEC3F32_INIT (.11, .23, .51);
     gfloat eigenvalue;
-    gint i, j;
+    gint j;
 
     /* Power iteration */
 
@@ -41,18 +78,14 @@ pca_converge (const ChafaVec3f32 *vecs_in, gint n_vecs,
 
     for (j = 0; j < PCA_POWER_MAX_ITERATIONS; j++)
     {
-        ChafaVec3f32 s = CHAFA_VEC3F32_INIT_ZERO;
+        ChafaVec3f32 s;
         ChafaVec3f32 t;
         gfloat err;
 
-        for (i = 0; i < n_vecs; i++)
-        {
-            gfloat u;
-
-            u = chafa_vec3f32_dot (&vecs_in [i], &r);
-            chafa_vec3f32_mul_scalar (&t, &vecs_in [i], u);
-            chafa_vec3f32_add (&s, &s, &t);
-        }
+        chafa_vec3f32_set (&s,
+                           chafa_vec3f32_dot (&gram [0], &r),
+                           chafa_vec3f32_dot (&gram [1], &r),
+                           chafa_vec3f32_dot (&gram [2], &r));
 
         eigenvalue = chafa_vec3f32_dot (&r, &s);
 
@@ -100,9 +133,9 @@ pca_deflate (ChafaVec3f32 *vecs, gint n_vecs, const ChafaVec3f32 *eigenvector)
  * @eigenvalues_out: Pointer to array to store n_components eigenvalues in, or NULL
  * @average_out: Pointer to a vector to store array average (for centering), or NULL
  *
- * Compute principal components from an array of 3D vectors. This
- * implementation is naive and probably not that fast, but it should
- * be good enough for our purposes.
+ * Compute principal components from an array of 3D vectors. Each component
+ * costs one pass over the array to build the Gram matrix; the power
+ * iteration itself runs on the 3x3 matrix and converges in constant time.
  **/
 void
 chafa_vec3f32_array_compute_pca (const ChafaVec3f32 *vecs_in, gint n_vecs,
@@ -113,6 +146,7 @@ chafa_vec3f32_array_compute_pca (const ChafaVec3f32 *vecs_in, gint n_vecs,
 {
     ChafaVec3f32 *v;
     ChafaVec3f32 average;
+    ChafaVec3f32 gram [3];
     ChafaVec3f32 t;
     gfloat eigenvalue;
     gint i;
@@ -134,7 +168,8 @@ chafa_vec3f32_array_compute_pca (const ChafaVec3f32 *vecs_in, gint n_vecs,
 
     for (i = 0; ; )
     {
-        eigenvalue = pca_converge (v, n_vecs, &t);
+        compute_gram (v, n_vecs, gram);
+        eigenvalue = pca_converge (gram, &t);
 
         if (eigenvectors_out)
         {
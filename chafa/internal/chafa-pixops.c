@@ -45,7 +45,9 @@ typedef struct
 }
 Histogram;
 
-typedef struct
+typedef struct ChafaPrepareContext PrepareContext;
+
+struct ChafaPrepareContext
 {
     ChafaPixelType src_pixel_type;
     gconstpointer src_pixels;
@@ -55,9 +57,14 @@ typedef struct
     ChafaPixel *dest_pixels;
     gint dest_width, dest_height;
 
+    /* Destination row range; covers the full image unless we're
+     * preparing a strip */
+    gint dest_first_row, dest_n_rows;
+
     const ChafaPalette *palette;
     const ChafaDither *dither;
     ChafaColorSpace color_space;
+    gboolean colorspace_fused;
     gboolean preprocessing_enabled;
     gint work_factor_int;
 
@@ -73,8 +80,8 @@ typedef struct
     gint n_rows_per_batch_pixels;
 
     SmolScaleCtx *scale_ctx;
-}
-PrepareContext;
+    guint owns_scale_ctx : 1;
+};
 
 typedef struct
 {
@@ -295,10 +302,45 @@ convert_rgb_to_din99d (ChafaPixel *pixels, gint width, gint dest_y, gint n_rows)
 
     for ( ; pixel < pixel_max; pixel++)
     {
-        chafa_color_rgb_to_din99d (&pixel->col, &pixel->col);
+        chafa_color_rgb_to_din99d_fast (&pixel->col, &pixel->col);
     }
 }
 
+/* Post-row hook for the scaler; converts rows to DIN99d while they are
+ * still cache-hot, so the second pass doesn't have to re-walk the image */
+static void
+convert_row_to_din99d (guint32 *row_inout, int width, G_GNUC_UNUSED void *user_data)
+{
+    ChafaColor *col = (ChafaColor *) row_inout;
+    ChafaColor *col_max = col + width;
+
+    for ( ; col < col_max; col++)
+    {
+        chafa_color_rgb_to_din99d_fast (col, col);
+    }
+}
+
+/* The colorspace conversion can be folded into the scaler's row output only
+ * if no whole-image RGB-space operation has to run in between. Normalization
+ * needs the global histogram, alpha compositing needs the detection result
+ * from the first pass, and ordered dithering happens in RGB space. Diffusion
+ * is fine; it runs after conversion anyway. */
+static gboolean
+can_fuse_colorspace (PrepareContext *prep_ctx)
+{
+    if (prep_ctx->color_space != CHAFA_COLOR_SPACE_DIN99D)
+        return FALSE;
+    if (prep_ctx->preprocessing_enabled)
+        return FALSE;
+    if (prep_ctx->dither->mode == CHAFA_DITHER_MODE_ORDERED)
+        return FALSE;
+    if (prep_ctx->src_pixel_type != CHAFA_PIXEL_RGB8
+        && prep_ctx->src_pixel_type != CHAFA_PIXEL_BGR8)
+        return FALSE;
+
+    return TRUE;
+}
+
 static void
 bayer_dither (const ChafaDither *dither, ChafaPixel *pixels, gint width, gint dest_y, gint n_rows)
 {
@@ -430,7 +472,7 @@ bayer_and_convert_rgb_to_din99d (const ChafaDither *dither,
         for (x = 0; x < width; x++)
         {
             pixel->col = chafa_dither_color_ordered (dither, pixel->col, x, y);
-            chafa_color_rgb_to_din99d (&pixel->col, &pixel->col);
+            chafa_color_rgb_to_din99d_fast (&pixel->col, &pixel->col);
             pixel++;
         }
     }
@@ -571,14 +613,15 @@ prepare_pixels_pass_1 (PrepareContext *prep_ctx)
                                      FALSE,
                                      NULL);
 
-    for (cy = 0, i = 0;
-         cy < prep_ctx->dest_height;
+    for (cy = prep_ctx->dest_first_row, i = 0;
+         cy < prep_ctx->dest_first_row + prep_ctx->dest_n_rows;
          cy += prep_ctx->n_rows_per_batch_pixels, i++)
     {
         PreparePixelsBatch1 *batch = &batches [i];
 
         batch->first_row = cy;
-        batch->n_rows = MIN (prep_ctx->dest_height - cy, prep_ctx->n_rows_per_batch_pixels);
+        batch->n_rows = MIN (prep_ctx->dest_first_row + prep_ctx->dest_n_rows - cy,
+                             prep_ctx->n_rows_per_batch_pixels);
 
         g_thread_pool_push (thread_pool, batch, NULL);
     }
@@ -641,7 +684,8 @@ prepare_pixels_2_worker (PreparePixelsBatch2 *work, PrepareContext *prep_ctx)
                                prep_ctx->dest_pixels, prep_ctx->dest_width,
                                work->first_row, work->n_rows);
 
-    if (prep_ctx->color_space == CHAFA_COLOR_SPACE_DIN99D)
+    if (prep_ctx->color_space == CHAFA_COLOR_SPACE_DIN99D
+        && !prep_ctx->colorspace_fused)
     {
         if (prep_ctx->dither->mode == CHAFA_DITHER_MODE_ORDERED)
         {
@@ -696,7 +740,8 @@ need_pass_2 (PrepareContext *prep_ctx)
              || prep_ctx->palette_type == CHAFA_PALETTE_TYPE_FIXED_8
              || prep_ctx->palette_type == CHAFA_PALETTE_TYPE_FIXED_FGBG))
         || prep_ctx->have_alpha_int
-        || prep_ctx->color_space == CHAFA_COLOR_SPACE_DIN99D
+        || (prep_ctx->color_space == CHAFA_COLOR_SPACE_DIN99D
+            && !prep_ctx->colorspace_fused)
         || prep_ctx->dither->mode != CHAFA_DITHER_MODE_NONE)
         return TRUE;
 
@@ -730,14 +775,15 @@ prepare_pixels_pass_2 (PrepareContext *prep_ctx)
                                      FALSE,
                                      NULL);
 
-    for (cy = 0, i = 0;
-         cy < prep_ctx->dest_height;
+    for (cy = prep_ctx->dest_first_row, i = 0;
+         cy < prep_ctx->dest_first_row + prep_ctx->dest_n_rows;
          cy += prep_ctx->n_rows_per_batch_pixels, i++)
     {
         PreparePixelsBatch1 *batch = &batches [i];
 
         batch->first_row = cy;
-        batch->n_rows = MIN (prep_ctx->dest_height - cy, prep_ctx->n_rows_per_batch_pixels);
+        batch->n_rows = MIN (prep_ctx->dest_first_row + prep_ctx->dest_n_rows - cy,
+                             prep_ctx->n_rows_per_batch_pixels);
 
         g_thread_pool_push (thread_pool, batch, NULL);
     }
@@ -748,6 +794,138 @@ prepare_pixels_pass_2 (PrepareContext *prep_ctx)
     g_free (batches);
 }
 
+/* Returns a scaling context for the conversion described by prep_ctx,
+ * reusing the cached one when only the source pointer has changed */
+static SmolScaleCtx *
+scale_cache_ensure_ctx (ChafaScaleCache *scale_cache, const PrepareContext *prep_ctx)
+{
+    if (scale_cache->scale_ctx
+        && scale_cache->src_pixel_type == prep_ctx->src_pixel_type
+        && scale_cache->src_width == prep_ctx->src_width
+        && scale_cache->src_height == prep_ctx->src_height
+        && scale_cache->src_rowstride == prep_ctx->src_rowstride
+        && scale_cache->dest_width == prep_ctx->dest_width
+        && scale_cache->dest_height == prep_ctx->dest_height
+        && scale_cache->fused_din99d == (guint) prep_ctx->colorspace_fused)
+    {
+        smol_scale_set_pixels_in (scale_cache->scale_ctx,
+                                  (const guint32 *) prep_ctx->src_pixels);
+        return scale_cache->scale_ctx;
+    }
+
+    if (scale_cache->scale_ctx)
+        smol_scale_destroy (scale_cache->scale_ctx);
+
+    scale_cache->scale_ctx = smol_scale_new_full ((SmolPixelType) prep_ctx->src_pixel_type,
+                                                  (const guint32 *) prep_ctx->src_pixels,
+                                                  prep_ctx->src_width,
+                                                  prep_ctx->src_height,
+                                                  prep_ctx->src_rowstride,
+                                                  SMOL_PIXEL_RGBA8_PREMULTIPLIED,
+                                                  NULL,
+                                                  prep_ctx->dest_width,
+                                                  prep_ctx->dest_height,
+                                                  prep_ctx->dest_width * sizeof (guint32),
+                                                  prep_ctx->colorspace_fused ? convert_row_to_din99d : NULL,
+                                                  NULL,
+                                                  SMOL_ALPHA_AUTO);
+    scale_cache->src_pixel_type = prep_ctx->src_pixel_type;
+    scale_cache->src_width = prep_ctx->src_width;
+    scale_cache->src_height = prep_ctx->src_height;
+    scale_cache->src_rowstride = prep_ctx->src_rowstride;
+    scale_cache->dest_width = prep_ctx->dest_width;
+    scale_cache->dest_height = prep_ctx->dest_height;
+    scale_cache->fused_din99d = prep_ctx->colorspace_fused;
+
+    return scale_cache->scale_ctx;
+}
+
+void
+chafa_scale_cache_deinit (ChafaScaleCache *scale_cache)
+{
+    if (scale_cache->scale_ctx)
+        smol_scale_destroy (scale_cache->scale_ctx);
+    scale_cache->scale_ctx = NULL;
+}
+
+static void
+prepare_ctx_init (PrepareContext *prep_ctx,
+                  const ChafaPalette *palette,
+                  const ChafaDither *dither,
+                  ChafaColorSpace color_space,
+                  gboolean preprocessing_enabled,
+                  gint work_factor,
+                  ChafaPixelType src_pixel_type,
+                  gconstpointer src_pixels,
+                  gint src_width,
+                  gint src_height,
+                  gint src_rowstride,
+                  ChafaPixel *dest_pixels,
+                  gint dest_width,
+                  gint dest_height,
+                  gint dest_first_row,
+                  gint dest_n_rows,
+                  ChafaScaleCache *scale_cache)
+{
+    guint n_cpus;
+
+    n_cpus = g_get_num_processors ();
+
+    prep_ctx->palette = palette;
+    prep_ctx->dither = dither;
+    prep_ctx->color_space = color_space;
+    prep_ctx->preprocessing_enabled = preprocessing_enabled;
+    prep_ctx->work_factor_int = work_factor;
+
+    prep_ctx->palette_type = chafa_palette_get_type (palette);
+    prep_ctx->bg_color_rgb = *chafa_palette_get_color (palette,
+                                                       CHAFA_COLOR_SPACE_RGB,
+                                                       CHAFA_PALETTE_INDEX_BG);
+
+    prep_ctx->src_pixel_type = src_pixel_type;
+    prep_ctx->src_pixels = src_pixels;
+    prep_ctx->src_width = src_width;
+    prep_ctx->src_height = src_height;
+    prep_ctx->src_rowstride = src_rowstride;
+
+    /* Bias the base pointer so the batch workers can keep indexing with
+     * absolute row numbers; only rows [dest_first_row..dest_first_row
+     * +dest_n_rows) are ever dereferenced. */
+    prep_ctx->dest_pixels = dest_pixels - (gsize) dest_first_row * dest_width;
+    prep_ctx->dest_width = dest_width;
+    prep_ctx->dest_height = dest_height;
+    prep_ctx->dest_first_row = dest_first_row;
+    prep_ctx->dest_n_rows = dest_n_rows;
+
+    prep_ctx->n_batches_pixels = (prep_ctx->dest_n_rows + n_cpus - 1) / n_cpus;
+    prep_ctx->n_rows_per_batch_pixels = (prep_ctx->dest_n_rows + prep_ctx->n_batches_pixels - 1) / prep_ctx->n_batches_pixels;
+
+    prep_ctx->colorspace_fused = can_fuse_colorspace (prep_ctx);
+
+    if (scale_cache)
+    {
+        prep_ctx->scale_ctx = scale_cache_ensure_ctx (scale_cache, prep_ctx);
+        prep_ctx->owns_scale_ctx = FALSE;
+    }
+    else
+    {
+        prep_ctx->scale_ctx = smol_scale_new_full ((SmolPixelType) prep_ctx->src_pixel_type,
+                                                   (const guint32 *) prep_ctx->src_pixels,
+                                                   prep_ctx->src_width,
+                                                   prep_ctx->src_height,
+                                                   prep_ctx->src_rowstride,
+                                                   SMOL_PIXEL_RGBA8_PREMULTIPLIED,
+                                                   NULL,
+                                                   prep_ctx->dest_width,
+                                                   prep_ctx->dest_height,
+                                                   prep_ctx->dest_width * sizeof (guint32),
+                                                   prep_ctx->colorspace_fused ? convert_row_to_din99d : NULL,
+                                                   NULL,
+                                                   SMOL_ALPHA_AUTO);
+        prep_ctx->owns_scale_ctx = TRUE;
+    }
+}
+
 void
 chafa_prepare_pixel_data_for_symbols (const ChafaPalette *palette,
                                       const ChafaDither *dither,
@@ -761,56 +939,158 @@ chafa_prepare_pixel_data_for_symbols (const ChafaPalette *palette,
                                       gint src_rowstride,
                                       ChafaPixel *dest_pixels,
                                       gint dest_width,
-                                      gint dest_height)
+                                      gint dest_height,
+                                      ChafaScaleCache *scale_cache)
 {
-    PrepareContext prep_ctx = { 0 };
-    guint n_cpus;
+    chafa_prepare_pixel_data_for_symbols_rows (palette, dither, color_space,
+                                               preprocessing_enabled,
+                                               work_factor,
+                                               src_pixel_type,
+                                               src_pixels,
+                                               src_width, src_height,
+                                               src_rowstride,
+                                               dest_pixels,
+                                               dest_width, dest_height,
+                                               0, dest_height,
+                                               scale_cache);
+}
 
-    n_cpus = g_get_num_processors ();
+/* Like chafa_prepare_pixel_data_for_symbols(), but only materializes the
+ * destination rows [dest_first_row..dest_first_row+dest_n_rows). @dest_pixels
+ * points at the first row of the strip and needs to hold just dest_n_rows
+ * rows. The source is still scaled relative to the full destination
+ * geometry, so consecutive strips join up seamlessly.
+ *
+ * Alpha detection and preprocessing normalization are computed per strip,
+ * so strip output can deviate slightly from a whole-image conversion when
+ * preprocessing is enabled. */
+void
+chafa_prepare_pixel_data_for_symbols_rows (const ChafaPalette *palette,
+                                           const ChafaDither *dither,
+                                           ChafaColorSpace color_space,
+                                           gboolean preprocessing_enabled,
+                                           gint work_factor,
+                                           ChafaPixelType src_pixel_type,
+                                           gconstpointer src_pixels,
+                                           gint src_width,
+                                           gint src_height,
+                                           gint src_rowstride,
+                                           ChafaPixel *dest_pixels,
+                                           gint dest_width,
+                                           gint dest_height,
+                                           gint dest_first_row,
+                                           gint dest_n_rows,
+                                           ChafaScaleCache *scale_cache)
+{
+    PrepareContext prep_ctx = { 0 };
 
-    prep_ctx.palette = palette;
-    prep_ctx.dither = dither;
-    prep_ctx.color_space = color_space;
-    prep_ctx.preprocessing_enabled = preprocessing_enabled;
-    prep_ctx.work_factor_int = work_factor;
-
-    prep_ctx.palette_type = chafa_palette_get_type (palette);
-    prep_ctx.bg_color_rgb = *chafa_palette_get_color (palette,
-                                                      CHAFA_COLOR_SPACE_RGB,
-                                                      CHAFA_PALETTE_INDEX_BG);
-
-    prep_ctx.src_pixel_type = src_pixel_type;
-    prep_ctx.src_pixels = src_pixels;
-    prep_ctx.src_width = src_width;
-    prep_ctx.src_height = src_height;
-    prep_ctx.src_rowstride = src_rowstride;
-
-    prep_ctx.dest_pixels = dest_pixels;
-    prep_ctx.dest_width = dest_width;
-    prep_ctx.dest_height = dest_height;
-
-    prep_ctx.n_batches_pixels = (prep_ctx.dest_height + n_cpus - 1) / n_cpus;
-    prep_ctx.n_rows_per_batch_pixels = (prep_ctx.dest_height + prep_ctx.n_batches_pixels - 1) / prep_ctx.n_batches_pixels;
-
-    prep_ctx.scale_ctx = smol_scale_new ((SmolPixelType) prep_ctx.src_pixel_type,
-                                         (const guint32 *) prep_ctx.src_pixels,
-                                         prep_ctx.src_width,
-                                         prep_ctx.src_height,
-                                         prep_ctx.src_rowstride,
-                                         SMOL_PIXEL_RGBA8_PREMULTIPLIED,
-                                         NULL,
-                                         prep_ctx.dest_width,
-                                         prep_ctx.dest_height,
-                                         prep_ctx.dest_width * sizeof (guint32));
+    prepare_ctx_init (&prep_ctx, palette, dither, color_space,
+                      preprocessing_enabled, work_factor,
+                      src_pixel_type, src_pixels,
+                      src_width, src_height, src_rowstride,
+                      dest_pixels, dest_width, dest_height,
+                      dest_first_row, dest_n_rows,
+                      scale_cache);
 
     prepare_pixels_pass_1 (&prep_ctx);
     prepare_pixels_pass_2 (&prep_ctx);
 
-    smol_scale_destroy (prep_ctx.scale_ctx);
+    if (prep_ctx.owns_scale_ctx)
+        smol_scale_destroy (prep_ctx.scale_ctx);
+}
+
+gboolean
+chafa_prepare_pixel_data_can_fuse (const ChafaPalette *palette,
+                                   gboolean preprocessing_enabled)
+{
+    ChafaPaletteType palette_type = chafa_palette_get_type (palette);
+
+    /* Normalization needs an intensity histogram of the whole frame, which
+     * only exists once every band has finished its first pass. Everything
+     * else in the second pass is band-local: alpha compositing only
+     * modifies translucent pixels, and dithering and color space
+     * conversion work row by row. */
+    if (preprocessing_enabled
+        && (palette_type == CHAFA_PALETTE_TYPE_FIXED_16
+            || palette_type == CHAFA_PALETTE_TYPE_FIXED_8
+            || palette_type == CHAFA_PALETTE_TYPE_FIXED_FGBG))
+        return FALSE;
+
+    return TRUE;
+}
+
+ChafaPrepareContext *
+chafa_prepare_pixel_data_begin (const ChafaPalette *palette,
+                                const ChafaDither *dither,
+                                ChafaColorSpace color_space,
+                                gboolean preprocessing_enabled,
+                                gint work_factor,
+                                ChafaPixelType src_pixel_type,
+                                gconstpointer src_pixels,
+                                gint src_width,
+                                gint src_height,
+                                gint src_rowstride,
+                                ChafaPixel *dest_pixels,
+                                gint dest_width,
+                                gint dest_height,
+                                ChafaScaleCache *scale_cache)
+{
+    PrepareContext *prep_ctx;
+
+    g_return_val_if_fail (chafa_prepare_pixel_data_can_fuse (palette, preprocessing_enabled),
+                          NULL);
+
+    prep_ctx = g_new0 (PrepareContext, 1);
+    prepare_ctx_init (prep_ctx, palette, dither, color_space,
+                      preprocessing_enabled, work_factor,
+                      src_pixel_type, src_pixels,
+                      src_width, src_height, src_rowstride,
+                      dest_pixels, dest_width, dest_height,
+                      0, dest_height,
+                      scale_cache);
+
+    return prep_ctx;
+}
+
+void
+chafa_prepare_pixel_data_band (ChafaPrepareContext *prep_ctx,
+                               gint dest_first_row, gint dest_n_rows)
+{
+    PreparePixelsBatch1 batch = { 0 };
+
+    batch.first_row = dest_first_row;
+    batch.n_rows = dest_n_rows;
+
+    if (prep_ctx->work_factor_int < 3
+        && prep_ctx->src_pixel_type == CHAFA_PIXEL_RGBA8_UNASSOCIATED)
+        prepare_pixels_1_worker_nearest (&batch, prep_ctx);
+    else
+        prepare_pixels_1_worker_smooth (&batch, prep_ctx);
+
+    /* Concurrent bands may be flipping have_alpha_int while we consult it
+     * here; that's fine. Our own band's detection result is always visible
+     * at this point, and compositing a band that turned out to be opaque
+     * is a no-op. */
+    if (need_pass_2 (prep_ctx))
+    {
+        PreparePixelsBatch2 batch2;
+
+        batch2.first_row = dest_first_row;
+        batch2.n_rows = dest_n_rows;
+        prepare_pixels_2_worker (&batch2, prep_ctx);
+    }
+}
+
+void
+chafa_prepare_pixel_data_end (ChafaPrepareContext *prep_ctx)
+{
+    if (prep_ctx->owns_scale_ctx)
+        smol_scale_destroy (prep_ctx->scale_ctx);
+    g_free (prep_ctx);
 }
 
 void
-chafa_sort_pixel_index_by_channel (guint8 *index, const ChafaPixel *pixels, gint n_pixels, gint ch)
+chafa_sort_pixel_index_by_channel (guint8 *index, const guint8 *values, gint n_pixels)
 {
     const gint gaps [] = { 57, 23, 10, 4, 1 };
     gint g, i, j;
@@ -833,8 +1113,8 @@ chafa_sort_pixel_index_by_channel (guint8 *index, const ChafaPixel *pixels, gint
         {
             guint8 ptemp = index [i];
 
-            for (j = i; j >= gap && pixels [index [j - gap]].col.ch [ch]
-                                  > pixels [ptemp].col.ch [ch]; j -= gap)
+            for (j = i; j >= gap && values [index [j - gap]]
+                                  > values [ptemp]; j -= gap)
             {
                 index [j] = index [j - gap];
             }
@@ -25,6 +25,22 @@
 
 G_BEGIN_DECLS
 
+/* Caches a scaling context across conversions. Animation frames typically
+ * share pixel type and geometry, in which case the context's precalculated
+ * sampling parameters can be reused with just the source pointer rebound.
+ * Zero-initialize to set up; contents are private. */
+typedef struct
+{
+    gpointer scale_ctx;  /* SmolScaleCtx */
+    ChafaPixelType src_pixel_type;
+    gint src_width, src_height, src_rowstride;
+    gint dest_width, dest_height;
+    guint fused_din99d : 1;
+}
+ChafaScaleCache;
+
+void chafa_scale_cache_deinit (ChafaScaleCache *scale_cache);
+
 void chafa_prepare_pixel_data_for_symbols (const ChafaPalette *palette,
                                            const ChafaDither *dither,
                                            ChafaColorSpace color_space,
@@ -37,11 +53,58 @@ void chafa_prepare_pixel_data_for_symbols (const ChafaPalette *palette,
                                            gint src_rowstride,
                                            ChafaPixel *dest_pixels,
                                            gint dest_width,
-                                           gint dest_height);
+                                           gint dest_height,
+                                           ChafaScaleCache *scale_cache);
+
+/* Incremental variant for fusing preparation with cell evaluation. A
+ * context is set up once on the calling thread, after which any number of
+ * worker threads may each prepare disjoint row bands concurrently via
+ * chafa_prepare_pixel_data_band(). Only legal when
+ * chafa_prepare_pixel_data_can_fuse() returns TRUE; per-band output then
+ * matches a whole-image conversion batched at the same band boundaries
+ * (error-diffusion dithering is band-limited either way). */
+typedef struct ChafaPrepareContext ChafaPrepareContext;
+
+gboolean chafa_prepare_pixel_data_can_fuse (const ChafaPalette *palette,
+                                            gboolean preprocessing_enabled);
+
+ChafaPrepareContext *chafa_prepare_pixel_data_begin (const ChafaPalette *palette,
+                                                     const ChafaDither *dither,
+                                                     ChafaColorSpace color_space,
+                                                     gboolean preprocessing_enabled,
+                                                     gint work_factor,
+                                                     ChafaPixelType src_pixel_type,
+                                                     gconstpointer src_pixels,
+                                                     gint src_width,
+                                                     gint src_height,
+                                                     gint src_rowstride,
+                                                     ChafaPixel *dest_pixels,
+                                                     gint dest_width,
+                                                     gint dest_height,
+                                                     ChafaScaleCache *scale_cache);
+void chafa_prepare_pixel_data_band (ChafaPrepareContext *prep_ctx,
+                                    gint dest_first_row, gint dest_n_rows);
+void chafa_prepare_pixel_data_end (ChafaPrepareContext *prep_ctx);
+
+void chafa_prepare_pixel_data_for_symbols_rows (const ChafaPalette *palette,
+                                                const ChafaDither *dither,
+                                                ChafaColorSpace color_space,
+                                                gboolean preprocessing_enabled,
+                                                gint work_factor,
+                                                ChafaPixelType src_pixel_type,
+                                                gconstpointer src_pixels,
+                                                gint src_width,
+                                                gint src_height,
+                                                gint src_rowstride,
+                                                ChafaPixel *dest_pixels,
+                                                gint dest_width,
+                                                gint dest_height,
+                                                gint dest_first_row,
+                                                gint dest_n_rows,
+                                                ChafaScaleCache *scale_cache);
 
 void chafa_sort_pixel_index_by_channel (guint8 *index,
-                                        const ChafaPixel *pixels, gint n_pixels,
-                                        gint ch);
+                                        const guint8 *values, gint n_pixels);
 
 G_END_DECLS
 
@@ -32,6 +32,25 @@
 
 G_BEGIN_DECLS
 
+/* Preformatted SGR strings for the 256-color indexed modes. Built lazily
+ * by chafa-term-info.c; used by the symbol printer so attribute changes
+ * become a simple memcpy. fgbg covers the common fg == bg case only. */
+
+typedef struct
+{
+    guint8 fg_len [256];
+    guint8 bg_len [256];
+    guint8 fgbg_len [256];
+    gchar fg_str [256] [CHAFA_TERM_SEQ_LENGTH_MAX];
+    gchar bg_str [256] [CHAFA_TERM_SEQ_LENGTH_MAX];
+    gchar fgbg_str [256] [CHAFA_TERM_SEQ_LENGTH_MAX];
+}
+ChafaTermColor256Cache;
+
+const ChafaTermColor256Cache *chafa_term_info_get_color256_cache (ChafaTermInfo *term_info);
+
+gint chafa_term_info_get_seq_length_max (const ChafaTermInfo *term_info, ChafaTermSeq seq);
+
 /* Character symbols and symbol classes */
 
 #define CHAFA_N_SYMBOLS_MAX 1024  /* For static temp arrays */
@@ -66,12 +85,23 @@ struct ChafaSymbolMap
     GHashTable *glyphs2;  /* Wide glyphs with left/right bitmaps */
     GArray *selectors;
 
-    /* Remaining fields are populated by chafa_symbol_map_prepare () */
+    /* Number of leading selectors already reflected in the prepared arrays,
+     * or -1 if they can't be patched incrementally (glyph set changed,
+     * selector list was reset, or no prepare has happened yet) */
+    gint n_selectors_prepared;
+
+    /* Remaining fields are populated by chafa_symbol_map_prepare (). The
+     * symbol arrays can be shared between maps copied from the same source;
+     * prepared_refs counts the maps holding them, and the last one frees. */
+
+    gint *prepared_refs;
 
     /* Narrow symbols */
     ChafaSymbol *symbols;
     gint n_symbols;
     guint64 *packed_bitmaps;
+    guint16 *coarse_bitmaps;  /* 16-bit downsampled signatures, for pre-filtering */
+    gint16 fill_index [CHAFA_SYMBOL_N_PIXELS + 1];  /* popcount -> closest-popcount symbol */
 
     /* Wide symbols */
     ChafaSymbol2 *symbols2;
@@ -112,7 +142,11 @@ struct ChafaCanvasConfig
     ChafaSymbolMap fill_symbol_map;
     guint preprocessing_enabled : 1;
     guint fg_only_enabled : 1;
+    guint frame_deltas_enabled : 1;  /* Repeated draws emit partial updates */
+    guint kitty_shm_enabled : 1;  /* Kitty pixel data may go via POSIX shm */
+    guint source_retention_enabled : 1;  /* Keep a copy of the last source image */
     ChafaOptimizations optimizations;
+    gint compression_level;  /* 0 = none, 1-9 = increasing effort */
 };
 
 /* Canvas */
@@ -131,6 +165,8 @@ ChafaSymbolTags chafa_get_tags_for_char (gunichar c);
 void chafa_init (void);
 gboolean chafa_have_mmx (void) G_GNUC_PURE;
 gboolean chafa_have_sse41 (void) G_GNUC_PURE;
+gboolean chafa_have_avx2 (void) G_GNUC_PURE;
+gboolean chafa_have_neon (void) G_GNUC_PURE;
 gboolean chafa_have_popcnt (void) G_GNUC_PURE;
 
 void chafa_symbol_map_init (ChafaSymbolMap *symbol_map);
@@ -165,6 +201,33 @@ void chafa_canvas_config_copy_contents (ChafaCanvasConfig *dest, const ChafaCanv
 
 gint *chafa_gen_bayer_matrix (gint matrix_size, gdouble magnitude);
 
+/* Heap accounting; tracks the library's big pixel/cell buffers so
+ * chafa_get_heap_stats() can report them */
+
+void chafa_heap_stats_add (gsize size);
+void chafa_heap_stats_remove (gsize size);
+
+/* Allocator for large working buffers: cache-line aligned, and hinted
+ * for transparent huge pages past 2 MB where the platform supports it.
+ * The memory must be released with chafa_free_large (). */
+
+gpointer chafa_alloc_large (gsize size);
+void chafa_free_large (gpointer mem);
+
+/* Streaming output helpers for chafa_canvas_print_to_fd() and friends.
+ * Serializers streaming to a file descriptor flush their scratch string
+ * whenever it grows past CHAFA_FD_FLUSH_THRESHOLD. */
+
+#define CHAFA_FD_FLUSH_THRESHOLD 16384
+
+gboolean chafa_fd_write_all (gint fd, gconstpointer data, gsize len);
+gboolean chafa_fd_flush_gstring (gint fd, GString *gs);
+
+/* ChafaBufferPool */
+
+gpointer chafa_buffer_pool_acquire (ChafaBufferPool *pool, gsize size);
+void chafa_buffer_pool_release (ChafaBufferPool *pool, gpointer data, gsize size);
+
 /* Math stuff */
 
 #ifdef HAVE_MMX_INTRINSICS
@@ -176,6 +239,34 @@ void chafa_leave_mmx (void);
 
 #ifdef HAVE_SSE41_INTRINSICS
 gint calc_error_sse41 (const ChafaPixel *pixels, const ChafaColorPair *color_pair, const guint8 *cov) G_GNUC_PURE;
+gint chafa_base64_encode_sse41 (guint8 *out, const guint8 *in, gint in_len);
+#endif
+
+#ifdef HAVE_AVX2_INTRINSICS
+void calc_colors_avx2 (const ChafaPixel *pixels, ChafaColorAccum *accums_out, const guint8 *cov);
+gint calc_error_avx2 (const ChafaPixel *pixels, const ChafaColorPair *color_pair, const guint8 *cov) G_GNUC_PURE;
+void calc_error_2_avx2 (const ChafaPixel *pixels_a, const ChafaPixel *pixels_b,
+                        const ChafaColorPair *color_pair,
+                        const guint8 *cov_a, const guint8 *cov_b,
+                        gint *error_a_out, gint *error_b_out);
+void chafa_hamming_distance_vu64_avx2 (guint64 a, const guint64 *vb, gint *vc, gint n);
+void chafa_hamming_distance_2_vu64_avx2 (const guint64 *a, const guint64 *vb, gint *vc, gint n);
+gint chafa_base64_encode_avx2 (guint8 *out, const guint8 *in, gint in_len);
+gboolean chafa_color_table_scan_8_avx2 (const gint *v0s,
+                                        const gint *chr, const gint *chg, const gint *chb,
+                                        gint ofs, gint tv0, gint tr, gint tg, gint tb,
+                                        gint *best_entry_inout, gint *best_diff_inout);
+void chafa_vec3f32_gram_avx2 (const gfloat *v, gint n_vecs, gfloat *sums_out);
+#endif
+
+#ifdef HAVE_NEON_INTRINSICS
+void calc_colors_neon (const ChafaPixel *pixels, ChafaColorAccum *accums_out, const guint8 *cov);
+gint calc_error_neon (const ChafaPixel *pixels, const ChafaColorPair *color_pair, const guint8 *cov) G_GNUC_PURE;
+gint chafa_pop_count_u64_neon (guint64 v) G_GNUC_PURE;
+void chafa_pop_count_vu64_neon (const guint64 *vv, gint *vc, gint n);
+void chafa_hamming_distance_vu64_neon (guint64 a, const guint64 *vb, gint *vc, gint n);
+void chafa_hamming_distance_2_vu64_neon (const guint64 *a, const guint64 *vb, gint *vc, gint n);
+gint chafa_base64_encode_neon (guint8 *out, const guint8 *in, gint in_len);
 #endif
 
 #if defined(HAVE_POPCNT64_INTRINSICS) || defined(HAVE_POPCNT32_INTRINSICS)
@@ -217,6 +308,10 @@ chafa_population_count_u64 (guint64 v)
     if (chafa_have_popcnt ())
         return chafa_pop_count_u64_builtin (v);
 #endif
+#ifdef HAVE_NEON_INTRINSICS
+    if (chafa_have_neon ())
+        return chafa_pop_count_u64_neon (v);
+#endif
 
     return chafa_slow_pop_count (v);
 }
@@ -231,6 +326,13 @@ chafa_population_count_vu64 (const guint64 *vv, gint *vc, gint n)
         return;
     }
 #endif
+#ifdef HAVE_NEON_INTRINSICS
+    if (chafa_have_neon ())
+    {
+        chafa_pop_count_vu64_neon (vv, vc, n);
+        return;
+    }
+#endif
 
     while (n--)
         *(vc++) = chafa_slow_pop_count (*(vv++));
@@ -239,6 +341,13 @@ chafa_population_count_vu64 (const guint64 *vv, gint *vc, gint n)
 static inline void
 chafa_hamming_distance_vu64 (guint64 a, const guint64 *vb, gint *vc, gint n)
 {
+#ifdef HAVE_AVX2_INTRINSICS
+    if (chafa_have_avx2 ())
+    {
+        chafa_hamming_distance_vu64_avx2 (a, vb, vc, n);
+        return;
+    }
+#endif
 #ifdef HAVE_POPCNT_INTRINSICS
     if (chafa_have_popcnt ())
     {
@@ -246,6 +355,13 @@ chafa_hamming_distance_vu64 (guint64 a, const guint64 *vb, gint *vc, gint n)
         return;
     }
 #endif
+#ifdef HAVE_NEON_INTRINSICS
+    if (chafa_have_neon ())
+    {
+        chafa_hamming_distance_vu64_neon (a, vb, vc, n);
+        return;
+    }
+#endif
 
     while (n--)
         *(vc++) = chafa_slow_pop_count (a ^ *(vb++));
@@ -254,6 +370,13 @@ chafa_hamming_distance_vu64 (guint64 a, const guint64 *vb, gint *vc, gint n)
 static inline void
 chafa_hamming_distance_2_vu64 (const guint64 *a, const guint64 *vb, gint *vc, gint n)
 {
+#ifdef HAVE_AVX2_INTRINSICS
+    if (chafa_have_avx2 ())
+    {
+        chafa_hamming_distance_2_vu64_avx2 (a, vb, vc, n);
+        return;
+    }
+#endif
 #ifdef HAVE_POPCNT_INTRINSICS
     if (chafa_have_popcnt ())
     {
@@ -261,6 +384,13 @@ chafa_hamming_distance_2_vu64 (const guint64 *a, const guint64 *vb, gint *vc, gi
         return;
     }
 #endif
+#ifdef HAVE_NEON_INTRINSICS
+    if (chafa_have_neon ())
+    {
+        chafa_hamming_distance_2_vu64_neon (a, vb, vc, n);
+        return;
+    }
+#endif
 
     while (n--)
     {
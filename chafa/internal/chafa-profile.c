@@ -0,0 +1,107 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2021 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that turns images into character art.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "config.h"
+
+#include <stdlib.h>  /* atexit */
+
+#include "internal/chafa-profile.h"
+
+/* Counters are process-wide rather than per-canvas: quantization and
+ * serialization run in modules that have no canvas pointer, and a single
+ * summary at exit is what's wanted when comparing runs anyway. Stage
+ * boundaries are crossed a handful of times per frame, so a mutex around
+ * the accumulators costs nothing measurable. */
+
+static const gchar * const stage_names [CHAFA_PROF_STAGE_MAX] =
+{
+    "prepare",
+    "cells",
+    "quantize",
+    "print"
+};
+
+static GMutex prof_mutex;
+static gint64 prof_total_us [CHAFA_PROF_STAGE_MAX];
+static gint prof_n_samples [CHAFA_PROF_STAGE_MAX];
+
+static void
+dump_summary (void)
+{
+    gint i;
+
+    for (i = 0; i < CHAFA_PROF_STAGE_MAX; i++)
+    {
+        if (prof_n_samples [i] < 1)
+            continue;
+
+        g_printerr ("chafa-profile: stage=%s n=%d total_us=%" G_GINT64_FORMAT
+                    " mean_us=%" G_GINT64_FORMAT "\n",
+                    stage_names [i],
+                    prof_n_samples [i],
+                    prof_total_us [i],
+                    prof_total_us [i] / prof_n_samples [i]);
+    }
+}
+
+static gboolean
+prof_is_enabled (void)
+{
+    static gsize enabled = 0;
+
+    if (g_once_init_enter (&enabled))
+    {
+        gsize e = 1;
+
+        if (g_getenv ("CHAFA_PROFILE"))
+        {
+            e = 2;
+            atexit (dump_summary);
+        }
+
+        g_once_init_leave (&enabled, e);
+    }
+
+    return enabled == 2;
+}
+
+gint64
+chafa_prof_begin (void)
+{
+    if (!prof_is_enabled ())
+        return 0;
+
+    return g_get_monotonic_time ();
+}
+
+void
+chafa_prof_end (ChafaProfStage stage, gint64 t0)
+{
+    gint64 t1;
+
+    if (t0 == 0)
+        return;
+
+    t1 = g_get_monotonic_time ();
+
+    g_mutex_lock (&prof_mutex);
+    prof_total_us [stage] += t1 - t0;
+    prof_n_samples [stage]++;
+    g_mutex_unlock (&prof_mutex);
+}
@@ -0,0 +1,52 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2021 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that turns images into character art.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef __CHAFA_PROFILE_H__
+#define __CHAFA_PROFILE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Lightweight per-stage timing. Disabled unless the CHAFA_PROFILE
+ * environment variable is set; when disabled, chafa_prof_begin() is a
+ * single cached branch and no clock is read. A summary is printed to
+ * stderr at process exit as one 'chafa-profile:' key=value line per
+ * stage. */
+
+typedef enum
+{
+    CHAFA_PROF_STAGE_PREPARE,   /* Scale, convert and dither into working image */
+    CHAFA_PROF_STAGE_CELLS,     /* Symbol and color selection */
+    CHAFA_PROF_STAGE_QUANTIZE,  /* Dynamic palette generation */
+    CHAFA_PROF_STAGE_PRINT,     /* Serialization to control sequences */
+
+    CHAFA_PROF_STAGE_MAX
+}
+ChafaProfStage;
+
+/* Returns a timestamp to pass to chafa_prof_end(), or 0 if profiling
+ * is disabled */
+gint64 chafa_prof_begin (void);
+
+void chafa_prof_end (ChafaProfStage stage, gint64 t0);
+
+G_END_DECLS
+
+#endif /* __CHAFA_PROFILE_H__ */
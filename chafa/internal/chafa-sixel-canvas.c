@@ -24,6 +24,7 @@
 #include "internal/chafa-batch.h"
 #include "internal/chafa-bitfield.h"
 #include "internal/chafa-indexed-image.h"
+#include "internal/chafa-private.h"
 #include "internal/chafa-sixel-canvas.h"
 #include "internal/chafa-string-util.h"
 
@@ -33,6 +34,11 @@ typedef struct
 {
     ChafaSixelCanvas *sixel_canvas;
     GString *out_str;
+
+    /* When fd >= 0, finished batches are written straight to the file
+     * descriptor instead of accumulating in out_str */
+    gint fd;
+    gboolean fd_error;
 }
 BuildSixelsCtx;
 
@@ -47,6 +53,10 @@ typedef struct
 {
     SixelData *data;
     ChafaBitfield filter_bits;
+
+    /* Union of the per-bank filters; used to skip pens that don't occur
+     * anywhere in the row */
+    ChafaBitfield row_pens;
 }
 SixelRow;
 
@@ -71,6 +81,7 @@ chafa_sixel_canvas_new (gint width, gint height,
     sixel_canvas->color_space = color_space;
     sixel_canvas->image = chafa_indexed_image_new (width, round_up_to_multiple_of (height, SIXEL_CELL_HEIGHT),
                                                    palette, dither);
+    sixel_canvas->emitted_registers = NULL;
 
     return sixel_canvas;
 }
@@ -96,6 +107,18 @@ chafa_sixel_canvas_draw_all_pixels (ChafaSixelCanvas *sixel_canvas, ChafaPixelTy
     if (src_width == 0 || src_height == 0)
         return;
 
+    /* An input with no alpha channel can't produce transparent pixels, and
+     * a zero threshold admits every pixel regardless. Releasing the
+     * transparent pen lets palette generation skip its per-pixel alpha tests
+     * and reclaims the pen for an extra color. */
+    if (src_pixel_type == CHAFA_PIXEL_RGB8
+        || src_pixel_type == CHAFA_PIXEL_BGR8
+        || chafa_palette_get_alpha_threshold (&sixel_canvas->image->palette) == 0)
+        chafa_palette_set_transparent_index (&sixel_canvas->image->palette,
+                                             CHAFA_PALETTE_INDEX_TRANSPARENT);
+    else
+        chafa_palette_set_transparent_index (&sixel_canvas->image->palette, 255);
+
     chafa_indexed_image_draw_pixels (sixel_canvas->image,
                                      sixel_canvas->color_space,
                                      src_pixel_type,
@@ -104,6 +127,35 @@ chafa_sixel_canvas_draw_all_pixels (ChafaSixelCanvas *sixel_canvas, ChafaPixelTy
                                      sixel_canvas->width, sixel_canvas->height);
 }
 
+void
+chafa_sixel_canvas_draw_all_indexed_pixels (ChafaSixelCanvas *sixel_canvas,
+                                            const guint8 *src_index_pixels,
+                                            const guint8 *src_palette, gint src_n_colors,
+                                            gint src_transparent_index,
+                                            gint src_width, gint src_height, gint src_rowstride)
+{
+    g_return_if_fail (sixel_canvas != NULL);
+    g_return_if_fail (src_index_pixels != NULL);
+    g_return_if_fail (src_palette != NULL);
+    g_return_if_fail (src_n_colors > 0 && src_n_colors <= 256);
+    g_return_if_fail (src_width >= 0);
+    g_return_if_fail (src_height >= 0);
+
+    if (src_width == 0 || src_height == 0)
+        return;
+
+    /* The source is already quantized; adopt its palette wholesale and
+     * skip the expansion and palette generation passes */
+    chafa_palette_init_with_colors (&sixel_canvas->image->palette,
+                                    src_palette, src_n_colors,
+                                    src_transparent_index);
+
+    chafa_indexed_image_draw_indexed_pixels (sixel_canvas->image,
+                                             src_index_pixels,
+                                             src_width, src_height, src_rowstride,
+                                             sixel_canvas->width, sixel_canvas->height);
+}
+
 #define FILTER_BANK_WIDTH 64
 
 static void
@@ -160,7 +212,12 @@ fetch_sixel_row (SixelRow *srow, const guint8 *pixels, gint width)
 
         (sdata++)->d = d;
     }
-} 
+
+    /* Word-parallel union of the bank filters */
+
+    for (x = 0; x < (width + FILTER_BANK_WIDTH - 1) / FILTER_BANK_WIDTH; x++)
+        chafa_bitfield_or_range (&srow->row_pens, 0, &srow->filter_bits, x * 256, 256);
+}
 
 static gchar
 sixel_data_to_schar (const SixelData *sdata, guint64 expanded_pen)
@@ -242,13 +299,18 @@ format_pen (guint8 pen, gchar *p)
 static gchar *
 build_sixel_row_ansi (const ChafaSixelCanvas *scanvas, const SixelRow *srow, gchar *p, gboolean force_full_width)
 {
-    gint pen = 0;
+    gint n_colors = chafa_palette_get_n_colors (&scanvas->image->palette);
+    gint pen;
     gboolean need_cr = FALSE;
     gboolean need_cr_next = FALSE;
     const SixelData *sdata = srow->data;
     gint width = scanvas->width;
 
-    do
+    /* Iterate over the pens that actually occur in this row */
+
+    for (pen = chafa_bitfield_next_set_bit (&srow->row_pens, 0);
+         pen >= 0 && pen < n_colors;
+         pen = chafa_bitfield_next_set_bit (&srow->row_pens, pen + 1))
     {
         guint64 expanded_pen;
         gboolean need_pen = TRUE;
@@ -360,7 +422,19 @@ build_sixel_row_ansi (const ChafaSixelCanvas *scanvas, const SixelRow *srow, gch
 
         need_cr = need_cr_next;
     }
-    while (++pen < chafa_palette_get_n_colors (&scanvas->image->palette));
+
+    if (force_full_width)
+    {
+        /* Row is entirely transparent, but we still have to draw it at
+         * full width (see above). Use the lowest non-transparent pen. */
+
+        pen = chafa_palette_get_transparent_index (&scanvas->image->palette) == 0 ? 1 : 0;
+        if (pen < n_colors)
+        {
+            p = format_pen (pen, p);
+            p = format_schar_reps ('?', width, p);
+        }
+    }
 
     *(p++) = '-';
     return p;
@@ -377,6 +451,7 @@ build_sixel_row_worker (ChafaBatchInfo *batch, const BuildSixelsCtx *ctx)
     n_sixel_rows = (batch->n_rows + SIXEL_CELL_HEIGHT - 1) / SIXEL_CELL_HEIGHT;
     srow.data = g_alloca (sizeof (SixelData) * ctx->sixel_canvas->width);
     chafa_bitfield_init (&srow.filter_bits, ((ctx->sixel_canvas->width + FILTER_BANK_WIDTH - 1) / FILTER_BANK_WIDTH) * 256);
+    chafa_bitfield_init (&srow.row_pens, 256);
 
     sixel_ansi = p = g_malloc (256 * (ctx->sixel_canvas->width + 5) * n_sixel_rows + 1);
 
@@ -390,21 +465,47 @@ build_sixel_row_worker (ChafaBatchInfo *batch, const BuildSixelsCtx *ctx)
                                   (i == 0) || (i == n_sixel_rows - 1)
                                   ? TRUE : FALSE);
         chafa_bitfield_clear (&srow.filter_bits);
+        chafa_bitfield_clear (&srow.row_pens);
     }
 
     batch->ret_p = sixel_ansi;
     batch->ret_n = p - sixel_ansi;
 
     chafa_bitfield_deinit (&srow.filter_bits);
+    chafa_bitfield_deinit (&srow.row_pens);
 }
 
 static void
 build_sixel_row_post (ChafaBatchInfo *batch, BuildSixelsCtx *ctx)
 {
-    g_string_append_len (ctx->out_str, batch->ret_p, batch->ret_n);
+    if (ctx->fd >= 0)
+    {
+        if (!ctx->fd_error
+            && !chafa_fd_write_all (ctx->fd, batch->ret_p, batch->ret_n))
+            ctx->fd_error = TRUE;
+    }
+    else
+    {
+        g_string_append_len (ctx->out_str, batch->ret_p, batch->ret_n);
+    }
+
     g_free (batch->ret_p);
 }
 
+/* Points sixel_canvas at an array of 256 register values persisting across
+ * frames, recording what each color register was last defined as on the
+ * terminal. Register definitions already in effect are then omitted from
+ * the output. The array must be zeroed before the first frame and is
+ * updated in place; it is owned by the caller. */
+void
+chafa_sixel_canvas_set_emitted_registers (ChafaSixelCanvas *sixel_canvas,
+                                          guint32 *emitted_registers)
+{
+    g_return_if_fail (sixel_canvas != NULL);
+
+    sixel_canvas->emitted_registers = emitted_registers;
+}
+
 static void
 build_sixel_palette (ChafaSixelCanvas *sixel_canvas, GString *out_str)
 {
@@ -418,25 +519,45 @@ build_sixel_palette (ChafaSixelCanvas *sixel_canvas, GString *out_str)
     for (pen = 0; pen < chafa_palette_get_n_colors (&sixel_canvas->image->palette); pen++)
     {
         const ChafaColor *col;
+        guint8 c [3];
+        guint32 packed;
+        gint i;
 
         if (pen == chafa_palette_get_transparent_index (&sixel_canvas->image->palette))
             continue;
 
         col = chafa_palette_get_color (&sixel_canvas->image->palette, CHAFA_COLOR_SPACE_RGB,
                                        first_color + pen);
+
+        /* Sixel color channel range is 0..100 */
+
+        for (i = 0; i < 3; i++)
+            c [i] = (col->ch [i] * 100) / 255;
+
+        /* Skip registers the terminal already has from a previous frame.
+         * The high byte marks the register as defined, so a zeroed array
+         * never matches. */
+
+        packed = c [0] | (c [1] << 8) | (c [2] << 16) | 0x01000000;
+
+        if (sixel_canvas->emitted_registers)
+        {
+            if (sixel_canvas->emitted_registers [pen] == packed)
+                continue;
+            sixel_canvas->emitted_registers [pen] = packed;
+        }
+
         *(p++) = '#';
         p = chafa_format_dec_u8 (p, pen);
         *(p++) = ';';
         *(p++) = '2';  /* Color space: RGB */
         *(p++) = ';';
 
-        /* Sixel color channel range is 0..100 */
-
-        p = chafa_format_dec_u8 (p, (col->ch [0] * 100) / 255);
+        p = chafa_format_dec_u8 (p, c [0]);
         *(p++) = ';';
-        p = chafa_format_dec_u8 (p, (col->ch [1] * 100) / 255);
+        p = chafa_format_dec_u8 (p, c [1]);
         *(p++) = ';';
-        p = chafa_format_dec_u8 (p, (col->ch [2] * 100) / 255);
+        p = chafa_format_dec_u8 (p, c [2]);
     }
 
     g_string_append_len (out_str, str, p - str);
@@ -451,6 +572,8 @@ chafa_sixel_canvas_build_ansi (ChafaSixelCanvas *sixel_canvas, GString *out_str)
 
     ctx.sixel_canvas = sixel_canvas;
     ctx.out_str = out_str;
+    ctx.fd = -1;
+    ctx.fd_error = FALSE;
 
     build_sixel_palette (sixel_canvas, out_str);
 
@@ -461,3 +584,36 @@ chafa_sixel_canvas_build_ansi (ChafaSixelCanvas *sixel_canvas, GString *out_str)
                            g_get_num_processors (),
                            SIXEL_CELL_HEIGHT);
 }
+
+/* Like chafa_sixel_canvas_build_ansi (), but writes each sixel row band
+ * to fd as soon as it's serialized, so only a band or two is in memory
+ * at a time. Returns FALSE on write error. */
+gboolean
+chafa_sixel_canvas_build_ansi_fd (ChafaSixelCanvas *sixel_canvas, gint fd)
+{
+    BuildSixelsCtx ctx;
+    GString *palette_str;
+
+    g_assert (sixel_canvas->image->height % SIXEL_CELL_HEIGHT == 0);
+
+    ctx.sixel_canvas = sixel_canvas;
+    ctx.out_str = NULL;
+    ctx.fd = fd;
+    ctx.fd_error = FALSE;
+
+    palette_str = g_string_new ("");
+    build_sixel_palette (sixel_canvas, palette_str);
+    if (!chafa_fd_write_all (fd, palette_str->str, palette_str->len))
+        ctx.fd_error = TRUE;
+    g_string_free (palette_str, TRUE);
+
+    if (!ctx.fd_error)
+        chafa_process_batches (&ctx,
+                               (GFunc) build_sixel_row_worker,
+                               (GFunc) build_sixel_row_post,
+                               sixel_canvas->image->height,
+                               g_get_num_processors (),
+                               SIXEL_CELL_HEIGHT);
+
+    return !ctx.fd_error;
+}
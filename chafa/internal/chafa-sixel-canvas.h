@@ -29,6 +29,10 @@ typedef struct
     gint width, height;
     ChafaColorSpace color_space;
     ChafaIndexedImage *image;
+
+    /* Optional cross-frame register state; see
+     * chafa_sixel_canvas_set_emitted_registers () */
+    guint32 *emitted_registers;
 }
 ChafaSixelCanvas;
 
@@ -41,7 +45,15 @@ void chafa_sixel_canvas_destroy (ChafaSixelCanvas *sixel_canvas);
 void chafa_sixel_canvas_draw_all_pixels (ChafaSixelCanvas *sixel_canvas, ChafaPixelType src_pixel_type,
                                          gconstpointer src_pixels,
                                          gint src_width, gint src_height, gint src_rowstride);
+void chafa_sixel_canvas_draw_all_indexed_pixels (ChafaSixelCanvas *sixel_canvas,
+                                                 const guint8 *src_index_pixels,
+                                                 const guint8 *src_palette, gint src_n_colors,
+                                                 gint src_transparent_index,
+                                                 gint src_width, gint src_height, gint src_rowstride);
+void chafa_sixel_canvas_set_emitted_registers (ChafaSixelCanvas *sixel_canvas,
+                                               guint32 *emitted_registers);
 void chafa_sixel_canvas_build_ansi (ChafaSixelCanvas *sixel_canvas, GString *out_str);
+gboolean chafa_sixel_canvas_build_ansi_fd (ChafaSixelCanvas *sixel_canvas, gint fd);
 
 G_END_DECLS
 
@@ -46,3 +46,65 @@ calc_error_sse41 (const ChafaPixel *pixels, const ChafaColorPair *color_pair, co
 
     return e [0] + e [1] + e [2];
 }
+
+/* --- Base64 --- */
+
+/* Expand 12 input bytes into 16 6-bit indices. Each 3-byte group is first
+ * shuffled to [b1 b0 b2 b1] so the two multiplies can shift all four
+ * indices into their output bytes at once. */
+static inline __m128i
+base64_split_6bit (__m128i in)
+{
+    const __m128i shuf = _mm_setr_epi8 (1, 0, 2, 1, 4, 3, 5, 4,
+                                        7, 6, 8, 7, 10, 9, 11, 10);
+    __m128i t0, t1, t2, t3;
+
+    in = _mm_shuffle_epi8 (in, shuf);
+
+    t0 = _mm_and_si128 (in, _mm_set1_epi32 (0x0fc0fc00));
+    t1 = _mm_mulhi_epu16 (t0, _mm_set1_epi32 (0x04000040));
+    t2 = _mm_and_si128 (in, _mm_set1_epi32 (0x003f03f0));
+    t3 = _mm_mullo_epi16 (t2, _mm_set1_epi32 (0x01000010));
+
+    return _mm_or_si128 (t1, t3);
+}
+
+/* Map 6-bit indices to base64 code points by adding a per-range offset
+ * picked from a 13-entry table */
+static inline __m128i
+base64_translate (__m128i in)
+{
+    const __m128i lut = _mm_setr_epi8 (65, 71, -4, -4, -4, -4, -4, -4,
+                                       -4, -4, -4, -4, -19, -16, 0, 0);
+    __m128i indices, mask;
+
+    indices = _mm_subs_epu8 (in, _mm_set1_epi8 (51));
+    mask = _mm_cmpgt_epi8 (in, _mm_set1_epi8 (25));
+    indices = _mm_sub_epi8 (indices, mask);
+
+    return _mm_add_epi8 (in, _mm_shuffle_epi8 (lut, indices));
+}
+
+/* Encode complete 3-byte groups, 12 bytes per iteration. Returns the
+ * number of input bytes consumed; the caller handles the remainder.
+ * Each iteration reads 16 bytes, hence the conservative loop bound. */
+gint
+chafa_base64_encode_sse41 (guint8 *out, const guint8 *in, gint in_len)
+{
+    gint consumed = 0;
+
+    while (in_len - consumed >= 16)
+    {
+        __m128i t;
+
+        t = _mm_loadu_si128 ((const __m128i *) in);
+        t = base64_translate (base64_split_6bit (t));
+        _mm_storeu_si128 ((__m128i *) out, t);
+
+        in += 12;
+        out += 16;
+        consumed += 12;
+    }
+
+    return consumed;
+}
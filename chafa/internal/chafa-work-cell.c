@@ -106,10 +106,20 @@ chafa_work_cell_get_mean_colors_for_symbol (const ChafaWorkCell *wcell, const Ch
     const guint8 *covp = (guint8 *) &sym->coverage [0];
     ChafaColorAccum accums [2] = { 0 };
 
+#ifdef HAVE_AVX2_INTRINSICS
+    if (chafa_have_avx2 ())
+        calc_colors_avx2 (wcell->pixels, accums, covp);
+    else
+#endif
 #ifdef HAVE_MMX_INTRINSICS
     if (chafa_have_mmx ())
         calc_colors_mmx (wcell->pixels, accums, covp);
     else
+#endif
+#ifdef HAVE_NEON_INTRINSICS
+    if (chafa_have_neon ())
+        calc_colors_neon (wcell->pixels, accums, covp);
+    else
 #endif
         calc_colors_plain (wcell->pixels, accums, covp);
 
@@ -126,18 +136,19 @@ chafa_work_cell_get_mean_colors_for_symbol (const ChafaWorkCell *wcell, const Ch
 void
 chafa_work_cell_calc_mean_color (const ChafaWorkCell *wcell, ChafaColor *color_out)
 {
-    ChafaColorAccum accum = { 0 };
-    const ChafaPixel *block = wcell->pixels;
-    gint i;
+    gint ch, i;
 
-    for (i = 0; i < CHAFA_SYMBOL_N_PIXELS; i++)
+    /* Plain per-plane reductions; these vectorize cleanly */
+    for (ch = 0; ch < 4; ch++)
     {
-        chafa_color_accum_add (&accum, &block->col);
-        block++;
-    }
+        const guint8 *values = wcell->channels [ch];
+        guint sum = 0;
 
-    chafa_color_accum_div_scalar (&accum, CHAFA_SYMBOL_N_PIXELS);
-    accum_to_color (&accum, color_out);
+        for (i = 0; i < CHAFA_SYMBOL_N_PIXELS; i++)
+            sum += values [i];
+
+        color_out->ch [ch] = sum / CHAFA_SYMBOL_N_PIXELS;
+    }
 }
 
 /* colors must point to an array of two elements */
@@ -185,7 +196,7 @@ work_cell_get_sorted_pixels (ChafaWorkCell *wcell, gint ch)
         return index;
 
     memcpy (index, index_init, CHAFA_SYMBOL_N_PIXELS);
-    chafa_sort_pixel_index_by_channel (index, wcell->pixels, CHAFA_SYMBOL_N_PIXELS, ch);
+    chafa_sort_pixel_index_by_channel (index, wcell->channels [ch], CHAFA_SYMBOL_N_PIXELS);
 
     wcell->have_pixels_sorted_by_channel [ch] = TRUE;
     return index;
@@ -195,46 +206,70 @@ void
 chafa_work_cell_init (ChafaWorkCell *wcell, const ChafaPixel *src_image,
                       gint src_width, gint cx, gint cy)
 {
+    gint i;
+
     memset (wcell->have_pixels_sorted_by_channel, 0,
             sizeof (wcell->have_pixels_sorted_by_channel));
     fetch_canvas_pixel_block (src_image, src_width, wcell->pixels, cx, cy);
     wcell->dominant_channel = -1;
+    wcell->have_contrast_pair = FALSE;
+
+    /* Transpose into per-channel planes */
+    for (i = 0; i < CHAFA_SYMBOL_N_PIXELS; i++)
+    {
+        const guint8 *ch = wcell->pixels [i].col.ch;
+
+        wcell->channels [0] [i] = ch [0];
+        wcell->channels [1] [i] = ch [1];
+        wcell->channels [2] [i] = ch [2];
+        wcell->channels [3] [i] = ch [3];
+    }
 }
 
 static gint
 work_cell_get_dominant_channel (ChafaWorkCell *wcell)
 {
-    const guint8 *sorted_pixels [4];
-    gint best_range;
-    gint best_ch;
-    gint i;
+    gint best_range = -1;
+    gint best_ch = 0;
+    gint ch, i;
 
     if (wcell->dominant_channel >= 0)
         return wcell->dominant_channel;
 
-    for (i = 0; i < 4; i++)
-        sorted_pixels [i] = work_cell_get_sorted_pixels (wcell, i);
-
-    best_range = wcell->pixels [sorted_pixels [0] [CHAFA_SYMBOL_N_PIXELS - 1]].col.ch [0]
-        - wcell->pixels [sorted_pixels [0] [0]].col.ch [0];
-    best_ch = 0;
-
-    for (i = 1; i < 4; i++)
+    /* Only the ranges are needed; direct min/max scans over the channel
+     * planes are much cheaper than sorting */
+    for (ch = 0; ch < 4; ch++)
     {
-        gint range = wcell->pixels [sorted_pixels [i] [CHAFA_SYMBOL_N_PIXELS - 1]].col.ch [i]
-            - wcell->pixels [sorted_pixels [i] [0]].col.ch [i];
+        const guint8 *values = wcell->channels [ch];
+        guint8 min = values [0], max = values [0];
 
-        if (range > best_range)
+        for (i = 1; i < CHAFA_SYMBOL_N_PIXELS; i++)
         {
-            best_range = range;
-            best_ch = i;
+            min = MIN (min, values [i]);
+            max = MAX (max, values [i]);
+        }
+
+        if ((gint) max - (gint) min > best_range)
+        {
+            best_range = max - min;
+            best_ch = ch;
         }
     }
 
     wcell->dominant_channel = best_ch;
+    wcell->dominant_range = best_range;
     return wcell->dominant_channel;
 }
 
+/* Widest per-channel spread (max - min) in the cell; a cheap flatness
+ * metric for routing decisions. Memoized with the dominant channel. */
+gint
+chafa_work_cell_get_range (ChafaWorkCell *wcell)
+{
+    work_cell_get_dominant_channel (wcell);
+    return wcell->dominant_range;
+}
+
 static void
 work_cell_get_dominant_channels_for_symbol (ChafaWorkCell *wcell, const ChafaSymbol *sym,
                                             gint *bg_ch_out, gint *fg_ch_out)
@@ -245,7 +280,6 @@ work_cell_get_dominant_channels_for_symbol (ChafaWorkCell *wcell, const ChafaSym
                            { G_MININT16, G_MININT16, G_MININT16, G_MININT16 } };
     gint16 range [2] [4];
     gint ch, best_ch [2];
-    const guint8 *sorted_pixels [4];
     gint i, j;
 
     if (sym->popcount == 0)
@@ -261,42 +295,21 @@ work_cell_get_dominant_channels_for_symbol (ChafaWorkCell *wcell, const ChafaSym
         return;
     }
 
-    for (i = 0; i < 4; i++)
-        sorted_pixels [i] = work_cell_get_sorted_pixels (wcell, i);
-
-    /* Get minimums */
+    /* Per-pen min/max in one direct pass over the channel planes; this
+     * used to require all four channels sorted */
 
-    for (j = 0; j < 4; j++)
+    for (i = 0; i < CHAFA_SYMBOL_N_PIXELS; i++)
     {
-        gint pen_a = sym->coverage [sorted_pixels [j] [0]];
-        min [pen_a] [j] = wcell->pixels [sorted_pixels [j] [0]].col.ch [j];
+        gint pen = sym->coverage [i];
 
-        for (i = 1; ; i++)
+        for (j = 0; j < 4; j++)
         {
-            gint pen_b = sym->coverage [sorted_pixels [j] [i]];
-            if (pen_b != pen_a)
-            {
-                min [pen_b] [j] = wcell->pixels [sorted_pixels [j] [i]].col.ch [j];
-                break;
-            }
-        }
-    }
-
-    /* Get maximums */
+            gint16 v = wcell->channels [j] [i];
 
-    for (j = 0; j < 4; j++)
-    {
-        gint pen_a = sym->coverage [sorted_pixels [j] [CHAFA_SYMBOL_N_PIXELS - 1]];
-        max [pen_a] [j] = wcell->pixels [sorted_pixels [j] [CHAFA_SYMBOL_N_PIXELS - 1]].col.ch [j];
-
-        for (i = CHAFA_SYMBOL_N_PIXELS - 2; ; i--)
-        {
-            gint pen_b = sym->coverage [sorted_pixels [j] [i]];
-            if (pen_b != pen_a)
-            {
-                max [pen_b] [j] = wcell->pixels [sorted_pixels [j] [i]].col.ch [j];
-                break;
-            }
+            if (v < min [pen] [j])
+                min [pen] [j] = v;
+            if (v > max [pen] [j])
+                max [pen] [j] = v;
         }
     }
 
@@ -322,18 +335,93 @@ work_cell_get_dominant_channels_for_symbol (ChafaWorkCell *wcell, const ChafaSym
     *fg_ch_out = best_ch [1];
 }
 
+/* Hoare-partition quickselect over an index array. Returns the index of
+ * the nth smallest value within [lo..hi], leaving the array partitioned
+ * around it so a subsequent selection can work on a subrange. */
+static guint8
+select_nth_pixel_index (const guint8 *values, guint8 *index, gint lo, gint hi, gint nth)
+{
+    while (lo < hi)
+    {
+        guint8 pivot = values [index [(lo + hi) / 2]];
+        gint i = lo, j = hi;
+
+        while (i <= j)
+        {
+            while (values [index [i]] < pivot)
+                i++;
+            while (values [index [j]] > pivot)
+                j--;
+
+            if (i <= j)
+            {
+                guint8 t = index [i];
+                index [i] = index [j];
+                index [j] = t;
+                i++;
+                j--;
+            }
+        }
+
+        if (nth <= j)
+            hi = j;
+        else if (nth >= i)
+            lo = i;
+        else
+            break;
+    }
+
+    return index [nth];
+}
+
 /* colors_out must point to an array of two elements */
 void
 chafa_work_cell_get_contrasting_color_pair (ChafaWorkCell *wcell, ChafaColorPair *color_pair_out)
 {
-    const guint8 *sorted_pixels;
+    gint ch;
+    gint first, second;
 
-    sorted_pixels = work_cell_get_sorted_pixels (wcell, work_cell_get_dominant_channel (wcell));
+    if (wcell->have_contrast_pair)
+    {
+        *color_pair_out = wcell->contrast_pair;
+        return;
+    }
+
+    ch = work_cell_get_dominant_channel (wcell);
 
     /* Choose two colors by median cut */
 
-    color_pair_out->colors [0] = wcell->pixels [sorted_pixels [CHAFA_SYMBOL_N_PIXELS / 4]].col;
-    color_pair_out->colors [1] = wcell->pixels [sorted_pixels [(CHAFA_SYMBOL_N_PIXELS * 3) / 4]].col;
+    if (wcell->have_pixels_sorted_by_channel [ch])
+    {
+        const guint8 *sorted_pixels = wcell->pixels_sorted_index [ch];
+
+        first = sorted_pixels [CHAFA_SYMBOL_N_PIXELS / 4];
+        second = sorted_pixels [(CHAFA_SYMBOL_N_PIXELS * 3) / 4];
+    }
+    else
+    {
+        /* Only two order statistics are needed, so partial selection
+         * beats a full sort. The upper quartile is selected within the
+         * partition left by the first pass. */
+        const guint8 *values = wcell->channels [ch];
+        guint8 scratch [CHAFA_SYMBOL_N_PIXELS];
+        gint i;
+
+        for (i = 0; i < CHAFA_SYMBOL_N_PIXELS; i++)
+            scratch [i] = i;
+
+        first = select_nth_pixel_index (values, scratch, 0, CHAFA_SYMBOL_N_PIXELS - 1,
+                                        CHAFA_SYMBOL_N_PIXELS / 4);
+        second = select_nth_pixel_index (values, scratch, CHAFA_SYMBOL_N_PIXELS / 4,
+                                         CHAFA_SYMBOL_N_PIXELS - 1,
+                                         (CHAFA_SYMBOL_N_PIXELS * 3) / 4);
+    }
+
+    color_pair_out->colors [0] = wcell->pixels [first].col;
+    color_pair_out->colors [1] = wcell->pixels [second].col;
+
+    wcell->contrast_pair = *color_pair_out;
+    wcell->have_contrast_pair = TRUE;
 }
 
 static const ChafaPixel *
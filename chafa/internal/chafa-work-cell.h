@@ -27,9 +27,21 @@ typedef struct ChafaWorkCell ChafaWorkCell;
 struct ChafaWorkCell
 {
     ChafaPixel pixels [CHAFA_SYMBOL_N_PIXELS];
+
+    /* Planar mirror of pixels, one contiguous array per channel. Filled
+     * on init; cell statistics (mean, range, sorting) walk these instead
+     * of striding through the interleaved pixels. */
+    guint8 channels [4] [CHAFA_SYMBOL_N_PIXELS];
+
     guint8 pixels_sorted_index [4] [CHAFA_SYMBOL_N_PIXELS];
     guint8 have_pixels_sorted_by_channel [4];
     gint dominant_channel;
+    gint dominant_range;
+
+    /* Memoized contrasting pair; the same cell is queried by the narrow
+     * pass and by up to two wide-pair evaluations */
+    ChafaColorPair contrast_pair;
+    guint have_contrast_pair : 1;
 };
 
 /* Currently unused */
@@ -48,6 +60,7 @@ void chafa_work_cell_get_mean_colors_for_symbol (const ChafaWorkCell *wcell, con
 void chafa_work_cell_get_median_colors_for_symbol (ChafaWorkCell *wcell, const ChafaSymbol *sym,
                                                    ChafaColorPair *color_pair_out);
 void chafa_work_cell_get_contrasting_color_pair (ChafaWorkCell *wcell, ChafaColorPair *color_pair_out);
+gint chafa_work_cell_get_range (ChafaWorkCell *wcell);
 void chafa_work_cell_calc_mean_color (const ChafaWorkCell *wcell, ChafaColor *color_out);
 guint64 chafa_work_cell_to_bitmap (const ChafaWorkCell *wcell, const ChafaColorPair *color_pair);
 
@@ -0,0 +1,1044 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright © 2019-2021 Hans Petter Jansson. See COPYING for details. */
+
+#include <assert.h> /* assert */
+#include <stdlib.h> /* malloc, free, alloca */
+#include <stddef.h> /* ptrdiff_t */
+#include <string.h> /* memset */
+#include <limits.h>
+#include <arm_neon.h>
+#include "smolscale-private.h"
+
+/* NEON kernels for the contiguous inner loops. The parts rows use 32-bit
+ * fields at 128bpp, which map directly onto uint32x4 lanes. The 16-bit
+ * fields at 64bpp need widening multiplies for the lerps, so those stay
+ * with the generic code (NULL entries in the table below); the box
+ * filters are overridden for both storage types, since their sums and
+ * weights fit the lanes as-is.
+ *
+ * Like the AVX2 kernels, the lerps here operate on independent 32-bit
+ * lanes, whereas the generic code lets borrows propagate across fields
+ * before masking. The two can differ by one least significant unit when
+ * a lower channel underflows. */
+
+/* --- Linear interpolation helpers --- */
+
+#define LERP_SIMD128_U32(a, b, f)                                       \
+    vaddq_u32 (                                                         \
+    vshrq_n_u32 (                                                       \
+    vmulq_u32 (                                                         \
+    vsubq_u32 ((a), (b)), (f)), 8), (b))
+
+#define LERP_SIMD128_U32_AND_MASK(a, b, f, mask)                        \
+    vandq_u32 (LERP_SIMD128_U32 ((a), (b), (f)), (mask))
+
+/* --- Helpers --- */
+
+static SMOL_INLINE const uint32_t *
+inrow_ofs_to_pointer (const SmolScaleCtx *scale_ctx,
+                      uint32_t inrow_ofs)
+{
+    return scale_ctx->pixels_in + scale_ctx->rowstride_in * inrow_ofs;
+}
+
+static SMOL_INLINE uint64_t
+weight_pixel_64bpp (uint64_t p,
+                    uint16_t w)
+{
+    return ((p * w) >> 8) & 0x00ff00ff00ff00ff;
+}
+
+/* p and out may be the same address */
+static SMOL_INLINE void
+weight_pixel_128bpp (uint64_t *p,
+                     uint64_t *out,
+                     uint16_t w)
+{
+    out [0] = ((p [0] * w) >> 8) & 0x00ffffff00ffffffULL;
+    out [1] = ((p [1] * w) >> 8) & 0x00ffffff00ffffffULL;
+}
+
+static SMOL_INLINE void
+sum_parts_64bpp (const uint64_t ** SMOL_RESTRICT parts_in,
+                 uint64_t * SMOL_RESTRICT accum,
+                 uint32_t n)
+{
+    const uint64_t * SMOL_RESTRICT pp = *parts_in;
+    const uint64_t *pp_end = pp + n;
+    uint64x2_t acc2 = vdupq_n_u64 (0);
+
+    SMOL_ASSUME_ALIGNED_TO (pp, const uint64_t *, sizeof (uint64_t));
+
+    for ( ; pp + 2 <= pp_end; pp += 2)
+    {
+        acc2 = vaddq_u64 (acc2, vld1q_u64 (pp));
+    }
+
+    *accum += vgetq_lane_u64 (acc2, 0) + vgetq_lane_u64 (acc2, 1);
+
+    if (pp != pp_end)
+        *accum += *(pp++);
+
+    *parts_in = pp;
+}
+
+static SMOL_INLINE void
+sum_parts_128bpp (const uint64_t ** SMOL_RESTRICT parts_in,
+                  uint64_t * SMOL_RESTRICT accum,
+                  uint32_t n)
+{
+    const uint64_t * SMOL_RESTRICT pp = *parts_in;
+    const uint64_t *pp_end = pp + n * 2;
+    uint64x2_t acc2;
+
+    SMOL_ASSUME_ALIGNED_TO (pp, const uint64_t *, sizeof (uint64_t) * 2);
+
+    acc2 = vld1q_u64 (accum);
+
+    for ( ; pp < pp_end; pp += 2)
+    {
+        acc2 = vaddq_u64 (acc2, vld1q_u64 (pp));
+    }
+
+    vst1q_u64 (accum, acc2);
+    *parts_in = pp;
+}
+
+static SMOL_INLINE uint64_t
+scale_64bpp (uint64_t accum,
+             uint64_t multiplier)
+{
+    uint64_t a, b;
+
+    /* Average the inputs */
+    a = ((accum & 0x0000ffff0000ffffULL) * multiplier
+         + (SMOL_BOXES_MULTIPLIER / 2) + ((SMOL_BOXES_MULTIPLIER / 2) << 32)) / SMOL_BOXES_MULTIPLIER;
+    b = (((accum & 0xffff0000ffff0000ULL) >> 16) * multiplier
+         + (SMOL_BOXES_MULTIPLIER / 2) + ((SMOL_BOXES_MULTIPLIER / 2) << 32)) / SMOL_BOXES_MULTIPLIER;
+
+    /* Return pixel */
+    return (a & 0x000000ff000000ffULL) | ((b & 0x000000ff000000ffULL) << 16);
+}
+
+static SMOL_INLINE uint64_t
+scale_128bpp_half (uint64_t accum,
+                   uint64_t multiplier)
+{
+    uint64_t a, b;
+
+    a = accum & 0x00000000ffffffffULL;
+    a = (a * multiplier + SMOL_BOXES_MULTIPLIER / 2) / SMOL_BOXES_MULTIPLIER;
+
+    b = (accum & 0xffffffff00000000ULL) >> 32;
+    b = (b * multiplier + SMOL_BOXES_MULTIPLIER / 2) / SMOL_BOXES_MULTIPLIER;
+
+    return (a & 0x000000000000ffffULL)
+           | ((b & 0x000000000000ffffULL) << 32);
+}
+
+static SMOL_INLINE void
+scale_and_store_128bpp (const uint64_t * SMOL_RESTRICT accum,
+                        uint64_t multiplier,
+                        uint64_t ** SMOL_RESTRICT row_parts_out)
+{
+    *(*row_parts_out)++ = scale_128bpp_half (accum [0], multiplier);
+    *(*row_parts_out)++ = scale_128bpp_half (accum [1], multiplier);
+}
+
+static void
+add_parts (const uint64_t * SMOL_RESTRICT parts_in,
+           uint64_t * SMOL_RESTRICT parts_acc_out,
+           uint32_t n)
+{
+    const uint64_t *parts_in_max = parts_in + n;
+
+    SMOL_ASSUME_ALIGNED (parts_in, const uint64_t *);
+    SMOL_ASSUME_ALIGNED (parts_acc_out, uint64_t *);
+
+    while (parts_in + 2 <= parts_in_max)
+    {
+        vst1q_u64 (parts_acc_out,
+                   vaddq_u64 (vld1q_u64 (parts_acc_out),
+                              vld1q_u64 (parts_in)));
+        parts_in += 2;
+        parts_acc_out += 2;
+    }
+
+    while (parts_in < parts_in_max)
+        *(parts_acc_out++) += *(parts_in++);
+}
+
+/* --- Horizontal scaling --- */
+
+#define DEF_INTERP_HORIZONTAL_BILINEAR(n_halvings)                      \
+static void                                                             \
+interp_horizontal_bilinear_##n_halvings##h_128bpp (const SmolScaleCtx *scale_ctx, \
+                                                   const uint64_t * SMOL_RESTRICT row_parts_in, \
+                                                   uint64_t * SMOL_RESTRICT row_parts_out) \
+{                                                                       \
+    const uint16_t * SMOL_RESTRICT ofs_x = scale_ctx->offsets_x;        \
+    uint64_t *row_parts_out_max = row_parts_out + scale_ctx->width_out * 2; \
+    const uint32x4_t mask = vdupq_n_u32 (0x00ffffff);                   \
+    int i;                                                              \
+                                                                        \
+    SMOL_ASSUME_ALIGNED (row_parts_in, const uint64_t *);               \
+    SMOL_ASSUME_ALIGNED (row_parts_out, uint64_t *);                    \
+                                                                        \
+    do                                                                  \
+    {                                                                   \
+        uint32x4_t accum = vdupq_n_u32 (0);                             \
+                                                                        \
+        for (i = 0; i < (1 << (n_halvings)); i++)                       \
+        {                                                               \
+            uint32x4_t p, q, factors;                                   \
+                                                                        \
+            row_parts_in += *(ofs_x++) * 2;                             \
+            factors = vdupq_n_u32 (*(ofs_x++));                         \
+                                                                        \
+            p = vld1q_u32 ((const uint32_t *) row_parts_in);            \
+            q = vld1q_u32 ((const uint32_t *) (row_parts_in + 2));      \
+                                                                        \
+            accum = vaddq_u32 (accum,                                   \
+                               LERP_SIMD128_U32_AND_MASK (p, q, factors, mask)); \
+        }                                                               \
+        vst1q_u32 ((uint32_t *) row_parts_out,                          \
+                   vandq_u32 (vshrq_n_u32 (accum, n_halvings), mask));  \
+        row_parts_out += 2;                                             \
+    }                                                                   \
+    while (row_parts_out != row_parts_out_max);                         \
+}
+
+static void
+interp_horizontal_bilinear_0h_128bpp (const SmolScaleCtx *scale_ctx,
+                                      const uint64_t * SMOL_RESTRICT row_parts_in,
+                                      uint64_t * SMOL_RESTRICT row_parts_out)
+{
+    const uint16_t * SMOL_RESTRICT ofs_x = scale_ctx->offsets_x;
+    uint64_t * SMOL_RESTRICT row_parts_out_max = row_parts_out + scale_ctx->width_out * 2;
+    const uint32x4_t mask = vdupq_n_u32 (0x00ffffff);
+
+    SMOL_ASSUME_ALIGNED (row_parts_in, const uint64_t *);
+    SMOL_ASSUME_ALIGNED (row_parts_out, uint64_t *);
+
+    do
+    {
+        uint32x4_t p, q, factors;
+
+        row_parts_in += *(ofs_x++) * 2;
+        factors = vdupq_n_u32 (*(ofs_x++));
+
+        p = vld1q_u32 ((const uint32_t *) row_parts_in);
+        q = vld1q_u32 ((const uint32_t *) (row_parts_in + 2));
+
+        vst1q_u32 ((uint32_t *) row_parts_out,
+                   LERP_SIMD128_U32_AND_MASK (p, q, factors, mask));
+        row_parts_out += 2;
+    }
+    while (row_parts_out != row_parts_out_max);
+}
+
+DEF_INTERP_HORIZONTAL_BILINEAR(1)
+DEF_INTERP_HORIZONTAL_BILINEAR(2)
+DEF_INTERP_HORIZONTAL_BILINEAR(3)
+DEF_INTERP_HORIZONTAL_BILINEAR(4)
+DEF_INTERP_HORIZONTAL_BILINEAR(5)
+DEF_INTERP_HORIZONTAL_BILINEAR(6)
+
+static void
+interp_horizontal_boxes_64bpp (const SmolScaleCtx *scale_ctx,
+                               const uint64_t *row_parts_in,
+                               uint64_t * SMOL_RESTRICT row_parts_out)
+{
+    const uint64_t * SMOL_RESTRICT pp;
+    const uint16_t *ofs_x = scale_ctx->offsets_x;
+    uint64_t *row_parts_out_max = row_parts_out + scale_ctx->width_out - 1;
+    uint64_t accum = 0;
+    uint64_t p, q, r, s;
+    uint32_t n;
+    uint64_t F;
+
+    SMOL_ASSUME_ALIGNED (row_parts_in, const uint64_t *);
+    SMOL_ASSUME_ALIGNED (row_parts_out, uint64_t *);
+
+    pp = row_parts_in;
+    p = weight_pixel_64bpp (*(pp++), 256);
+    n = *(ofs_x++);
+
+    while (row_parts_out != row_parts_out_max)
+    {
+        sum_parts_64bpp ((const uint64_t ** SMOL_RESTRICT) &pp, &accum, n);
+
+        F = *(ofs_x++);
+        n = *(ofs_x++);
+
+        r = *(pp++);
+        s = r * F;
+
+        q = (s >> 8) & 0x00ff00ff00ff00ffULL;
+
+        accum += p + q;
+
+        /* (255 * r) - (F * r) */
+        p = (((r << 8) - r - s) >> 8) & 0x00ff00ff00ff00ffULL;
+
+        *(row_parts_out++) = scale_64bpp (accum, scale_ctx->span_mul_x);
+        accum = 0;
+    }
+
+    /* Final box optionally features the rightmost fractional pixel */
+
+    sum_parts_64bpp ((const uint64_t ** SMOL_RESTRICT) &pp, &accum, n);
+
+    q = 0;
+    F = *(ofs_x);
+    if (F > 0)
+        q = weight_pixel_64bpp (*(pp), F);
+
+    accum += p + q;
+    *(row_parts_out++) = scale_64bpp (accum, scale_ctx->span_mul_x);
+}
+
+static void
+interp_horizontal_boxes_128bpp (const SmolScaleCtx *scale_ctx,
+                                const uint64_t *row_parts_in,
+                                uint64_t * SMOL_RESTRICT row_parts_out)
+{
+    const uint64_t * SMOL_RESTRICT pp;
+    const uint16_t *ofs_x = scale_ctx->offsets_x;
+    uint64_t *row_parts_out_max = row_parts_out + (scale_ctx->width_out - 1) * 2;
+    uint64_t accum [2] = { 0, 0 };
+    uint64_t p [2], q [2], r [2], s [2];
+    uint32_t n;
+    uint64_t F;
+
+    SMOL_ASSUME_ALIGNED (row_parts_in, const uint64_t *);
+    SMOL_ASSUME_ALIGNED (row_parts_out, uint64_t *);
+
+    pp = row_parts_in;
+
+    p [0] = *(pp++);
+    p [1] = *(pp++);
+    weight_pixel_128bpp (p, p, 256);
+
+    n = *(ofs_x++);
+
+    while (row_parts_out != row_parts_out_max)
+    {
+        sum_parts_128bpp ((const uint64_t ** SMOL_RESTRICT) &pp, accum, n);
+
+        F = *(ofs_x++);
+        n = *(ofs_x++);
+
+        r [0] = *(pp++);
+        r [1] = *(pp++);
+
+        s [0] = r [0] * F;
+        s [1] = r [1] * F;
+
+        q [0] = (s [0] >> 8) & 0x00ffffff00ffffff;
+        q [1] = (s [1] >> 8) & 0x00ffffff00ffffff;
+
+        accum [0] += p [0] + q [0];
+        accum [1] += p [1] + q [1];
+
+        p [0] = (((r [0] << 8) - r [0] - s [0]) >> 8) & 0x00ffffff00ffffff;
+        p [1] = (((r [1] << 8) - r [1] - s [1]) >> 8) & 0x00ffffff00ffffff;
+
+        scale_and_store_128bpp (accum,
+                                scale_ctx->span_mul_x,
+                                (uint64_t ** SMOL_RESTRICT) &row_parts_out);
+
+        accum [0] = 0;
+        accum [1] = 0;
+    }
+
+    /* Final box optionally features the rightmost fractional pixel */
+
+    sum_parts_128bpp ((const uint64_t ** SMOL_RESTRICT) &pp, accum, n);
+
+    q [0] = 0;
+    q [1] = 0;
+
+    F = *(ofs_x);
+    if (F > 0)
+    {
+        q [0] = *(pp++);
+        q [1] = *(pp++);
+        weight_pixel_128bpp (q, q, F);
+    }
+
+    accum [0] += p [0] + q [0];
+    accum [1] += p [1] + q [1];
+
+    scale_and_store_128bpp (accum,
+                            scale_ctx->span_mul_x,
+                            (uint64_t ** SMOL_RESTRICT) &row_parts_out);
+}
+
+static void
+scale_horizontal (const SmolScaleCtx *scale_ctx,
+                  const uint32_t *row_in,
+                  uint64_t *row_parts_out)
+{
+    uint64_t * SMOL_RESTRICT unpacked_in;
+
+    unpacked_in = smol_alloca_aligned (scale_ctx->width_in * sizeof (uint64_t) * 2);
+
+    scale_ctx->unpack_row_func (row_in,
+                                unpacked_in,
+                                scale_ctx->width_in);
+    scale_ctx->hfilter_func (scale_ctx,
+                             unpacked_in,
+                             row_parts_out);
+}
+
+/* --- Vertical scaling --- */
+
+static void
+update_vertical_ctx_bilinear (const SmolScaleCtx *scale_ctx,
+                              SmolVerticalCtx *vertical_ctx,
+                              uint32_t outrow_index)
+{
+    uint32_t new_in_ofs = scale_ctx->offsets_y [outrow_index * 2];
+
+    if (new_in_ofs == vertical_ctx->in_ofs)
+        return;
+
+    if (new_in_ofs == vertical_ctx->in_ofs + 1)
+    {
+        uint64_t *t = vertical_ctx->parts_row [0];
+        vertical_ctx->parts_row [0] = vertical_ctx->parts_row [1];
+        vertical_ctx->parts_row [1] = t;
+
+        scale_horizontal (scale_ctx,
+                          inrow_ofs_to_pointer (scale_ctx, new_in_ofs + 1),
+                          vertical_ctx->parts_row [1]);
+    }
+    else
+    {
+        scale_horizontal (scale_ctx,
+                          inrow_ofs_to_pointer (scale_ctx, new_in_ofs),
+                          vertical_ctx->parts_row [0]);
+        scale_horizontal (scale_ctx,
+                          inrow_ofs_to_pointer (scale_ctx, new_in_ofs + 1),
+                          vertical_ctx->parts_row [1]);
+    }
+
+    vertical_ctx->in_ofs = new_in_ofs;
+}
+
+static void
+interp_vertical_bilinear_store_128bpp (uint64_t F,
+                                       const uint64_t * SMOL_RESTRICT top_row_parts_in,
+                                       const uint64_t * SMOL_RESTRICT bottom_row_parts_in,
+                                       uint64_t * SMOL_RESTRICT parts_out,
+                                       uint32_t width)
+{
+    uint64_t *parts_out_last = parts_out + width;
+    const uint32x4_t mask = vdupq_n_u32 (0x00ffffff);
+    uint32x4_t factors;
+
+    SMOL_ASSUME_ALIGNED (top_row_parts_in, const uint64_t *);
+    SMOL_ASSUME_ALIGNED (bottom_row_parts_in, const uint64_t *);
+    SMOL_ASSUME_ALIGNED (parts_out, uint64_t *);
+
+    factors = vdupq_n_u32 ((uint32_t) F);
+
+    while (parts_out + 4 <= parts_out_last)
+    {
+        uint32x4_t m0, m1, m2, m3;
+
+        m0 = vld1q_u32 ((const uint32_t *) top_row_parts_in);
+        m2 = vld1q_u32 ((const uint32_t *) (top_row_parts_in + 2));
+        top_row_parts_in += 4;
+        m1 = vld1q_u32 ((const uint32_t *) bottom_row_parts_in);
+        m3 = vld1q_u32 ((const uint32_t *) (bottom_row_parts_in + 2));
+        bottom_row_parts_in += 4;
+
+        vst1q_u32 ((uint32_t *) parts_out,
+                   LERP_SIMD128_U32_AND_MASK (m0, m1, factors, mask));
+        vst1q_u32 ((uint32_t *) (parts_out + 2),
+                   LERP_SIMD128_U32_AND_MASK (m2, m3, factors, mask));
+        parts_out += 4;
+    }
+
+    while (parts_out != parts_out_last)
+    {
+        uint64_t p, q;
+
+        p = *(top_row_parts_in++);
+        q = *(bottom_row_parts_in++);
+
+        *(parts_out++) = ((((p - q) * F) >> 8) + q) & 0x00ffffff00ffffffULL;
+    }
+}
+
+static void
+interp_vertical_bilinear_add_128bpp (uint64_t F,
+                                     const uint64_t * SMOL_RESTRICT top_row_parts_in,
+                                     const uint64_t * SMOL_RESTRICT bottom_row_parts_in,
+                                     uint64_t * SMOL_RESTRICT accum_out,
+                                     uint32_t width)
+{
+    uint64_t *accum_out_last = accum_out + width;
+    const uint32x4_t mask = vdupq_n_u32 (0x00ffffff);
+    uint32x4_t factors;
+
+    SMOL_ASSUME_ALIGNED (top_row_parts_in, const uint64_t *);
+    SMOL_ASSUME_ALIGNED (bottom_row_parts_in, const uint64_t *);
+    SMOL_ASSUME_ALIGNED (accum_out, uint64_t *);
+
+    factors = vdupq_n_u32 ((uint32_t) F);
+
+    while (accum_out + 4 <= accum_out_last)
+    {
+        uint32x4_t m0, m1, m2, m3, o0, o1;
+
+        m0 = vld1q_u32 ((const uint32_t *) top_row_parts_in);
+        m2 = vld1q_u32 ((const uint32_t *) (top_row_parts_in + 2));
+        top_row_parts_in += 4;
+        m1 = vld1q_u32 ((const uint32_t *) bottom_row_parts_in);
+        m3 = vld1q_u32 ((const uint32_t *) (bottom_row_parts_in + 2));
+        bottom_row_parts_in += 4;
+        o0 = vld1q_u32 ((const uint32_t *) accum_out);
+        o1 = vld1q_u32 ((const uint32_t *) (accum_out + 2));
+
+        o0 = vaddq_u32 (o0, LERP_SIMD128_U32_AND_MASK (m0, m1, factors, mask));
+        o1 = vaddq_u32 (o1, LERP_SIMD128_U32_AND_MASK (m2, m3, factors, mask));
+
+        vst1q_u32 ((uint32_t *) accum_out, o0);
+        vst1q_u32 ((uint32_t *) (accum_out + 2), o1);
+        accum_out += 4;
+    }
+
+    while (accum_out != accum_out_last)
+    {
+        uint64_t p, q;
+
+        p = *(top_row_parts_in++);
+        q = *(bottom_row_parts_in++);
+
+        *(accum_out++) += ((((p - q) * F) >> 8) + q) & 0x00ffffff00ffffffULL;
+    }
+}
+
+#define DEF_INTERP_VERTICAL_BILINEAR_FINAL(n_halvings)                  \
+static void                                                             \
+interp_vertical_bilinear_final_##n_halvings##h_128bpp (uint64_t F,      \
+                                                       const uint64_t * SMOL_RESTRICT top_row_parts_in, \
+                                                       const uint64_t * SMOL_RESTRICT bottom_row_parts_in, \
+                                                       uint64_t * SMOL_RESTRICT accum_inout, \
+                                                       uint32_t width)  \
+{                                                                       \
+    uint64_t *accum_inout_last = accum_inout + width;                   \
+    const uint32x4_t mask = vdupq_n_u32 (0x00ffffff);                   \
+    uint32x4_t factors;                                                 \
+                                                                        \
+    SMOL_ASSUME_ALIGNED (top_row_parts_in, const uint64_t *);           \
+    SMOL_ASSUME_ALIGNED (bottom_row_parts_in, const uint64_t *);        \
+    SMOL_ASSUME_ALIGNED (accum_inout, uint64_t *);                      \
+                                                                        \
+    factors = vdupq_n_u32 ((uint32_t) F);                               \
+                                                                        \
+    while (accum_inout + 4 <= accum_inout_last)                         \
+    {                                                                   \
+        uint32x4_t m0, m1, m2, m3, o0, o1;                              \
+                                                                        \
+        m0 = vld1q_u32 ((const uint32_t *) top_row_parts_in);           \
+        m2 = vld1q_u32 ((const uint32_t *) (top_row_parts_in + 2));     \
+        top_row_parts_in += 4;                                          \
+        m1 = vld1q_u32 ((const uint32_t *) bottom_row_parts_in);        \
+        m3 = vld1q_u32 ((const uint32_t *) (bottom_row_parts_in + 2));  \
+        bottom_row_parts_in += 4;                                       \
+        o0 = vld1q_u32 ((const uint32_t *) accum_inout);                \
+        o1 = vld1q_u32 ((const uint32_t *) (accum_inout + 2));          \
+                                                                        \
+        o0 = vaddq_u32 (o0, LERP_SIMD128_U32_AND_MASK (m0, m1, factors, mask)); \
+        o1 = vaddq_u32 (o1, LERP_SIMD128_U32_AND_MASK (m2, m3, factors, mask)); \
+        o0 = vandq_u32 (vshrq_n_u32 (o0, n_halvings), mask);            \
+        o1 = vandq_u32 (vshrq_n_u32 (o1, n_halvings), mask);            \
+                                                                        \
+        vst1q_u32 ((uint32_t *) accum_inout, o0);                       \
+        vst1q_u32 ((uint32_t *) (accum_inout + 2), o1);                 \
+        accum_inout += 4;                                               \
+    }                                                                   \
+                                                                        \
+    while (accum_inout != accum_inout_last)                             \
+    {                                                                   \
+        uint64_t p, q;                                                  \
+                                                                        \
+        p = *(top_row_parts_in++);                                      \
+        q = *(bottom_row_parts_in++);                                   \
+                                                                        \
+        p = ((((p - q) * F) >> 8) + q) & 0x00ffffff00ffffffULL;         \
+        p = ((p + *accum_inout) >> n_halvings) & 0x00ffffff00ffffffULL; \
+                                                                        \
+        *(accum_inout++) = p;                                           \
+    }                                                                   \
+}
+
+#define DEF_SCALE_OUTROW_BILINEAR(n_halvings)                           \
+static void                                                             \
+scale_outrow_bilinear_##n_halvings##h_128bpp (const SmolScaleCtx *scale_ctx, \
+                                              SmolVerticalCtx *vertical_ctx, \
+                                              uint32_t outrow_index,    \
+                                              uint32_t *row_out)        \
+{                                                                       \
+    uint32_t bilin_index = outrow_index << (n_halvings);                \
+    unsigned int i;                                                     \
+                                                                        \
+    update_vertical_ctx_bilinear (scale_ctx, vertical_ctx, bilin_index); \
+    interp_vertical_bilinear_store_128bpp (scale_ctx->offsets_y [bilin_index * 2 + 1], \
+                                           vertical_ctx->parts_row [0], \
+                                           vertical_ctx->parts_row [1], \
+                                           vertical_ctx->parts_row [2], \
+                                           scale_ctx->width_out * 2);   \
+    bilin_index++;                                                      \
+                                                                        \
+    for (i = 0; i < (1 << (n_halvings)) - 2; i++)                       \
+    {                                                                   \
+        update_vertical_ctx_bilinear (scale_ctx, vertical_ctx, bilin_index); \
+        interp_vertical_bilinear_add_128bpp (scale_ctx->offsets_y [bilin_index * 2 + 1], \
+                                             vertical_ctx->parts_row [0], \
+                                             vertical_ctx->parts_row [1], \
+                                             vertical_ctx->parts_row [2], \
+                                             scale_ctx->width_out * 2); \
+        bilin_index++;                                                  \
+    }                                                                   \
+                                                                        \
+    update_vertical_ctx_bilinear (scale_ctx, vertical_ctx, bilin_index); \
+    interp_vertical_bilinear_final_##n_halvings##h_128bpp (scale_ctx->offsets_y [bilin_index * 2 + 1], \
+                                                           vertical_ctx->parts_row [0], \
+                                                           vertical_ctx->parts_row [1], \
+                                                           vertical_ctx->parts_row [2], \
+                                                           scale_ctx->width_out * 2); \
+                                                                        \
+    scale_ctx->pack_row_func (vertical_ctx->parts_row [2], row_out, scale_ctx->width_out); \
+}
+
+static void
+scale_outrow_bilinear_0h_128bpp (const SmolScaleCtx *scale_ctx,
+                                 SmolVerticalCtx *vertical_ctx,
+                                 uint32_t outrow_index,
+                                 uint32_t *row_out)
+{
+    update_vertical_ctx_bilinear (scale_ctx, vertical_ctx, outrow_index);
+    interp_vertical_bilinear_store_128bpp (scale_ctx->offsets_y [outrow_index * 2 + 1],
+                                           vertical_ctx->parts_row [0],
+                                           vertical_ctx->parts_row [1],
+                                           vertical_ctx->parts_row [2],
+                                           scale_ctx->width_out * 2);
+    scale_ctx->pack_row_func (vertical_ctx->parts_row [2], row_out, scale_ctx->width_out);
+}
+
+DEF_INTERP_VERTICAL_BILINEAR_FINAL(1)
+
+static void
+scale_outrow_bilinear_1h_128bpp (const SmolScaleCtx *scale_ctx,
+                                 SmolVerticalCtx *vertical_ctx,
+                                 uint32_t outrow_index,
+                                 uint32_t *row_out)
+{
+    uint32_t bilin_index = outrow_index << 1;
+
+    update_vertical_ctx_bilinear (scale_ctx, vertical_ctx, bilin_index);
+    interp_vertical_bilinear_store_128bpp (scale_ctx->offsets_y [bilin_index * 2 + 1],
+                                           vertical_ctx->parts_row [0],
+                                           vertical_ctx->parts_row [1],
+                                           vertical_ctx->parts_row [2],
+                                           scale_ctx->width_out * 2);
+    bilin_index++;
+    update_vertical_ctx_bilinear (scale_ctx, vertical_ctx, bilin_index);
+    interp_vertical_bilinear_final_1h_128bpp (scale_ctx->offsets_y [bilin_index * 2 + 1],
+                                              vertical_ctx->parts_row [0],
+                                              vertical_ctx->parts_row [1],
+                                              vertical_ctx->parts_row [2],
+                                              scale_ctx->width_out * 2);
+    scale_ctx->pack_row_func (vertical_ctx->parts_row [2], row_out, scale_ctx->width_out);
+}
+
+DEF_INTERP_VERTICAL_BILINEAR_FINAL(2)
+DEF_SCALE_OUTROW_BILINEAR(2)
+DEF_INTERP_VERTICAL_BILINEAR_FINAL(3)
+DEF_SCALE_OUTROW_BILINEAR(3)
+DEF_INTERP_VERTICAL_BILINEAR_FINAL(4)
+DEF_SCALE_OUTROW_BILINEAR(4)
+DEF_INTERP_VERTICAL_BILINEAR_FINAL(5)
+DEF_SCALE_OUTROW_BILINEAR(5)
+DEF_INTERP_VERTICAL_BILINEAR_FINAL(6)
+DEF_SCALE_OUTROW_BILINEAR(6)
+
+static void
+finalize_vertical_64bpp (const uint64_t * SMOL_RESTRICT accums,
+                         uint64_t multiplier,
+                         uint64_t * SMOL_RESTRICT parts_out,
+                         uint32_t n)
+{
+    uint64_t *parts_out_max = parts_out + n;
+    const uint32x4_t mask16 = vdupq_n_u32 (0x0000ffff);
+    const uint32x4_t mask8 = vdupq_n_u32 (0x000000ff);
+    const uint32x4_t round = vdupq_n_u32 (SMOL_BOXES_MULTIPLIER / 2);
+    uint32x4_t mul = vdupq_n_u32 ((uint32_t) multiplier);
+
+    SMOL_ASSUME_ALIGNED (accums, const uint64_t *);
+    SMOL_ASSUME_ALIGNED (parts_out, uint64_t *);
+
+    while (parts_out + 2 <= parts_out_max)
+    {
+        uint32x4_t v, a, b;
+
+        v = vld1q_u32 ((const uint32_t *) accums);
+        accums += 2;
+
+        a = vandq_u32 (v, mask16);
+        b = vshrq_n_u32 (v, 16);
+
+        a = vandq_u32 (vshrq_n_u32 (vaddq_u32 (vmulq_u32 (a, mul), round), 24), mask8);
+        b = vandq_u32 (vshrq_n_u32 (vaddq_u32 (vmulq_u32 (b, mul), round), 24), mask8);
+
+        vst1q_u32 ((uint32_t *) parts_out,
+                   vorrq_u32 (a, vshlq_n_u32 (b, 16)));
+        parts_out += 2;
+    }
+
+    while (parts_out != parts_out_max)
+    {
+        *(parts_out++) = scale_64bpp (*(accums++), multiplier);
+    }
+}
+
+static void
+weight_edge_row_64bpp (uint64_t *row,
+                       uint16_t w,
+                       uint32_t n)
+{
+    uint64_t *row_max = row + n;
+    const uint32x4_t mask = vdupq_n_u32 (0x00ff00ff);
+    uint32x4_t w128 = vdupq_n_u32 (w);
+
+    SMOL_ASSUME_ALIGNED (row, uint64_t *);
+
+    while (row + 2 <= row_max)
+    {
+        uint32x4_t v;
+
+        v = vld1q_u32 ((const uint32_t *) row);
+        v = vandq_u32 (vshrq_n_u32 (vmulq_u32 (v, w128), 8), mask);
+        vst1q_u32 ((uint32_t *) row, v);
+        row += 2;
+    }
+
+    while (row != row_max)
+    {
+        *row = ((*row * w) >> 8) & 0x00ff00ff00ff00ffULL;
+        row++;
+    }
+}
+
+static void
+scale_and_weight_edge_rows_box_64bpp (const uint64_t * SMOL_RESTRICT first_row,
+                                      uint64_t * SMOL_RESTRICT last_row,
+                                      uint64_t * SMOL_RESTRICT accum,
+                                      uint16_t w2,
+                                      uint32_t n)
+{
+    const uint64_t *first_row_max = first_row + n;
+
+    SMOL_ASSUME_ALIGNED (first_row, const uint64_t *);
+    SMOL_ASSUME_ALIGNED (last_row, uint64_t *);
+    SMOL_ASSUME_ALIGNED (accum, uint64_t *);
+
+    while (first_row != first_row_max)
+    {
+        uint64_t r, s, p, q;
+
+        p = *(first_row++);
+
+        r = *(last_row);
+        s = r * w2;
+        q = (s >> 8) & 0x00ff00ff00ff00ffULL;
+        /* (255 * r) - (F * r) */
+        *(last_row++) = (((r << 8) - r - s) >> 8) & 0x00ff00ff00ff00ffULL;
+
+        *(accum++) = p + q;
+    }
+}
+
+static void
+update_vertical_ctx_box_64bpp (const SmolScaleCtx *scale_ctx,
+                               SmolVerticalCtx *vertical_ctx,
+                               uint32_t ofs_y,
+                               uint32_t ofs_y_max,
+                               uint16_t w1,
+                               uint16_t w2)
+{
+    /* Old in_ofs is the previous max */
+    if (ofs_y == vertical_ctx->in_ofs)
+    {
+        uint64_t *t = vertical_ctx->parts_row [0];
+        vertical_ctx->parts_row [0] = vertical_ctx->parts_row [1];
+        vertical_ctx->parts_row [1] = t;
+    }
+    else
+    {
+        scale_horizontal (scale_ctx,
+                          inrow_ofs_to_pointer (scale_ctx, ofs_y),
+                          vertical_ctx->parts_row [0]);
+        weight_edge_row_64bpp (vertical_ctx->parts_row [0], w1, scale_ctx->width_out);
+    }
+
+    /* When w2 == 0, the final inrow may be out of bounds. Don't try to access it in
+     * that case. */
+    if (w2 || ofs_y_max < scale_ctx->height_in)
+    {
+        scale_horizontal (scale_ctx,
+                          inrow_ofs_to_pointer (scale_ctx, ofs_y_max),
+                          vertical_ctx->parts_row [1]);
+    }
+    else
+    {
+        memset (vertical_ctx->parts_row [1], 0, scale_ctx->width_out * sizeof (uint64_t));
+    }
+
+    vertical_ctx->in_ofs = ofs_y_max;
+}
+
+static void
+scale_outrow_box_64bpp (const SmolScaleCtx *scale_ctx,
+                        SmolVerticalCtx *vertical_ctx,
+                        uint32_t outrow_index,
+                        uint32_t *row_out)
+{
+    uint32_t ofs_y, ofs_y_max;
+    uint16_t w1, w2;
+
+    /* Get the inrow range for this outrow: [ofs_y .. ofs_y_max> */
+
+    ofs_y = scale_ctx->offsets_y [outrow_index * 2];
+    ofs_y_max = scale_ctx->offsets_y [(outrow_index + 1) * 2];
+
+    /* Scale the first and last rows, weight them and store in accumulator */
+
+    w1 = (outrow_index == 0) ? 256 : 255 - scale_ctx->offsets_y [outrow_index * 2 - 1];
+    w2 = scale_ctx->offsets_y [outrow_index * 2 + 1];
+
+    update_vertical_ctx_box_64bpp (scale_ctx, vertical_ctx, ofs_y, ofs_y_max, w1, w2);
+
+    scale_and_weight_edge_rows_box_64bpp (vertical_ctx->parts_row [0],
+                                          vertical_ctx->parts_row [1],
+                                          vertical_ctx->parts_row [2],
+                                          w2,
+                                          scale_ctx->width_out);
+
+    ofs_y++;
+
+    /* Add up whole rows */
+
+    while (ofs_y < ofs_y_max)
+    {
+        scale_horizontal (scale_ctx,
+                          inrow_ofs_to_pointer (scale_ctx, ofs_y),
+                          vertical_ctx->parts_row [0]);
+        add_parts (vertical_ctx->parts_row [0],
+                   vertical_ctx->parts_row [2],
+                   scale_ctx->width_out);
+
+        ofs_y++;
+    }
+
+    finalize_vertical_64bpp (vertical_ctx->parts_row [2],
+                             scale_ctx->span_mul_y,
+                             vertical_ctx->parts_row [0],
+                             scale_ctx->width_out);
+    scale_ctx->pack_row_func (vertical_ctx->parts_row [0], row_out, scale_ctx->width_out);
+}
+
+static void
+finalize_vertical_128bpp (const uint64_t * SMOL_RESTRICT accums,
+                          uint64_t multiplier,
+                          uint64_t * SMOL_RESTRICT parts_out,
+                          uint32_t n)
+{
+    uint64_t *parts_out_max = parts_out + n * 2;
+    const uint64x2_t mask16 = vdupq_n_u64 (0xffff);
+    const uint64x2_t round = vdupq_n_u64 (SMOL_BOXES_MULTIPLIER / 2);
+    uint32x2_t mul = vdup_n_u32 ((uint32_t) multiplier);
+
+    SMOL_ASSUME_ALIGNED (accums, const uint64_t *);
+    SMOL_ASSUME_ALIGNED (parts_out, uint64_t *);
+
+    while (parts_out != parts_out_max)
+    {
+        uint64x2_t v, a, b;
+        uint32x2_t lo, hi;
+
+        v = vld1q_u64 (accums);
+        accums += 2;
+
+        lo = vmovn_u64 (v);
+        hi = vshrn_n_u64 (v, 32);
+
+        a = vshrq_n_u64 (vaddq_u64 (vmull_u32 (lo, mul), round), 24);
+        b = vshrq_n_u64 (vaddq_u64 (vmull_u32 (hi, mul), round), 24);
+
+        vst1q_u64 (parts_out,
+                   vorrq_u64 (vandq_u64 (a, mask16),
+                              vshlq_n_u64 (vandq_u64 (b, mask16), 32)));
+        parts_out += 2;
+    }
+}
+
+static void
+weight_row_128bpp (uint64_t *row,
+                   uint16_t w,
+                   uint32_t n)
+{
+    uint64_t *row_max = row + (n * 2);
+    const uint32x4_t mask = vdupq_n_u32 (0x00ffffff);
+    uint32x4_t w128 = vdupq_n_u32 (w);
+
+    SMOL_ASSUME_ALIGNED (row, uint64_t *);
+
+    while (row != row_max)
+    {
+        uint32x4_t v;
+
+        v = vld1q_u32 ((const uint32_t *) row);
+        v = vandq_u32 (vshrq_n_u32 (vmulq_u32 (v, w128), 8), mask);
+        vst1q_u32 ((uint32_t *) row, v);
+        row += 2;
+    }
+}
+
+static void
+scale_outrow_box_128bpp (const SmolScaleCtx *scale_ctx,
+                         SmolVerticalCtx *vertical_ctx,
+                         uint32_t outrow_index,
+                         uint32_t *row_out)
+{
+    uint32_t ofs_y, ofs_y_max;
+    uint16_t w;
+
+    /* Get the inrow range for this outrow: [ofs_y .. ofs_y_max> */
+
+    ofs_y = scale_ctx->offsets_y [outrow_index * 2];
+    ofs_y_max = scale_ctx->offsets_y [(outrow_index + 1) * 2];
+
+    /* Scale the first inrow and store it */
+
+    scale_horizontal (scale_ctx,
+                      inrow_ofs_to_pointer (scale_ctx, ofs_y),
+                      vertical_ctx->parts_row [0]);
+    weight_row_128bpp (vertical_ctx->parts_row [0],
+                       outrow_index == 0 ? 256 : 255 - scale_ctx->offsets_y [outrow_index * 2 - 1],
+                       scale_ctx->width_out);
+    ofs_y++;
+
+    /* Add up whole rows */
+
+    while (ofs_y < ofs_y_max)
+    {
+        scale_horizontal (scale_ctx,
+                          inrow_ofs_to_pointer (scale_ctx, ofs_y),
+                          vertical_ctx->parts_row [1]);
+        add_parts (vertical_ctx->parts_row [1],
+                   vertical_ctx->parts_row [0],
+                   scale_ctx->width_out * 2);
+
+        ofs_y++;
+    }
+
+    /* Final row is optional; if this is the bottommost outrow it could be out of bounds */
+
+    w = scale_ctx->offsets_y [outrow_index * 2 + 1];
+    if (w > 0)
+    {
+        scale_horizontal (scale_ctx,
+                          inrow_ofs_to_pointer (scale_ctx, ofs_y),
+                          vertical_ctx->parts_row [1]);
+        weight_row_128bpp (vertical_ctx->parts_row [1],
+                           w - 1,  /* Subtract 1 to avoid overflow */
+                           scale_ctx->width_out);
+        add_parts (vertical_ctx->parts_row [1],
+                   vertical_ctx->parts_row [0],
+                   scale_ctx->width_out * 2);
+    }
+
+    finalize_vertical_128bpp (vertical_ctx->parts_row [0],
+                              scale_ctx->span_mul_y,
+                              vertical_ctx->parts_row [1],
+                              scale_ctx->width_out);
+    scale_ctx->pack_row_func (vertical_ctx->parts_row [1], row_out, scale_ctx->width_out);
+}
+
+/* NULL entries fall back to the generic implementation */
+static const SmolImplementation neon_implementation =
+{
+    {
+        /* Horizontal filters */
+        {
+            /* 64bpp */
+            NULL,
+            NULL,
+            NULL,
+            NULL,
+            NULL,
+            NULL,
+            NULL,
+            NULL,
+            NULL,
+            interp_horizontal_boxes_64bpp
+        },
+        {
+            /* 128bpp */
+            NULL,
+            NULL,
+            interp_horizontal_bilinear_0h_128bpp,
+            interp_horizontal_bilinear_1h_128bpp,
+            interp_horizontal_bilinear_2h_128bpp,
+            interp_horizontal_bilinear_3h_128bpp,
+            interp_horizontal_bilinear_4h_128bpp,
+            interp_horizontal_bilinear_5h_128bpp,
+            interp_horizontal_bilinear_6h_128bpp,
+            interp_horizontal_boxes_128bpp
+        }
+    },
+    {
+        /* Vertical filters */
+        {
+            /* 64bpp */
+            NULL,
+            NULL,
+            NULL,
+            NULL,
+            NULL,
+            NULL,
+            NULL,
+            NULL,
+            NULL,
+            scale_outrow_box_64bpp
+        },
+        {
+            /* 128bpp */
+            NULL,
+            NULL,
+            scale_outrow_bilinear_0h_128bpp,
+            scale_outrow_bilinear_1h_128bpp,
+            scale_outrow_bilinear_2h_128bpp,
+            scale_outrow_bilinear_3h_128bpp,
+            scale_outrow_bilinear_4h_128bpp,
+            scale_outrow_bilinear_5h_128bpp,
+            scale_outrow_bilinear_6h_128bpp,
+            scale_outrow_box_128bpp
+        }
+    },
+    /* No conversion overrides */
+    NULL
+};
+
+const SmolImplementation *
+_smol_get_neon_implementation (void)
+{
+    return &neon_implementation;
+}
@@ -89,6 +89,7 @@ typedef enum
     SMOL_FILTER_BILINEAR_5H,
     SMOL_FILTER_BILINEAR_6H,
     SMOL_FILTER_BOX,
+    SMOL_FILTER_NEAREST,
 
     SMOL_FILTER_MAX
 }
@@ -181,6 +182,10 @@ struct SmolScaleCtx
 const SmolImplementation *_smol_get_avx2_implementation (void);
 #endif
 
+#ifdef SMOL_WITH_NEON
+const SmolImplementation *_smol_get_neon_implementation (void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -1124,11 +1124,23 @@ pick_filter_params (uint32_t dim_in,
                     uint32_t *halvings_out,
                     uint32_t *dim_bilin_out,
                     SmolFilterType *filter_out,
-                    SmolStorageType *storage_out)
+                    SmolStorageType *storage_out,
+                    SmolQuality quality)
 {
     *dim_bilin_out = dim_out;
     *storage_out = SMOL_STORAGE_64BPP;
 
+    /* When quality doesn't matter, pick the nearest input pixel. The
+     * single-pixel and 1:1 cases below are cheaper still, so let those
+     * keep their usual filters. */
+
+    if (quality == SMOL_QUALITY_NEAREST
+        && dim_in != 1 && dim_in != dim_out)
+    {
+        *filter_out = SMOL_FILTER_NEAREST;
+        return;
+    }
+
     /* The box algorithms are only sufficiently precise when
      * dim_in > dim_out * 5. box_64bpp typically starts outperforming
      * bilinear+halving at dim_in > dim_out * 8. */
@@ -1613,6 +1625,51 @@ interp_horizontal_copy_128bpp (const SmolScaleCtx *scale_ctx,
     memcpy (row_parts_out, row_parts_in, scale_ctx->width_out * 2 * sizeof (uint64_t));
 }
 
+/* The nearest filters reuse the bilinear offset arrays; each fraction
+ * decides which of the two sample pixels is closest. */
+
+static void
+interp_horizontal_nearest_64bpp (const SmolScaleCtx *scale_ctx,
+                                 const uint64_t * SMOL_RESTRICT row_parts_in,
+                                 uint64_t * SMOL_RESTRICT row_parts_out)
+{
+    const uint16_t * SMOL_RESTRICT ofs_x = scale_ctx->offsets_x;
+    uint64_t *row_parts_out_max = row_parts_out + scale_ctx->width_out;
+
+    SMOL_ASSUME_ALIGNED (row_parts_in, const uint64_t *);
+    SMOL_ASSUME_ALIGNED (row_parts_out, uint64_t *);
+
+    do
+    {
+        row_parts_in += *(ofs_x++);
+        *(row_parts_out++) = row_parts_in [*(ofs_x++) < SMOL_SMALL_MUL / 2 ? 1 : 0];
+    }
+    while (row_parts_out != row_parts_out_max);
+}
+
+static void
+interp_horizontal_nearest_128bpp (const SmolScaleCtx *scale_ctx,
+                                  const uint64_t * SMOL_RESTRICT row_parts_in,
+                                  uint64_t * SMOL_RESTRICT row_parts_out)
+{
+    const uint16_t * SMOL_RESTRICT ofs_x = scale_ctx->offsets_x;
+    uint64_t *row_parts_out_max = row_parts_out + scale_ctx->width_out * 2;
+
+    SMOL_ASSUME_ALIGNED (row_parts_in, const uint64_t *);
+    SMOL_ASSUME_ALIGNED (row_parts_out, uint64_t *);
+
+    do
+    {
+        uint32_t n;
+
+        row_parts_in += *(ofs_x++) * 2;
+        n = *(ofs_x++) < SMOL_SMALL_MUL / 2 ? 2 : 0;
+        *(row_parts_out++) = row_parts_in [n];
+        *(row_parts_out++) = row_parts_in [n + 1];
+    }
+    while (row_parts_out != row_parts_out_max);
+}
+
 static void
 scale_horizontal (const SmolScaleCtx *scale_ctx,
                   const uint32_t *row_in,
@@ -2293,6 +2350,28 @@ scale_outrow_copy (const SmolScaleCtx *scale_ctx,
     scale_ctx->pack_row_func (vertical_ctx->parts_row [0], row_out, scale_ctx->width_out);
 }
 
+static void
+scale_outrow_nearest (const SmolScaleCtx *scale_ctx,
+                      SmolVerticalCtx *vertical_ctx,
+                      uint32_t outrow_index,
+                      uint32_t *row_out)
+{
+    uint32_t in_ofs = scale_ctx->offsets_y [outrow_index * 2];
+
+    if (scale_ctx->offsets_y [outrow_index * 2 + 1] < SMOL_SMALL_MUL / 2)
+        in_ofs++;
+
+    if (vertical_ctx->in_ofs != in_ofs)
+    {
+        scale_horizontal (scale_ctx,
+                          inrow_ofs_to_pointer (scale_ctx, in_ofs),
+                          vertical_ctx->parts_row [0]);
+        vertical_ctx->in_ofs = in_ofs;
+    }
+
+    scale_ctx->pack_row_func (vertical_ctx->parts_row [0], row_out, scale_ctx->width_out);
+}
+
 static void
 scale_outrow (const SmolScaleCtx *scale_ctx,
               SmolVerticalCtx *vertical_ctx,
@@ -2322,7 +2401,8 @@ do_rows (const SmolScaleCtx *scale_ctx,
     if (scale_ctx->storage_type == SMOL_STORAGE_128BPP)
         n_parts_per_pixel = 2;
 
-    if (scale_ctx->filter_v == SMOL_FILTER_ONE)
+    if (scale_ctx->filter_v == SMOL_FILTER_ONE
+        || scale_ctx->filter_v == SMOL_FILTER_NEAREST)
         n_stored_rows = 1;
 
     /* Must be one less, or this test in update_vertical_ctx() will wrap around:
@@ -2636,7 +2716,8 @@ static const SmolImplementation generic_implementation =
             interp_horizontal_bilinear_4h_64bpp,
             interp_horizontal_bilinear_5h_64bpp,
             interp_horizontal_bilinear_6h_64bpp,
-            interp_horizontal_boxes_64bpp
+            interp_horizontal_boxes_64bpp,
+            interp_horizontal_nearest_64bpp
         },
         {
             /* 128bpp */
@@ -2649,7 +2730,8 @@ static const SmolImplementation generic_implementation =
             interp_horizontal_bilinear_4h_128bpp,
             interp_horizontal_bilinear_5h_128bpp,
             interp_horizontal_bilinear_6h_128bpp,
-            interp_horizontal_boxes_128bpp
+            interp_horizontal_boxes_128bpp,
+            interp_horizontal_nearest_128bpp
         }
     },
     {
@@ -2665,7 +2747,8 @@ static const SmolImplementation generic_implementation =
             scale_outrow_bilinear_4h_64bpp,
             scale_outrow_bilinear_5h_64bpp,
             scale_outrow_bilinear_6h_64bpp,
-            scale_outrow_box_64bpp
+            scale_outrow_box_64bpp,
+            scale_outrow_nearest
         },
         {
             /* 128bpp */
@@ -2678,7 +2761,8 @@ static const SmolImplementation generic_implementation =
             scale_outrow_bilinear_4h_128bpp,
             scale_outrow_bilinear_5h_128bpp,
             scale_outrow_bilinear_6h_128bpp,
-            scale_outrow_box_128bpp
+            scale_outrow_box_128bpp,
+            scale_outrow_nearest
         }
     },
     &generic_conversions
@@ -2745,6 +2829,37 @@ get_host_pixel_type (SmolPixelType pixel_type)
     return host_pixel_type;
 }
 
+/* When all pixels are fully opaque, unassociated data is bit-identical to
+ * premultiplied data, so we can pick the cheaper premultiplied conversions
+ * and skip the associate/unassociate arithmetic. */
+static SmolPixelType
+get_opaque_pixel_type (SmolPixelType pixel_type)
+{
+    SmolPixelType opaque_pixel_type = SMOL_PIXEL_MAX;
+
+    switch (pixel_type)
+    {
+        case SMOL_PIXEL_RGBA8_UNASSOCIATED:
+            opaque_pixel_type = SMOL_PIXEL_RGBA8_PREMULTIPLIED; break;
+        case SMOL_PIXEL_BGRA8_UNASSOCIATED:
+            opaque_pixel_type = SMOL_PIXEL_BGRA8_PREMULTIPLIED; break;
+        case SMOL_PIXEL_ARGB8_UNASSOCIATED:
+            opaque_pixel_type = SMOL_PIXEL_ARGB8_PREMULTIPLIED; break;
+        case SMOL_PIXEL_ABGR8_UNASSOCIATED:
+            opaque_pixel_type = SMOL_PIXEL_ABGR8_PREMULTIPLIED; break;
+        case SMOL_PIXEL_RGBA8_PREMULTIPLIED:
+        case SMOL_PIXEL_BGRA8_PREMULTIPLIED:
+        case SMOL_PIXEL_ARGB8_PREMULTIPLIED:
+        case SMOL_PIXEL_ABGR8_PREMULTIPLIED:
+        case SMOL_PIXEL_RGB8:
+        case SMOL_PIXEL_BGR8:
+        case SMOL_PIXEL_MAX:
+            opaque_pixel_type = pixel_type; break;
+    }
+
+    return opaque_pixel_type;
+}
+
 #ifdef SMOL_WITH_AVX2
 
 static SmolBool
@@ -2762,6 +2877,18 @@ have_avx2 (void)
 
 #endif
 
+#ifdef SMOL_WITH_NEON
+
+static SmolBool
+have_neon (void)
+{
+    /* The build only enables this on targets where NEON is part of the
+     * baseline, so compile-time support implies runtime support */
+    return TRUE;
+}
+
+#endif
+
 static void
 try_override_conversion (SmolScaleCtx *scale_ctx,
                          const SmolImplementation *impl,
@@ -2771,6 +2898,9 @@ try_override_conversion (SmolScaleCtx *scale_ctx,
 {
     const SmolConversion *conv;
 
+    if (!impl->ctab)
+        return;
+
     conv = &impl->ctab->conversions
         [scale_ctx->storage_type] [ptype_in] [ptype_out];
 
@@ -2807,12 +2937,18 @@ get_implementations (SmolScaleCtx *scale_ctx)
     SmolPixelType ptype_in, ptype_out;
     uint8_t n_bytes_per_pixel;
     const SmolImplementation *avx2_impl = NULL;
+    const SmolImplementation *neon_impl = NULL;
 
 #ifdef SMOL_WITH_AVX2
     if (have_avx2 ())
         avx2_impl = _smol_get_avx2_implementation ();
 #endif
 
+#ifdef SMOL_WITH_NEON
+    if (have_neon ())
+        neon_impl = _smol_get_neon_implementation ();
+#endif
+
     ptype_in = get_host_pixel_type (scale_ctx->pixel_type_in);
     ptype_out = get_host_pixel_type (scale_ctx->pixel_type_out);
 
@@ -2831,6 +2967,10 @@ get_implementations (SmolScaleCtx *scale_ctx)
         try_override_conversion (scale_ctx, avx2_impl,
                                  ptype_in, ptype_out,
                                  &n_bytes_per_pixel);
+    if (neon_impl)
+        try_override_conversion (scale_ctx, neon_impl,
+                                 ptype_in, ptype_out,
+                                 &n_bytes_per_pixel);
 
     /* Some conversions require extra precision. This can only ever
      * upgrade the storage from 64bpp to 128bpp, but we handle both
@@ -2855,6 +2995,8 @@ get_implementations (SmolScaleCtx *scale_ctx)
 
     if (avx2_impl)
         try_override_filters (scale_ctx, avx2_impl);
+    if (neon_impl)
+        try_override_filters (scale_ctx, neon_impl);
 }
 
 static void
@@ -2870,10 +3012,18 @@ smol_scale_init (SmolScaleCtx *scale_ctx,
                  uint32_t height_out,
                  uint32_t rowstride_out,
                  SmolPostRowFunc post_row_func,
-                 void *user_data)
+                 void *user_data,
+                 SmolQuality quality,
+                 SmolAlphaHint alpha_hint)
 {
     SmolStorageType storage_type [2];
 
+    if (alpha_hint == SMOL_ALPHA_OPAQUE)
+    {
+        pixel_type_in = get_opaque_pixel_type (pixel_type_in);
+        pixel_type_out = get_opaque_pixel_type (pixel_type_out);
+    }
+
     scale_ctx->pixel_type_in = pixel_type_in;
     scale_ctx->pixels_in = pixels_in;
     scale_ctx->width_in = width_in;
@@ -2892,12 +3042,14 @@ smol_scale_init (SmolScaleCtx *scale_ctx,
                         &scale_ctx->width_halvings,
                         &scale_ctx->width_bilin_out,
                         &scale_ctx->filter_h,
-                        &storage_type [0]);
+                        &storage_type [0],
+                        quality);
     pick_filter_params (height_in, height_out,
                         &scale_ctx->height_halvings,
                         &scale_ctx->height_bilin_out,
                         &scale_ctx->filter_v,
-                        &storage_type [1]);
+                        &storage_type [1],
+                        quality);
 
     scale_ctx->storage_type = MAX (storage_type [0], storage_type [1]);
 
@@ -2913,7 +3065,7 @@ smol_scale_init (SmolScaleCtx *scale_ctx,
         precalc_boxes_array (scale_ctx->offsets_x, &scale_ctx->span_mul_x,
                              width_in, scale_ctx->width_out, FALSE);
     }
-    else /* SMOL_FILTER_BILINEAR_?H */
+    else /* SMOL_FILTER_BILINEAR_?H or SMOL_FILTER_NEAREST */
     {
         precalc_bilinear_array (scale_ctx->offsets_x,
                                 width_in, scale_ctx->width_bilin_out, FALSE);
@@ -2927,7 +3079,7 @@ smol_scale_init (SmolScaleCtx *scale_ctx,
         precalc_boxes_array (scale_ctx->offsets_y, &scale_ctx->span_mul_y,
                              height_in, scale_ctx->height_out, TRUE);
     }
-    else /* SMOL_FILTER_BILINEAR_?H */
+    else /* SMOL_FILTER_BILINEAR_?H or SMOL_FILTER_NEAREST */
     {
         precalc_bilinear_array (scale_ctx->offsets_y,
                                 height_in, scale_ctx->height_bilin_out, TRUE);
@@ -2971,7 +3123,9 @@ smol_scale_new (SmolPixelType pixel_type_in,
                      height_out,
                      rowstride_out,
                      NULL,
-                     NULL);
+                     NULL,
+                     SMOL_QUALITY_DEFAULT,
+                     SMOL_ALPHA_AUTO);
     return scale_ctx;
 }
 
@@ -2987,7 +3141,44 @@ smol_scale_new_full (SmolPixelType pixel_type_in,
                      uint32_t height_out,
                      uint32_t rowstride_out,
                      SmolPostRowFunc post_row_func,
-                     void *user_data)
+                     void *user_data,
+                     SmolAlphaHint alpha_hint)
+{
+    SmolScaleCtx *scale_ctx;
+
+    scale_ctx = calloc (sizeof (SmolScaleCtx), 1);
+    smol_scale_init (scale_ctx,
+                     pixel_type_in,
+                     pixels_in,
+                     width_in,
+                     height_in,
+                     rowstride_in,
+                     pixel_type_out,
+                     pixels_out,
+                     width_out,
+                     height_out,
+                     rowstride_out,
+                     post_row_func,
+                     user_data,
+                     SMOL_QUALITY_DEFAULT,
+                     alpha_hint);
+    return scale_ctx;
+}
+
+SmolScaleCtx *
+smol_scale_new_quality (SmolPixelType pixel_type_in,
+                        const uint32_t *pixels_in,
+                        uint32_t width_in,
+                        uint32_t height_in,
+                        uint32_t rowstride_in,
+                        SmolPixelType pixel_type_out,
+                        uint32_t *pixels_out,
+                        uint32_t width_out,
+                        uint32_t height_out,
+                        uint32_t rowstride_out,
+                        SmolPostRowFunc post_row_func,
+                        void *user_data,
+                        SmolQuality quality)
 {
     SmolScaleCtx *scale_ctx;
 
@@ -3004,7 +3195,9 @@ smol_scale_new_full (SmolPixelType pixel_type_in,
                      height_out,
                      rowstride_out,
                      post_row_func,
-                     user_data);
+                     user_data,
+                     quality,
+                     SMOL_ALPHA_AUTO);
     return scale_ctx;
 }
 
@@ -3015,6 +3208,12 @@ smol_scale_destroy (SmolScaleCtx *scale_ctx)
     free (scale_ctx);
 }
 
+void
+smol_scale_set_pixels_in (SmolScaleCtx *scale_ctx, const uint32_t *pixels_in)
+{
+    scale_ctx->pixels_in = pixels_in;
+}
+
 void
 smol_scale_simple (SmolPixelType pixel_type_in,
                    const uint32_t *pixels_in,
@@ -3034,7 +3233,39 @@ smol_scale_simple (SmolPixelType pixel_type_in,
                      width_in, height_in, rowstride_in,
                      pixel_type_out, pixels_out,
                      width_out, height_out, rowstride_out,
-                     NULL, NULL);
+                     NULL, NULL,
+                     SMOL_QUALITY_DEFAULT,
+                     SMOL_ALPHA_AUTO);
+    do_rows (&scale_ctx,
+             outrow_ofs_to_pointer (&scale_ctx, 0),
+             0,
+             scale_ctx.height_out);
+    smol_scale_finalize (&scale_ctx);
+}
+
+void
+smol_scale_simple_quality (SmolPixelType pixel_type_in,
+                           const uint32_t *pixels_in,
+                           uint32_t width_in,
+                           uint32_t height_in,
+                           uint32_t rowstride_in,
+                           SmolPixelType pixel_type_out,
+                           uint32_t *pixels_out,
+                           uint32_t width_out,
+                           uint32_t height_out,
+                           uint32_t rowstride_out,
+                           SmolQuality quality)
+{
+    SmolScaleCtx scale_ctx;
+
+    smol_scale_init (&scale_ctx,
+                     pixel_type_in, pixels_in,
+                     width_in, height_in, rowstride_in,
+                     pixel_type_out, pixels_out,
+                     width_out, height_out, rowstride_out,
+                     NULL, NULL,
+                     quality,
+                     SMOL_ALPHA_AUTO);
     do_rows (&scale_ctx,
              outrow_ofs_to_pointer (&scale_ctx, 0),
              0,
@@ -3042,6 +3273,69 @@ smol_scale_simple (SmolPixelType pixel_type_in,
     smol_scale_finalize (&scale_ctx);
 }
 
+void
+smol_scale_multi (SmolPixelType pixel_type_in,
+                  const uint32_t *pixels_in,
+                  uint32_t width_in,
+                  uint32_t height_in,
+                  uint32_t rowstride_in,
+                  SmolPixelType pixel_type_out,
+                  uint32_t **pixels_out,
+                  const uint32_t *widths_out,
+                  const uint32_t *heights_out,
+                  const uint32_t *rowstrides_out,
+                  unsigned int n_out)
+{
+    unsigned int largest = 0;
+    unsigned int i;
+
+    if (n_out == 0)
+        return;
+
+    for (i = 1; i < n_out; i++)
+    {
+        if ((uint64_t) widths_out [i] * heights_out [i]
+            > (uint64_t) widths_out [largest] * heights_out [largest])
+            largest = i;
+    }
+
+    smol_scale_simple (pixel_type_in, pixels_in,
+                       width_in, height_in, rowstride_in,
+                       pixel_type_out, pixels_out [largest],
+                       widths_out [largest], heights_out [largest],
+                       rowstrides_out [largest]);
+
+    for (i = 0; i < n_out; i++)
+    {
+        if (i == largest)
+            continue;
+
+        if (widths_out [i] <= widths_out [largest]
+            && heights_out [i] <= heights_out [largest])
+        {
+            /* Derive from the largest output; it has plenty of detail for
+             * a smaller target and is much cheaper to traverse than the
+             * source */
+            smol_scale_simple (pixel_type_out, pixels_out [largest],
+                               widths_out [largest], heights_out [largest],
+                               rowstrides_out [largest],
+                               pixel_type_out, pixels_out [i],
+                               widths_out [i], heights_out [i],
+                               rowstrides_out [i]);
+        }
+        else
+        {
+            /* One of the axes exceeds the largest output; go back to the
+             * source rather than upscale an intermediate */
+            smol_scale_simple (pixel_type_in, pixels_in,
+                               width_in, height_in, rowstride_in,
+                               pixel_type_out, pixels_out [i],
+                               widths_out [i], heights_out [i],
+                               rowstrides_out [i]);
+        }
+    }
+}
+
 void
 smol_scale_batch (const SmolScaleCtx *scale_ctx,
                   uint32_t first_out_row,
@@ -38,6 +38,32 @@ typedef void (SmolPostRowFunc) (uint32_t *row_inout,
                                 int width,
                                 void *user_data);
 
+/* Quality hint. SMOL_QUALITY_SMOOTH is the regular box/bilinear sampling.
+ * SMOL_QUALITY_NEAREST picks the nearest input pixel instead, which is much
+ * faster but produces aliasing artifacts; useful for previews and thumbnails
+ * where throughput matters more than fidelity. */
+
+typedef enum
+{
+    SMOL_QUALITY_SMOOTH,
+    SMOL_QUALITY_NEAREST,
+
+    SMOL_QUALITY_DEFAULT = SMOL_QUALITY_SMOOTH
+}
+SmolQuality;
+
+/* Alpha hint. With SMOL_ALPHA_OPAQUE, the caller guarantees that every
+ * input pixel is fully opaque. Unassociated data is then identical to
+ * premultiplied data, and the associate/unassociate conversions can be
+ * skipped. The output is undefined if the guarantee is broken. */
+
+typedef enum
+{
+    SMOL_ALPHA_AUTO,
+    SMOL_ALPHA_OPAQUE
+}
+SmolAlphaHint;
+
 typedef struct SmolScaleCtx SmolScaleCtx;
 
 /* Simple API: Scales an entire image in one shot. You must provide pointers to
@@ -49,6 +75,26 @@ void smol_scale_simple (SmolPixelType pixel_type_in, const uint32_t *pixels_in,
                         SmolPixelType pixel_type_out, uint32_t *pixels_out,
                         uint32_t width_out, uint32_t height_out, uint32_t rowstride_out);
 
+/* Like smol_scale_simple(), but with a quality hint. */
+
+void smol_scale_simple_quality (SmolPixelType pixel_type_in, const uint32_t *pixels_in,
+                                uint32_t width_in, uint32_t height_in, uint32_t rowstride_in,
+                                SmolPixelType pixel_type_out, uint32_t *pixels_out,
+                                uint32_t width_out, uint32_t height_out, uint32_t rowstride_out,
+                                SmolQuality quality);
+
+/* Multi API: Scales one source image to several destinations. The largest
+ * destination is scaled directly from the source; each smaller one is then
+ * derived from the largest intermediate whose dimensions cover it, so the
+ * source is traversed only once no matter how many sizes are requested.
+ * All destinations receive the same pixel type. */
+
+void smol_scale_multi (SmolPixelType pixel_type_in, const uint32_t *pixels_in,
+                       uint32_t width_in, uint32_t height_in, uint32_t rowstride_in,
+                       SmolPixelType pixel_type_out, uint32_t **pixels_out,
+                       const uint32_t *widths_out, const uint32_t *heights_out,
+                       const uint32_t *rowstrides_out, unsigned int n_out);
+
 /* Batch API: Allows scaling a few rows at a time. Suitable for multithreading. */
 
 SmolScaleCtx *smol_scale_new (SmolPixelType pixel_type_in, const uint32_t *pixels_in,
@@ -60,10 +106,27 @@ SmolScaleCtx *smol_scale_new_full (SmolPixelType pixel_type_in, const uint32_t *
                                    uint32_t width_in, uint32_t height_in, uint32_t rowstride_in,
                                    SmolPixelType pixel_type_out, uint32_t *pixels_out,
                                    uint32_t width_out, uint32_t height_out, uint32_t rowstride_out,
-                                   SmolPostRowFunc post_row_func, void *user_data);
+                                   SmolPostRowFunc post_row_func, void *user_data,
+                                   SmolAlphaHint alpha_hint);
+
+/* Like smol_scale_new_full(), but with a quality hint. */
+
+SmolScaleCtx *smol_scale_new_quality (SmolPixelType pixel_type_in, const uint32_t *pixels_in,
+                                      uint32_t width_in, uint32_t height_in, uint32_t rowstride_in,
+                                      SmolPixelType pixel_type_out, uint32_t *pixels_out,
+                                      uint32_t width_out, uint32_t height_out, uint32_t rowstride_out,
+                                      SmolPostRowFunc post_row_func, void *user_data,
+                                      SmolQuality quality);
 
 void smol_scale_destroy (SmolScaleCtx *scale_ctx);
 
+/* Points the context at a new source image. The image must have the same
+ * pixel type and dimensions as the one passed at creation; the precalculated
+ * sampling parameters are kept. Useful for e.g. animation frames sharing
+ * geometry. Don't call while workers are running. */
+
+void smol_scale_set_pixels_in (SmolScaleCtx *scale_ctx, const uint32_t *pixels_in);
+
 /* It's ok to call smol_scale_batch() without locking from multiple concurrent
  * threads, as long as the outrows do not overlap. Make sure all workers are
  * finished before you call smol_scale_destroy(). */
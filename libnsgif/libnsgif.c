@@ -593,6 +593,7 @@ gif_internal_decode_frame(gif_animation *gif,
         ssize_t save_buffer_position;
         unsigned int return_value = 0;
         unsigned int x, y, decode_y, burst_bytes;
+        unsigned int transparency, transparency_index;
         register unsigned char colour;
 
         /* Ensure this frame is supposed to be decoded */
@@ -829,6 +830,8 @@ gif_internal_decode_frame(gif_animation *gif,
                 }
 
                 /* Decompress the data */
+                transparency = gif->frames[frame].transparency;
+                transparency_index = gif->frames[frame].transparency_index;
                 for (y = 0; y < height; y++) {
                         if (interlace) {
                                 decode_y = gif_interlaced_line(height, y) + offset_y;
@@ -849,14 +852,24 @@ gif_internal_decode_frame(gif_animation *gif,
                                                 burst_bytes = x;
                                         }
                                         x -= burst_bytes;
-                                        while (burst_bytes-- > 0) {
-                                                colour = *--stack_pos;
-                                                if (((gif->frames[frame].transparency) &&
-                                                     (colour != gif->frames[frame].transparency_index)) ||
-                                                    (!gif->frames[frame].transparency)) {
-                                                        *frame_scanline = colour_table[colour];
+                                        /* The transparency test is hoisted
+                                         * out of the pixel loop; the opaque
+                                         * case is a plain table lookup the
+                                         * compiler can vectorise.
+                                         */
+                                        if (!transparency) {
+                                                while (burst_bytes-- > 0) {
+                                                        colour = *--stack_pos;
+                                                        *frame_scanline++ = colour_table[colour];
+                                                }
+                                        } else {
+                                                while (burst_bytes-- > 0) {
+                                                        colour = *--stack_pos;
+                                                        if (colour != transparency_index) {
+                                                                *frame_scanline = colour_table[colour];
+                                                        }
+                                                        frame_scanline++;
                                                 }
-                                                frame_scanline++;
                                         }
                                 } else {
                                         res = lzw_decode(gif->lzw_ctx, &stack_pos);
@@ -0,0 +1,467 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2021 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that turns images into character art.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Benchmark driver for the conversion pipeline. Feeds synthetic images
+ * (and, optionally, raw RGBA dumps passed on the command line) through
+ * chafa_canvas_draw_all_pixels() + chafa_canvas_print() for the major
+ * configurations, and reports cells/s, pixels/s and output MB/s. The
+ * draw and print stages are timed separately so a serializer regression
+ * can't hide behind a fast conversion stage.
+ *
+ * Run with 'make bench'. Raw corpus images can be supplied as
+ * 'chafa-bench WIDTHxHEIGHT:FILE ...', where FILE contains packed
+ * 8-bit RGBA.
+ *
+ * Regression checking: 'make bench-record' stores per-stage timings in
+ * a baseline file; 'make bench-check' re-runs the suite and fails if
+ * any stage is more than BASELINE_TOLERANCE slower than its recorded
+ * envelope. Baselines are machine-specific; record them on the same
+ * box (and at the same clock settings) you intend to check on. */
+
+#include <chafa.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define CANVAS_WIDTH 80
+#define CANVAS_HEIGHT 25
+
+#define SRC_WIDTH 1280
+#define SRC_HEIGHT 800
+
+#define N_WARMUP_REPS 2
+#define N_TIMED_REPS 10
+
+#define RANDOM_SEED 0x5eed
+
+/* A run must be this much slower than its baseline to fail the check.
+ * Generous because wall-clock timings on shared machines are noisy. */
+#define BASELINE_TOLERANCE 1.25
+
+typedef struct
+{
+    const gchar *name;
+    ChafaPixelMode pixel_mode;
+    ChafaCanvasMode canvas_mode;
+    ChafaColorSpace color_space;
+}
+BenchConfig;
+
+typedef struct
+{
+    gchar *name;
+    guint8 *pixels;
+    gint width, height;
+}
+BenchImage;
+
+typedef struct
+{
+    const BenchConfig *config;
+    const BenchImage *image;
+    gdouble draw_us_per_rep;
+    gdouble print_us_per_rep;
+}
+BenchResult;
+
+static const BenchConfig bench_configs [] =
+{
+    { "symbols/truecolor/rgb",    CHAFA_PIXEL_MODE_SYMBOLS, CHAFA_CANVAS_MODE_TRUECOLOR,   CHAFA_COLOR_SPACE_RGB },
+    { "symbols/truecolor/din99d", CHAFA_PIXEL_MODE_SYMBOLS, CHAFA_CANVAS_MODE_TRUECOLOR,   CHAFA_COLOR_SPACE_DIN99D },
+    { "symbols/256/rgb",          CHAFA_PIXEL_MODE_SYMBOLS, CHAFA_CANVAS_MODE_INDEXED_256, CHAFA_COLOR_SPACE_RGB },
+    { "symbols/16/rgb",           CHAFA_PIXEL_MODE_SYMBOLS, CHAFA_CANVAS_MODE_INDEXED_16,  CHAFA_COLOR_SPACE_RGB },
+    { "sixels/256/rgb",           CHAFA_PIXEL_MODE_SIXELS,  CHAFA_CANVAS_MODE_INDEXED_256, CHAFA_COLOR_SPACE_RGB },
+    { "kitty/truecolor/rgb",      CHAFA_PIXEL_MODE_KITTY,   CHAFA_CANVAS_MODE_TRUECOLOR,   CHAFA_COLOR_SPACE_RGB },
+    { "iterm2/truecolor/rgb",     CHAFA_PIXEL_MODE_ITERM2,  CHAFA_CANVAS_MODE_TRUECOLOR,   CHAFA_COLOR_SPACE_RGB }
+};
+
+static BenchImage *
+bench_image_new (const gchar *name, gint width, gint height)
+{
+    BenchImage *image;
+
+    image = g_new0 (BenchImage, 1);
+    image->name = g_strdup (name);
+    image->width = width;
+    image->height = height;
+    image->pixels = g_malloc ((gsize) width * height * 4);
+
+    return image;
+}
+
+static void
+bench_image_destroy (BenchImage *image)
+{
+    g_free (image->name);
+    g_free (image->pixels);
+    g_free (image);
+}
+
+/* Solid color with letterbox bars; mostly identical cells */
+static BenchImage *
+generate_flat_image (void)
+{
+    BenchImage *image = bench_image_new ("flat", SRC_WIDTH, SRC_HEIGHT);
+    gint x, y;
+
+    for (y = 0; y < image->height; y++)
+    {
+        guint8 *row = image->pixels + (gsize) y * image->width * 4;
+        gboolean is_bar = (y < image->height / 8) || (y >= image->height - image->height / 8);
+
+        for (x = 0; x < image->width; x++)
+        {
+            row [x * 4] = is_bar ? 0 : 0x30;
+            row [x * 4 + 1] = is_bar ? 0 : 0x60;
+            row [x * 4 + 2] = is_bar ? 0 : 0x90;
+            row [x * 4 + 3] = 0xff;
+        }
+    }
+
+    return image;
+}
+
+/* Smooth diagonal gradient; few attribute changes, many distinct colors */
+static BenchImage *
+generate_gradient_image (void)
+{
+    BenchImage *image = bench_image_new ("gradient", SRC_WIDTH, SRC_HEIGHT);
+    gint x, y;
+
+    for (y = 0; y < image->height; y++)
+    {
+        guint8 *row = image->pixels + (gsize) y * image->width * 4;
+
+        for (x = 0; x < image->width; x++)
+        {
+            row [x * 4] = (x * 255) / image->width;
+            row [x * 4 + 1] = (y * 255) / image->height;
+            row [x * 4 + 2] = ((x + y) * 255) / (image->width + image->height);
+            row [x * 4 + 3] = 0xff;
+        }
+    }
+
+    return image;
+}
+
+/* Uniform noise; worst case for attribute reuse and symbol selection */
+static BenchImage *
+generate_noise_image (void)
+{
+    BenchImage *image = bench_image_new ("noise", SRC_WIDTH, SRC_HEIGHT);
+    GRand *rand = g_rand_new_with_seed (RANDOM_SEED);
+    gsize i;
+
+    for (i = 0; i < (gsize) image->width * image->height; i++)
+    {
+        image->pixels [i * 4] = g_rand_int_range (rand, 0, 256);
+        image->pixels [i * 4 + 1] = g_rand_int_range (rand, 0, 256);
+        image->pixels [i * 4 + 2] = g_rand_int_range (rand, 0, 256);
+        image->pixels [i * 4 + 3] = 0xff;
+    }
+
+    g_rand_free (rand);
+    return image;
+}
+
+/* 'WIDTHxHEIGHT:FILE' -> raw packed RGBA corpus image */
+static BenchImage *
+load_raw_image (const gchar *spec)
+{
+    BenchImage *image = NULL;
+    gchar *contents = NULL;
+    gsize length;
+    gint width, height;
+    const gchar *path;
+    gchar *delim;
+
+    width = strtol (spec, &delim, 10);
+    if (*delim != 'x')
+        goto out;
+    height = strtol (delim + 1, &delim, 10);
+    if (*delim != ':' || width < 1 || height < 1)
+        goto out;
+    path = delim + 1;
+
+    if (!g_file_get_contents (path, &contents, &length, NULL))
+        goto out;
+    if (length < (gsize) width * height * 4)
+        goto out;
+
+    image = bench_image_new (path, width, height);
+    memcpy (image->pixels, contents, (gsize) width * height * 4);
+
+out:
+    if (!image)
+        g_printerr ("Skipping '%s'; expected WIDTHxHEIGHT:FILE with packed RGBA data\n", spec);
+    g_free (contents);
+    return image;
+}
+
+static ChafaCanvas *
+build_canvas (const BenchConfig *config)
+{
+    ChafaCanvasConfig *canvas_config;
+    ChafaCanvas *canvas;
+
+    canvas_config = chafa_canvas_config_new ();
+    chafa_canvas_config_set_geometry (canvas_config, CANVAS_WIDTH, CANVAS_HEIGHT);
+    chafa_canvas_config_set_pixel_mode (canvas_config, config->pixel_mode);
+    chafa_canvas_config_set_canvas_mode (canvas_config, config->canvas_mode);
+    chafa_canvas_config_set_color_space (canvas_config, config->color_space);
+
+    canvas = chafa_canvas_new (canvas_config);
+    chafa_canvas_config_unref (canvas_config);
+
+    return canvas;
+}
+
+static void
+run_bench (const BenchConfig *config, const BenchImage *image, ChafaTermInfo *term_info,
+           BenchResult *result_out)
+{
+    ChafaCanvas *canvas;
+    GTimer *timer;
+    gdouble draw_s = 0.0, print_s = 0.0, elapsed_s;
+    gsize out_bytes = 0;
+    gint i;
+
+    canvas = build_canvas (config);
+
+    for (i = 0; i < N_WARMUP_REPS; i++)
+    {
+        GString *gs;
+
+        chafa_canvas_draw_all_pixels (canvas, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                      image->pixels,
+                                      image->width, image->height,
+                                      image->width * 4);
+        gs = chafa_canvas_print (canvas, term_info);
+        g_string_free (gs, TRUE);
+    }
+
+    timer = g_timer_new ();
+
+    for (i = 0; i < N_TIMED_REPS; i++)
+    {
+        GString *gs;
+        gdouble t0, t1;
+
+        t0 = g_timer_elapsed (timer, NULL);
+        chafa_canvas_draw_all_pixels (canvas, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                      image->pixels,
+                                      image->width, image->height,
+                                      image->width * 4);
+        t1 = g_timer_elapsed (timer, NULL);
+        draw_s += t1 - t0;
+
+        gs = chafa_canvas_print (canvas, term_info);
+        print_s += g_timer_elapsed (timer, NULL) - t1;
+        out_bytes += gs->len;
+        g_string_free (gs, TRUE);
+    }
+
+    elapsed_s = draw_s + print_s;
+    g_timer_destroy (timer);
+
+    g_print ("%-28s %-10s %10.0f cells/s %12.0f pixels/s %8.2f MB/s out "
+             "(draw %.0f us, print %.0f us)\n",
+             config->name,
+             image->name,
+             (gdouble) CANVAS_WIDTH * CANVAS_HEIGHT * N_TIMED_REPS / elapsed_s,
+             (gdouble) image->width * image->height * N_TIMED_REPS / elapsed_s,
+             (gdouble) out_bytes / (elapsed_s * 1000000.0),
+             draw_s * 1000000.0 / N_TIMED_REPS,
+             print_s * 1000000.0 / N_TIMED_REPS);
+
+    result_out->config = config;
+    result_out->image = image;
+    result_out->draw_us_per_rep = draw_s * 1000000.0 / N_TIMED_REPS;
+    result_out->print_us_per_rep = print_s * 1000000.0 / N_TIMED_REPS;
+
+    chafa_canvas_unref (canvas);
+}
+
+static void
+save_baseline (const gchar *path, GArray *results)
+{
+    GString *gs = g_string_new ("# chafa-bench baseline; config image draw_us print_us\n");
+    guint i;
+
+    for (i = 0; i < results->len; i++)
+    {
+        const BenchResult *result = &g_array_index (results, BenchResult, i);
+
+        g_string_append_printf (gs, "%s %s %.0f %.0f\n",
+                                result->config->name,
+                                result->image->name,
+                                result->draw_us_per_rep,
+                                result->print_us_per_rep);
+    }
+
+    if (!g_file_set_contents (path, gs->str, gs->len, NULL))
+    {
+        g_printerr ("Could not write baseline to '%s'\n", path);
+        exit (2);
+    }
+
+    g_print ("Recorded baseline for %u runs in '%s'\n", results->len, path);
+    g_string_free (gs, TRUE);
+}
+
+/* Compare one result against its recorded envelope. Returns the number
+ * of regressed stages (0-2), or 0 with a notice if no baseline exists
+ * for the run (e.g. a newly added config). */
+static gint
+check_result (const BenchResult *result, const gchar *baseline)
+{
+    const gchar *p = baseline;
+    gint n_regressed = 0;
+
+    for ( ; p; p = strchr (p, '\n') ? strchr (p, '\n') + 1 : NULL)
+    {
+        gchar config_name [64], image_name [128];
+        gdouble draw_us, print_us;
+
+        if (sscanf (p, "%63s %127s %lf %lf",
+                    config_name, image_name, &draw_us, &print_us) != 4)
+            continue;
+        if (strcmp (config_name, result->config->name) != 0
+            || strcmp (image_name, result->image->name) != 0)
+            continue;
+
+        if (result->draw_us_per_rep > draw_us * BASELINE_TOLERANCE)
+        {
+            g_print ("REGRESSED %s %s draw: %.0f us -> %.0f us\n",
+                     config_name, image_name, draw_us, result->draw_us_per_rep);
+            n_regressed++;
+        }
+        if (result->print_us_per_rep > print_us * BASELINE_TOLERANCE)
+        {
+            g_print ("REGRESSED %s %s print: %.0f us -> %.0f us\n",
+                     config_name, image_name, print_us, result->print_us_per_rep);
+            n_regressed++;
+        }
+
+        return n_regressed;
+    }
+
+    g_print ("NO BASELINE %s %s\n", result->config->name, result->image->name);
+    return 0;
+}
+
+static gint
+check_baseline (const gchar *path, GArray *results)
+{
+    gchar *baseline;
+    gint n_regressed = 0;
+    guint i;
+
+    if (!g_file_get_contents (path, &baseline, NULL, NULL))
+    {
+        g_printerr ("Could not read baseline from '%s'; record one with --record first\n", path);
+        return 2;
+    }
+
+    for (i = 0; i < results->len; i++)
+        n_regressed += check_result (&g_array_index (results, BenchResult, i), baseline);
+
+    g_free (baseline);
+
+    if (n_regressed > 0)
+    {
+        g_print ("%d stage(s) regressed beyond %.0f%% tolerance\n",
+                 n_regressed, (BASELINE_TOLERANCE - 1.0) * 100.0);
+        return 1;
+    }
+
+    g_print ("No regressions beyond %.0f%% tolerance\n",
+             (BASELINE_TOLERANCE - 1.0) * 100.0);
+    return 0;
+}
+
+int
+main (int argc, char *argv [])
+{
+    ChafaTermInfo *term_info;
+    GPtrArray *images;
+    GArray *results;
+    const gchar *record_path = NULL, *check_path = NULL;
+    guint i, j, first_image_arg = 1;
+    gint exit_code = 0;
+
+    if (argc >= 3 && !strcmp (argv [1], "--record"))
+    {
+        record_path = argv [2];
+        first_image_arg = 3;
+    }
+    else if (argc >= 3 && !strcmp (argv [1], "--check"))
+    {
+        check_path = argv [2];
+        first_image_arg = 3;
+    }
+
+    /* A fixed terminal model keeps results comparable across machines */
+    term_info = chafa_term_db_get_fallback_info (chafa_term_db_get_default ());
+
+    images = g_ptr_array_new ();
+    g_ptr_array_add (images, generate_flat_image ());
+    g_ptr_array_add (images, generate_gradient_image ());
+    g_ptr_array_add (images, generate_noise_image ());
+
+    for (i = first_image_arg; i < (guint) argc; i++)
+    {
+        BenchImage *image = load_raw_image (argv [i]);
+
+        if (image)
+            g_ptr_array_add (images, image);
+    }
+
+    results = g_array_new (FALSE, FALSE, sizeof (BenchResult));
+
+    g_print ("Canvas %dx%d cells, %d reps after %d warmup\n\n",
+             CANVAS_WIDTH, CANVAS_HEIGHT, N_TIMED_REPS, N_WARMUP_REPS);
+
+    for (i = 0; i < G_N_ELEMENTS (bench_configs); i++)
+    {
+        for (j = 0; j < images->len; j++)
+        {
+            BenchResult result;
+
+            run_bench (&bench_configs [i], g_ptr_array_index (images, j), term_info,
+                       &result);
+            g_array_append_val (results, result);
+        }
+
+        g_print ("\n");
+    }
+
+    if (record_path)
+        save_baseline (record_path, results);
+    else if (check_path)
+        exit_code = check_baseline (check_path, results);
+
+    g_array_free (results, TRUE);
+    for (j = 0; j < images->len; j++)
+        bench_image_destroy (g_ptr_array_index (images, j));
+    g_ptr_array_free (images, TRUE);
+
+    chafa_term_info_unref (term_info);
+    return exit_code;
+}
@@ -127,25 +127,35 @@ static void
 canvas_to_ncurses (ChafaCanvas *canvas)
 {
     ChafaCanvasMode mode = detect_canvas_mode ();
+    ChafaCanvasCellInfo *cells, *cell;
     int pair = 256;  /* Reserve lower pairs for application in direct-color mode */
     int x, y;
 
+    /* Export the entire canvas in one call */
+
+    cells = g_malloc (screen_width * (screen_height - 1) * sizeof (ChafaCanvasCellInfo));
+
+    if (mode == CHAFA_CANVAS_MODE_TRUECOLOR || mode == CHAFA_CANVAS_MODE_FGBG)
+        chafa_canvas_get_cells (canvas, 0, 0, screen_width, screen_height - 1, cells);
+    else
+        chafa_canvas_get_raw_cells (canvas, 0, 0, screen_width, screen_height - 1, cells);
+
+    cell = cells;
+
     for (y = 0; y < screen_height - 1; y++)
     {
-        for (x = 0; x < screen_width; x++)
+        for (x = 0; x < screen_width; x++, cell++)
         {
             wchar_t wc [2];
             cchar_t cch;
-            int fg, bg;
 
             /* wchar_t is 32-bit in glibc, but this may not work on e.g. Windows */
-            wc [0] = chafa_canvas_get_char_at (canvas, x, y);
+            wc [0] = cell->c;
             wc [1] = 0;
 
             if (mode == CHAFA_CANVAS_MODE_TRUECOLOR)
             {
-                chafa_canvas_get_colors_at (canvas, x, y, &fg, &bg);
-                init_extended_pair (pair, fg, bg);
+                init_extended_pair (pair, cell->fg_color, cell->bg_color);
             }
             else if (mode == CHAFA_CANVAS_MODE_FGBG)
             {
@@ -155,8 +165,7 @@ canvas_to_ncurses (ChafaCanvas *canvas)
             {
                 /* In indexed color mode, we've probably got enough pairs
                  * to just let ncurses allocate and reuse as needed. */
-                chafa_canvas_get_raw_colors_at (canvas, x, y, &fg, &bg);
-                pair = alloc_pair (fg, bg);
+                pair = alloc_pair (cell->fg_color, cell->bg_color);
             }
 
             setcchar (&cch, wc, A_NORMAL, -1, &pair);
@@ -164,6 +173,8 @@ canvas_to_ncurses (ChafaCanvas *canvas)
             pair++;
         }
     }
+
+    g_free (cells);
 }
 
 static void
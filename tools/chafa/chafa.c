@@ -25,6 +25,11 @@
 #include <sys/ioctl.h>  /* ioctl */
 #include <sys/types.h>  /* open */
 #include <sys/stat.h>  /* stat */
+#include <sys/socket.h>  /* socket, bind, listen, accept */
+#include <sys/time.h>  /* timeval */
+#include <sys/uio.h>  /* writev */
+#include <sys/un.h>  /* sockaddr_un */
+#include <errno.h>  /* errno, EINTR */
 #include <fcntl.h>  /* open */
 #include <unistd.h>  /* STDOUT_FILENO */
 #include <signal.h>  /* sigaction */
@@ -39,7 +44,10 @@
 #include <chafa.h>
 #include "font-loader.h"
 #include "gif-loader.h"
+#include "glyph-cache.h"
+#include "jpeg-loader.h"
 #include "named-colors.h"
+#include "png-loader.h"
 #include "xwd-loader.h"
 
 #define ANIM_FPS_MAX 100000.0
@@ -73,6 +81,15 @@ typedef struct
     gboolean zoom;
     gboolean watch;
     gboolean fg_only;
+
+    /* If set, serve conversions over a unix socket at this path */
+    gchar *daemon_path;
+
+    /* If raw_width > 0, read raw frames of these dimensions from stdin
+     * instead of loading image files. */
+    gint raw_width, raw_height;
+    ChafaPixelType raw_pixel_type;
+
     gint width, height;
     gint cell_width, cell_height;
     gdouble font_ratio;
@@ -232,6 +249,9 @@ print_summary (void)
     "                     [average, median]. Average is the default.\n"
     "      --color-space=CS  Color space used for quantization; one of [rgb, din99d].\n"
     "                     Defaults to rgb, which is faster but less accurate.\n"
+    "      --daemon=PATH  Serve conversions over a unix socket at PATH. Clients\n"
+    "                     write a file path followed by a newline and read the\n"
+    "                     output. Other options fix the daemon's conversion setup.\n"
     "      --dither=DITHER  Set output dither mode; one of [none, ordered,\n"
     "                     diffusion]. No effect with 24-bit color. Defaults to none.\n"
     "      --dither-grain=WxH  Set dimensions of dither grains in 1/8ths of a\n"
@@ -262,6 +282,11 @@ print_summary (void)
     "                     used with \"-c none\", where it defaults to 0.\n"
     "  -p, --preprocess=BOOL  Image preprocessing [on, off]. Defaults to on with 16\n"
     "                     colors or lower, off otherwise.\n"
+    "      --raw-format=FORMAT  Pixel format of frames read with --raw-size; one of\n"
+    "                     [rgb, bgr, rgba, bgra, argb, abgr]. Defaults to rgba.\n"
+    "      --raw-size=WxH  Read raw video frames with the given pixel dimensions\n"
+    "                     from standard input, back to back, and play them until\n"
+    "                     the stream ends. See below for an example.\n"
     "  -s, --size=WxH     Set maximum output dimensions in columns and rows. By\n"
     "                     default this will be the size of your terminal, or 80x25\n"
     "                     if size detection fails.\n"
@@ -300,7 +325,11 @@ print_summary (void)
 
     "  Generate uncolored output using block and border symbols, but avoid the\n"
     "  solid block symbol:\n\n"
-    "  $ chafa -c none --symbols block+border-solid in.png\n";
+    "  $ chafa -c none --symbols block+border-solid in.png\n\n"
+
+    "  Play video in the terminal using ffmpeg as the decoder:\n\n"
+    "  $ ffmpeg -i in.mkv -f rawvideo -pix_fmt rgba -vf scale=640:-1 - |\n"
+    "    chafa --raw-size 640x360 --clear\n";
 
     g_printerr ("Usage:\n  %s [OPTION...] [FILE...]\n\n%s\n",
                 options.executable_name,
@@ -533,6 +562,65 @@ out:
     return result;
 }
 
+static gboolean
+parse_raw_size_arg (G_GNUC_UNUSED const gchar *option_name, const gchar *value, G_GNUC_UNUSED gpointer data, GError **error)
+{
+    gboolean result = TRUE;
+    gint width = -1, height = -1;
+    gint n;
+    gint o = 0;
+
+    n = sscanf (value, "%d%n", &width, &o);
+
+    if (n == 1 && value [o] == 'x' && value [o + 1] != '\0')
+    {
+        gint o2;
+
+        n = sscanf (value + o + 1, "%d%n", &height, &o2);
+        if (n == 1 && value [o + o2 + 1] != '\0')
+            height = -1;
+    }
+
+    if (width < 1 || height < 1)
+    {
+        g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                     "Raw frame dimensions must be specified as WIDTHxHEIGHT, e.g. 1280x720.");
+        result = FALSE;
+    }
+
+    options.raw_width = width;
+    options.raw_height = height;
+
+    return result;
+}
+
+static gboolean
+parse_raw_format_arg (G_GNUC_UNUSED const gchar *option_name, const gchar *value, G_GNUC_UNUSED gpointer data, GError **error)
+{
+    gboolean result = TRUE;
+
+    if (!g_ascii_strcasecmp (value, "rgba"))
+        options.raw_pixel_type = CHAFA_PIXEL_RGBA8_UNASSOCIATED;
+    else if (!g_ascii_strcasecmp (value, "bgra"))
+        options.raw_pixel_type = CHAFA_PIXEL_BGRA8_UNASSOCIATED;
+    else if (!g_ascii_strcasecmp (value, "argb"))
+        options.raw_pixel_type = CHAFA_PIXEL_ARGB8_UNASSOCIATED;
+    else if (!g_ascii_strcasecmp (value, "abgr"))
+        options.raw_pixel_type = CHAFA_PIXEL_ABGR8_UNASSOCIATED;
+    else if (!g_ascii_strcasecmp (value, "rgb"))
+        options.raw_pixel_type = CHAFA_PIXEL_RGB8;
+    else if (!g_ascii_strcasecmp (value, "bgr"))
+        options.raw_pixel_type = CHAFA_PIXEL_BGR8;
+    else
+    {
+        g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                     "Raw format must be one of [rgb, bgr, rgba, bgra, argb, abgr].");
+        result = FALSE;
+    }
+
+    return result;
+}
+
 static gboolean
 parse_dither_grain_arg (G_GNUC_UNUSED const gchar *option_name, const gchar *value, G_GNUC_UNUSED gpointer data, GError **error)
 {
@@ -579,19 +667,131 @@ out:
     return result;
 }
 
+/* Keep the rasterizer from racing too far ahead of the conversion workers */
+#define GLYPH_IMPORT_MAX_BACKLOG 4096
+
+typedef struct
+{
+    gunichar c;
+    gpointer bitmap;
+    gint width, height;
+}
+GlyphImportJob;
+
+typedef struct
+{
+    GThread *thread;
+    GAsyncQueue *queue;
+    ChafaSymbolMap *symbol_map;
+}
+GlyphImporter;
+
+/* A symbol map can only be modified from one thread, so each map gets its
+ * own worker. The scaling and coverage conversion inside
+ * chafa_symbol_map_add_glyph () dominates the import cost, and this lets it
+ * run for both maps while FreeType rasterizes the next glyph. */
+static gpointer
+glyph_importer_thread_main (gpointer data)
+{
+    GlyphImporter *importer = data;
+
+    for (;;)
+    {
+        GlyphImportJob *job = g_async_queue_pop (importer->queue);
+
+        /* The importer struct itself doubles as the quit sentinel */
+        if (job == (GlyphImportJob *) (gpointer) importer)
+            break;
+
+        chafa_symbol_map_add_glyph (importer->symbol_map, job->c,
+                                    CHAFA_PIXEL_RGBA8_PREMULTIPLIED, job->bitmap,
+                                    job->width, job->height, job->width * 4);
+        g_free (job->bitmap);
+        g_free (job);
+    }
+
+    return NULL;
+}
+
+static void
+glyph_importer_init (GlyphImporter *importer, ChafaSymbolMap *symbol_map)
+{
+    importer->queue = g_async_queue_new ();
+    importer->symbol_map = symbol_map;
+    importer->thread = g_thread_new ("glyph-importer", glyph_importer_thread_main, importer);
+}
+
+static void
+glyph_importer_push (GlyphImporter *importer, gunichar c, gconstpointer bitmap,
+                     gint width, gint height)
+{
+    GlyphImportJob *job;
+
+    while (g_async_queue_length (importer->queue) > GLYPH_IMPORT_MAX_BACKLOG)
+        g_usleep (1000);
+
+    job = g_new (GlyphImportJob, 1);
+    job->c = c;
+    job->bitmap = g_memdup (bitmap, width * height * 4);
+    job->width = width;
+    job->height = height;
+
+    g_async_queue_push (importer->queue, job);
+}
+
+static void
+glyph_importer_finish (GlyphImporter *importer)
+{
+    g_async_queue_push (importer->queue, importer);
+    g_thread_join (importer->thread);
+    g_async_queue_unref (importer->queue);
+}
+
+static void
+import_cached_glyph (gunichar c, gconstpointer bitmap, gint width, gint height,
+                     gpointer user_data)
+{
+    GlyphImporter *importers = user_data;
+
+    glyph_importer_push (&importers [0], c, bitmap, width, height);
+    glyph_importer_push (&importers [1], c, bitmap, width, height);
+}
+
 static gboolean
 parse_glyph_file_arg (G_GNUC_UNUSED const gchar *option_name, const gchar *value, G_GNUC_UNUSED gpointer data, GError **error)
 {
     gboolean result = FALSE;
-    FileMapping *file_mapping;
+    FileMapping *file_mapping = NULL;
     FontLoader *font_loader;
+    GlyphImporter importers [2];
+    GlyphCache *glyph_cache;
     gunichar c;
     gpointer c_bitmap;
     gint width, height;
 
+    glyph_importer_init (&importers [0], options.symbol_map);
+    glyph_importer_init (&importers [1], options.fill_symbol_map);
+
+    /* Rasterizing a font with FreeType can take a while; reuse the glyphs
+     * from a previous run with the same font when possible */
+
+    glyph_cache = glyph_cache_new_for_font (value);
+    if (glyph_cache && glyph_cache_try_load (glyph_cache, import_cached_glyph, importers))
+    {
+        glyph_cache_destroy (glyph_cache);
+        glyph_importer_finish (&importers [0]);
+        glyph_importer_finish (&importers [1]);
+        result = TRUE;
+        goto out;
+    }
+
     file_mapping = file_mapping_new (value);
     if (!file_mapping)
     {
+        glyph_importer_finish (&importers [0]);
+        glyph_importer_finish (&importers [1]);
+        if (glyph_cache)
+            glyph_cache_destroy (glyph_cache);
         g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
                      "Unable to open glyph file '%s'.", value);
         goto out;
@@ -602,6 +802,10 @@ parse_glyph_file_arg (G_GNUC_UNUSED const gchar *option_name, const gchar *value
 
     if (!font_loader)
     {
+        glyph_importer_finish (&importers [0]);
+        glyph_importer_finish (&importers [1]);
+        if (glyph_cache)
+            glyph_cache_destroy (glyph_cache);
         g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
                      "Unable to load glyph file '%s'.", value);
         goto out;
@@ -609,17 +813,24 @@ parse_glyph_file_arg (G_GNUC_UNUSED const gchar *option_name, const gchar *value
 
     while (font_loader_get_next_glyph (font_loader, &c, &c_bitmap, &width, &height))
     {
-        chafa_symbol_map_add_glyph (options.symbol_map, c,
-                                    CHAFA_PIXEL_RGBA8_PREMULTIPLIED, c_bitmap,
-                                    width, height, width * 4);
-        chafa_symbol_map_add_glyph (options.fill_symbol_map, c,
-                                    CHAFA_PIXEL_RGBA8_PREMULTIPLIED, c_bitmap,
-                                    width, height, width * 4);
+        glyph_importer_push (&importers [0], c, c_bitmap, width, height);
+        glyph_importer_push (&importers [1], c, c_bitmap, width, height);
+        if (glyph_cache)
+            glyph_cache_add (glyph_cache, c, c_bitmap, width, height);
         g_free (c_bitmap);
     }
 
+    glyph_importer_finish (&importers [0]);
+    glyph_importer_finish (&importers [1]);
+
     font_loader_destroy (font_loader);
 
+    if (glyph_cache)
+    {
+        glyph_cache_save (glyph_cache);
+        glyph_cache_destroy (glyph_cache);
+    }
+
     result = TRUE;
 
 out:
@@ -868,12 +1079,126 @@ detect_terminal (ChafaTermInfo **term_info_out, ChafaCanvasMode *mode_out, Chafa
     g_strfreev (envp);
 }
 
+/* Terminal detection runs on a worker thread started early in
+ * parse_options(), so it overlaps with option parsing and -- more
+ * importantly -- with the first file's decode, which starts before the
+ * result is needed. This will matter more once detection involves
+ * terminal round trips (DA1 and friends); today it mostly hides termcap
+ * and environment lookups.
+ *
+ * join_terminal_detection() collects the result and applies the
+ * detection-dependent option defaults. It must be called before the
+ * options are used to convert or print anything, and is a no-op on
+ * subsequent calls. */
+
+typedef struct
+{
+    ChafaTermInfo *term_info;
+    ChafaCanvasMode mode;
+    ChafaPixelMode pixel_mode;
+}
+TermDetectState;
+
+static GThread *detect_thread;
+static TermDetectState detect_state;
+static gint detected_term_width;
+
+static gpointer
+detect_terminal_thread_main (G_GNUC_UNUSED gpointer data)
+{
+    detect_terminal (&detect_state.term_info, &detect_state.mode,
+                     &detect_state.pixel_mode);
+    return NULL;
+}
+
+static void
+join_terminal_detection (void)
+{
+    if (!detect_thread)
+        return;
+
+    g_thread_join (detect_thread);
+    detect_thread = NULL;
+
+    options.term_info = detect_state.term_info;
+
+    if (options.pixel_mode == CHAFA_PIXEL_MODE_MAX)
+        options.pixel_mode = detect_state.pixel_mode;
+
+    /* Now we've established the pixel mode, apply dependent defaults */
+
+    if (options.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS)
+    {
+        /* Character cell defaults */
+
+        if (options.mode == CHAFA_CANVAS_MODE_MAX)
+            options.mode = detect_state.mode;
+        if (options.dither_grain_width < 0)
+            options.dither_grain_width = 4;
+        if (options.dither_grain_height < 0)
+            options.dither_grain_height = 4;
+        if (options.font_ratio < 0.0)
+            options.font_ratio = 1.0 / 2.0;
+    }
+    else
+    {
+        /* iTerm2/Kitty/sixel defaults */
+
+        if (options.mode == CHAFA_CANVAS_MODE_MAX)
+            options.mode = CHAFA_CANVAS_MODE_TRUECOLOR;
+        if (options.dither_grain_width < 0)
+            options.dither_grain_width = 1;
+        if (options.dither_grain_height < 0)
+            options.dither_grain_height = 1;
+        if (options.font_ratio < 0.0)
+            options.font_ratio = 1.0 / 2.0;
+    }
+
+    /* Kitty leaves the cursor in the column trailing the last row of the
+     * image. However, if the image is as wide as the terminal, the cursor
+     * will wrap to the first column of the following row, making us lose
+     * track of its position.
+     *
+     * This is not a problem when instructed to clear the terminal, as we
+     * use absolute positioning then.
+     *
+     * If needed, trim one column from the image to make the cursor position
+     * predictable. */
+    if (options.pixel_mode == CHAFA_PIXEL_MODE_KITTY
+        && !options.clear
+        && options.width > 1
+        && options.width == detected_term_width)
+        options.width -= 1;
+
+    /* Since FGBG mode can't use escape sequences to invert, it really
+     * needs inverted symbols. In other modes they will only slow us down,
+     * so disable them unless the user specified symbols of their own. */
+    if (options.mode != CHAFA_CANVAS_MODE_FGBG && !options.symbols_specified)
+        chafa_symbol_map_remove_by_tags (options.symbol_map, CHAFA_SYMBOL_TAG_INVERTED);
+
+    /* If optimization level is unset, enable optimizations. However, we
+     * leave them off for FGBG mode, since control sequences may be
+     * unexpected in this mode unless explicitly asked for. */
+    if (options.optimization_level == G_MININT)
+        options.optimization_level = (options.mode == CHAFA_CANVAS_MODE_FGBG) ? 0 : 5;
+
+    /* Translate optimization level to flags */
+
+    options.optimizations = CHAFA_OPTIMIZATION_NONE;
+
+    if (options.optimization_level >= 1)
+        options.optimizations |= CHAFA_OPTIMIZATION_REUSE_ATTRIBUTES;
+    if (options.optimization_level >= 6)
+        options.optimizations |= CHAFA_OPTIMIZATION_REPEAT_CELLS;
+    if (options.optimization_level >= 7)
+        options.optimizations |= CHAFA_OPTIMIZATION_SKIP_CELLS;
+}
+
 static gboolean
 parse_options (int *argc, char **argv [])
 {
     GError *error = NULL;
     GOptionContext *context;
-    gint detected_width;
     gboolean result = TRUE;
     const GOptionEntry option_entries [] =
     {
@@ -887,6 +1212,7 @@ parse_options (int *argc, char **argv [])
         { "colors",      'c',  0, G_OPTION_ARG_CALLBACK, parse_colors_arg,      "Colors (none, 2, 16, 256, 240 or full)", NULL },
         { "color-extractor", '\0', 0, G_OPTION_ARG_CALLBACK, parse_color_extractor_arg, "Color extractor (average or median)", NULL },
         { "color-space", '\0', 0, G_OPTION_ARG_CALLBACK, parse_color_space_arg, "Color space (rgb or din99d)", NULL },
+        { "daemon",      '\0', 0, G_OPTION_ARG_FILENAME, &options.daemon_path,  "Serve conversions over a unix socket", NULL },
         { "dither",      '\0', 0, G_OPTION_ARG_CALLBACK, parse_dither_arg,      "Dither", NULL },
         { "dither-grain",'\0', 0, G_OPTION_ARG_CALLBACK, parse_dither_grain_arg, "Dither grain", NULL },
         { "dither-intensity", '\0',  0, G_OPTION_ARG_DOUBLE,   &options.dither_intensity, "Dither intensity", NULL },
@@ -900,6 +1226,8 @@ parse_options (int *argc, char **argv [])
         { "invert",      '\0', 0, G_OPTION_ARG_NONE,     &options.invert,       "Invert foreground/background", NULL },
         { "optimize",    'O',  0, G_OPTION_ARG_INT,      &options.optimization_level,  "Optimization", NULL },
         { "preprocess",  'p',  0, G_OPTION_ARG_CALLBACK, parse_preprocess_arg,  "Preprocessing", NULL },
+        { "raw-format",  '\0', 0, G_OPTION_ARG_CALLBACK, parse_raw_format_arg,  "Raw frame pixel format", NULL },
+        { "raw-size",    '\0', 0, G_OPTION_ARG_CALLBACK, parse_raw_size_arg,    "Raw frame dimensions", NULL },
         { "work",        'w',  0, G_OPTION_ARG_INT,      &options.work_factor,  "Work factor", NULL },
         { "size",        's',  0, G_OPTION_ARG_CALLBACK, parse_size_arg,        "Output size", NULL },
         { "speed",       '\0', 0, G_OPTION_ARG_CALLBACK, parse_anim_speed_arg,  "Animation speed", NULL },
@@ -910,8 +1238,6 @@ parse_options (int *argc, char **argv [])
         { "zoom",        '\0', 0, G_OPTION_ARG_NONE,     &options.zoom,         "Allow scaling up beyond one character per pixel", NULL },
         { NULL }
     };
-    ChafaCanvasMode canvas_mode;
-    ChafaPixelMode pixel_mode;
 
     memset (&options, 0, sizeof (options));
 
@@ -932,9 +1258,9 @@ parse_options (int *argc, char **argv [])
     options.fill_symbol_map = chafa_symbol_map_new ();
 
     options.is_interactive = isatty (STDIN_FILENO) && isatty (STDOUT_FILENO);
-    detect_terminal (&options.term_info, &canvas_mode, &pixel_mode);
+    detect_thread = g_thread_new ("term-detect", detect_terminal_thread_main, NULL);
     options.mode = CHAFA_CANVAS_MODE_MAX;  /* Unset */
-    options.pixel_mode = pixel_mode;
+    options.pixel_mode = CHAFA_PIXEL_MODE_MAX;  /* Unset; default from detection */
     options.dither_mode = CHAFA_DITHER_MODE_NONE;
     options.dither_grain_width = -1;  /* Unset */
     options.dither_grain_height = -1;  /* Unset */
@@ -954,9 +1280,12 @@ parse_options (int *argc, char **argv [])
     options.file_duration_s = G_MAXDOUBLE;
     options.anim_fps = -1.0;
     options.anim_speed_multiplier = 1.0;
+    options.raw_width = -1;  /* Unset */
+    options.raw_height = -1;
+    options.raw_pixel_type = CHAFA_PIXEL_MAX;  /* Unset */
     get_tty_size ();
 
-    detected_width = options.width;
+    detected_term_width = options.width;
 
     if (!g_option_context_parse (context, argc, argv, &error))
     {
@@ -964,50 +1293,8 @@ parse_options (int *argc, char **argv [])
         return FALSE;
     }
 
-    /* Now we've established the pixel mode, apply dependent defaults */
-
-    if (options.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS)
-    {
-        /* Character cell defaults */
-
-        if (options.mode == CHAFA_CANVAS_MODE_MAX)
-            options.mode = canvas_mode;
-        if (options.dither_grain_width < 0)
-            options.dither_grain_width = 4;
-        if (options.dither_grain_height < 0)
-            options.dither_grain_height = 4;
-        if (options.font_ratio < 0.0)
-            options.font_ratio = 1.0 / 2.0;
-    }
-    else
-    {
-        /* iTerm2/Kitty/sixel defaults */
-
-        if (options.mode == CHAFA_CANVAS_MODE_MAX)
-            options.mode = CHAFA_CANVAS_MODE_TRUECOLOR;
-        if (options.dither_grain_width < 0)
-            options.dither_grain_width = 1;
-        if (options.dither_grain_height < 0)
-            options.dither_grain_height = 1;
-        if (options.font_ratio < 0.0)
-            options.font_ratio = 1.0 / 2.0;
-    }
-
-    /* Kitty leaves the cursor in the column trailing the last row of the
-     * image. However, if the image is as wide as the terminal, the cursor
-     * will wrap to the first column of the following row, making us lose
-     * track of its position.
-     *
-     * This is not a problem when instructed to clear the terminal, as we
-     * use absolute positioning then.
-     *
-     * If needed, trim one column from the image to make the cursor position
-     * predictable. */
-    if (options.pixel_mode == CHAFA_PIXEL_MODE_KITTY
-        && !options.clear
-        && options.width > 1
-        && options.width == detected_width)
-        options.width -= 1;
+    /* Defaults that depend on the detected terminal are applied in
+     * join_terminal_detection(), after the first decode has started */
 
     if (options.work_factor < 1 || options.work_factor > 9)
     {
@@ -1030,7 +1317,7 @@ parse_options (int *argc, char **argv [])
         return TRUE;
     }
 
-    if (*argc < 2)
+    if (*argc < 2 && options.raw_width < 0 && !options.daemon_path)
     {
         print_summary ();
         return FALSE;
@@ -1050,6 +1337,33 @@ parse_options (int *argc, char **argv [])
         return FALSE;
     }
 
+    if (options.raw_pixel_type != CHAFA_PIXEL_MAX && options.raw_width < 0)
+    {
+        g_printerr ("%s: --raw-format requires --raw-size.\n", options.executable_name);
+        return FALSE;
+    }
+
+    if (options.daemon_path
+        && (options.args || options.watch || options.raw_width > 0))
+    {
+        g_printerr ("%s: Cannot combine --daemon with input files, --watch or --raw-size.\n",
+                    options.executable_name);
+        return FALSE;
+    }
+
+    if (options.raw_width > 0)
+    {
+        if (options.args || options.watch)
+        {
+            g_printerr ("%s: Cannot combine --raw-size with input files or --watch.\n",
+                        options.executable_name);
+            return FALSE;
+        }
+
+        if (options.raw_pixel_type == CHAFA_PIXEL_MAX)
+            options.raw_pixel_type = CHAFA_PIXEL_RGBA8_UNASSOCIATED;
+    }
+
     /* --stretch implies --zoom */
     options.zoom |= options.stretch;
 
@@ -1063,7 +1377,9 @@ parse_options (int *argc, char **argv [])
     }
 
     if (options.file_duration_s == G_MAXDOUBLE
+        && options.raw_width < 0
         && (!options.is_interactive
+            || options.daemon_path
             || (options.args && options.args->next)))
     {
         /* Apply a zero default duration when we have multiple files or it looks
@@ -1072,40 +1388,18 @@ parse_options (int *argc, char **argv [])
         options.file_duration_s = FILE_DURATION_DEFAULT;
     }
 
-    /* Since FGBG mode can't use escape sequences to invert, it really
-     * needs inverted symbols. In other modes they will only slow us down,
-     * so disable them unless the user specified symbols of their own. */
-    if (options.mode != CHAFA_CANVAS_MODE_FGBG && !options.symbols_specified)
-        chafa_symbol_map_remove_by_tags (options.symbol_map, CHAFA_SYMBOL_TAG_INVERTED);
-
-    /* If optimization level is unset, enable optimizations. However, we
-     * leave them off for FGBG mode, since control sequences may be
-     * unexpected in this mode unless explicitly asked for. */
-    if (options.optimization_level == G_MININT)
-        options.optimization_level = (options.mode == CHAFA_CANVAS_MODE_FGBG) ? 0 : 5;
-
-    if (options.optimization_level < 0 || options.optimization_level > 9)
+    if (options.optimization_level != G_MININT
+        && (options.optimization_level < 0 || options.optimization_level > 9))
     {
         g_printerr ("%s: Optimization level %d is not in the range [0-9].\n",
                     options.executable_name, options.optimization_level);
         return FALSE;
     }
 
-    /* Translate optimization level to flags */
+    g_option_context_free (context);
 
-    options.optimizations = CHAFA_OPTIMIZATION_NONE;
-
-    if (options.optimization_level >= 1)
-        options.optimizations |= CHAFA_OPTIMIZATION_REUSE_ATTRIBUTES;
-    if (options.optimization_level >= 6)
-        options.optimizations |= CHAFA_OPTIMIZATION_REPEAT_CELLS;
-    if (options.optimization_level >= 7)
-        options.optimizations |= CHAFA_OPTIMIZATION_SKIP_CELLS;
-
-    g_option_context_free (context);
-
-    return result;
-}
+    return result;
+}
 
 static void
 auto_orient_image (MagickWand *image)
@@ -1154,14 +1448,10 @@ auto_orient_image (MagickWand *image)
 #endif
 }
 
-static GString *
-build_string (ChafaPixelType pixel_type, const guint8 *pixels,
-              gint src_width, gint src_height, gint src_rowstride,
-              gint dest_width, gint dest_height)
+static ChafaCanvasConfig *
+build_config (gint dest_width, gint dest_height)
 {
     ChafaCanvasConfig *config;
-    ChafaCanvas *canvas;
-    GString *gs;
 
     config = chafa_canvas_config_new ();
 
@@ -1192,6 +1482,30 @@ build_string (ChafaPixelType pixel_type, const guint8 *pixels,
 
     chafa_canvas_config_set_optimizations (config, options.optimizations);
 
+    /* Shared-memory handoff only works when the terminal shares our host;
+     * a remote session is the one case we can cheaply rule out. The
+     * library falls back to direct transmission if the terminal doesn't
+     * advertise the sequence or the object can't be created. */
+    if (options.pixel_mode == CHAFA_PIXEL_MODE_KITTY
+        && isatty (STDOUT_FILENO)
+        && !g_getenv ("SSH_CONNECTION")
+        && !g_getenv ("SSH_CLIENT")
+        && !g_getenv ("SSH_TTY"))
+        chafa_canvas_config_set_kitty_shm_enabled (config, TRUE);
+
+    return config;
+}
+
+static GString *
+build_string (ChafaPixelType pixel_type, const guint8 *pixels,
+              gint src_width, gint src_height, gint src_rowstride,
+              gint dest_width, gint dest_height)
+{
+    ChafaCanvasConfig *config;
+    ChafaCanvas *canvas;
+    GString *gs;
+
+    config = build_config (dest_width, dest_height);
     canvas = chafa_canvas_new (config);
     chafa_canvas_draw_all_pixels (canvas, pixel_type, pixels, src_width, src_height, src_rowstride);
     gs = chafa_canvas_print (canvas, options.term_info);
@@ -1273,9 +1587,16 @@ group_build (Group *group, MagickWand *wand)
 static void
 group_build_gif (Group *group, GifLoader *loader)
 {
+    gint i, n_frames;
+
     memset (group, 0, sizeof (*group));
 
-    for (gif_loader_first_frame (loader); !interrupted_by_user; )
+    /* Don't drive the loader here; stepping through it would make us wait
+     * for every frame to decode before playback starts. The frame count
+     * is known after initialisation. */
+    n_frames = gif_loader_get_n_frames (loader);
+
+    for (i = 0; i < n_frames; i++)
     {
         GroupFrame *frame;
 
@@ -1288,16 +1609,13 @@ group_build_gif (Group *group, GifLoader *loader)
         /* String representation is built on demand and cached */
 
         group->frames = g_list_prepend (group->frames, frame);
-
-        if (!gif_loader_next_frame (loader))
-            break;
     }
 
     group->frames = g_list_reverse (group->frames);
 }
 
 static void
-group_build_xwd (Group *group)
+group_build_single (Group *group)
 {
     GroupFrame *frame;
 
@@ -1340,85 +1658,389 @@ interruptible_usleep (gint us)
     }
 }
 
+/* Writes a scatter-gather list to stdout, bypassing stdio so no
+ * concatenation or buffer copy is needed. Restarts after partial
+ * writes and EINTR. */
 static gboolean
-write_to_stdout (gpointer buf, gsize len)
+write_vec_to_stdout (struct iovec *iov, gint n_iov)
 {
-   return fwrite (buf, 1, len, stdout) == len ? TRUE : FALSE;
+    while (n_iov > 0)
+    {
+        gssize n_written = writev (STDOUT_FILENO, iov, n_iov);
+
+        if (n_written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+
+        while (n_iov > 0 && (gsize) n_written >= iov [0].iov_len)
+        {
+            n_written -= iov [0].iov_len;
+            iov++;
+            n_iov--;
+        }
+
+        if (n_iov > 0)
+        {
+            iov [0].iov_base = (gchar *) iov [0].iov_base + n_written;
+            iov [0].iov_len -= n_written;
+        }
+    }
+
+    return TRUE;
 }
 
-/* FIXME: This function is ripe for refactoring, probably to something with
- * a heap-allocated context. */
-static gboolean
-run_magickwand (const gchar *filename, gboolean is_first_file, gboolean is_first_frame, gboolean quiet)
+/* --- Frame printer --- */
+
+/* Two-deep output pipeline: a writer thread owns stdout and drains one
+ * frame while the main thread converts the next, so a slow sink (e.g. a
+ * throttled SSH session) overlaps with conversion instead of stalling it.
+ * Frame pacing happens on the writer side, where presentation time is
+ * actually known. */
+
+#define FRAME_PRINTER_MAX_PENDING 2
+
+typedef struct
 {
-    MagickWand *wand = NULL;
-    gboolean is_animation = FALSE;
-    gdouble anim_elapsed_s = 0.0;
+    gchar header [CHAFA_TERM_SEQ_LENGTH_MAX * 2 + 1];
+    gint header_len;
+    GString *gs;  /* Owned by the frame group, not by us */
+    guint add_linefeed : 1;
+    guint is_animation : 1;
+    gdouble delay_ms;
+}
+PrintJob;
+
+typedef struct
+{
+    GThread *thread;
+    GAsyncQueue *queue;
+    GMutex mutex;
+    GCond cond;
+    gint n_pending;
+    gdouble anim_elapsed_s;
+    gboolean failed;
     GTimer *timer;
-    Group group = { NULL };
-    GList *l;
-    gint loop_n = 0;
-    FileMapping *file_mapping;
+}
+FramePrinter;
+
+static gpointer
+frame_printer_thread_main (gpointer data)
+{
+    FramePrinter *printer = data;
+
+    for (;;)
+    {
+        PrintJob *job = g_async_queue_pop (printer->queue);
+        gboolean success = FALSE;
+
+        /* The printer struct itself doubles as the quit sentinel */
+        if (job == (PrintJob *) (gpointer) printer)
+            break;
+
+        /* Only this thread ever sets the failure flag, so it can be read
+         * without the lock here */
+        if (!printer->failed)
+        {
+            struct iovec iov [3];
+            gint n_iov = 0;
+
+            if (job->header_len > 0)
+            {
+                iov [n_iov].iov_base = job->header;
+                iov [n_iov].iov_len = job->header_len;
+                n_iov++;
+            }
+
+            iov [n_iov].iov_base = job->gs->str;
+            iov [n_iov].iov_len = job->gs->len;
+            n_iov++;
+
+            if (job->add_linefeed)
+            {
+                iov [n_iov].iov_base = (gchar *) "\n";
+                iov [n_iov].iov_len = 1;
+                n_iov++;
+            }
+
+            success = write_vec_to_stdout (iov, n_iov);
+        }
+
+        g_mutex_lock (&printer->mutex);
+
+        if (success && job->is_animation)
+        {
+            /* Account for time spent converting and printing frame */
+            gdouble elapsed_ms = g_timer_elapsed (printer->timer, NULL) * 1000.0;
+            gdouble remain_ms;
+
+            if (options.anim_fps > 0.0)
+                remain_ms = 1000.0 / options.anim_fps;
+            else
+                remain_ms = job->delay_ms;
+            remain_ms /= options.anim_speed_multiplier;
+            remain_ms = MAX (remain_ms - elapsed_ms, 0);
+
+            printer->anim_elapsed_s += MAX (elapsed_ms, job->delay_ms) / 1000.0;
+            g_mutex_unlock (&printer->mutex);
+
+            if (remain_ms > 0.0001 && 1000.0 / (gdouble) remain_ms < ANIM_FPS_MAX)
+                interruptible_usleep (remain_ms * 1000);
+
+            g_mutex_lock (&printer->mutex);
+        }
+
+        g_timer_start (printer->timer);
+
+        if (!success)
+            printer->failed = TRUE;
+        printer->n_pending--;
+        g_cond_broadcast (&printer->cond);
+        g_mutex_unlock (&printer->mutex);
+
+        g_free (job);
+    }
+
+    return NULL;
+}
+
+static FramePrinter *
+frame_printer_new (void)
+{
+    FramePrinter *printer = g_new0 (FramePrinter, 1);
+
+    g_mutex_init (&printer->mutex);
+    g_cond_init (&printer->cond);
+    printer->queue = g_async_queue_new ();
+    printer->timer = g_timer_new ();
+    printer->thread = g_thread_new ("frame-printer", frame_printer_thread_main, printer);
+
+    return printer;
+}
+
+/* Queues a frame for output, blocking if the pipeline is full. Returns
+ * FALSE if the writer has failed; no more frames will be printed then.
+ * The GString must stay valid until the printer is destroyed. */
+static gboolean
+frame_printer_push (FramePrinter *printer, const gchar *header, gint header_len,
+                    GString *gs, gboolean add_linefeed, gboolean is_animation,
+                    gdouble delay_ms)
+{
+    PrintJob *job;
+    gboolean failed;
+
+    g_mutex_lock (&printer->mutex);
+    while (printer->n_pending >= FRAME_PRINTER_MAX_PENDING && !printer->failed)
+        g_cond_wait (&printer->cond, &printer->mutex);
+    failed = printer->failed;
+    if (!failed)
+        printer->n_pending++;
+    g_mutex_unlock (&printer->mutex);
+
+    if (failed)
+        return FALSE;
+
+    job = g_new0 (PrintJob, 1);
+    memcpy (job->header, header, header_len);
+    job->header_len = header_len;
+    job->gs = gs;
+    job->add_linefeed = add_linefeed;
+    job->is_animation = is_animation;
+    job->delay_ms = delay_ms;
+
+    g_async_queue_push (printer->queue, job);
+    return TRUE;
+}
+
+/* Credits animation time for frames that were never printed (e.g.
+ * dropped by the scheduler) */
+static void
+frame_printer_add_elapsed (FramePrinter *printer, gdouble elapsed_s)
+{
+    g_mutex_lock (&printer->mutex);
+    printer->anim_elapsed_s += elapsed_s;
+    g_mutex_unlock (&printer->mutex);
+}
+
+static gdouble
+frame_printer_get_elapsed_s (FramePrinter *printer)
+{
+    gdouble elapsed_s;
+
+    g_mutex_lock (&printer->mutex);
+    elapsed_s = printer->anim_elapsed_s;
+    g_mutex_unlock (&printer->mutex);
+
+    return elapsed_s;
+}
+
+/* Number of frames queued but not yet written out. When this reaches
+ * FRAME_PRINTER_MAX_PENDING, the sink isn't keeping up and a push
+ * would block. */
+static gint
+frame_printer_get_queue_depth (FramePrinter *printer)
+{
+    gint n_pending;
+
+    g_mutex_lock (&printer->mutex);
+    n_pending = printer->n_pending;
+    g_mutex_unlock (&printer->mutex);
+
+    return n_pending;
+}
+
+/* Drains remaining frames and joins the writer. Returns FALSE if any
+ * frame failed to print. */
+static gboolean
+frame_printer_destroy (FramePrinter *printer)
+{
+    gboolean success;
+
+    g_async_queue_push (printer->queue, (PrintJob *) (gpointer) printer);
+    g_thread_join (printer->thread);
+    success = !printer->failed;
+
+    g_async_queue_unref (printer->queue);
+    g_timer_destroy (printer->timer);
+    g_cond_clear (&printer->cond);
+    g_mutex_clear (&printer->mutex);
+    g_free (printer);
+
+    return success;
+}
+
+/* Decoded (or at least probed and mapped) representation of an input
+ * file, ready for conversion. Exactly one of the decoder fields is
+ * non-NULL on success; on failure all are NULL and error_str may hold
+ * a MagickWand error message. Filling one of these in is the part of
+ * input handling that can run on a worker thread ahead of time. */
+typedef struct
+{
+    GifLoader *gif_loader;
+    JpegLoader *jpeg_loader;
+    PngLoader *png_loader;
     XwdLoader *xwd_loader;
-    gchar buf [CHAFA_TERM_SEQ_LENGTH_MAX * 2 + 1];
-    gchar *p0;
+    MagickWand *wand;
+    gchar *error_str;  /* Allocated by MagickWand */
+}
+DecodedInput;
 
-    timer = g_timer_new ();
+static void
+decode_input (const gchar *filename, DecodedInput *input)
+{
+    FileMapping *file_mapping;
+    PixelWand *color;
+
+    memset (input, 0, sizeof (*input));
 
-    /* Try XWD fast path first */
+    /* Try the built-in loaders first; they're faster than the wand */
 
     file_mapping = file_mapping_new (filename);
-    xwd_loader = xwd_loader_new_from_mapping (file_mapping);
-    if (!xwd_loader)
+    if (file_mapping)
     {
-        PixelWand *color;
+        input->gif_loader = gif_loader_new_from_mapping (file_mapping);
+        if (input->gif_loader)
+            return;
+
+        input->jpeg_loader = jpeg_loader_new_from_mapping (file_mapping);
+        if (input->jpeg_loader)
+            return;
+
+        input->png_loader = png_loader_new_from_mapping (file_mapping);
+        if (input->png_loader)
+            return;
+
+        input->xwd_loader = xwd_loader_new_from_mapping (file_mapping);
+        if (input->xwd_loader)
+            return;
 
         file_mapping_destroy (file_mapping);
-        file_mapping = NULL;
+    }
 
-        wand = NewMagickWand ();
+    input->wand = NewMagickWand ();
 
-        color = NewPixelWand ();
-        PixelSetColor (color, "none");
-        MagickSetBackgroundColor (wand, color);
-        DestroyPixelWand (color);
+    color = NewPixelWand ();
+    PixelSetColor (color, "none");
+    MagickSetBackgroundColor (input->wand, color);
+    DestroyPixelWand (color);
 
-        if (MagickReadImage (wand, filename) < 1)
+    if (MagickReadImage (input->wand, filename) < 1)
+    {
+        ExceptionType severity;
+        gchar *try_filename;
+        gint r;
+
+        input->error_str = MagickGetException (input->wand, &severity);
+
+        /* Try backup strategy for XWD. It's a file type we want to support
+         * due to the fun implications with Xvfb etc. The filenames in use
+         * tend to have no extension, and the file magic isn't very definite,
+         * so ImageMagick doesn't know what to do on its own. */
+        try_filename = g_strdup_printf ("XWD:%s", filename);
+        r = MagickReadImage (input->wand, try_filename);
+        g_free (try_filename);
+
+        if (r < 1)
         {
-            gchar *error_str = NULL;
-            ExceptionType severity;
-            gchar *try_filename;
-            gint r;
-
-            error_str = MagickGetException (wand, &severity);
-
-            /* Try backup strategy for XWD. It's a file type we want to support
-             * due to the fun implications with Xvfb etc. The filenames in use
-             * tend to have no extension, and the file magic isn't very definite,
-             * so ImageMagick doesn't know what to do on its own. */
-            try_filename = g_strdup_printf ("XWD:%s", filename);
-            r = MagickReadImage (wand, try_filename);
-            g_free (try_filename);
-
-            if (r < 1)
-            {
-                if (!quiet)
-                    g_printerr ("%s: Error loading '%s': %s\n",
-                                options.executable_name,
-                                filename,
-                                error_str);
-                MagickRelinquishMemory (error_str);
-                goto out;
-            }
+            input->wand = DestroyMagickWand (input->wand);
+            return;
         }
+
+        MagickRelinquishMemory (input->error_str);
+        input->error_str = NULL;
     }
+}
+
+static void
+decoded_input_clear (DecodedInput *input)
+{
+    if (input->gif_loader)
+        gif_loader_destroy (input->gif_loader);
+    if (input->jpeg_loader)
+        jpeg_loader_destroy (input->jpeg_loader);
+    if (input->png_loader)
+        png_loader_destroy (input->png_loader);
+    if (input->xwd_loader)
+        xwd_loader_destroy (input->xwd_loader);
+    if (input->wand)
+        DestroyMagickWand (input->wand);
+    if (input->error_str)
+        MagickRelinquishMemory (input->error_str);
+    memset (input, 0, sizeof (*input));
+}
+
+/* FIXME: This function is ripe for refactoring, probably to something with
+ * a heap-allocated context. Takes ownership of the decoders in input. */
+static gboolean
+run_magickwand (DecodedInput *input, gboolean is_first_file, gboolean is_first_frame)
+{
+    MagickWand *wand = input->wand;
+    JpegLoader *jpeg_loader = input->jpeg_loader;
+    PngLoader *png_loader = input->png_loader;
+    XwdLoader *xwd_loader = input->xwd_loader;
+    gboolean is_animation = FALSE;
+    FramePrinter *printer = NULL;
+    Group group = { NULL };
+    GList *l;
+    gint loop_n = 0;
+    gchar buf [CHAFA_TERM_SEQ_LENGTH_MAX * 2 + 1];
+    gchar *p0;
+
+    /* We own these now; the wand in particular may be swapped out when
+     * coalescing animation frames */
+    input->wand = NULL;
+    input->jpeg_loader = NULL;
+    input->png_loader = NULL;
+    input->xwd_loader = NULL;
 
     if (interrupted_by_user)
         goto out;
 
-    if (xwd_loader)
+    if (xwd_loader || jpeg_loader || png_loader)
     {
-        group_build_xwd (&group);
+        group_build_single (&group);
     }
     else /* wand */
     {
@@ -1440,6 +2062,8 @@ run_magickwand (const gchar *filename, gboolean is_first_file, gboolean is_first
             goto out;
     }
 
+    printer = frame_printer_new ();
+
     do
     {
         /* Outer loop repeats animation if desired */
@@ -1448,30 +2072,41 @@ run_magickwand (const gchar *filename, gboolean is_first_file, gboolean is_first
             MagickResetIterator (wand);
 
         for (l = group.frames;
-             l && !interrupted_by_user && (loop_n == 0 || anim_elapsed_s < options.file_duration_s);
+             l && !interrupted_by_user
+                 && (loop_n == 0 || frame_printer_get_elapsed_s (printer) < options.file_duration_s);
              l = g_list_next (l))
         {
             GroupFrame *frame = l->data;
-            gdouble elapsed_ms, remain_ms;
 
             if (wand)
                 MagickNextImage (wand);
 
-            g_timer_start (timer);
-
             if (!frame->gs)
             {
                 ChafaPixelType pixel_type;
                 gint src_width, src_height, src_rowstride;
                 const guint8 *pixels;
 
-                if (xwd_loader)
+                if (xwd_loader || jpeg_loader || png_loader)
                 {
-                    pixels = xwd_loader_get_image_data (xwd_loader,
-                                                        &pixel_type,
-                                                        &src_width,
-                                                        &src_height,
-                                                        &src_rowstride);
+                    if (xwd_loader)
+                        pixels = xwd_loader_get_image_data (xwd_loader,
+                                                            &pixel_type,
+                                                            &src_width,
+                                                            &src_height,
+                                                            &src_rowstride);
+                    else if (jpeg_loader)
+                        pixels = jpeg_loader_get_image_data (jpeg_loader,
+                                                             &pixel_type,
+                                                             &src_width,
+                                                             &src_height,
+                                                             &src_rowstride);
+                    else
+                        pixels = png_loader_get_image_data (png_loader,
+                                                            &pixel_type,
+                                                            &src_width,
+                                                            &src_height,
+                                                            &src_rowstride);
 
                     /* FIXME: This shouldn't happen -- but if it does, our
                      * options for handling it gracefully here aren't great.
@@ -1509,7 +2144,9 @@ run_magickwand (const gchar *filename, gboolean is_first_file, gboolean is_first
                                           src_width, src_height, src_rowstride,
                                           frame->dest_width, frame->dest_height);
 
-                if (!xwd_loader)
+                /* The native loaders own their pixel data; only the wand
+                 * export was allocated by us */
+                if (wand)
                     g_free ((void *) pixels);
             }
 
@@ -1536,91 +2173,57 @@ run_magickwand (const gchar *filename, gboolean is_first_file, gboolean is_first
             if (is_first_frame && !options.clear && !is_first_file)
                 *(p0++) = '\n';
 
-            if (!write_to_stdout (buf, p0 - buf))
-                goto out;
-            if (!write_to_stdout (frame->gs->str, frame->gs->len))
-                goto out;
-
             /* No linefeed after frame in sixel mode */
-            if (options.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS
-                || options.pixel_mode == CHAFA_PIXEL_MODE_KITTY
-                || options.pixel_mode == CHAFA_PIXEL_MODE_ITERM2)
-            {
-                if (!write_to_stdout ("\n", 1))
-                    goto out;
-            }
-
-            if (fflush (stdout) != 0)
+            if (!frame_printer_push (printer, buf, p0 - buf, frame->gs,
+                                     options.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS
+                                     || options.pixel_mode == CHAFA_PIXEL_MODE_KITTY
+                                     || options.pixel_mode == CHAFA_PIXEL_MODE_ITERM2,
+                                     is_animation,
+                                     frame->delay_ms))
                 goto out;
 
-            if (is_animation)
-            {
-                /* Account for time spent converting and printing frame */
-                elapsed_ms = g_timer_elapsed (timer, NULL) * 1000.0;
-
-                if (options.anim_fps > 0.0)
-                    remain_ms = 1000.0 / options.anim_fps;
-                else
-                    remain_ms = frame->delay_ms;
-                remain_ms /= options.anim_speed_multiplier;
-                remain_ms = MAX (remain_ms - elapsed_ms, 0);
-
-                if (remain_ms > 0.0001 && 1000.0 / (gdouble) remain_ms < ANIM_FPS_MAX)
-                    interruptible_usleep (remain_ms * 1000);
-
-                anim_elapsed_s += MAX (elapsed_ms, frame->delay_ms) / 1000.0;
-            }
-
             is_first_frame = FALSE;
         }
 
         loop_n++;
     }
     while (is_animation && !interrupted_by_user
-           && !options.watch && anim_elapsed_s < options.file_duration_s);
+           && !options.watch && frame_printer_get_elapsed_s (printer) < options.file_duration_s);
 
 out:
+    /* Drain the writer before freeing the frame strings it may be using */
+    if (printer)
+        frame_printer_destroy (printer);
     if (wand)
         DestroyMagickWand (wand);
+    if (jpeg_loader)
+        jpeg_loader_destroy (jpeg_loader);
+    if (png_loader)
+        png_loader_destroy (png_loader);
     if (xwd_loader)
         xwd_loader_destroy (xwd_loader);
     group_clear (&group);
-    g_timer_destroy (timer);
 
     return is_animation;
 }
 
+/* Takes ownership of the loader */
 static gboolean
-run_gif (const gchar *filename, gboolean is_first_file, gboolean is_first_frame, gboolean *success_out)
+run_gif (GifLoader *loader, gboolean is_first_file, gboolean is_first_frame)
 {
-    FileMapping *mapping = NULL;
-    GifLoader *loader = NULL;
     const guint8 *pixels;
-    gboolean success = FALSE;
     gboolean is_animation = FALSE;
-    gdouble anim_elapsed_s = 0.0;
-    GTimer *timer;
+    FramePrinter *printer = NULL;
     Group group = { NULL };
     GList *l;
     gint loop_n = 0;
+    gint frame_index, loader_pos = 0;
+    gint last_delay_ms = 50;
+    gdouble target_ms = 0.0;
+    GTimer *timer = NULL;
     gchar buf [CHAFA_TERM_SEQ_LENGTH_MAX * 2 + 1];
     gchar *p0;
 
-    timer = g_timer_new ();
-
-    mapping = file_mapping_new (filename);
-    if (!mapping)
-        goto out;
-
-    loader = gif_loader_new_from_mapping (mapping);
-    if (!loader)
-        goto out;
-
-    /* Loader owns the mapping now */
-    mapping = NULL;
-
-    success = TRUE;
-
     if (interrupted_by_user)
         goto out;
 
@@ -1630,23 +2233,64 @@ run_gif (const gchar *filename, gboolean is_first_file, gboolean is_first_frame,
 
     gif_loader_first_frame (loader);
 
+    printer = frame_printer_new ();
+    timer = g_timer_new ();
+
     do
     {
         /* Outer loop repeats animation if desired */
 
-        for (l = group.frames;
-             l && !interrupted_by_user && (loop_n == 0 || anim_elapsed_s < options.file_duration_s);
-             l = g_list_next (l))
+        for (l = group.frames, frame_index = 0;
+             l && !interrupted_by_user
+                 && (loop_n == 0 || frame_printer_get_elapsed_s (printer) < options.file_duration_s);
+             l = g_list_next (l), frame_index++)
         {
             GroupFrame *frame = l->data;
-            gdouble elapsed_ms, remain_ms;
-
-            g_timer_start (timer);
+            gdouble slot_ms;
+            gint est_delay_ms;
+
+            /* Deadline scheduler: every frame has a slot on the wall clock.
+             * If conversion or output fell behind and the slot has already
+             * passed, drop the frame so playback stays realtime instead of
+             * stretching. Dropped frames are still decoded later if needed
+             * for compositing, but never converted or printed. */
+
+            est_delay_ms = frame->delay_ms >= 0 ? frame->delay_ms : last_delay_ms;
+
+            if (options.anim_fps > 0.0)
+                slot_ms = 1000.0 / options.anim_fps;
+            else
+                slot_ms = est_delay_ms;
+            slot_ms /= options.anim_speed_multiplier;
+            target_ms += slot_ms;
+
+            if (is_animation && !is_first_frame
+                && g_timer_elapsed (timer, NULL) * 1000.0 > target_ms)
+            {
+                frame_printer_add_elapsed (printer, est_delay_ms / 1000.0);
+                continue;
+            }
 
             if (!frame->gs)
             {
                 gint src_width, src_height;
 
+                /* If frames were dropped or the animation wrapped, bring the
+                 * decoder up to date first. The skipped frames are composited
+                 * only; no conversion. */
+                if (loader_pos > frame_index)
+                {
+                    gif_loader_first_frame (loader);
+                    loader_pos = 0;
+                }
+                while (loader_pos < frame_index)
+                {
+                    if (!gif_loader_get_frame_data (loader, NULL))
+                        goto out;
+                    gif_loader_next_frame (loader);
+                    loader_pos++;
+                }
+
                 pixels = gif_loader_get_frame_data (loader, &frame->delay_ms);
                 if (!pixels)
                     goto out;
@@ -1671,8 +2315,11 @@ run_gif (const gchar *filename, gboolean is_first_file, gboolean is_first_frame,
                                           frame->dest_width, frame->dest_height);
 
                 gif_loader_next_frame (loader);
+                loader_pos++;
             }
 
+            last_delay_ms = frame->delay_ms;
+
             p0 = buf;
 
             if (options.clear)
@@ -1696,73 +2343,61 @@ run_gif (const gchar *filename, gboolean is_first_file, gboolean is_first_frame,
             if (is_first_frame && !options.clear && !is_first_file)
                 *(p0++) = '\n';
 
-            if (!write_to_stdout (buf, p0 - buf))
-                goto out;
-            if (!write_to_stdout (frame->gs->str, frame->gs->len))
-                goto out;
-
             /* No linefeed after frame in sixel mode */
-            if (options.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS
-                || options.pixel_mode == CHAFA_PIXEL_MODE_KITTY
-                || options.pixel_mode == CHAFA_PIXEL_MODE_ITERM2)
-            {
-                if (!write_to_stdout ("\n", 1))
-                    goto out;
-            }
-
-            if (fflush (stdout) != 0)
+            if (!frame_printer_push (printer, buf, p0 - buf, frame->gs,
+                                     options.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS
+                                     || options.pixel_mode == CHAFA_PIXEL_MODE_KITTY
+                                     || options.pixel_mode == CHAFA_PIXEL_MODE_ITERM2,
+                                     is_animation,
+                                     frame->delay_ms))
                 goto out;
 
-            if (is_animation)
-            {
-                /* Account for time spent converting and printing frame */
-                elapsed_ms = g_timer_elapsed (timer, NULL) * 1000.0;
-
-                if (options.anim_fps > 0.0)
-                    remain_ms = 1000.0 / options.anim_fps;
-                else
-                    remain_ms = frame->delay_ms;
-                remain_ms /= options.anim_speed_multiplier;
-                remain_ms = MAX (remain_ms - elapsed_ms, 0);
-
-                if (remain_ms > 0.0001 && 1000.0 / (gdouble) remain_ms < ANIM_FPS_MAX)
-                    interruptible_usleep (remain_ms * 1000);
-
-                anim_elapsed_s += MAX (elapsed_ms, frame->delay_ms) / 1000.0;
-            }
-
             is_first_frame = FALSE;
         }
 
         loop_n++;
     }
     while (is_animation && !interrupted_by_user
-           && !options.watch && anim_elapsed_s < options.file_duration_s);
+           && !options.watch && frame_printer_get_elapsed_s (printer) < options.file_duration_s);
 
 out:
-    if (loader)
-        gif_loader_destroy (loader);
+    /* Drain the writer before freeing the frame strings it may be using */
+    if (printer)
+        frame_printer_destroy (printer);
+    gif_loader_destroy (loader);
     group_clear (&group);
-    if (mapping)
-        file_mapping_destroy (mapping);
-    g_timer_destroy (timer);
+    if (timer)
+        g_timer_destroy (timer);
 
-    if (success_out)
-        *success_out = success;
     return is_animation;
 }
 
+/* Converts and prints a decoded input, consuming it */
 static gboolean
-run (const gchar *filename, gboolean is_first_file, gboolean is_first_frame, gboolean quiet)
+run (const gchar *filename, DecodedInput *input, gboolean is_first_file, gboolean is_first_frame, gboolean quiet)
 {
-    gboolean is_animation;
-    gboolean success = FALSE;
+    gboolean is_animation = FALSE;
 
-    is_animation = run_gif (filename, is_first_file, is_first_frame, &success);
-    if (success)
-        return is_animation;
+    if (input->gif_loader)
+    {
+        GifLoader *loader = input->gif_loader;
+
+        input->gif_loader = NULL;
+        is_animation = run_gif (loader, is_first_file, is_first_frame);
+    }
+    else if (input->jpeg_loader || input->png_loader || input->xwd_loader || input->wand)
+    {
+        is_animation = run_magickwand (input, is_first_file, is_first_frame);
+    }
+    else if (!quiet)
+    {
+        g_printerr ("%s: Error loading '%s': %s\n",
+                    options.executable_name,
+                    filename,
+                    input->error_str ? input->error_str : "Unknown error");
+    }
 
-    is_animation = run_magickwand (filename, is_first_file, is_first_frame, quiet);
+    decoded_input_clear (input);
     return is_animation;
 }
 
@@ -1772,6 +2407,7 @@ run_watch (const gchar *filename)
     GTimer *timer;
     gboolean is_first_frame = TRUE;
 
+    join_terminal_detection ();
     tty_options_init ();
     MagickWandGenesis ();
     timer = g_timer_new ();
@@ -1782,10 +2418,13 @@ run_watch (const gchar *filename)
 
         if (!stat (filename, &sbuf))
         {
+            DecodedInput input;
+
             /* Sadly we can't rely on timestamps to tell us when to reload
              * the file, since they can take way too long to update. */
 
-            run (filename, TRUE, is_first_frame, TRUE);
+            decode_input (filename, &input);
+            run (filename, &input, TRUE, is_first_frame, TRUE);
             is_first_frame = FALSE;
 
             g_usleep (10000);
@@ -1807,23 +2446,285 @@ run_watch (const gchar *filename)
     return 0;
 }
 
+/* Terminal video sink: reads back-to-back raw frames from stdin into a
+ * reused buffer and converts each with one persistent canvas, so the
+ * per-frame cost is a single conversion. Meant to be fed by e.g.
+ * ffmpeg's rawvideo output. Pacing is left to the producer unless the
+ * user overrides it with --speed. */
 static int
-run_all (GList *filenames)
+run_raw (void)
+{
+    ChafaCanvasConfig *config;
+    ChafaCanvas *canvas;
+    FramePrinter *printer;
+    GString *gs_ring [FRAME_PRINTER_MAX_PENDING + 1] = { NULL };
+    guint8 *frame_buf;
+    gsize frame_size;
+    gint n_channels;
+    gint dest_width, dest_height;
+    gint frame_n = 0;
+    gboolean is_first_frame = TRUE;
+    gchar buf [CHAFA_TERM_SEQ_LENGTH_MAX * 2 + 1];
+    gchar *p0;
+    gint i;
+
+    join_terminal_detection ();
+
+    n_channels = (options.raw_pixel_type == CHAFA_PIXEL_RGB8
+                  || options.raw_pixel_type == CHAFA_PIXEL_BGR8) ? 3 : 4;
+    frame_size = (gsize) options.raw_width * options.raw_height * n_channels;
+    frame_buf = g_malloc (frame_size);
+
+    dest_width = options.width;
+    dest_height = options.height;
+    chafa_calc_canvas_geometry (options.raw_width,
+                                options.raw_height,
+                                &dest_width,
+                                &dest_height,
+                                options.font_ratio,
+                                options.zoom,
+                                options.stretch);
+
+    config = build_config (dest_width, dest_height);
+    canvas = chafa_canvas_new (config);
+
+    tty_options_init ();
+    printer = frame_printer_new ();
+
+    while (!interrupted_by_user
+           && frame_printer_get_elapsed_s (printer) < options.file_duration_s)
+    {
+        GString *gs;
+        gsize n_read = 0;
+        gint slot;
+
+        /* Frames arrive back to back; a short read means the stream ended */
+        while (n_read < frame_size)
+        {
+            gsize n = fread (frame_buf + n_read, 1, frame_size - n_read, stdin);
+            if (n == 0)
+                break;
+            n_read += n;
+        }
+
+        if (n_read < frame_size)
+            break;
+
+        /* If the terminal isn't draining fast enough, drop this frame
+         * before converting it; input keeps arriving regardless, and
+         * stalling here would make playback lag further and further
+         * behind the producer */
+        if (frame_printer_get_queue_depth (printer) >= FRAME_PRINTER_MAX_PENDING)
+            continue;
+
+        chafa_canvas_draw_all_pixels (canvas,
+                                      options.raw_pixel_type,
+                                      frame_buf,
+                                      options.raw_width,
+                                      options.raw_height,
+                                      options.raw_width * n_channels);
+        gs = chafa_canvas_print (canvas, options.term_info);
+
+        /* The writer may still be printing strings from the last
+         * FRAME_PRINTER_MAX_PENDING frames; rotate through one slot more
+         * than that, so the string freed here is guaranteed done with */
+        slot = frame_n % (FRAME_PRINTER_MAX_PENDING + 1);
+        if (gs_ring [slot])
+            g_string_free (gs_ring [slot], TRUE);
+        gs_ring [slot] = gs;
+
+        p0 = buf;
+
+        if (options.clear)
+        {
+            if (is_first_frame)
+            {
+                /* Clear */
+                p0 = chafa_term_info_emit_clear (options.term_info, p0);
+            }
+
+            /* Home cursor between frames */
+            p0 = chafa_term_info_emit_cursor_to_top_left (options.term_info, p0);
+        }
+        else if (!is_first_frame)
+        {
+            /* Cursor up N steps */
+            p0 = chafa_term_info_emit_cursor_up (options.term_info, p0, dest_height);
+        }
+
+        /* No linefeed after frame in sixel mode */
+        if (!frame_printer_push (printer, buf, p0 - buf, gs,
+                                 options.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS
+                                 || options.pixel_mode == CHAFA_PIXEL_MODE_KITTY
+                                 || options.pixel_mode == CHAFA_PIXEL_MODE_ITERM2,
+                                 TRUE,
+                                 0))
+            break;
+
+        is_first_frame = FALSE;
+        frame_n++;
+    }
+
+    /* Drain the writer before freeing the frame strings it may be using */
+    frame_printer_destroy (printer);
+
+    for (i = 0; i < FRAME_PRINTER_MAX_PENDING + 1; i++)
+    {
+        if (gs_ring [i])
+            g_string_free (gs_ring [i], TRUE);
+    }
+
+    chafa_canvas_unref (canvas);
+    chafa_canvas_config_unref (config);
+    g_free (frame_buf);
+    tty_options_deinit ();
+    return 0;
+}
+
+/* --- Input preloader --- */
+
+/* Decode-ahead pipeline for multi-file runs: a worker thread maps and
+ * decodes the next couple of files while the main thread converts and
+ * prints the current one, so decode time overlaps with output time. */
+
+#define PRELOADER_MAX_PENDING 2
+
+typedef struct
 {
+    gchar *filename;  /* Owned by the options list, not by us */
+    DecodedInput input;
+}
+PreloadJob;
+
+typedef struct
+{
+    GThread *thread;
+    GAsyncQueue *queue;
+    GList *filenames;
+    GMutex mutex;
+    GCond cond;
+    gint n_pending;
+    gboolean cancelled;
+}
+Preloader;
+
+static gpointer
+preloader_thread_main (gpointer data)
+{
+    Preloader *preloader = data;
     GList *l;
 
+    for (l = preloader->filenames; l; l = g_list_next (l))
+    {
+        PreloadJob *job;
+        gboolean cancelled;
+
+        g_mutex_lock (&preloader->mutex);
+        while (preloader->n_pending >= PRELOADER_MAX_PENDING && !preloader->cancelled)
+            g_cond_wait (&preloader->cond, &preloader->mutex);
+        cancelled = preloader->cancelled;
+        if (!cancelled)
+            preloader->n_pending++;
+        g_mutex_unlock (&preloader->mutex);
+
+        /* Note: Once we've claimed a slot we must always push a job, or
+         * the main thread could be left waiting for one that never comes */
+        if (cancelled)
+            break;
+
+        job = g_new0 (PreloadJob, 1);
+        job->filename = l->data;
+        decode_input (job->filename, &job->input);
+
+        g_async_queue_push (preloader->queue, job);
+    }
+
+    return NULL;
+}
+
+static Preloader *
+preloader_new (GList *filenames)
+{
+    Preloader *preloader = g_new0 (Preloader, 1);
+
+    g_mutex_init (&preloader->mutex);
+    g_cond_init (&preloader->cond);
+    preloader->queue = g_async_queue_new ();
+    preloader->filenames = filenames;
+    preloader->thread = g_thread_new ("preloader", preloader_thread_main, preloader);
+
+    return preloader;
+}
+
+/* Returns the next decoded file, blocking until it's ready. The caller
+ * must consume job->input and free the job. */
+static PreloadJob *
+preloader_pop (Preloader *preloader)
+{
+    PreloadJob *job;
+
+    job = g_async_queue_pop (preloader->queue);
+
+    g_mutex_lock (&preloader->mutex);
+    preloader->n_pending--;
+    g_cond_broadcast (&preloader->cond);
+    g_mutex_unlock (&preloader->mutex);
+
+    return job;
+}
+
+static void
+preloader_destroy (Preloader *preloader)
+{
+    PreloadJob *job;
+
+    g_mutex_lock (&preloader->mutex);
+    preloader->cancelled = TRUE;
+    g_cond_broadcast (&preloader->cond);
+    g_mutex_unlock (&preloader->mutex);
+
+    g_thread_join (preloader->thread);
+
+    /* Free any decoded files we never got to */
+    while ((job = g_async_queue_try_pop (preloader->queue)))
+    {
+        decoded_input_clear (&job->input);
+        g_free (job);
+    }
+
+    g_async_queue_unref (preloader->queue);
+    g_cond_clear (&preloader->cond);
+    g_mutex_clear (&preloader->mutex);
+    g_free (preloader);
+}
+
+static int
+run_all (GList *filenames)
+{
+    Preloader *preloader;
+    gint n_files, i;
+
     if (!filenames)
         return 0;
 
     tty_options_init ();
     MagickWandGenesis ();
 
-    for (l = filenames; l && !interrupted_by_user; l = g_list_next (l))
+    n_files = g_list_length (filenames);
+    preloader = preloader_new (filenames);
+
+    /* The preloader is now decoding the first file; collect the terminal
+     * detection result while it works */
+    join_terminal_detection ();
+
+    for (i = 0; i < n_files && !interrupted_by_user; i++)
     {
-        gchar *filename = l->data;
+        PreloadJob *job;
         gboolean was_animation;
 
-        was_animation = run (filename, l->prev ? FALSE : TRUE, TRUE, FALSE);
+        job = preloader_pop (preloader);
+        was_animation = run (job->filename, &job->input, i == 0 ? TRUE : FALSE, TRUE, FALSE);
+        g_free (job);
 
         if (!was_animation && options.file_duration_s != G_MAXDOUBLE)
         {
@@ -1831,11 +2732,143 @@ run_all (GList *filenames)
         }
     }
 
+    preloader_destroy (preloader);
+
     MagickWandTerminus ();
     tty_options_deinit ();
     return 0;
 }
 
+/* --- Daemon mode --- */
+
+/* Resident conversion server. A client connects to the unix socket,
+ * writes one file path terminated by a newline, and reads the converted
+ * output until the server closes the connection. Options are fixed at
+ * daemon startup, so prepared symbol maps, terminal info and the worker
+ * pool stay warm across requests, and per-image latency drops to decode
+ * plus conversion. E.g.:
+ *
+ *   chafa --daemon /tmp/chafa.sock &
+ *   printf '%s\n' image.png | nc -U /tmp/chafa.sock
+ */
+
+#define DAEMON_REQUEST_MAX 4096
+#define DAEMON_RECV_TIMEOUT_S 5
+
+static gboolean
+read_request_line (gint fd, gchar *buf, gsize buf_size)
+{
+    gsize len = 0;
+
+    while (len + 1 < buf_size)
+    {
+        gssize n = read (fd, buf + len, 1);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        if (n == 0 || buf [len] == '\n')
+            break;
+        len++;
+    }
+
+    buf [len] = '\0';
+    return len > 0;
+}
+
+static int
+run_daemon (const gchar *socket_path)
+{
+    struct sockaddr_un addr = { 0 };
+    gint listen_fd;
+
+    join_terminal_detection ();
+    MagickWandGenesis ();
+
+    /* Clients routinely disconnect mid-write (e.g. a pager quitting).
+     * Take the EPIPE from write () instead of dying on the signal */
+    signal (SIGPIPE, SIG_IGN);
+
+    if (strlen (socket_path) >= sizeof (addr.sun_path))
+    {
+        g_printerr ("%s: Socket path '%s' is too long.\n",
+                    options.executable_name, socket_path);
+        return 1;
+    }
+
+    listen_fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+    {
+        g_printerr ("%s: Failed to create socket: %s\n",
+                    options.executable_name, strerror (errno));
+        return 1;
+    }
+
+    addr.sun_family = AF_UNIX;
+    strcpy (addr.sun_path, socket_path);
+    unlink (socket_path);
+
+    if (bind (listen_fd, (struct sockaddr *) &addr, sizeof (addr)) < 0
+        || listen (listen_fd, 16) < 0)
+    {
+        g_printerr ("%s: Failed to listen on '%s': %s\n",
+                    options.executable_name, socket_path, strerror (errno));
+        close (listen_fd);
+        return 1;
+    }
+
+    while (!interrupted_by_user)
+    {
+        gchar req [DAEMON_REQUEST_MAX];
+        struct timeval recv_timeout = { DAEMON_RECV_TIMEOUT_S, 0 };
+        gint client_fd;
+
+        client_fd = accept (listen_fd, NULL, NULL);
+        if (client_fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        /* The accept loop is single-threaded; a client that connects but
+         * never finishes its request must not starve the others.
+         * read_request_line () treats the expired timeout like any other
+         * read error and the connection is dropped */
+        setsockopt (client_fd, SOL_SOCKET, SO_RCVTIMEO,
+                    &recv_timeout, sizeof (recv_timeout));
+
+        if (read_request_line (client_fd, req, sizeof (req)))
+        {
+            DecodedInput input;
+            gint saved_stdout;
+
+            /* All output paths write to stdout; point it at the client
+             * for the duration of the request */
+            fflush (stdout);
+            saved_stdout = dup (STDOUT_FILENO);
+            dup2 (client_fd, STDOUT_FILENO);
+
+            decode_input (req, &input);
+            run (req, &input, TRUE, TRUE, FALSE);
+
+            fflush (stdout);
+            dup2 (saved_stdout, STDOUT_FILENO);
+            close (saved_stdout);
+        }
+
+        close (client_fd);
+    }
+
+    close (listen_fd);
+    unlink (socket_path);
+    MagickWandTerminus ();
+    return 0;
+}
+
 static void
 proc_init (void)
 {
@@ -1862,9 +2895,18 @@ main (int argc, char *argv [])
     if (!parse_options (&argc, &argv))
         exit (1);
 
-    ret = options.watch
-        ? run_watch (options.args->data)
-        : run_all (options.args);
+    if (options.daemon_path)
+        ret = run_daemon (options.daemon_path);
+    else if (options.watch)
+        ret = run_watch (options.args->data);
+    else if (options.raw_width > 0)
+        ret = run_raw ();
+    else
+        ret = run_all (options.args);
+
+    /* Normally a no-op; makes sure a detection thread that was never
+     * needed (e.g. empty file list) gets collected before cleanup */
+    join_terminal_detection ();
 
     if (options.symbol_map)
         chafa_symbol_map_unref (options.symbol_map);
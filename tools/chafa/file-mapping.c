@@ -165,6 +165,20 @@ read_file (gint fd, size_t *data_size)
     return buffer;
 }
 
+#ifdef HAVE_MMAP
+static void
+apply_mapping_hints (FileMapping *file_mapping)
+{
+    /* The loaders make a single sequential sweep over the file, and with a
+     * big image the first-touch page faults can dominate. Ask the kernel to
+     * read ahead aggressively and start faulting pages in right away. */
+# ifdef HAVE_POSIX_MADVISE
+    posix_madvise (file_mapping->data, file_mapping->length, POSIX_MADV_SEQUENTIAL);
+    posix_madvise (file_mapping->data, file_mapping->length, POSIX_MADV_WILLNEED);
+# endif
+}
+#endif
+
 static gboolean
 map_or_read_file (FileMapping *file_mapping)
 {
@@ -194,12 +208,17 @@ map_or_read_file (FileMapping *file_mapping)
                                    MAP_SHARED | MAP_NORESERVE,
                                    file_mapping->fd,
                                    0);
+        if (file_mapping->data == MAP_FAILED)
+            file_mapping->data = NULL;
 #endif
     }
 
     if (file_mapping->data)
     {
         file_mapping->is_mmapped = TRUE;
+#ifdef HAVE_MMAP
+        apply_mapping_hints (file_mapping);
+#endif
     }
     else
     {
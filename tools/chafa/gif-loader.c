@@ -34,6 +34,38 @@
 #define BYTES_PER_PIXEL 4
 #define MAX_IMAGE_BYTES (128 * 1024 * 1024)
 
+/* Number of frames the decode thread is allowed to run ahead of the
+ * consumer. Decode and conversion roughly split a frame's budget, so a
+ * small ring is enough to keep both sides busy. */
+#define FRAME_RING_SIZE 4
+
+/* Record a seek snapshot every this many frames. libnsgif can only
+ * decode in order, so a backwards seek restarts from the nearest
+ * snapshot instead of frame zero. */
+#define SEEK_SNAPSHOT_INTERVAL 32
+
+/* Upper bound on recorded snapshots, to cap the memory spent on very
+ * long animations. Seeks beyond the last snapshot still work; they just
+ * re-decode a longer run. */
+#define SEEK_SNAPSHOT_MAX 64
+
+typedef struct
+{
+    guint8 *data;
+    gint frame_index;
+    gint frame_delay;
+}
+DecodedFrame;
+
+/* Copy of the composited frame buffer right after decoding frame_index;
+ * a valid restart point for decoding frame_index + 1 */
+typedef struct
+{
+    gint frame_index;
+    guint8 *data;
+}
+SeekSnapshot;
+
 struct GifLoader
 {
     FileMapping *mapping;
@@ -43,7 +75,28 @@ struct GifLoader
     gif_result code;
     gint current_frame_index;
     guint gif_is_initialized : 1;
-    guint frame_is_decoded : 1;
+
+    /* Decode-ahead state. libnsgif wants frames decoded in order, so a
+     * single producer thread owns the decoder and copies finished frames
+     * into a small ring. The ring always holds a consecutive run of
+     * frames starting with the one the consumer is on. */
+    GThread *decode_thread;
+    GMutex mutex;
+    GCond cond;
+    DecodedFrame frame_ring [FRAME_RING_SIZE];
+    gint ring_head, ring_len;
+    gint next_decode_index;
+    guint decode_failed : 1;
+    guint quit : 1;
+
+    /* Seek index built lazily as frames are first decoded (SeekSnapshot *,
+     * ordered by frame_index). restore_snapshot tells the decode thread to
+     * resume from that snapshot; -1 means none pending. Frames below
+     * deliver_first_index are decoded for their side effects only and not
+     * pushed to the ring. */
+    GPtrArray *snapshots;
+    gint restore_snapshot;
+    gint deliver_first_index;
 };
 
 static void *
@@ -93,6 +146,121 @@ bitmap_modified (void *bitmap)
     g_assert (bitmap != NULL);
 }
 
+/* Called by the decode thread with the mutex held, right after a
+ * successful decode of frame_index */
+static void
+maybe_record_snapshot (GifLoader *loader, gint frame_index)
+{
+    SeekSnapshot *snap;
+    guint i;
+
+    if (frame_index == 0
+        || frame_index % SEEK_SNAPSHOT_INTERVAL != 0
+        || loader->snapshots->len >= SEEK_SNAPSHOT_MAX)
+        return;
+
+    /* After a seek we may decode past this point again */
+    for (i = 0; i < loader->snapshots->len; i++)
+    {
+        snap = g_ptr_array_index (loader->snapshots, i);
+        if (snap->frame_index == frame_index)
+            return;
+    }
+
+    snap = g_new (SeekSnapshot, 1);
+    snap->frame_index = frame_index;
+    snap->data = g_malloc ((gsize) loader->gif.width * loader->gif.height * BYTES_PER_PIXEL);
+    memcpy (snap->data, loader->gif.frame_image,
+            (gsize) loader->gif.width * loader->gif.height * BYTES_PER_PIXEL);
+    g_ptr_array_add (loader->snapshots, snap);
+}
+
+static void
+seek_snapshot_free (gpointer data)
+{
+    SeekSnapshot *snap = data;
+
+    g_free (snap->data);
+    g_free (snap);
+}
+
+static gpointer
+decode_thread_main (gpointer data)
+{
+    GifLoader *loader = data;
+
+    g_mutex_lock (&loader->mutex);
+
+    for (;;)
+    {
+        DecodedFrame *frame;
+        gint frame_index;
+        gif_result code;
+
+        while (!loader->quit
+               && (loader->ring_len >= FRAME_RING_SIZE
+                   || loader->next_decode_index >= (gint) loader->gif.frame_count
+                   || loader->decode_failed))
+            g_cond_wait (&loader->cond, &loader->mutex);
+
+        if (loader->quit)
+            break;
+
+        if (loader->restore_snapshot >= 0)
+        {
+            /* A backwards seek landed on a snapshot; swap its composited
+             * pixels into the decoder and continue from there */
+            SeekSnapshot *snap = g_ptr_array_index (loader->snapshots,
+                                                    loader->restore_snapshot);
+
+            memcpy (loader->gif.frame_image, snap->data,
+                    (gsize) loader->gif.width * loader->gif.height * BYTES_PER_PIXEL);
+            loader->gif.decoded_frame = snap->frame_index;
+            loader->restore_snapshot = -1;
+        }
+
+        frame_index = loader->next_decode_index;
+
+        /* Drop the lock while decoding; the decoder state is only ever
+         * touched by this thread. */
+        g_mutex_unlock (&loader->mutex);
+        code = gif_decode_frame (&loader->gif, frame_index);
+        g_mutex_lock (&loader->mutex);
+
+        /* The consumer may have rewound while we were decoding; if so,
+         * the frame we just produced is stale. */
+        if (loader->next_decode_index != frame_index
+            || loader->restore_snapshot >= 0
+            || loader->quit)
+            continue;
+
+        if (code != GIF_OK)
+        {
+            loader->decode_failed = TRUE;
+            g_cond_broadcast (&loader->cond);
+            continue;
+        }
+
+        maybe_record_snapshot (loader, frame_index);
+
+        if (frame_index >= loader->deliver_first_index)
+        {
+            frame = &loader->frame_ring [(loader->ring_head + loader->ring_len) % FRAME_RING_SIZE];
+            memcpy (frame->data, loader->gif.frame_image,
+                    (gsize) loader->gif.width * loader->gif.height * BYTES_PER_PIXEL);
+            frame->frame_index = frame_index;
+            frame->frame_delay = loader->gif.frames [frame_index].frame_delay;
+            loader->ring_len++;
+        }
+
+        loader->next_decode_index++;
+        g_cond_broadcast (&loader->cond);
+    }
+
+    g_mutex_unlock (&loader->mutex);
+    return NULL;
+}
+
 static GifLoader *
 gif_loader_new (void)
 {
@@ -139,6 +307,25 @@ gif_loader_new_from_mapping (FileMapping *mapping)
     }
     while (code != GIF_OK);
 
+    {
+        gint i;
+
+        g_mutex_init (&loader->mutex);
+        g_cond_init (&loader->cond);
+
+        for (i = 0; i < FRAME_RING_SIZE; i++)
+        {
+            loader->frame_ring [i].data =
+                g_malloc ((gsize) loader->gif.width * loader->gif.height * BYTES_PER_PIXEL);
+            loader->frame_ring [i].frame_index = -1;
+        }
+
+        loader->snapshots = g_ptr_array_new_with_free_func (seek_snapshot_free);
+        loader->restore_snapshot = -1;
+
+        loader->decode_thread = g_thread_new ("gif-decoder", decode_thread_main, loader);
+    }
+
     success = TRUE;
 
 out:
@@ -160,6 +347,25 @@ out:
 void
 gif_loader_destroy (GifLoader *loader)
 {
+    if (loader->decode_thread)
+    {
+        gint i;
+
+        g_mutex_lock (&loader->mutex);
+        loader->quit = TRUE;
+        g_cond_broadcast (&loader->cond);
+        g_mutex_unlock (&loader->mutex);
+
+        g_thread_join (loader->decode_thread);
+
+        for (i = 0; i < FRAME_RING_SIZE; i++)
+            g_free (loader->frame_ring [i].data);
+
+        g_ptr_array_free (loader->snapshots, TRUE);
+        g_cond_clear (&loader->cond);
+        g_mutex_clear (&loader->mutex);
+    }
+
     if (loader->mapping)
         file_mapping_destroy (loader->mapping);
 
@@ -191,21 +397,31 @@ gif_loader_get_n_frames (GifLoader *loader)
 const guint8 *
 gif_loader_get_frame_data (GifLoader *loader, gint *post_frame_delay_hs_out)
 {
+    DecodedFrame *frame;
+    const guint8 *data = NULL;
+
     g_return_val_if_fail (loader != NULL, NULL);
     g_return_val_if_fail (loader->gif_is_initialized, NULL);
 
-    if (!loader->frame_is_decoded)
+    g_mutex_lock (&loader->mutex);
+
+    while (loader->ring_len == 0 && !loader->decode_failed)
+        g_cond_wait (&loader->cond, &loader->mutex);
+
+    if (loader->ring_len > 0)
     {
-        gif_result code = gif_decode_frame (&loader->gif, loader->current_frame_index);
-        if (code != GIF_OK)
-            return NULL;
+        /* The head of the ring is always the consumer's current frame.
+         * It stays reserved until the consumer moves on, so the pointer
+         * remains valid after we drop the lock. */
+        frame = &loader->frame_ring [loader->ring_head];
+
+        if (post_frame_delay_hs_out)
+            *post_frame_delay_hs_out = frame->frame_delay;
+        data = frame->data;
     }
 
-    loader->frame_is_decoded = TRUE;
-
-    if (post_frame_delay_hs_out)
-        *post_frame_delay_hs_out = loader->gif.frames [loader->current_frame_index].frame_delay;
-    return loader->gif.frame_image;
+    g_mutex_unlock (&loader->mutex);
+    return data;
 }
 
 void
@@ -218,7 +434,93 @@ gif_loader_first_frame (GifLoader *loader)
         return;
 
     loader->current_frame_index = 0;
-    loader->frame_is_decoded = FALSE;
+
+    /* Flush the ring and restart decoding from the beginning. Any frame
+     * in flight is discarded by the decode thread when it notices the
+     * index changed under it. */
+    g_mutex_lock (&loader->mutex);
+    loader->ring_len = 0;
+    loader->next_decode_index = 0;
+    loader->deliver_first_index = 0;
+    loader->restore_snapshot = -1;
+    loader->decode_failed = FALSE;
+    g_cond_broadcast (&loader->cond);
+    g_mutex_unlock (&loader->mutex);
+}
+
+gboolean
+gif_loader_goto_frame (GifLoader *loader, gint frame_index)
+{
+    gint best_snapshot = -1;
+    gint best_frame = -1;
+    gint delta;
+    guint i;
+
+    g_return_val_if_fail (loader != NULL, FALSE);
+    g_return_val_if_fail (loader->gif_is_initialized, FALSE);
+
+    if (frame_index < 0 || frame_index >= (gint) loader->gif.frame_count)
+        return FALSE;
+
+    if (frame_index == loader->current_frame_index)
+        return TRUE;
+
+    g_mutex_lock (&loader->mutex);
+
+    delta = frame_index - loader->current_frame_index;
+
+    if (delta > 0 && delta < loader->ring_len)
+    {
+        /* The target is already sitting in the ring; just advance to it */
+        loader->ring_head = (loader->ring_head + delta) % FRAME_RING_SIZE;
+        loader->ring_len -= delta;
+    }
+    else
+    {
+        /* Find the deepest snapshot at or before the target */
+        for (i = 0; i < loader->snapshots->len; i++)
+        {
+            SeekSnapshot *snap = g_ptr_array_index (loader->snapshots, i);
+
+            if (snap->frame_index <= frame_index && snap->frame_index > best_frame)
+            {
+                best_frame = snap->frame_index;
+                best_snapshot = i;
+            }
+        }
+
+        loader->ring_len = 0;
+        loader->decode_failed = FALSE;
+
+        if (delta > 0
+            && loader->next_decode_index <= frame_index
+            && loader->next_decode_index > best_frame + 1)
+        {
+            /* The decoder is already closer than any snapshot; let it
+             * roll forward from where it is */
+            loader->restore_snapshot = -1;
+        }
+        else if (best_snapshot >= 0)
+        {
+            loader->restore_snapshot = best_snapshot;
+            loader->next_decode_index = best_frame + 1;
+        }
+        else
+        {
+            loader->restore_snapshot = -1;
+            loader->next_decode_index = 0;
+        }
+
+        /* Intermediate frames are decoded only to satisfy inter-frame
+         * dependencies; don't deliver them */
+        loader->deliver_first_index = frame_index;
+    }
+
+    g_cond_broadcast (&loader->cond);
+    g_mutex_unlock (&loader->mutex);
+
+    loader->current_frame_index = frame_index;
+    return TRUE;
 }
 
 gboolean
@@ -231,6 +533,22 @@ gif_loader_next_frame (GifLoader *loader)
         return FALSE;
 
     loader->current_frame_index++;
-    loader->frame_is_decoded = FALSE;
+
+    g_mutex_lock (&loader->mutex);
+
+    /* Retire the current frame so the decode thread can reuse its slot.
+     * If it was never fetched, wait for it to show up first; popping out
+     * of order would break the ring's consecutive-run invariant. */
+    while (loader->ring_len == 0 && !loader->decode_failed)
+        g_cond_wait (&loader->cond, &loader->mutex);
+
+    if (loader->ring_len > 0)
+    {
+        loader->ring_head = (loader->ring_head + 1) % FRAME_RING_SIZE;
+        loader->ring_len--;
+        g_cond_broadcast (&loader->cond);
+    }
+
+    g_mutex_unlock (&loader->mutex);
     return TRUE;
 }
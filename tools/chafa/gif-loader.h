@@ -37,6 +37,7 @@ const guint8 *gif_loader_get_frame_data (GifLoader *loader, gint *post_frame_del
 
 void gif_loader_first_frame (GifLoader *loader);
 gboolean gif_loader_next_frame (GifLoader *loader);
+gboolean gif_loader_goto_frame (GifLoader *loader, gint frame_index);
 
 G_END_DECLS
 
@@ -0,0 +1,217 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2018-2021 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that turns images into character art.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Caches the result of rasterizing a font file with --glyph-file, so
+ * repeat invocations skip FreeType entirely. The font loader emits glyphs
+ * as fixed-size fields of fully inked or uninked pixels, so each glyph
+ * packs down to one coverage bit per pixel:
+ *
+ *   magic string
+ *   repeated { u32le char; u8 width; u8 height; coverage bits, row-major }
+ *
+ * Cache files live under the user cache directory, named by a hash of the
+ * font's absolute path, size and mtime; a modified font therefore misses
+ * the cache rather than hitting a stale entry. Malformed or truncated
+ * files are ignored and the caller falls back to the font loader. */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include "glyph-cache.h"
+
+#define GLYPH_CACHE_MAGIC "chafa-glyph-cache-1\n"
+
+/* Glyph fields are small (one or two character cells) */
+#define GLYPH_DIM_MAX 64
+
+struct GlyphCache
+{
+    gchar *path;
+    GString *data;
+};
+
+GlyphCache *
+glyph_cache_new_for_font (const gchar *font_path)
+{
+    GlyphCache *cache;
+    GStatBuf sbuf;
+    gchar *abs_path;
+    gchar *key, *hash;
+
+    if (g_stat (font_path, &sbuf) != 0)
+        return NULL;
+
+    if (g_path_is_absolute (font_path))
+    {
+        abs_path = g_strdup (font_path);
+    }
+    else
+    {
+        gchar *cwd = g_get_current_dir ();
+        abs_path = g_build_filename (cwd, font_path, NULL);
+        g_free (cwd);
+    }
+
+    key = g_strdup_printf ("%s\n%" G_GINT64_FORMAT "\n%" G_GINT64_FORMAT,
+                           abs_path,
+                           (gint64) sbuf.st_size,
+                           (gint64) sbuf.st_mtime);
+    hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+
+    cache = g_new0 (GlyphCache, 1);
+    cache->path = g_build_filename (g_get_user_cache_dir (), "chafa",
+                                    hash, NULL);
+    cache->data = g_string_new (GLYPH_CACHE_MAGIC);
+
+    g_free (hash);
+    g_free (key);
+    g_free (abs_path);
+    return cache;
+}
+
+void
+glyph_cache_destroy (GlyphCache *cache)
+{
+    g_string_free (cache->data, TRUE);
+    g_free (cache->path);
+    g_free (cache);
+}
+
+/* Feeds all cached glyphs to func. Returns FALSE if there is no usable
+ * cache entry, in which case the caller should rasterize the font and
+ * repopulate with glyph_cache_add () + glyph_cache_save (). */
+gboolean
+glyph_cache_try_load (GlyphCache *cache, GlyphCacheLoadFunc func, gpointer user_data)
+{
+    gchar *contents = NULL;
+    gsize len;
+    const guint8 *p, *end;
+    guint32 *pixels;
+    gboolean success = FALSE;
+
+    if (!g_file_get_contents (cache->path, &contents, &len, NULL))
+        return FALSE;
+
+    if (len < strlen (GLYPH_CACHE_MAGIC)
+        || memcmp (contents, GLYPH_CACHE_MAGIC, strlen (GLYPH_CACHE_MAGIC)) != 0)
+        goto out;
+
+    pixels = g_malloc (GLYPH_DIM_MAX * GLYPH_DIM_MAX * sizeof (guint32));
+
+    p = (const guint8 *) contents + strlen (GLYPH_CACHE_MAGIC);
+    end = (const guint8 *) contents + len;
+
+    while (p < end)
+    {
+        guint32 c;
+        gint width, height, n_pixels, n_bytes;
+        gint i;
+
+        if (end - p < 6)
+            break;
+
+        c = (guint32) p [0] | ((guint32) p [1] << 8)
+          | ((guint32) p [2] << 16) | ((guint32) p [3] << 24);
+        width = p [4];
+        height = p [5];
+        p += 6;
+
+        if (width < 1 || width > GLYPH_DIM_MAX
+            || height < 1 || height > GLYPH_DIM_MAX)
+            break;
+
+        n_pixels = width * height;
+        n_bytes = (n_pixels + 7) / 8;
+
+        if (end - p < n_bytes)
+            break;
+
+        for (i = 0; i < n_pixels; i++)
+            pixels [i] = (p [i / 8] & (0x80 >> (i % 8))) ? 0xffffffffu : 0;
+        p += n_bytes;
+
+        func ((gunichar) c, pixels, width, height, user_data);
+    }
+
+    g_free (pixels);
+
+    /* Only a fully consumed file counts; anything else is treated as
+     * corrupt and regenerated */
+    success = (p == end);
+
+out:
+    g_free (contents);
+    return success;
+}
+
+/* bitmap is RGBA8 data as produced by the font loader: every pixel either
+ * fully inked or uninked */
+void
+glyph_cache_add (GlyphCache *cache, gunichar c, gconstpointer bitmap,
+                 gint width, gint height)
+{
+    const guint32 *pixels = bitmap;
+    guint8 rec [6];
+    gint n_pixels, n_bytes;
+    gint i;
+
+    if (width < 1 || width > GLYPH_DIM_MAX
+        || height < 1 || height > GLYPH_DIM_MAX)
+        return;
+
+    rec [0] = c & 0xff;
+    rec [1] = (c >> 8) & 0xff;
+    rec [2] = (c >> 16) & 0xff;
+    rec [3] = (c >> 24) & 0xff;
+    rec [4] = width;
+    rec [5] = height;
+    g_string_append_len (cache->data, (const gchar *) rec, 6);
+
+    n_pixels = width * height;
+    n_bytes = (n_pixels + 7) / 8;
+
+    for (i = 0; i < n_bytes; i++)
+    {
+        guint8 byte = 0;
+        gint j;
+
+        for (j = 0; j < 8 && i * 8 + j < n_pixels; j++)
+        {
+            if (pixels [i * 8 + j])
+                byte |= 0x80 >> j;
+        }
+
+        g_string_append_c (cache->data, byte);
+    }
+}
+
+/* Best-effort; failure to write the cache is not an error */
+void
+glyph_cache_save (GlyphCache *cache)
+{
+    gchar *dir;
+
+    dir = g_path_get_dirname (cache->path);
+    if (g_mkdir_with_parents (dir, 0755) == 0)
+        g_file_set_contents (cache->path, cache->data->str, cache->data->len, NULL);
+    g_free (dir);
+}
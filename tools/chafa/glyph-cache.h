@@ -0,0 +1,45 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2018-2021 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that turns images into character art.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef __GLYPH_CACHE_H__
+#define __GLYPH_CACHE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct GlyphCache GlyphCache;
+
+/* Receives a glyph as RGBA8 pixel data with each pixel either fully inked
+ * (0xffffffff) or uninked (0x00000000), matching the font loader's output */
+typedef void (*GlyphCacheLoadFunc) (gunichar c, gconstpointer bitmap,
+                                    gint width, gint height, gpointer user_data);
+
+GlyphCache *glyph_cache_new_for_font (const gchar *font_path);
+void glyph_cache_destroy (GlyphCache *cache);
+
+gboolean glyph_cache_try_load (GlyphCache *cache, GlyphCacheLoadFunc func, gpointer user_data);
+
+void glyph_cache_add (GlyphCache *cache, gunichar c, gconstpointer bitmap,
+                      gint width, gint height);
+void glyph_cache_save (GlyphCache *cache);
+
+G_END_DECLS
+
+#endif /* __GLYPH_CACHE_H__ */
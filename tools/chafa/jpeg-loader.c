@@ -0,0 +1,184 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2018-2021 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that turns images into character art.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Native JPEG loader built on libjpeg (preferably libjpeg-turbo, which
+ * decodes with SIMD). This skips MagickWand's per-file setup and extra
+ * pixel-export copy for the most common input format. Compiled to a stub
+ * that always declines when libjpeg isn't available; the caller then
+ * falls back to the wand. */
+
+#include "config.h"
+#include <string.h>
+#include <setjmp.h>
+#ifdef HAVE_JPEG
+# include <stdio.h>
+# include <jpeglib.h>
+#endif
+
+#include <chafa.h>
+#include "jpeg-loader.h"
+
+#define DIMENSION_MAX (1 << 28)
+
+struct JpegLoader
+{
+    FileMapping *mapping;
+    guint8 *frame_data;
+    gint width, height, rowstride;
+};
+
+#ifdef HAVE_JPEG
+
+static const guint8 jpeg_magic [3] = { 0xff, 0xd8, 0xff };
+
+typedef struct
+{
+    struct jpeg_error_mgr jerr;
+    jmp_buf setjmp_buffer;
+}
+ErrorManager;
+
+static void
+error_exit (j_common_ptr cinfo)
+{
+    ErrorManager *error_mgr = (ErrorManager *) cinfo->err;
+
+    longjmp (error_mgr->setjmp_buffer, 1);
+}
+
+static void
+output_message (G_GNUC_UNUSED j_common_ptr cinfo)
+{
+    /* Keep libjpeg's warnings off stderr; a broken file simply fails
+     * over to the generic loader */
+}
+
+JpegLoader *
+jpeg_loader_new_from_mapping (FileMapping *mapping)
+{
+    struct jpeg_decompress_struct cinfo;
+    ErrorManager error_mgr;
+    JpegLoader *loader = NULL;
+    const guint8 *file_data;
+    gsize file_data_len;
+    gboolean success = FALSE;
+
+    g_return_val_if_fail (mapping != NULL, NULL);
+
+    if (!file_mapping_has_magic (mapping, 0, jpeg_magic, sizeof (jpeg_magic)))
+        return NULL;
+
+    file_data = file_mapping_get_data (mapping, &file_data_len);
+    if (!file_data)
+        return NULL;
+
+    cinfo.err = jpeg_std_error (&error_mgr.jerr);
+    error_mgr.jerr.error_exit = error_exit;
+    error_mgr.jerr.output_message = output_message;
+
+    if (setjmp (error_mgr.setjmp_buffer))
+        goto out;
+
+    jpeg_create_decompress (&cinfo);
+    jpeg_mem_src (&cinfo, (unsigned char *) file_data, file_data_len);
+
+    if (jpeg_read_header (&cinfo, TRUE) != JPEG_HEADER_OK)
+        goto out;
+
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress (&cinfo);
+
+    if (cinfo.output_components != 3
+        || cinfo.output_width < 1 || cinfo.output_width >= DIMENSION_MAX
+        || cinfo.output_height < 1 || cinfo.output_height >= DIMENSION_MAX)
+        goto out;
+
+    loader = g_new0 (JpegLoader, 1);
+    loader->width = cinfo.output_width;
+    loader->height = cinfo.output_height;
+    loader->rowstride = loader->width * 3;
+    loader->frame_data = g_malloc ((gsize) loader->height * loader->rowstride);
+
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        JSAMPROW row = loader->frame_data
+            + (gsize) cinfo.output_scanline * loader->rowstride;
+
+        if (jpeg_read_scanlines (&cinfo, &row, 1) < 1)
+            goto out;
+    }
+
+    jpeg_finish_decompress (&cinfo);
+    success = TRUE;
+
+out:
+    jpeg_destroy_decompress (&cinfo);
+
+    if (!success)
+    {
+        if (loader)
+        {
+            g_free (loader->frame_data);
+            g_free (loader);
+        }
+        return NULL;
+    }
+
+    /* Loader owns the mapping now */
+    loader->mapping = mapping;
+    return loader;
+}
+
+#else /* !HAVE_JPEG */
+
+JpegLoader *
+jpeg_loader_new_from_mapping (G_GNUC_UNUSED FileMapping *mapping)
+{
+    return NULL;
+}
+
+#endif
+
+void
+jpeg_loader_destroy (JpegLoader *loader)
+{
+    if (loader->mapping)
+        file_mapping_destroy (loader->mapping);
+
+    g_free (loader->frame_data);
+    g_free (loader);
+}
+
+gconstpointer
+jpeg_loader_get_image_data (JpegLoader *loader, ChafaPixelType *pixel_type_out,
+                            gint *width_out, gint *height_out, gint *rowstride_out)
+{
+    g_return_val_if_fail (loader != NULL, NULL);
+
+    if (pixel_type_out)
+        *pixel_type_out = CHAFA_PIXEL_RGB8;
+    if (width_out)
+        *width_out = loader->width;
+    if (height_out)
+        *height_out = loader->height;
+    if (rowstride_out)
+        *rowstride_out = loader->rowstride;
+
+    return loader->frame_data;
+}
@@ -0,0 +1,134 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2018-2021 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that turns images into character art.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Native PNG loader built on libpng's simplified read API, decoding
+ * straight from the file mapping into a single RGBA buffer. Like the
+ * JPEG loader, this is compiled to a stub that always declines when
+ * libpng isn't available, and the caller falls back to MagickWand. */
+
+#include "config.h"
+#include <string.h>
+#ifdef HAVE_PNG
+# include <png.h>
+#endif
+
+#include <chafa.h>
+#include "png-loader.h"
+
+struct PngLoader
+{
+    FileMapping *mapping;
+    guint8 *frame_data;
+    gint width, height, rowstride;
+};
+
+#ifdef HAVE_PNG
+
+static const guint8 png_magic [8] = { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a };
+
+PngLoader *
+png_loader_new_from_mapping (FileMapping *mapping)
+{
+    PngLoader *loader = NULL;
+    png_image image;
+    const guint8 *file_data;
+    gsize file_data_len;
+    guint8 *frame_data;
+
+    g_return_val_if_fail (mapping != NULL, NULL);
+
+    if (!file_mapping_has_magic (mapping, 0, png_magic, sizeof (png_magic)))
+        return NULL;
+
+    file_data = file_mapping_get_data (mapping, &file_data_len);
+    if (!file_data)
+        return NULL;
+
+    memset (&image, 0, sizeof (image));
+    image.version = PNG_IMAGE_VERSION;
+
+    if (!png_image_begin_read_from_memory (&image, file_data, file_data_len))
+        return NULL;
+
+    image.format = PNG_FORMAT_RGBA;
+
+    if (image.width < 1 || image.height < 1
+        || PNG_IMAGE_SIZE (image) / (image.width * 4) != image.height)
+    {
+        png_image_free (&image);
+        return NULL;
+    }
+
+    frame_data = g_malloc (PNG_IMAGE_SIZE (image));
+
+    if (!png_image_finish_read (&image, NULL, frame_data, 0, NULL))
+    {
+        png_image_free (&image);
+        g_free (frame_data);
+        return NULL;
+    }
+
+    loader = g_new0 (PngLoader, 1);
+    loader->width = image.width;
+    loader->height = image.height;
+    loader->rowstride = image.width * 4;
+    loader->frame_data = frame_data;
+
+    /* Loader owns the mapping now */
+    loader->mapping = mapping;
+    return loader;
+}
+
+#else /* !HAVE_PNG */
+
+PngLoader *
+png_loader_new_from_mapping (G_GNUC_UNUSED FileMapping *mapping)
+{
+    return NULL;
+}
+
+#endif
+
+void
+png_loader_destroy (PngLoader *loader)
+{
+    if (loader->mapping)
+        file_mapping_destroy (loader->mapping);
+
+    g_free (loader->frame_data);
+    g_free (loader);
+}
+
+gconstpointer
+png_loader_get_image_data (PngLoader *loader, ChafaPixelType *pixel_type_out,
+                           gint *width_out, gint *height_out, gint *rowstride_out)
+{
+    g_return_val_if_fail (loader != NULL, NULL);
+
+    if (pixel_type_out)
+        *pixel_type_out = CHAFA_PIXEL_RGBA8_UNASSOCIATED;
+    if (width_out)
+        *width_out = loader->width;
+    if (height_out)
+        *height_out = loader->height;
+    if (rowstride_out)
+        *rowstride_out = loader->rowstride;
+
+    return loader->frame_data;
+}
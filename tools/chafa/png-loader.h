@@ -0,0 +1,39 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2018-2021 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that turns images into character art.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef __PNG_LOADER_H__
+#define __PNG_LOADER_H__
+
+#include <glib.h>
+#include <chafa.h>
+#include "file-mapping.h"
+
+G_BEGIN_DECLS
+
+typedef struct PngLoader PngLoader;
+
+PngLoader *png_loader_new_from_mapping (FileMapping *mapping);
+void png_loader_destroy (PngLoader *loader);
+
+gconstpointer png_loader_get_image_data (PngLoader *loader, ChafaPixelType *pixel_type_out,
+                                         gint *width_out, gint *height_out, gint *rowstride_out);
+
+G_END_DECLS
+
+#endif /* __PNG_LOADER_H__ */